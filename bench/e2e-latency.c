@@ -0,0 +1,485 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// End-to-end latency through a real mpv and session bus, in the
+// environment of the shell tests: test/shell/e2e-latency starts mpv with
+// --vo=null --ao=null and the plugin on a private bus (dbus-run-session),
+// then runs this with mpv's JSON IPC socket. Two paths are timed:
+//
+//   method-to-state   PlayPause called on D-Bus until mpv reports the
+//                     changed pause property on its IPC socket
+//   change-to-signal  pause set through the IPC socket until
+//                     PropertiesChanged with the new PlaybackStatus
+//                     arrives from the bus
+//
+// Percentiles are printed in microseconds. With --baseline, the p50 and
+// p99 of each path are compared with a file written by --save, and the
+// run fails when one of them got slower than the tolerance allows.
+//
+// Run with: make -C bench e2e-latency
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#define MPRIS_NAME "org.mpris.MediaPlayer2.mpv"
+#define MPRIS_PATH "/org/mpris/MediaPlayer2"
+#define PLAYER_INTERFACE "org.mpris.MediaPlayer2.Player"
+
+#define WARMUP 100
+#define TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+typedef enum Waiting {
+    WAITING_NONE,
+    WAITING_MPV_PAUSE, // property-change of pause on the IPC socket
+    WAITING_SIGNAL,    // PropertiesChanged with PlaybackStatus
+} Waiting;
+
+typedef struct Probe {
+    GMainContext *context;
+    GDBusConnection *bus;
+    GSocket *ipc;
+    GString *ipc_input;
+    Waiting waiting;
+    gboolean expected_pause;
+    guint replies_pending;
+} Probe;
+
+typedef struct Result {
+    const char *name;
+    gint64 *samples; // sorted
+    int count;
+} Result;
+
+static const int percentiles[][2] = {
+    // per mille, printed name
+    {500, 50}, {900, 90}, {990, 99}, {999, 999},
+};
+
+static int compare_gint64(const void *a, const void *b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+static gint64 percentile(const Result *result, int per_mille)
+{
+    return result->samples[(result->count - 1) * per_mille / 1000];
+}
+
+static void ipc_line(Probe *probe, const char *line)
+{
+    const char *data;
+
+    if (probe->waiting != WAITING_MPV_PAUSE ||
+        !strstr(line, "\"event\":\"property-change\"") ||
+        !strstr(line, "\"name\":\"pause\""))
+    {
+        return;
+    }
+
+    data = strstr(line, "\"data\":");
+    if (data && g_str_has_prefix(data + 7, probe->expected_pause ? "true" : "false"))
+    {
+        probe->waiting = WAITING_NONE;
+    }
+}
+
+static gboolean on_ipc_readable(G_GNUC_UNUSED GSocket *socket,
+                                G_GNUC_UNUSED GIOCondition condition,
+                                gpointer data)
+{
+    Probe *probe = data;
+    char buffer[4096];
+    GError *error = NULL;
+    gssize size = g_socket_receive(probe->ipc, buffer, sizeof(buffer), NULL, &error);
+    char *end;
+
+    if (size <= 0)
+    {
+        g_printerr("mpv IPC socket: %s\n", error ? error->message : "closed");
+        exit(EXIT_FAILURE);
+    }
+
+    g_string_append_len(probe->ipc_input, buffer, size);
+    while ((end = memchr(probe->ipc_input->str, '\n', probe->ipc_input->len)))
+    {
+        *end = '\0';
+        ipc_line(probe, probe->ipc_input->str);
+        g_string_erase(probe->ipc_input, 0, end - probe->ipc_input->str + 1);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_properties_changed(G_GNUC_UNUSED GDBusConnection *connection,
+                                  G_GNUC_UNUSED const char *sender,
+                                  G_GNUC_UNUSED const char *path,
+                                  G_GNUC_UNUSED const char *interface,
+                                  G_GNUC_UNUSED const char *signal,
+                                  GVariant *parameters, gpointer data)
+{
+    Probe *probe = data;
+    GVariant *changed;
+    const char *status;
+
+    if (probe->waiting != WAITING_SIGNAL)
+    {
+        return;
+    }
+
+    g_variant_get(parameters, "(s@a{sv}as)", NULL, &changed, NULL);
+    if (g_variant_lookup(changed, "PlaybackStatus", "&s", &status) &&
+        g_strcmp0(status, probe->expected_pause ? "Paused" : "Playing") == 0)
+    {
+        probe->waiting = WAITING_NONE;
+    }
+    g_variant_unref(changed);
+}
+
+static void on_reply(GObject *source, GAsyncResult *result, gpointer data)
+{
+    Probe *probe = data;
+    GError *error = NULL;
+    GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                    result, &error);
+
+    if (!reply)
+    {
+        g_printerr("PlayPause failed: %s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+    g_variant_unref(reply);
+    probe->replies_pending--;
+}
+
+static gboolean keep_ticking(G_GNUC_UNUSED gpointer data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static void ipc_command(Probe *probe, const char *json)
+{
+    GError *error = NULL;
+    gchar *line = g_strconcat(json, "\n", NULL);
+
+    if (g_socket_send(probe->ipc, line, strlen(line), NULL, &error) < 0)
+    {
+        g_printerr("mpv IPC socket: %s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+    g_free(line);
+}
+
+// Runs the main context until the awaited change arrived
+static void wait_for(Probe *probe, const char *what)
+{
+    gint64 deadline = g_get_monotonic_time() + TIMEOUT_US;
+
+    while (probe->waiting != WAITING_NONE)
+    {
+        if (g_get_monotonic_time() > deadline)
+        {
+            g_printerr("Timed out waiting for %s\n", what);
+            exit(EXIT_FAILURE);
+        }
+        g_main_context_iteration(probe->context, TRUE);
+    }
+}
+
+static gint64 method_to_state(Probe *probe)
+{
+    gint64 start, elapsed;
+
+    probe->expected_pause = !probe->expected_pause;
+    probe->waiting = WAITING_MPV_PAUSE;
+    probe->replies_pending++;
+
+    start = g_get_monotonic_time();
+    g_dbus_connection_call(probe->bus, MPRIS_NAME, MPRIS_PATH, PLAYER_INTERFACE,
+                           "PlayPause", NULL, NULL, G_DBUS_CALL_FLAGS_NONE, -1,
+                           NULL, on_reply, probe);
+    wait_for(probe, "mpv to toggle pause");
+    elapsed = g_get_monotonic_time() - start;
+
+    // The reply follows mpv's acknowledgement, do not let it overlap the
+    // next call
+    while (probe->replies_pending)
+    {
+        g_main_context_iteration(probe->context, TRUE);
+    }
+    return elapsed;
+}
+
+static gint64 change_to_signal(Probe *probe)
+{
+    gint64 start;
+
+    probe->expected_pause = !probe->expected_pause;
+    probe->waiting = WAITING_SIGNAL;
+
+    start = g_get_monotonic_time();
+    ipc_command(probe, probe->expected_pause
+                           ? "{\"command\":[\"set_property\",\"pause\",true]}"
+                           : "{\"command\":[\"set_property\",\"pause\",false]}");
+    wait_for(probe, "PropertiesChanged");
+    return g_get_monotonic_time() - start;
+}
+
+static Result measure(Probe *probe, const char *name, gint64 (*run)(Probe *probe),
+                      int iterations)
+{
+    Result result = {name, g_new(gint64, iterations), iterations};
+
+    for (int i = -WARMUP; i < iterations; i++)
+    {
+        gint64 elapsed = run(probe);
+        if (i >= 0)
+        {
+            result.samples[i] = elapsed;
+        }
+    }
+    qsort(result.samples, iterations, sizeof(gint64), compare_gint64);
+    return result;
+}
+
+static void print_result(const Result *result)
+{
+    printf("%-18s", result->name);
+    for (guint i = 0; i < G_N_ELEMENTS(percentiles); i++)
+    {
+        printf(" %8" G_GINT64_FORMAT, percentile(result, percentiles[i][0]));
+    }
+    printf(" %8" G_GINT64_FORMAT "\n", result->samples[result->count - 1]);
+}
+
+static void save_results(const char *path, const Result *results, guint count)
+{
+    GString *contents = g_string_new("# path percentile microseconds\n");
+    GError *error = NULL;
+
+    for (guint i = 0; i < count; i++)
+    {
+        for (guint j = 0; j < G_N_ELEMENTS(percentiles); j++)
+        {
+            g_string_append_printf(contents, "%s p%d %" G_GINT64_FORMAT "\n",
+                                   results[i].name, percentiles[j][1],
+                                   percentile(&results[i], percentiles[j][0]));
+        }
+    }
+
+    if (!g_file_set_contents(path, contents->str, contents->len, &error))
+    {
+        g_printerr("%s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+    printf("Saved baseline to %s\n", path);
+    g_string_free(contents, TRUE);
+}
+
+// Returns the number of p50 and p99 values slower than the baseline by
+// more than tolerance percent and slack microseconds
+static int compare_results(const char *path, const Result *results, guint count,
+                           double tolerance, gint64 slack)
+{
+    gchar *contents;
+    gchar **lines;
+    GError *error = NULL;
+    int regressions = 0;
+
+    if (!g_file_get_contents(path, &contents, NULL, &error))
+    {
+        g_printerr("%s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+
+    lines = g_strsplit(contents, "\n", -1);
+    for (gchar **line = lines; *line; line++)
+    {
+        char name[64];
+        int which;
+        gint64 baseline;
+
+        if (sscanf(*line, "%63s p%d %" G_GINT64_FORMAT, name, &which, &baseline) != 3 ||
+            (which != 50 && which != 99))
+        {
+            continue;
+        }
+
+        for (guint i = 0; i < count; i++)
+        {
+            gint64 current;
+            if (g_strcmp0(results[i].name, name) != 0)
+            {
+                continue;
+            }
+
+            current = percentile(&results[i], which == 50 ? 500 : 990);
+            if (current > baseline * (1 + tolerance / 100) + slack)
+            {
+                g_printerr("%s p%d regressed: %" G_GINT64_FORMAT " us, baseline %"
+                           G_GINT64_FORMAT " us\n", name, which, current, baseline);
+                regressions++;
+            }
+        }
+    }
+
+    g_strfreev(lines);
+    g_free(contents);
+    return regressions;
+}
+
+static GSocket *connect_ipc(const char *path)
+{
+    GSocketClient *client = g_socket_client_new();
+    GSocketAddress *address = g_unix_socket_address_new(path);
+    GError *error = NULL;
+    GSocketConnection *connection;
+    GSocket *socket;
+
+    connection = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address),
+                                         NULL, &error);
+    g_object_unref(address);
+    g_object_unref(client);
+    if (!connection)
+    {
+        g_printerr("%s: %s\n", path, error->message);
+        exit(EXIT_FAILURE);
+    }
+
+    // The socket outlives the connection object, which would close it
+    socket = g_object_ref(g_socket_connection_get_socket(connection));
+    g_object_set_data_full(G_OBJECT(socket), "connection", connection, g_object_unref);
+    return socket;
+}
+
+int main(int argc, char **argv)
+{
+    Probe probe = {0};
+    GError *error = NULL;
+    GOptionContext *options;
+    GSource *ipc_source, *tick;
+    gchar *ipc_path = NULL, *baseline = NULL, *save = NULL;
+    int iterations = 2000;
+    double tolerance = 25;
+    int slack = 100;
+    int ret = EXIT_SUCCESS;
+    Result results[2];
+    GOptionEntry entries[] = {
+        {"ipc", 0, 0, G_OPTION_ARG_FILENAME, &ipc_path,
+         "mpv's --input-ipc-server socket", "PATH"},
+        {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+         "Samples per path (2000)", "N"},
+        {"baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline,
+         "Fail when slower than the results saved in FILE", "FILE"},
+        {"save", 's', 0, G_OPTION_ARG_FILENAME, &save,
+         "Save the results to FILE as a baseline", "FILE"},
+        {"tolerance", 't', 0, G_OPTION_ARG_DOUBLE, &tolerance,
+         "Allowed slowdown against the baseline in percent (25)", "PERCENT"},
+        {"slack", 0, 0, G_OPTION_ARG_INT, &slack,
+         "Allowed slowdown on top of the tolerance, in microseconds (100)", "US"},
+        {NULL, 0, 0, 0, NULL, NULL, NULL}};
+
+    options = g_option_context_new("- MPRIS end-to-end latency");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (!g_option_context_parse(options, &argc, &argv, &error) || !ipc_path ||
+        iterations <= 0)
+    {
+        g_printerr("%s\n", error ? error->message : "--ipc and a positive --iterations are required");
+        g_option_context_free(options);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(options);
+
+    probe.context = g_main_context_default();
+    probe.ipc_input = g_string_new(NULL);
+    probe.bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if (!probe.bus)
+    {
+        g_printerr("No session bus: %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    g_dbus_connection_signal_subscribe(probe.bus, MPRIS_NAME,
+                                       "org.freedesktop.DBus.Properties",
+                                       "PropertiesChanged", MPRIS_PATH,
+                                       PLAYER_INTERFACE, G_DBUS_SIGNAL_FLAGS_NONE,
+                                       on_properties_changed, &probe, NULL);
+
+    probe.ipc = connect_ipc(ipc_path);
+    ipc_source = g_socket_create_source(probe.ipc, G_IO_IN, NULL);
+    g_source_set_callback(ipc_source, (GSourceFunc)(void (*)(void))on_ipc_readable,
+                          &probe, NULL);
+    g_source_attach(ipc_source, probe.context);
+
+    // Wakes the loop up so that timeouts are noticed
+    tick = g_timeout_source_new(100);
+    g_source_set_callback(tick, keep_ticking, NULL, NULL);
+    g_source_attach(tick, probe.context);
+
+    // The file plays while the paths toggle pause, keep it from ending
+    ipc_command(&probe, "{\"command\":[\"set_property\",\"loop-file\",\"inf\"]}");
+    ipc_command(&probe, "{\"command\":[\"set_property\",\"pause\",true]}");
+    ipc_command(&probe, "{\"command\":[\"observe_property\",1,\"pause\"]}");
+    probe.expected_pause = TRUE;
+    probe.waiting = WAITING_MPV_PAUSE;
+    wait_for(&probe, "mpv to pause");
+
+    results[0] = measure(&probe, "method-to-state", method_to_state, iterations);
+    results[1] = measure(&probe, "change-to-signal", change_to_signal, iterations);
+
+    printf("%-18s %8s %8s %8s %8s %8s   (us, %d samples)\n", "",
+           "p50", "p90", "p99", "p99.9", "max", iterations);
+    for (guint i = 0; i < G_N_ELEMENTS(results); i++)
+    {
+        print_result(&results[i]);
+    }
+
+    if (save)
+    {
+        save_results(save, results, G_N_ELEMENTS(results));
+    }
+    if (baseline && compare_results(baseline, results, G_N_ELEMENTS(results),
+                                    tolerance, slack) > 0)
+    {
+        ret = EXIT_FAILURE;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(results); i++)
+    {
+        g_free(results[i].samples);
+    }
+    g_source_destroy(tick);
+    g_source_unref(tick);
+    g_source_destroy(ipc_source);
+    g_source_unref(ipc_source);
+    g_object_unref(probe.ipc);
+    g_object_unref(probe.bus);
+    g_string_free(probe.ipc_input, TRUE);
+    g_free(ipc_path);
+    g_free(baseline);
+    g_free(save);
+    return ret;
+}
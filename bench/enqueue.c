@@ -0,0 +1,162 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Time to queue many items over D-Bus: one org.mpv.MprisQueue.Enqueue call
+// per URI, as a controller without the extension would do, against a
+// single call carrying all of them.
+//
+// An idle mpv with the built plugin runs on a private bus (dbus-daemon has
+// to be installed). The URIs do not exist, appending them never opens
+// them. Every run checks playlist-count afterwards and clears the
+// playlist.
+//
+// Usage: enqueue.bench [PLUGIN.so], defaults to ../mpris.so
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <gio/gio.h>
+#include <mpv/client.h>
+
+#include "harness.h"
+
+#define ITEMS 500
+#define RUNS 5
+
+static const char *bus_name = "org.mpris.MediaPlayer2.mpv";
+
+static gboolean enqueue(GDBusConnection *bus, const char *const *uris)
+{
+    GError *error = NULL;
+    GVariant *reply;
+
+    reply = g_dbus_connection_call_sync(bus, bus_name, "/org/mpris/MediaPlayer2",
+                                        "org.mpv.MprisQueue", "Enqueue",
+                                        g_variant_new("(^ass)", uris, "append"),
+                                        NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+    if (!reply)
+    {
+        g_printerr("Enqueue failed: %s\n", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    g_variant_unref(reply);
+    return TRUE;
+}
+
+static gint64 run_per_call(GDBusConnection *bus, gchar **uris)
+{
+    gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < ITEMS; i++)
+    {
+        const char *one[] = {uris[i], NULL};
+        if (!enqueue(bus, one))
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+    return g_get_monotonic_time() - start;
+}
+
+static gint64 run_batched(GDBusConnection *bus, gchar **uris)
+{
+    gint64 start = g_get_monotonic_time();
+
+    if (!enqueue(bus, (const char *const *)uris))
+    {
+        exit(EXIT_FAILURE);
+    }
+    return g_get_monotonic_time() - start;
+}
+
+static void check_and_clear(mpv_handle *mpv)
+{
+    int64_t count = 0;
+    const char *clear[] = {"playlist-clear", NULL};
+
+    mpv_get_property(mpv, "playlist-count", MPV_FORMAT_INT64, &count);
+    if (count != ITEMS)
+    {
+        g_printerr("Expected %d playlist entries, found %" PRId64 "\n", ITEMS, count);
+        exit(EXIT_FAILURE);
+    }
+    mpv_command(mpv, clear);
+}
+
+int main(int argc, char **argv)
+{
+    GDBusConnection *bus;
+    gchar **uris = g_new0(gchar *, ITEMS + 1);
+    gchar *plugin;
+    mpv_handle *mpv;
+    gint64 per_call = 0, batched = 0;
+
+    plugin = g_canonicalize_filename(argc > 1 ? argv[1] : "../mpris.so", NULL);
+    if (!g_file_test(plugin, G_FILE_TEST_EXISTS))
+    {
+        g_printerr("%s not found, build the plugin first\n", plugin);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < ITEMS; i++)
+    {
+        uris[i] = g_strdup_printf("/nonexistent/mpv-mpris-bench/track-%04d.flac", i);
+    }
+
+    bus = bench_bus_up();
+
+    mpv = mpv_create();
+    mpv_set_option_string(mpv, "config", "no");
+    mpv_set_option_string(mpv, "load-scripts", "no");
+    mpv_set_option_string(mpv, "scripts", plugin);
+    mpv_set_option_string(mpv, "idle", "yes");
+    mpv_set_option_string(mpv, "vo", "null");
+    mpv_set_option_string(mpv, "ao", "null");
+    if (mpv_initialize(mpv) < 0 || !bench_wait_for_name(bus, bus_name))
+    {
+        g_printerr("Player did not show up on the bus\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        per_call += run_per_call(bus, uris);
+        check_and_clear(mpv);
+        batched += run_batched(bus, uris);
+        check_and_clear(mpv);
+    }
+
+    printf("%-10s %10s %12s   (%d items, mean of %d runs)\n",
+           "", "total us", "us/item", ITEMS, RUNS);
+    printf("%-10s %10" G_GINT64_FORMAT " %12.2f\n", "per call",
+           per_call / RUNS, (double)per_call / RUNS / ITEMS);
+    printf("%-10s %10" G_GINT64_FORMAT " %12.2f\n", "batched",
+           batched / RUNS, (double)batched / RUNS / ITEMS);
+
+    mpv_terminate_destroy(mpv);
+    bench_bus_down(bus);
+    g_strfreev(uris);
+    g_free(plugin);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// CPU time the plugin spends on bursts of property changes, such as a
+// volume fade or a speed ramp. Each burst sets the property from this
+// thread as fast as mpv takes it, then leaves time for the plugin to
+// drain the events and publish the result.
+//
+// The same bursts run against an idle mpv without the plugin and with it
+// (on a private bus, dbus-daemon has to be installed). The difference in
+// process CPU time is what the plugin costs.
+//
+// Usage: event-burst.bench [PLUGIN.so], defaults to ../mpris.so
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <gio/gio.h>
+#include <mpv/client.h>
+
+#include "harness.h"
+
+#define BURSTS 100
+#define CHANGES_PER_BURST 200
+#define SETTLE_US 20000
+
+static gint64 process_cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static mpv_handle *start_mpv(const char *plugin)
+{
+    mpv_handle *mpv = mpv_create();
+
+    mpv_set_option_string(mpv, "config", "no");
+    mpv_set_option_string(mpv, "load-scripts", "no");
+    if (plugin)
+    {
+        mpv_set_option_string(mpv, "scripts", plugin);
+    }
+    mpv_set_option_string(mpv, "idle", "yes");
+    mpv_set_option_string(mpv, "vo", "null");
+    mpv_set_option_string(mpv, "ao", "null");
+    if (mpv_initialize(mpv) < 0)
+    {
+        g_printerr("Failed to start mpv\n");
+        exit(EXIT_FAILURE);
+    }
+    // Let the plugin register before measuring
+    g_usleep(200000);
+    return mpv;
+}
+
+// CPU ns per burst, settling time included
+static gint64 run_bursts(mpv_handle *mpv, const char *property, double from, double to)
+{
+    gint64 start = process_cpu_ns();
+
+    for (int burst = 0; burst < BURSTS; burst++)
+    {
+        for (int i = 0; i < CHANGES_PER_BURST; i++)
+        {
+            double value = from + (to - from) * i / (CHANGES_PER_BURST - 1);
+            mpv_set_property(mpv, property, MPV_FORMAT_DOUBLE, &value);
+        }
+        g_usleep(SETTLE_US);
+    }
+
+    return (process_cpu_ns() - start) / BURSTS;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        const char *property;
+        double from, to;
+    } scenarios[] = {
+        {"volume fade", "volume", 100, 0},
+        {"speed ramp", "speed", 0.5, 2},
+    };
+    GDBusConnection *bus;
+    gchar *plugin;
+    mpv_handle *bare, *with_plugin;
+
+    plugin = g_canonicalize_filename(argc > 1 ? argv[1] : "../mpris.so", NULL);
+    if (!g_file_test(plugin, G_FILE_TEST_EXISTS))
+    {
+        g_printerr("%s not found, build the plugin first\n", plugin);
+        return EXIT_FAILURE;
+    }
+
+    bus = bench_bus_up();
+
+    bare = start_mpv(NULL);
+    with_plugin = start_mpv(plugin);
+
+    printf("%-12s %12s %12s %12s   (%d changes per burst, %d bursts)\n",
+           "", "mpv us", "plugin us", "ns/change", CHANGES_PER_BURST, BURSTS);
+    for (guint i = 0; i < G_N_ELEMENTS(scenarios); i++)
+    {
+        gint64 base = run_bursts(bare, scenarios[i].property,
+                                 scenarios[i].from, scenarios[i].to);
+        gint64 total = run_bursts(with_plugin, scenarios[i].property,
+                                  scenarios[i].from, scenarios[i].to);
+        gint64 plugin_ns = total > base ? total - base : 0;
+
+        printf("%-12s %12.1f %12.1f %12.1f\n", scenarios[i].name,
+               base / 1000.0, plugin_ns / 1000.0,
+               (double)plugin_ns / CHANGES_PER_BURST);
+    }
+
+    mpv_terminate_destroy(with_plugin);
+    mpv_terminate_destroy(bare);
+    bench_bus_down(bus);
+    g_free(plugin);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,824 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fake-mpv.h"
+
+#define METADATA_PREFIX "metadata/by-key/"
+
+typedef struct FakeEvent {
+    mpv_event_id event_id;
+    guint64 reply_userdata;
+    int error;
+    gchar *name;   // of the property, for property events
+    mpv_format format;
+    gchar *value;  // NULL when unavailable
+    gint64 due;    // monotonic time it can be delivered at
+} FakeEvent;
+
+typedef struct Observer {
+    guint64 id;
+    gchar *name;
+    mpv_format format;
+} Observer;
+
+struct mpv_handle {
+    GMutex lock;
+    GCond changed; // an event was queued or taken, or the handle is freed
+    GHashTable *properties;  // name -> value
+    GHashTable *script_opts; // mpris-name -> value
+    GArray *observers;
+    GQueue events;
+    void (*wakeup)(void *data);
+    void *wakeup_data;
+    gint64 reply_delay_us;
+    FakeMpvCommandFunc command_func;
+    gpointer command_data;
+    guint64 requests;
+    GThread *timer;
+    gboolean stopping;
+
+    // What mpv_wait_event() returned last, valid until it is called again
+    mpv_event event;
+    mpv_event_property property;
+    union {
+        int flag;
+        int64_t int64;
+        double number;
+        char *string;
+        mpv_node node;
+    } value;
+    gchar *property_name;
+};
+
+static const char *const error_strings[] = {
+    [-MPV_ERROR_SUCCESS] = "success",
+    [-MPV_ERROR_EVENT_QUEUE_FULL] = "event queue full",
+    [-MPV_ERROR_NOMEM] = "memory allocation failed",
+    [-MPV_ERROR_INVALID_PARAMETER] = "invalid parameter",
+    [-MPV_ERROR_OPTION_NOT_FOUND] = "option not found",
+    [-MPV_ERROR_PROPERTY_NOT_FOUND] = "property not found",
+    [-MPV_ERROR_PROPERTY_FORMAT] = "unsupported format for accessing property",
+    [-MPV_ERROR_PROPERTY_UNAVAILABLE] = "property unavailable",
+    [-MPV_ERROR_PROPERTY_ERROR] = "error accessing property",
+    [-MPV_ERROR_COMMAND] = "error running command",
+    [-MPV_ERROR_UNSUPPORTED] = "operation not implemented",
+    [-MPV_ERROR_GENERIC] = "something happened",
+};
+
+static void fake_event_free(FakeEvent *event)
+{
+    g_free(event->name);
+    g_free(event->value);
+    g_free(event);
+}
+
+static void wake_locked(mpv_handle *mpv)
+{
+    g_cond_broadcast(&mpv->changed);
+    if (mpv->wakeup)
+    {
+        mpv->wakeup(mpv->wakeup_data);
+    }
+}
+
+static void queue_locked(mpv_handle *mpv, FakeEvent *event)
+{
+    g_queue_push_tail(&mpv->events, event);
+    wake_locked(mpv);
+}
+
+static void queue_event_locked(mpv_handle *mpv, mpv_event_id event_id)
+{
+    FakeEvent *event = g_new0(FakeEvent, 1);
+
+    event->event_id = event_id;
+    queue_locked(mpv, event);
+}
+
+// Requests are answered after the reply delay
+static void queue_reply_locked(mpv_handle *mpv, mpv_event_id event_id,
+                               guint64 id, int error)
+{
+    FakeEvent *event = g_new0(FakeEvent, 1);
+
+    event->event_id = event_id;
+    event->reply_userdata = id;
+    event->error = error;
+    if (mpv->reply_delay_us)
+    {
+        event->due = g_get_monotonic_time() + mpv->reply_delay_us;
+    }
+    queue_locked(mpv, event);
+}
+
+static void notify_locked(mpv_handle *mpv, const char *name, const char *value)
+{
+    for (guint i = 0; i < mpv->observers->len; i++)
+    {
+        Observer *observer = &g_array_index(mpv->observers, Observer, i);
+        if (g_strcmp0(observer->name, name) == 0)
+        {
+            FakeEvent *event = g_new0(FakeEvent, 1);
+            event->event_id = MPV_EVENT_PROPERTY_CHANGE;
+            event->reply_userdata = observer->id;
+            event->name = g_strdup(name);
+            event->format = observer->format;
+            event->value = g_strdup(value);
+            queue_locked(mpv, event);
+        }
+    }
+}
+
+static void set_locked(mpv_handle *mpv, const char *name, const char *value)
+{
+    if (value)
+    {
+        g_hash_table_replace(mpv->properties, g_strdup(name), g_strdup(value));
+    }
+    else
+    {
+        g_hash_table_remove(mpv->properties, name);
+    }
+
+    notify_locked(mpv, name, value);
+    if (g_str_has_prefix(name, METADATA_PREFIX))
+    {
+        notify_locked(mpv, "metadata", NULL);
+    }
+}
+
+// The metadata property as a node map, made of the metadata/by-key/ ones
+static void metadata_node_locked(mpv_handle *mpv, mpv_node *node)
+{
+    mpv_node_list *list = g_new0(mpv_node_list, 1);
+    GHashTableIter iter;
+    gpointer key, value;
+    int i = 0;
+
+    list->keys = g_new0(char *, g_hash_table_size(mpv->properties));
+    list->values = g_new0(mpv_node, g_hash_table_size(mpv->properties));
+    g_hash_table_iter_init(&iter, mpv->properties);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (g_str_has_prefix(key, METADATA_PREFIX))
+        {
+            list->keys[i] = g_strdup((char *)key + strlen(METADATA_PREFIX));
+            list->values[i].format = MPV_FORMAT_STRING;
+            list->values[i].u.string = g_strdup(value);
+            i++;
+        }
+    }
+    list->num = i;
+    node->format = MPV_FORMAT_NODE_MAP;
+    node->u.list = list;
+}
+
+static gint64 get_int64_locked(mpv_handle *mpv, const char *name, gint64 fallback)
+{
+    const char *value = g_hash_table_lookup(mpv->properties, name);
+
+    return value ? g_ascii_strtoll(value, NULL, 10) : fallback;
+}
+
+static void set_int64_locked(mpv_handle *mpv, const char *name, gint64 value)
+{
+    gchar *str = g_strdup_printf("%" G_GINT64_FORMAT, value);
+
+    set_locked(mpv, name, str);
+    g_free(str);
+}
+
+// Converts a stored value to format, as mpv would
+static int convert(const char *value, mpv_format format, void *data)
+{
+    char *end;
+
+    if (!value)
+    {
+        return MPV_ERROR_PROPERTY_UNAVAILABLE;
+    }
+
+    switch (format)
+    {
+    case MPV_FORMAT_NONE:
+        return MPV_ERROR_SUCCESS;
+    case MPV_FORMAT_STRING:
+        *(char **)data = g_strdup(value);
+        return MPV_ERROR_SUCCESS;
+    case MPV_FORMAT_FLAG:
+        if (strcmp(value, "yes") != 0 && strcmp(value, "no") != 0)
+        {
+            return MPV_ERROR_PROPERTY_FORMAT;
+        }
+        *(int *)data = strcmp(value, "yes") == 0;
+        return MPV_ERROR_SUCCESS;
+    case MPV_FORMAT_INT64:
+        *(int64_t *)data = (int64_t)g_ascii_strtod(value, &end);
+        break;
+    case MPV_FORMAT_DOUBLE:
+        *(double *)data = g_ascii_strtod(value, &end);
+        break;
+    default:
+        return MPV_ERROR_PROPERTY_FORMAT;
+    }
+
+    return end == value || *end ? MPV_ERROR_PROPERTY_FORMAT : MPV_ERROR_SUCCESS;
+}
+
+// The reverse, for mpv_set_property_async()
+static gchar *format_value(mpv_format format, void *data)
+{
+    switch (format)
+    {
+    case MPV_FORMAT_STRING:
+        return g_strdup(*(char **)data);
+    case MPV_FORMAT_FLAG:
+        return g_strdup(*(int *)data ? "yes" : "no");
+    case MPV_FORMAT_INT64:
+        return g_strdup_printf("%" G_GINT64_FORMAT, (gint64) * (int64_t *)data);
+    case MPV_FORMAT_DOUBLE:
+        return g_strdup_printf("%f", *(double *)data);
+    default:
+        return NULL;
+    }
+}
+
+// Wakes the client up when a delayed reply becomes due
+static gpointer run_timer(gpointer data)
+{
+    mpv_handle *mpv = data;
+    gint64 woken_for = 0;
+
+    g_mutex_lock(&mpv->lock);
+    while (!mpv->stopping)
+    {
+        FakeEvent *head = g_queue_peek_head(&mpv->events);
+        gint64 now = g_get_monotonic_time();
+
+        if (!head || head->due == woken_for)
+        {
+            g_cond_wait(&mpv->changed, &mpv->lock);
+        }
+        else if (head->due > now)
+        {
+            g_cond_wait_until(&mpv->changed, &mpv->lock, head->due);
+        }
+        else
+        {
+            woken_for = head->due;
+            if (mpv->wakeup)
+            {
+                mpv->wakeup(mpv->wakeup_data);
+            }
+        }
+    }
+    g_mutex_unlock(&mpv->lock);
+    return NULL;
+}
+
+mpv_handle *fake_mpv_new(void)
+{
+    mpv_handle *mpv = g_new0(mpv_handle, 1);
+    gchar *cwd = g_get_current_dir();
+    const char *defaults[][2] = {
+        {"pause", "no"},
+        {"idle-active", "yes"},
+        {"speed", "1.000000"},
+        {"volume", "100.000000"},
+        {"loop-file", "no"},
+        {"loop-playlist", "no"},
+        {"shuffle", "no"},
+        {"fullscreen", "no"},
+        {"vo-configured", "no"},
+        {"playlist-pos", "-1"},
+        {"playlist-count", "0"},
+        {"working-directory", cwd},
+    };
+
+    g_mutex_init(&mpv->lock);
+    g_cond_init(&mpv->changed);
+    mpv->properties = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    mpv->script_opts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    mpv->observers = g_array_new(FALSE, FALSE, sizeof(Observer));
+    g_queue_init(&mpv->events);
+    for (guint i = 0; i < G_N_ELEMENTS(defaults); i++)
+    {
+        g_hash_table_insert(mpv->properties, g_strdup(defaults[i][0]),
+                            g_strdup(defaults[i][1]));
+    }
+    mpv->timer = g_thread_new("fake-mpv-timer", run_timer, mpv);
+
+    g_free(cwd);
+    return mpv;
+}
+
+void fake_mpv_free(mpv_handle *mpv)
+{
+    g_mutex_lock(&mpv->lock);
+    mpv->stopping = TRUE;
+    g_cond_broadcast(&mpv->changed);
+    g_mutex_unlock(&mpv->lock);
+    g_thread_join(mpv->timer);
+
+    for (guint i = 0; i < mpv->observers->len; i++)
+    {
+        g_free(g_array_index(mpv->observers, Observer, i).name);
+    }
+    g_array_unref(mpv->observers);
+    g_queue_clear_full(&mpv->events, (GDestroyNotify)fake_event_free);
+    g_hash_table_unref(mpv->properties);
+    g_hash_table_unref(mpv->script_opts);
+    if (mpv->property.format == MPV_FORMAT_STRING)
+    {
+        g_free(mpv->value.string);
+    }
+    else if (mpv->property.format == MPV_FORMAT_NODE)
+    {
+        mpv_free_node_contents(&mpv->value.node);
+    }
+    g_free(mpv->property_name);
+    g_cond_clear(&mpv->changed);
+    g_mutex_clear(&mpv->lock);
+    g_free(mpv);
+}
+
+void fake_mpv_set(mpv_handle *mpv, const char *name, const char *value)
+{
+    g_mutex_lock(&mpv->lock);
+    set_locked(mpv, name, value);
+    g_mutex_unlock(&mpv->lock);
+}
+
+void fake_mpv_set_int64(mpv_handle *mpv, const char *name, gint64 value)
+{
+    g_mutex_lock(&mpv->lock);
+    set_int64_locked(mpv, name, value);
+    g_mutex_unlock(&mpv->lock);
+}
+
+void fake_mpv_set_double(mpv_handle *mpv, const char *name, double value)
+{
+    gchar *str = g_strdup_printf("%f", value);
+
+    fake_mpv_set(mpv, name, str);
+    g_free(str);
+}
+
+void fake_mpv_set_script_opt(mpv_handle *mpv, const char *name, const char *value)
+{
+    g_mutex_lock(&mpv->lock);
+    g_hash_table_replace(mpv->script_opts, g_strconcat("mpris-", name, NULL),
+                         g_strdup(value));
+    g_mutex_unlock(&mpv->lock);
+}
+
+void fake_mpv_event(mpv_handle *mpv, mpv_event_id event_id)
+{
+    g_mutex_lock(&mpv->lock);
+    queue_event_locked(mpv, event_id);
+    g_mutex_unlock(&mpv->lock);
+}
+
+void fake_mpv_load(mpv_handle *mpv, gint64 playlist_pos, const char *path)
+{
+    gchar *title = g_path_get_basename(path);
+
+    g_mutex_lock(&mpv->lock);
+    queue_event_locked(mpv, MPV_EVENT_START_FILE);
+    set_int64_locked(mpv, "playlist-pos", playlist_pos);
+    if (get_int64_locked(mpv, "playlist-count", 0) <= playlist_pos)
+    {
+        set_int64_locked(mpv, "playlist-count", playlist_pos + 1);
+    }
+    set_locked(mpv, "path", path);
+    set_locked(mpv, "media-title", title);
+    set_locked(mpv, "idle-active", "no");
+    queue_event_locked(mpv, MPV_EVENT_FILE_LOADED);
+    set_locked(mpv, "time-pos", "0.000000");
+    queue_event_locked(mpv, MPV_EVENT_PLAYBACK_RESTART);
+    g_mutex_unlock(&mpv->lock);
+
+    g_free(title);
+}
+
+void fake_mpv_shutdown(mpv_handle *mpv)
+{
+    fake_mpv_event(mpv, MPV_EVENT_SHUTDOWN);
+}
+
+void fake_mpv_set_reply_delay(mpv_handle *mpv, gint64 delay_us)
+{
+    g_mutex_lock(&mpv->lock);
+    mpv->reply_delay_us = delay_us;
+    g_mutex_unlock(&mpv->lock);
+}
+
+void fake_mpv_set_command_handler(mpv_handle *mpv, FakeMpvCommandFunc func,
+                                  gpointer data)
+{
+    g_mutex_lock(&mpv->lock);
+    mpv->command_func = func;
+    mpv->command_data = data;
+    g_mutex_unlock(&mpv->lock);
+}
+
+guint fake_mpv_pending_events(mpv_handle *mpv)
+{
+    guint length;
+
+    g_mutex_lock(&mpv->lock);
+    length = g_queue_get_length(&mpv->events);
+    g_mutex_unlock(&mpv->lock);
+    return length;
+}
+
+gboolean fake_mpv_wait_drained(mpv_handle *mpv, gint64 timeout_us)
+{
+    gint64 deadline = g_get_monotonic_time() + timeout_us;
+    gboolean drained = TRUE;
+
+    g_mutex_lock(&mpv->lock);
+    while (drained && !g_queue_is_empty(&mpv->events))
+    {
+        drained = g_cond_wait_until(&mpv->changed, &mpv->lock, deadline);
+    }
+    g_mutex_unlock(&mpv->lock);
+    return drained;
+}
+
+guint64 fake_mpv_requests(mpv_handle *mpv)
+{
+    guint64 requests;
+
+    g_mutex_lock(&mpv->lock);
+    requests = mpv->requests;
+    g_mutex_unlock(&mpv->lock);
+    return requests;
+}
+
+// Built-in commands, -1 for the ones left to the command handler
+static int run_builtin_locked(mpv_handle *mpv, const char **args)
+{
+    gint64 pos = get_int64_locked(mpv, "playlist-pos", -1);
+    gint64 count = get_int64_locked(mpv, "playlist-count", 0);
+
+    if (g_strcmp0(args[0], "loadfile") == 0 && args[1])
+    {
+        if (!args[2] || g_strcmp0(args[2], "replace") == 0)
+        {
+            set_int64_locked(mpv, "playlist-count", 1);
+            set_int64_locked(mpv, "playlist-pos", 0);
+        }
+        else
+        {
+            set_int64_locked(mpv, "playlist-count", count + 1);
+        }
+        return MPV_ERROR_SUCCESS;
+    }
+    if (g_strcmp0(args[0], "playlist-next") == 0 ||
+        g_strcmp0(args[0], "playlist-prev") == 0 ||
+        g_strcmp0(args[0], "playlist-play-index") == 0)
+    {
+        gint64 next = args[0][9] == 'n' ? pos + 1
+                    : args[0][9] == 'p' && args[0][10] == 'r' ? pos - 1
+                    : args[1] ? g_ascii_strtoll(args[1], NULL, 10) : -1;
+        if (next < 0 || next >= count)
+        {
+            return MPV_ERROR_COMMAND;
+        }
+        set_int64_locked(mpv, "playlist-pos", next);
+        return MPV_ERROR_SUCCESS;
+    }
+    if (g_strcmp0(args[0], "stop") == 0)
+    {
+        queue_event_locked(mpv, MPV_EVENT_END_FILE);
+        set_int64_locked(mpv, "playlist-pos", -1);
+        set_locked(mpv, "idle-active", "yes");
+        return MPV_ERROR_SUCCESS;
+    }
+    if (g_strcmp0(args[0], "seek") == 0 && args[1])
+    {
+        const char *now = g_hash_table_lookup(mpv->properties, "time-pos");
+        double target = g_ascii_strtod(args[1], NULL);
+        gchar *value;
+
+        if (!now)
+        {
+            return MPV_ERROR_COMMAND;
+        }
+        if (!args[2] || !strstr(args[2], "absolute"))
+        {
+            target += g_ascii_strtod(now, NULL);
+        }
+        value = g_strdup_printf("%f", MAX(target, 0));
+        queue_event_locked(mpv, MPV_EVENT_SEEK);
+        set_locked(mpv, "time-pos", value);
+        queue_event_locked(mpv, MPV_EVENT_PLAYBACK_RESTART);
+        g_free(value);
+        return MPV_ERROR_SUCCESS;
+    }
+    if (g_strcmp0(args[0], "quit") == 0)
+    {
+        queue_event_locked(mpv, MPV_EVENT_SHUTDOWN);
+        return MPV_ERROR_SUCCESS;
+    }
+    return -1;
+}
+
+// libmpv client API
+
+void mpv_set_wakeup_callback(mpv_handle *ctx, void (*cb)(void *d), void *d)
+{
+    g_mutex_lock(&ctx->lock);
+    ctx->wakeup = cb;
+    ctx->wakeup_data = d;
+    g_mutex_unlock(&ctx->lock);
+}
+
+int mpv_observe_property(mpv_handle *mpv, uint64_t reply_userdata,
+                         const char *name, mpv_format format)
+{
+    Observer observer = {reply_userdata, g_strdup(name), format};
+    FakeEvent *event = g_new0(FakeEvent, 1);
+
+    g_mutex_lock(&mpv->lock);
+    g_array_append_val(mpv->observers, observer);
+
+    // Like mpv, report the current value first
+    event->event_id = MPV_EVENT_PROPERTY_CHANGE;
+    event->reply_userdata = reply_userdata;
+    event->name = g_strdup(name);
+    event->format = format;
+    event->value = g_strdup(g_hash_table_lookup(mpv->properties, name));
+    queue_locked(mpv, event);
+    g_mutex_unlock(&mpv->lock);
+    return MPV_ERROR_SUCCESS;
+}
+
+mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
+{
+    gint64 deadline = g_get_monotonic_time() + (gint64)(timeout * G_USEC_PER_SEC);
+    FakeEvent *event;
+
+    g_mutex_lock(&ctx->lock);
+
+    if (ctx->property.format == MPV_FORMAT_STRING)
+    {
+        g_free(ctx->value.string);
+    }
+    else if (ctx->property.format == MPV_FORMAT_NODE)
+    {
+        mpv_free_node_contents(&ctx->value.node);
+    }
+    g_clear_pointer(&ctx->property_name, g_free);
+    memset(&ctx->event, 0, sizeof(ctx->event));
+    memset(&ctx->property, 0, sizeof(ctx->property));
+
+    for (;;)
+    {
+        gint64 now = g_get_monotonic_time();
+        event = g_queue_peek_head(&ctx->events);
+        if (event && event->due <= now)
+        {
+            break;
+        }
+        if (timeout == 0 || (timeout > 0 && now >= deadline))
+        {
+            g_mutex_unlock(&ctx->lock);
+            return &ctx->event; // MPV_EVENT_NONE
+        }
+        if (timeout < 0 && !event)
+        {
+            g_cond_wait(&ctx->changed, &ctx->lock);
+        }
+        else
+        {
+            g_cond_wait_until(&ctx->changed, &ctx->lock,
+                              timeout < 0 ? event->due : event ? MIN(event->due, deadline) : deadline);
+        }
+    }
+
+    g_queue_pop_head(&ctx->events);
+    ctx->event.event_id = event->event_id;
+    ctx->event.error = event->error;
+    ctx->event.reply_userdata = event->reply_userdata;
+    if (event->event_id == MPV_EVENT_PROPERTY_CHANGE ||
+        event->event_id == MPV_EVENT_GET_PROPERTY_REPLY)
+    {
+        ctx->property_name = g_steal_pointer(&event->name);
+        ctx->property.name = ctx->property_name;
+        if (event->format == MPV_FORMAT_NODE &&
+            g_strcmp0(ctx->property_name, "metadata") == 0)
+        {
+            metadata_node_locked(ctx, &ctx->value.node);
+            ctx->property.format = MPV_FORMAT_NODE;
+            ctx->property.data = &ctx->value;
+        }
+        else if (event->format != MPV_FORMAT_NONE &&
+                 convert(event->value, event->format, &ctx->value) == MPV_ERROR_SUCCESS)
+        {
+            ctx->property.format = event->format;
+            ctx->property.data = &ctx->value;
+        }
+        else if (event->event_id == MPV_EVENT_GET_PROPERTY_REPLY)
+        {
+            ctx->event.error = MPV_ERROR_PROPERTY_UNAVAILABLE;
+        }
+        ctx->event.data = &ctx->property;
+    }
+    fake_event_free(event);
+    g_cond_broadcast(&ctx->changed);
+
+    g_mutex_unlock(&ctx->lock);
+    return &ctx->event;
+}
+
+int mpv_get_property(mpv_handle *ctx, const char *name, mpv_format format, void *data)
+{
+    int res;
+
+    g_mutex_lock(&ctx->lock);
+    if (format == MPV_FORMAT_NODE && g_strcmp0(name, "options/script-opts") == 0)
+    {
+        mpv_node *node = data;
+        mpv_node_list *list = g_new0(mpv_node_list, 1);
+        GHashTableIter iter;
+        gpointer key, value;
+        int i = 0;
+
+        list->num = g_hash_table_size(ctx->script_opts);
+        list->keys = g_new0(char *, list->num);
+        list->values = g_new0(mpv_node, list->num);
+        g_hash_table_iter_init(&iter, ctx->script_opts);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+        {
+            list->keys[i] = g_strdup(key);
+            list->values[i].format = MPV_FORMAT_STRING;
+            list->values[i].u.string = g_strdup(value);
+            i++;
+        }
+        node->format = MPV_FORMAT_NODE_MAP;
+        node->u.list = list;
+        res = MPV_ERROR_SUCCESS;
+    }
+    else if (!g_hash_table_contains(ctx->properties, name))
+    {
+        res = MPV_ERROR_PROPERTY_UNAVAILABLE;
+    }
+    else
+    {
+        res = convert(g_hash_table_lookup(ctx->properties, name), format, data);
+    }
+    g_mutex_unlock(&ctx->lock);
+    return res;
+}
+
+char *mpv_get_property_string(mpv_handle *ctx, const char *name)
+{
+    char *value;
+
+    g_mutex_lock(&ctx->lock);
+    value = g_strdup(g_hash_table_lookup(ctx->properties, name));
+    g_mutex_unlock(&ctx->lock);
+    return value;
+}
+
+int mpv_get_property_async(mpv_handle *ctx, uint64_t reply_userdata,
+                           const char *name, mpv_format format)
+{
+    FakeEvent *event = g_new0(FakeEvent, 1);
+
+    g_mutex_lock(&ctx->lock);
+    ctx->requests++;
+    event->event_id = MPV_EVENT_GET_PROPERTY_REPLY;
+    event->reply_userdata = reply_userdata;
+    event->name = g_strdup(name);
+    event->format = format;
+    event->value = g_strdup(g_hash_table_lookup(ctx->properties, name));
+    if (ctx->reply_delay_us)
+    {
+        event->due = g_get_monotonic_time() + ctx->reply_delay_us;
+    }
+    queue_locked(ctx, event);
+    g_mutex_unlock(&ctx->lock);
+    return MPV_ERROR_SUCCESS;
+}
+
+int mpv_set_property_async(mpv_handle *ctx, uint64_t reply_userdata,
+                           const char *name, mpv_format format, void *data)
+{
+    gchar *value = format_value(format, data);
+
+    if (!value)
+    {
+        return MPV_ERROR_PROPERTY_FORMAT;
+    }
+
+    g_mutex_lock(&ctx->lock);
+    ctx->requests++;
+    set_locked(ctx, name, value);
+    queue_reply_locked(ctx, MPV_EVENT_SET_PROPERTY_REPLY, reply_userdata,
+                       MPV_ERROR_SUCCESS);
+    g_mutex_unlock(&ctx->lock);
+
+    g_free(value);
+    return MPV_ERROR_SUCCESS;
+}
+
+int mpv_command_async(mpv_handle *ctx, uint64_t reply_userdata, const char **args)
+{
+    FakeMpvCommandFunc func;
+    gpointer func_data;
+    int res;
+
+    if (!args || !args[0])
+    {
+        return MPV_ERROR_INVALID_PARAMETER;
+    }
+
+    g_mutex_lock(&ctx->lock);
+    ctx->requests++;
+    res = run_builtin_locked(ctx, args);
+    func = ctx->command_func;
+    func_data = ctx->command_data;
+    g_mutex_unlock(&ctx->lock);
+
+    // The handler may change properties, so it runs unlocked
+    if (res == -1)
+    {
+        res = func ? func(ctx, args, func_data) : MPV_ERROR_SUCCESS;
+    }
+
+    g_mutex_lock(&ctx->lock);
+    queue_reply_locked(ctx, MPV_EVENT_COMMAND_REPLY, reply_userdata, res);
+    g_mutex_unlock(&ctx->lock);
+    return MPV_ERROR_SUCCESS;
+}
+
+// Commands complete as they are queued, there is nothing left to abort
+void mpv_abort_async_command(G_GNUC_UNUSED mpv_handle *ctx,
+                             G_GNUC_UNUSED uint64_t reply_userdata)
+{
+}
+
+const char *mpv_error_string(int error)
+{
+    if (error > 0 || -error >= (int)G_N_ELEMENTS(error_strings) || !error_strings[-error])
+    {
+        return "unknown error";
+    }
+    return error_strings[-error];
+}
+
+void mpv_free(void *data)
+{
+    g_free(data);
+}
+
+void mpv_free_node_contents(mpv_node *node)
+{
+    if (node->format == MPV_FORMAT_NODE_MAP || node->format == MPV_FORMAT_NODE_ARRAY)
+    {
+        mpv_node_list *list = node->u.list;
+        for (int i = 0; i < list->num; i++)
+        {
+            if (list->keys)
+            {
+                g_free(list->keys[i]);
+            }
+            mpv_free_node_contents(&list->values[i]);
+        }
+        g_free(list->keys);
+        g_free(list->values);
+        g_free(list);
+    }
+    else if (node->format == MPV_FORMAT_STRING)
+    {
+        g_free(node->u.string);
+    }
+    node->format = MPV_FORMAT_NONE;
+}
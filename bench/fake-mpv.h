@@ -0,0 +1,89 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_BENCH_FAKE_MPV_H
+#define MPV_MPRIS_BENCH_FAKE_MPV_H
+
+#include <glib.h>
+#include <mpv/client.h>
+
+// A stand-in for libmpv implementing the part of the client API the
+// plugin uses, so that mpv_open_cplugin() can run in-process without a
+// player, an audio file or a display. Property values and events come
+// from the functions below; they can be called from any thread.
+//
+// Properties are stored as strings and converted to the format they are
+// read or observed with, the way mpv converts them: flags are "yes" and
+// "no". The metadata property, observed as a node, is the map of the
+// metadata/by-key/ ones and changes with them. Every change queues
+// MPV_EVENT_PROPERTY_CHANGE for its observers and wakes the client up.
+// Requests (mpv_*_async()) are answered after the reply delay, in order
+// with the other events, which makes a slow mpv. The built-in commands
+// are loadfile, playlist-next, playlist-prev, playlist-play-index, stop,
+// seek and quit; others succeed without doing anything unless a command
+// handler takes them.
+
+// Returns an mpv error code, MPV_ERROR_SUCCESS or below
+typedef int (*FakeMpvCommandFunc)(mpv_handle *mpv, const char **args, gpointer data);
+
+mpv_handle *fake_mpv_new(void);
+
+// After mpv_open_cplugin() returned
+void fake_mpv_free(mpv_handle *mpv);
+
+void fake_mpv_set(mpv_handle *mpv, const char *name, const char *value);
+
+void fake_mpv_set_int64(mpv_handle *mpv, const char *name, gint64 value);
+
+void fake_mpv_set_double(mpv_handle *mpv, const char *name, double value);
+
+// mpris-<name> in options/script-opts, before mpv_open_cplugin()
+void fake_mpv_set_script_opt(mpv_handle *mpv, const char *name, const char *value);
+
+// An event without data, such as MPV_EVENT_START_FILE
+void fake_mpv_event(mpv_handle *mpv, mpv_event_id event_id);
+
+// The events of loading the playlist entry: START_FILE, path and
+// media-title, FILE_LOADED and PLAYBACK_RESTART
+void fake_mpv_load(mpv_handle *mpv, gint64 playlist_pos, const char *path);
+
+// Makes mpv_open_cplugin() return
+void fake_mpv_shutdown(mpv_handle *mpv);
+
+void fake_mpv_set_reply_delay(mpv_handle *mpv, gint64 delay_us);
+
+void fake_mpv_set_command_handler(mpv_handle *mpv, FakeMpvCommandFunc func,
+                                  gpointer data);
+
+// Events queued and not yet taken by mpv_wait_event()
+guint fake_mpv_pending_events(mpv_handle *mpv);
+
+// Blocks until every queued event was taken, FALSE on timeout
+gboolean fake_mpv_wait_drained(mpv_handle *mpv, gint64 timeout_us);
+
+// Requests made through mpv_*_async()
+guint64 fake_mpv_requests(mpv_handle *mpv);
+
+#endif // MPV_MPRIS_BENCH_FAKE_MPV_H
@@ -0,0 +1,283 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Timing harness for the microbenchmarks. Linux and glibc only: malloc is
+// interposed to count allocations, and syscalls are counted with the
+// raw_syscalls:sys_enter tracepoint. Without access to it (see
+// /proc/sys/kernel/perf_event_paranoid) only read and write class
+// syscalls are counted, from /proc/thread-self/io.
+//
+// Also the private bus and plugin startup shared by the benchmarks that
+// run the plugin.
+
+#define _GNU_SOURCE
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static guint64 allocations;
+
+#ifndef BENCH_NO_MALLOC_HOOKS
+
+void *malloc(size_t size)
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+#endif
+
+static int syscall_counter = -2; // -2 not opened yet, -1 unavailable
+
+static int open_syscall_counter(void)
+{
+    const char *id_files[] = {
+        "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+        "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+    };
+    struct perf_event_attr attr;
+
+    for (size_t i = 0; i < G_N_ELEMENTS(id_files); i++)
+    {
+        gchar *contents = NULL;
+        int fd;
+
+        if (!g_file_get_contents(id_files[i], &contents, NULL, NULL))
+        {
+            continue;
+        }
+
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.size = sizeof(attr);
+        attr.config = g_ascii_strtoull(contents, NULL, 10);
+        g_free(contents);
+
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd >= 0)
+        {
+            return fd;
+        }
+    }
+    return -1;
+}
+
+static guint64 io_syscalls(void)
+{
+    gchar *contents = NULL;
+    guint64 count = 0;
+
+    if (g_file_get_contents("/proc/thread-self/io", &contents, NULL, NULL))
+    {
+        const char *read_line = strstr(contents, "syscr:");
+        const char *write_line = strstr(contents, "syscw:");
+        if (read_line && write_line)
+        {
+            count = g_ascii_strtoull(read_line + 6, NULL, 10) +
+                    g_ascii_strtoull(write_line + 6, NULL, 10);
+        }
+        g_free(contents);
+    }
+    return count;
+}
+
+static guint64 syscalls(void)
+{
+    guint64 count = 0;
+
+    if (syscall_counter == -2)
+    {
+        syscall_counter = open_syscall_counter();
+    }
+    if (syscall_counter < 0)
+    {
+        return io_syscalls();
+    }
+    if (read(syscall_counter, &count, sizeof(count)) != sizeof(count))
+    {
+        return 0;
+    }
+    return count;
+}
+
+static gint64 now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+void bench_header(void)
+{
+    syscalls();
+    printf("%-36s %12s %12s %12s\n", "", "ns/op", "allocs/op",
+           syscall_counter >= 0 ? "syscalls/op" : "io sysc/op");
+}
+
+void bench_run(const char *name, BenchFunc fn, gpointer data)
+{
+    guint64 iterations = 1;
+    guint64 allocs_before, syscalls_before, allocs, sys;
+    gint64 start, elapsed;
+
+    // Warm up caches and find an iteration count filling the target time
+    for (;;)
+    {
+        start = now_ns();
+        for (guint64 i = 0; i < iterations; i++)
+        {
+            fn(data);
+        }
+        elapsed = now_ns() - start;
+        if (elapsed >= BENCH_TARGET_NS / 10 || iterations >= G_GUINT64_CONSTANT(1) << 32)
+        {
+            break;
+        }
+        iterations *= 2;
+    }
+    iterations = MAX(1, (guint64)((double)iterations * BENCH_TARGET_NS / MAX(elapsed, 1)));
+
+    syscalls_before = syscalls();
+    allocs_before = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    start = now_ns();
+    for (guint64 i = 0; i < iterations; i++)
+    {
+        fn(data);
+    }
+    elapsed = now_ns() - start;
+    allocs = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - allocs_before;
+    sys = syscalls() - syscalls_before;
+
+    printf("%-36s %12.1f %12.2f %12.3f\n", name, (double)elapsed / iterations,
+           (double)allocs / iterations, (double)sys / iterations);
+}
+
+gint64 bench_resident_bytes(void)
+{
+    long size, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if (statm)
+    {
+        if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return (gint64)resident * sysconf(_SC_PAGESIZE);
+}
+
+static GTestDBus *test_bus;
+
+GDBusConnection *bench_bus_up(void)
+{
+    test_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_bus);
+    return g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+}
+
+void bench_bus_down(GDBusConnection *bus)
+{
+    if (bus)
+    {
+        g_object_unref(bus);
+    }
+    g_test_dbus_down(test_bus);
+    g_object_unref(test_bus);
+    test_bus = NULL;
+}
+
+gboolean bench_wait_for_name(GDBusConnection *bus, const char *name)
+{
+    for (int i = 0; i < 500; i++)
+    {
+        gboolean owned = FALSE;
+        GVariant *reply = g_dbus_connection_call_sync(bus, "org.freedesktop.DBus",
+                                                      "/org/freedesktop/DBus",
+                                                      "org.freedesktop.DBus",
+                                                      "NameHasOwner",
+                                                      g_variant_new("(s)", name),
+                                                      G_VARIANT_TYPE("(b)"),
+                                                      G_DBUS_CALL_FLAGS_NONE, -1,
+                                                      NULL, NULL);
+        if (reply)
+        {
+            g_variant_get(reply, "(b)", &owned);
+            g_variant_unref(reply);
+        }
+        if (owned)
+        {
+            return TRUE;
+        }
+        g_usleep(10000);
+    }
+    return FALSE;
+}
+
+typedef struct PluginThread {
+    BenchPluginFunc open_cplugin;
+    mpv_handle *mpv;
+} PluginThread;
+
+static gpointer run_plugin(gpointer data)
+{
+    PluginThread *thread = data;
+    int ret = thread->open_cplugin(thread->mpv);
+
+    g_free(thread);
+    return GINT_TO_POINTER(ret);
+}
+
+GThread *bench_run_plugin(BenchPluginFunc open_cplugin, mpv_handle *mpv)
+{
+    PluginThread *thread = g_new(PluginThread, 1);
+
+    thread->open_cplugin = open_cplugin;
+    thread->mpv = mpv;
+    return g_thread_new("mpv", run_plugin, thread);
+}
@@ -0,0 +1,65 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_BENCH_HARNESS_H
+#define MPV_MPRIS_BENCH_HARNESS_H
+
+#include <gio/gio.h>
+#include <mpv/client.h>
+
+// Runs fn repeatedly for about BENCH_TARGET_NS and prints one line with
+// ns/op, allocations/op and syscalls/op. Allocations are every malloc,
+// calloc and realloc made by the process, glib's included, unless built
+// with -DBENCH_NO_MALLOC_HOOKS for benchmarks that only want the helpers
+// below. Syscalls are those of the calling thread.
+#define BENCH_TARGET_NS 200000000
+
+typedef void (*BenchFunc)(gpointer data);
+
+void bench_header(void);
+
+void bench_run(const char *name, BenchFunc fn, gpointer data);
+
+// Resident pages from /proc/self/statm, in bytes
+gint64 bench_resident_bytes(void);
+
+// Starts a private session bus for the run, dbus-daemon has to be
+// installed, and connects to it. NULL if it cannot be reached.
+GDBusConnection *bench_bus_up(void);
+
+// Drops bus, which may be NULL, and stops the private bus
+void bench_bus_down(GDBusConnection *bus);
+
+// TRUE once name has an owner on bus, FALSE if it has none after 5 s
+gboolean bench_wait_for_name(GDBusConnection *bus, const char *name);
+
+typedef int (*BenchPluginFunc)(mpv_handle *mpv);
+
+// Runs open_cplugin(mpv), mpv_open_cplugin() of the plugin linked in, in
+// a thread of its own. g_thread_join() returns its result, use
+// GPOINTER_TO_INT() on it.
+GThread *bench_run_plugin(BenchPluginFunc open_cplugin, mpv_handle *mpv);
+
+#endif // MPV_MPRIS_BENCH_HARNESS_H
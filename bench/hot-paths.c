@@ -0,0 +1,382 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Per-call cost of the functions that run for every track change or
+// D-Bus request: art detection and lookup, string conversion, building
+// Metadata and serving properties from the caches. Each line reports
+// ns/op, allocations/op and syscalls/op (see harness.c).
+//
+// libmpv is replaced by mpv-stub.c. Art lookups run on directory trees
+// generated under $TMPDIR. Metadata is built for a file in one of them,
+// or for the media file given on the command line, whose embedded art is
+// then extracted on every uncached lookup.
+//
+// Usage: hot-paths.bench [MEDIA-FILE]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-artwork.h"
+#include "mpv-mpris-dbus.h"
+#include "mpv-mpris-events.h"
+#include "mpv-mpris-metadata.h"
+#include "mpv-mpris-props.h"
+#include "mpv-mpris-introspection.h"
+#include "harness.h"
+#include "mpv-stub.h"
+
+#define SCAN_FILES 200
+
+// Keeps results alive so the calls are not optimised away
+static const void *volatile sink;
+
+// events.c is not linked, the art proxy is left off here
+void art_fetched(G_GNUC_UNUSED const char *url, G_GNUC_UNUSED const char *art_url,
+                 G_GNUC_UNUSED gpointer data)
+{
+}
+
+typedef struct ImageHeader {
+    const char *name;
+    const uint8_t *data;
+    size_t size;
+} ImageHeader;
+
+static const uint8_t png_header[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n',
+                                     0, 0, 0, 13, 'I', 'H', 'D', 'R'};
+static const uint8_t jpeg_header[] = {0xff, 0xd8, 0xff, 0xe0, 0, 16, 'J', 'F',
+                                      'I', 'F', 0, 1, 1, 0, 0, 1};
+static const uint8_t gif_header[] = {'G', 'I', 'F', '8', '9', 'a', 1, 0,
+                                     1, 0, 0x80, 0, 0, 0, 0, 0};
+static const uint8_t webp_header[] = {'R', 'I', 'F', 'F', 0x24, 0, 0, 0,
+                                      'W', 'E', 'B', 'P', 'V', 'P', '8', ' '};
+static const uint8_t bmp_header[] = {'B', 'M', 0x36, 0x10, 0, 0, 0, 0,
+                                     0, 0, 0x36, 0, 0, 0, 0x28, 0};
+static const uint8_t unknown_header[] = {0, 0, 0, 0x20, 'f', 't', 'y', 'p',
+                                         'i', 's', 'o', 'm', 0, 0, 2, 0};
+
+static const ImageHeader image_headers[] = {
+    {"png", png_header, sizeof(png_header)},
+    {"jpeg", jpeg_header, sizeof(jpeg_header)},
+    {"gif", gif_header, sizeof(gif_header)},
+    {"webp", webp_header, sizeof(webp_header)},
+    {"bmp", bmp_header, sizeof(bmp_header)},
+    {"unknown", unknown_header, sizeof(unknown_header)},
+};
+
+static void bench_image_extension(gpointer data)
+{
+    const ImageHeader *header = data;
+
+    sink = get_image_extension(header->data, header->size);
+}
+
+static void bench_is_art_file(gpointer data)
+{
+    sink = GINT_TO_POINTER(is_art_file(data));
+}
+
+static void bench_local_art(gpointer data)
+{
+    gchar *uri = try_get_local_art(data);
+
+    sink = uri;
+    g_free(uri);
+}
+
+static void bench_string_to_utf8(gpointer data)
+{
+    gchar *utf8 = string_to_utf8(data);
+
+    sink = utf8;
+    g_free(utf8);
+}
+
+static void bench_path_to_uri(gpointer data)
+{
+    gchar *uri = path_to_uri("/home/user/Music", data);
+
+    sink = uri;
+    g_free(uri);
+}
+
+static void bench_metadata_cached(gpointer data)
+{
+    GVariant *metadata = g_variant_ref_sink(create_metadata(data));
+
+    sink = metadata;
+    g_variant_unref(metadata);
+}
+
+// Forgets the art of the last track first, as a track change does
+static void bench_metadata_uncached(gpointer data)
+{
+    UserData *ud = data;
+
+    g_clear_pointer(&ud->cached_path, g_free);
+    g_clear_pointer(&ud->cached_art_url, g_free);
+    bench_metadata_cached(ud);
+}
+
+static void bench_cache_get(gpointer data)
+{
+    UserData *ud = data;
+    GVariant *value = property_cache_get(&ud->player_properties, "PlaybackStatus");
+
+    sink = value;
+    g_variant_unref(value);
+}
+
+static void bench_cache_get_all(gpointer data)
+{
+    UserData *ud = data;
+
+    sink = property_cache_get_all(&ud->player_properties);
+}
+
+// GetAll right after a change has to rebuild the reply
+static void bench_cache_get_all_changed(gpointer data)
+{
+    UserData *ud = data;
+
+    property_cache_set(&ud->player_properties, "Volume", g_variant_new_double(0.5));
+    sink = property_cache_get_all(&ud->player_properties);
+}
+
+// GetAll during playback, with the live Position
+static void bench_cache_get_all_playing(gpointer data)
+{
+    UserData *ud = data;
+    GVariant *reply = g_variant_ref_sink(
+        property_cache_get_all_with(&ud->player_properties, "Position",
+                                    g_variant_new_int64(get_position_us(ud))));
+
+    sink = reply;
+    g_variant_unref(reply);
+}
+
+static void bench_update_player_state(gpointer data)
+{
+    UserData *ud = data;
+
+    update_player_state(ud, "Volume", g_variant_new_double(0.5));
+}
+
+static void touch(const char *dir, const char *name)
+{
+    gchar *path = g_build_filename(dir, name, NULL);
+
+    g_file_set_contents(path, "", 0, NULL);
+    g_free(path);
+}
+
+static void remove_tree(const char *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+
+    if (dir)
+    {
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)))
+        {
+            gchar *child = g_build_filename(path, name, NULL);
+            remove_tree(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+    g_remove(path);
+}
+
+// An album directory with its tracks and one image among SCAN_FILES
+// files, or without any image. Returns the directory.
+static gchar *make_album(const char *root, const char *name, const char *image)
+{
+    gchar *dir = g_build_filename(root, name, NULL);
+
+    g_mkdir(dir, 0700);
+    for (int i = 1; i <= SCAN_FILES; i++)
+    {
+        gchar *track = g_strdup_printf("%03d Track.flac", i);
+        touch(dir, track);
+        g_free(track);
+    }
+    if (image)
+    {
+        touch(dir, image);
+    }
+    return dir;
+}
+
+static void run_art(const char *root)
+{
+    const char *names[] = {"cover.jpg", "folder.png", "Front.webp",
+                           "01 Track.flac", "booklet.pdf"};
+    const char *albums[][2] = {
+        {"with-cover", "cover.jpg"},
+        {"with-scan", "zz-scan.png"},
+        {"without-art", NULL},
+    };
+
+    for (size_t i = 0; i < G_N_ELEMENTS(image_headers); i++)
+    {
+        gchar *label = g_strdup_printf("get_image_extension %s", image_headers[i].name);
+        bench_run(label, bench_image_extension, (gpointer)&image_headers[i]);
+        g_free(label);
+    }
+
+    for (size_t i = 0; i < G_N_ELEMENTS(names); i++)
+    {
+        gchar *label = g_strdup_printf("is_art_file %s", names[i]);
+        bench_run(label, bench_is_art_file, (gpointer)names[i]);
+        g_free(label);
+    }
+
+    for (size_t i = 0; i < G_N_ELEMENTS(albums); i++)
+    {
+        gchar *dir = make_album(root, albums[i][0], albums[i][1]);
+        gchar *track = g_build_filename(dir, "001 Track.flac", NULL);
+        gchar *label = g_strdup_printf("try_get_local_art %s", albums[i][0]);
+
+        bench_run(label, bench_local_art, track);
+
+        g_free(label);
+        g_free(track);
+        g_free(dir);
+    }
+}
+
+static void run_strings(void)
+{
+    const char *strings[][2] = {
+        {"ascii", "Bohemian Rhapsody (Remastered 2011)"},
+        {"multibyte", "Hoppípolla – Sigur Rós, 音楽"},
+        {"invalid", "Caf\xe9 del Mar \xff\xfe"},
+    };
+
+    for (size_t i = 0; i < G_N_ELEMENTS(strings); i++)
+    {
+        gchar *label = g_strdup_printf("string_to_utf8 %s", strings[i][0]);
+        bench_run(label, bench_string_to_utf8, (gpointer)strings[i][1]);
+        g_free(label);
+    }
+
+    bench_run("path_to_uri relative", bench_path_to_uri,
+              "Album/../Album/01 Track.flac");
+    bench_run("path_to_uri absolute", bench_path_to_uri,
+              "/home/user/Music/Album/01 Track.flac");
+}
+
+static void run_metadata(const char *root, const char *media)
+{
+    UserData ud = {0};
+    gchar *path = media ? g_canonicalize_filename(media, NULL)
+                        : g_build_filename(root, "with-scan", "001 Track.flac", NULL);
+    const char *tags[][2] = {
+        {"Title", "Bohemian Rhapsody"},
+        {"Artist", "Queen"},
+        {"Album", "A Night at the Opera"},
+        {"Album_Artist", "Queen"},
+        {"Genre", "Rock"},
+        {"Track", "11"},
+        {"Disc", "1"},
+        {"Date", "1975"},
+        {"MUSICBRAINZ_TRACKID", "b1a9c0e9-d987-4042-ae91-78d6a3267d69"},
+    };
+
+    // What the observed properties would hold
+    ud.working_dir = g_strdup(root);
+    ud.path = path;
+    ud.media_title = g_strdup("001 Track.flac");
+    ud.duration = 354.32;
+    ud.tags = metadata_tags_new(NULL);
+    for (size_t i = 0; i < G_N_ELEMENTS(tags); i++)
+    {
+        g_hash_table_insert(ud.tags, g_strdup(tags[i][0]), g_strdup(tags[i][1]));
+    }
+
+    ud.playlist_pos = 10;
+    bench_run("create_metadata cached art", bench_metadata_cached, &ud);
+    bench_run("create_metadata art lookup", bench_metadata_uncached, &ud);
+
+    g_free(ud.cached_path);
+    g_free(ud.cached_art_url);
+    g_free(ud.working_dir);
+    g_free(ud.path);
+    g_free(ud.media_title);
+    g_hash_table_unref(ud.tags);
+}
+
+static void run_properties(void)
+{
+    UserData ud = {0};
+
+    ud.root_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_interface;
+    ud.player_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_player_interface;
+    ud.state.status = STATUS_PAUSED;
+    ud.state.rate = 1.0;
+    init_property_caches(&ud);
+    memcpy(ud.emit_policies, default_emit_policies, sizeof(ud.emit_policies));
+    ud.changed_properties = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                  (GDestroyNotify)g_variant_unref);
+
+    bench_run("Get PlaybackStatus", bench_cache_get, &ud);
+    bench_run("GetAll Player", bench_cache_get_all, &ud);
+    bench_run("GetAll Player after a change", bench_cache_get_all_changed, &ud);
+    ud.state.status = STATUS_PLAYING;
+    ud.state.position_time = g_get_monotonic_time();
+    bench_run("GetAll Player while playing", bench_cache_get_all_playing, &ud);
+    bench_run("update_player_state Volume", bench_update_player_state, &ud);
+
+    property_cache_clear(&ud.root_properties);
+    property_cache_clear(&ud.player_properties);
+    g_hash_table_unref(ud.changed_properties);
+}
+
+int main(int argc, char *argv[])
+{
+    GError *error = NULL;
+    gchar *root = g_dir_make_tmp("mpv-mpris-bench-XXXXXX", &error);
+
+    if (!root)
+    {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    bench_header();
+    run_art(root);
+    run_strings();
+    run_metadata(root, argc > 1 ? argv[1] : NULL);
+    run_properties();
+
+    mpv_stub_clear();
+    remove_tree(root);
+    g_free(root);
+    return 0;
+}
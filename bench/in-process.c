@@ -0,0 +1,225 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// The plugin driven in-process by the fake libmpv (fake-mpv.c), on a
+// private bus: no player, audio file or display, so every run sees the
+// same events. dbus-daemon has to be installed.
+//
+//   event storm   100000 volume changes queued at once, until the plugin
+//                 took them all
+//   long playlist 1000 track changes in a 100000 entry playlist
+//   slow mpv      Properties.Get latency while 32 Set calls wait for an
+//                 mpv that answers requests after 50 ms
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <gio/gio.h>
+
+#include "fake-mpv.h"
+#include "harness.h"
+
+#define MPRIS_NAME "org.mpris.MediaPlayer2.mpv"
+#define MPRIS_PATH "/org/mpris/MediaPlayer2"
+#define DRAIN_TIMEOUT_US (60 * G_USEC_PER_SEC)
+
+#define STORM_CHANGES 100000
+#define PLAYLIST_ENTRIES 100000
+#define TRACK_CHANGES 1000
+#define SLOW_REPLY_US 50000
+#define SLOW_SETS 32
+#define SLOW_GETS 200
+
+int mpv_open_cplugin(mpv_handle *mpv);
+
+typedef struct SlowSets {
+    guint pending;
+    gint64 start;
+    gint64 last_us;
+} SlowSets;
+
+static gint64 process_cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static int compare_gint64(const void *a, const void *b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+static void drain(mpv_handle *mpv, const char *scenario)
+{
+    if (!fake_mpv_wait_drained(mpv, DRAIN_TIMEOUT_US))
+    {
+        g_printerr("%s: the plugin stopped taking events\n", scenario);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void report(const char *scenario, int operations, const char *unit,
+                   gint64 wall_us, gint64 cpu_ns)
+{
+    printf("%-14s %8d %-14s %10.1f ms %10.1f us/op %10.1f us cpu/op\n",
+           scenario, operations, unit, wall_us / 1000.0,
+           (double)wall_us / operations, cpu_ns / 1000.0 / operations);
+}
+
+static void event_storm(mpv_handle *mpv)
+{
+    gint64 start = g_get_monotonic_time();
+    gint64 cpu = process_cpu_ns();
+
+    for (int i = 0; i < STORM_CHANGES; i++)
+    {
+        fake_mpv_set_double(mpv, "volume", i % 101);
+    }
+    drain(mpv, "event storm");
+
+    report("event storm", STORM_CHANGES, "changes",
+           g_get_monotonic_time() - start, process_cpu_ns() - cpu);
+}
+
+static void long_playlist(mpv_handle *mpv)
+{
+    gint64 start, cpu;
+
+    fake_mpv_set_int64(mpv, "playlist-count", PLAYLIST_ENTRIES);
+    drain(mpv, "long playlist");
+
+    start = g_get_monotonic_time();
+    cpu = process_cpu_ns();
+    for (int i = 0; i < TRACK_CHANGES; i++)
+    {
+        gint64 pos = (gint64)i * (PLAYLIST_ENTRIES / TRACK_CHANGES);
+        gchar *path = g_strdup_printf("/nonexistent/album/%06" G_GINT64_FORMAT ".flac", pos);
+        fake_mpv_load(mpv, pos, path);
+        g_free(path);
+    }
+    drain(mpv, "long playlist");
+
+    report("long playlist", TRACK_CHANGES, "track changes",
+           g_get_monotonic_time() - start, process_cpu_ns() - cpu);
+}
+
+static void on_set_reply(GObject *source, GAsyncResult *result, gpointer data)
+{
+    SlowSets *sets = data;
+    GError *error = NULL;
+    GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                    result, &error);
+
+    if (!reply)
+    {
+        g_printerr("slow mpv: Set failed: %s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+    g_variant_unref(reply);
+    sets->pending--;
+    sets->last_us = g_get_monotonic_time() - sets->start;
+}
+
+static void slow_mpv(mpv_handle *mpv, GDBusConnection *bus)
+{
+    SlowSets sets = {SLOW_SETS, g_get_monotonic_time(), 0};
+    gint64 samples[SLOW_GETS];
+
+    fake_mpv_set_reply_delay(mpv, SLOW_REPLY_US);
+    for (int i = 0; i < SLOW_SETS; i++)
+    {
+        g_dbus_connection_call(bus, MPRIS_NAME, MPRIS_PATH,
+                               "org.freedesktop.DBus.Properties", "Set",
+                               g_variant_new("(ssv)", "org.mpris.MediaPlayer2.Player",
+                                             "Volume", g_variant_new_double(i / 100.0)),
+                               NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+                               on_set_reply, &sets);
+    }
+
+    for (int i = 0; i < SLOW_GETS; i++)
+    {
+        gint64 start = g_get_monotonic_time();
+        GVariant *reply = g_dbus_connection_call_sync(bus, MPRIS_NAME, MPRIS_PATH,
+                                                      "org.freedesktop.DBus.Properties",
+                                                      "Get",
+                                                      g_variant_new("(ss)",
+                                                                    "org.mpris.MediaPlayer2.Player",
+                                                                    "PlaybackStatus"),
+                                                      NULL, G_DBUS_CALL_FLAGS_NONE, -1,
+                                                      NULL, NULL);
+        if (!reply)
+        {
+            g_printerr("slow mpv: Get failed\n");
+            exit(EXIT_FAILURE);
+        }
+        g_variant_unref(reply);
+        samples[i] = g_get_monotonic_time() - start;
+    }
+
+    while (sets.pending)
+    {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    fake_mpv_set_reply_delay(mpv, 0);
+
+    qsort(samples, SLOW_GETS, sizeof(gint64), compare_gint64);
+    printf("%-14s Get p50 %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT
+           " us; %d Sets answered after %.1f ms (mpv replies after %d ms)\n",
+           "slow mpv", samples[SLOW_GETS / 2], samples[SLOW_GETS - 1],
+           SLOW_SETS, sets.last_us / 1000.0, SLOW_REPLY_US / 1000);
+}
+
+int main(void)
+{
+    GDBusConnection *bus;
+    mpv_handle *mpv;
+    GThread *plugin;
+    int ret;
+
+    bus = bench_bus_up();
+
+    mpv = fake_mpv_new();
+    plugin = bench_run_plugin(mpv_open_cplugin, mpv);
+    if (!bus || !bench_wait_for_name(bus, MPRIS_NAME))
+    {
+        g_printerr("The plugin did not register on the bus\n");
+        return EXIT_FAILURE;
+    }
+    drain(mpv, "startup");
+
+    event_storm(mpv);
+    long_playlist(mpv);
+    slow_mpv(mpv, bus);
+
+    fake_mpv_shutdown(mpv);
+    ret = GPOINTER_TO_INT(g_thread_join(plugin));
+    fake_mpv_free(mpv);
+
+    bench_bus_down(bus);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <mpv/client.h>
+
+#include "mpv-stub.h"
+
+static GHashTable *properties;
+
+void mpv_stub_set(const char *name, const char *value)
+{
+    if (!properties)
+    {
+        properties = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+
+    if (value)
+    {
+        g_hash_table_replace(properties, g_strdup(name), g_strdup(value));
+    }
+    else
+    {
+        g_hash_table_remove(properties, name);
+    }
+}
+
+void mpv_stub_clear(void)
+{
+    g_clear_pointer(&properties, g_hash_table_unref);
+}
+
+static const char *lookup(const char *name)
+{
+    return properties ? g_hash_table_lookup(properties, name) : NULL;
+}
+
+int mpv_get_property(G_GNUC_UNUSED mpv_handle *ctx, const char *name,
+                     mpv_format format, void *data)
+{
+    const char *value = lookup(name);
+    char *end;
+
+    if (!value)
+    {
+        return MPV_ERROR_PROPERTY_UNAVAILABLE;
+    }
+
+    switch (format)
+    {
+    case MPV_FORMAT_INT64:
+        *(int64_t *)data = g_ascii_strtoll(value, &end, 10);
+        break;
+    case MPV_FORMAT_DOUBLE:
+        *(double *)data = g_ascii_strtod(value, &end);
+        break;
+    case MPV_FORMAT_STRING:
+        *(char **)data = strdup(value);
+        return MPV_ERROR_SUCCESS;
+    default:
+        return MPV_ERROR_PROPERTY_FORMAT;
+    }
+
+    return end == value || *end ? MPV_ERROR_PROPERTY_FORMAT : MPV_ERROR_SUCCESS;
+}
+
+char *mpv_get_property_string(G_GNUC_UNUSED mpv_handle *ctx, const char *name)
+{
+    const char *value = lookup(name);
+
+    return value ? strdup(value) : NULL;
+}
+
+void mpv_free(void *data)
+{
+    free(data);
+}
+
+// Frame art is not exercised, its grabs fail right away
+int mpv_command_async(G_GNUC_UNUSED mpv_handle *ctx, G_GNUC_UNUSED uint64_t reply_userdata,
+                      G_GNUC_UNUSED const char **args)
+{
+    return MPV_ERROR_UNSUPPORTED;
+}
+
+void mpv_abort_async_command(G_GNUC_UNUSED mpv_handle *ctx,
+                             G_GNUC_UNUSED uint64_t reply_userdata)
+{
+}
+
+const char *mpv_error_string(G_GNUC_UNUSED int error)
+{
+    return "unsupported";
+}
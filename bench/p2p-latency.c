@@ -0,0 +1,153 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Round-trip latency of Properties.Get and GetAll through the session bus
+// daemon and through the peer-to-peer socket.
+//
+// The real D-Bus thread (run_dbus_thread()) serves both paths, with the
+// p2p endpoint enabled. A private bus daemon is started for the run, so
+// dbus-daemon has to be installed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-dbus.h"
+#include "mpv-mpris-introspection.h"
+#include "harness.h"
+
+#define CALLS 5000
+#define WARMUP 200
+
+static int compare_gint64(const void *a, const void *b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+static void measure(GDBusConnection *connection, const char *destination,
+                    const char *path_name, const char *method)
+{
+    gint64 *samples = g_new(gint64, CALLS);
+
+    for (int i = -WARMUP; i < CALLS; i++)
+    {
+        GError *error = NULL;
+        GVariant *params = g_strcmp0(method, "Get") == 0
+                               ? g_variant_new("(ss)", "org.mpris.MediaPlayer2.Player", "Position")
+                               : g_variant_new("(s)", "org.mpris.MediaPlayer2.Player");
+        gint64 start = g_get_monotonic_time();
+        GVariant *reply = g_dbus_connection_call_sync(connection, destination,
+                                                      "/org/mpris/MediaPlayer2",
+                                                      "org.freedesktop.DBus.Properties",
+                                                      method, params, NULL,
+                                                      G_DBUS_CALL_FLAGS_NONE, -1,
+                                                      NULL, &error);
+        if (!reply)
+        {
+            g_printerr("%s %s failed: %s\n", path_name, method, error->message);
+            exit(EXIT_FAILURE);
+        }
+        g_variant_unref(reply);
+
+        if (i >= 0)
+        {
+            samples[i] = g_get_monotonic_time() - start;
+        }
+    }
+
+    qsort(samples, CALLS, sizeof(gint64), compare_gint64);
+    printf("%-6s %-7s %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT "\n",
+           path_name, method, samples[CALLS / 2], samples[CALLS * 99 / 100],
+           samples[CALLS - 1]);
+    g_free(samples);
+}
+
+int main(void)
+{
+    UserData ud = {0};
+    GDBusConnection *bus, *peer;
+    GError *error = NULL;
+    gchar *address, *escaped;
+
+    bus = bench_bus_up();
+
+    ud.root_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_interface;
+    ud.player_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_player_interface;
+    ud.queue_interface_info = (GDBusInterfaceInfo *)&org_mpv_mprisqueue_interface;
+    ud.state.status = STATUS_PAUSED;
+    ud.state.rate = 1.0;
+    init_property_caches(&ud);
+    memcpy(ud.emit_policies, default_emit_policies, sizeof(ud.emit_policies));
+    ud.changed_properties = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                  (GDestroyNotify)g_variant_unref);
+    ud.dbus_context = g_main_context_new();
+    ud.dbus_loop = g_main_loop_new(ud.dbus_context, FALSE);
+    ud.p2p_socket = g_build_filename(g_get_tmp_dir(), "mpv-mpris-p2p-bench.sock", NULL);
+    ud.dbus_thread = g_thread_new("mpris-dbus", run_dbus_thread, &ud);
+
+    if (!bus || !bench_wait_for_name(bus, "org.mpris.MediaPlayer2.mpv"))
+    {
+        g_printerr("Player did not show up on the bus\n");
+        return EXIT_FAILURE;
+    }
+
+    escaped = g_dbus_address_escape_value(ud.p2p_socket);
+    address = g_strconcat("unix:path=", escaped, NULL);
+    peer = g_dbus_connection_new_for_address_sync(address,
+                                                  G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                  NULL, NULL, &error);
+    if (!peer)
+    {
+        g_printerr("Failed to connect to %s: %s\n", address, error->message);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-6s %-7s %8s %8s %8s   (us, %d calls)\n", "path", "method",
+           "p50", "p99", "max", CALLS);
+    measure(bus, "org.mpris.MediaPlayer2.mpv", "bus", "Get");
+    measure(peer, NULL, "p2p", "Get");
+    measure(bus, "org.mpris.MediaPlayer2.mpv", "bus", "GetAll");
+    measure(peer, NULL, "p2p", "GetAll");
+
+    g_dbus_connection_close_sync(peer, NULL, NULL);
+    g_object_unref(peer);
+
+    g_main_loop_quit(ud.dbus_loop);
+    g_thread_join(ud.dbus_thread);
+
+    property_cache_clear(&ud.root_properties);
+    property_cache_clear(&ud.player_properties);
+    g_hash_table_unref(ud.changed_properties);
+    g_main_loop_unref(ud.dbus_loop);
+    g_main_context_unref(ud.dbus_context);
+    g_free(ud.p2p_socket);
+    g_free(address);
+    g_free(escaped);
+
+    bench_bus_down(bus);
+    return EXIT_SUCCESS;
+}
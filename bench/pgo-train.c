@@ -0,0 +1,399 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Training workload for `make pgo`, and the latency it reports for the
+// plugins it builds. An mpv with the given plugin as its only script on
+// a private bus (dbus-daemon has to be installed), paused, goes through
+//
+//   track changes   a playlist of albums made of links to MEDIA, some
+//                   with a cover.jpg, played entry by entry: Metadata and
+//                   the embedded and local art lookups, timed from the
+//                   command until Metadata with the new track ID arrives
+//   GetAll storm    Player and root GetAll and Metadata Gets, 64 in
+//                   flight, timed per call
+//   volume storm    volume changes set as fast as mpv takes them, timed
+//                   until the last PropertiesChanged
+//
+// Usage: pgo-train.bench [PLUGIN.so [MEDIA]], defaults to ../mpris.so and
+// the shell tests' $MPV_MPRIS_TEST_PLAY or alarm-clock-elapsed.oga
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <mpv/client.h>
+
+#include "harness.h"
+
+#define MPRIS_NAME "org.mpris.MediaPlayer2.mpv"
+#define MPRIS_PATH "/org/mpris/MediaPlayer2"
+#define DEFAULT_MEDIA "/usr/share/sounds/freedesktop/stereo/alarm-clock-elapsed.oga"
+#define TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+#define ALBUMS 10
+#define TRACKS_PER_ALBUM 10
+#define TRACK_ROUNDS 2
+#define GETALL_CALLS 20000
+#define GETALL_IN_FLIGHT 64
+#define VOLUME_CHANGES 20000
+
+typedef struct Train {
+    GDBusConnection *bus;
+    gchar *track_id; // of the last Metadata published
+    double volume;   // last Volume published
+    // GetAll storm
+    gint64 *samples;
+    int issued;
+    int answered;
+} Train;
+
+static int compare_gint64(const void *a, const void *b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *name, gint64 *samples, int count)
+{
+    qsort(samples, count, sizeof(gint64), compare_gint64);
+    printf("%-16s %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT "\n",
+           name, samples[count / 2], samples[count * 9 / 10], samples[count * 99 / 100]);
+}
+
+// Wakes up the context now and then, so the deadline is checked even when
+// nothing happens on the bus
+static gboolean tick(G_GNUC_UNUSED gpointer data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static void wait_for(const char *what, gboolean (*done)(Train *, gconstpointer),
+                     Train *train, gconstpointer data)
+{
+    gint64 deadline = g_get_monotonic_time() + TIMEOUT_US;
+
+    while (!done(train, data))
+    {
+        if (g_get_monotonic_time() > deadline)
+        {
+            g_printerr("Timed out waiting for %s\n", what);
+            exit(EXIT_FAILURE);
+        }
+        g_main_context_iteration(NULL, TRUE);
+    }
+}
+
+static gboolean track_published(Train *train, gconstpointer track_id)
+{
+    return g_strcmp0(train->track_id, track_id) == 0;
+}
+
+static gboolean volume_published(Train *train, gconstpointer volume)
+{
+    return train->volume == *(const double *)volume;
+}
+
+static gboolean storm_answered(Train *train, G_GNUC_UNUSED gconstpointer data)
+{
+    return train->answered == GETALL_CALLS;
+}
+
+static void on_properties_changed(G_GNUC_UNUSED GDBusConnection *connection,
+                                  G_GNUC_UNUSED const gchar *sender,
+                                  G_GNUC_UNUSED const gchar *path,
+                                  G_GNUC_UNUSED const gchar *interface,
+                                  G_GNUC_UNUSED const gchar *signal,
+                                  GVariant *parameters,
+                                  gpointer data)
+{
+    Train *train = data;
+    GVariant *changed, *metadata;
+    const gchar *track_id;
+
+    g_variant_get(parameters, "(&s@a{sv}@as)", NULL, &changed, NULL);
+    metadata = g_variant_lookup_value(changed, "Metadata", G_VARIANT_TYPE_VARDICT);
+    if (metadata && g_variant_lookup(metadata, "mpris:trackid", "&o", &track_id))
+    {
+        g_free(train->track_id);
+        train->track_id = g_strdup(track_id);
+    }
+    g_variant_lookup(changed, "Volume", "d", &train->volume);
+    if (metadata)
+    {
+        g_variant_unref(metadata);
+    }
+    g_variant_unref(changed);
+}
+
+// ALBUMS directories of TRACKS_PER_ALBUM links to media, every other one
+// with a cover.jpg. Returns the tracks in playlist order.
+static GPtrArray *make_albums(const char *root, const char *media)
+{
+    static const char jpeg[] = {'\xff', '\xd8', '\xff', '\xe0', 0, 0x10, 'J', 'F', 'I', 'F', 0};
+    GPtrArray *tracks = g_ptr_array_new_with_free_func(g_free);
+    const char *extension = strrchr(media, '.');
+
+    for (int a = 0; a < ALBUMS; a++)
+    {
+        gchar *album = g_strdup_printf("%s/album-%02d", root, a);
+
+        g_mkdir(album, 0755);
+        if (a % 2 == 0)
+        {
+            gchar *cover = g_build_filename(album, "cover.jpg", NULL);
+            g_file_set_contents(cover, jpeg, sizeof(jpeg), NULL);
+            g_free(cover);
+        }
+        for (int t = 0; t < TRACKS_PER_ALBUM; t++)
+        {
+            gchar *track = g_strdup_printf("%s/%02d Track%s", album, t + 1,
+                                           extension ? extension : "");
+            if (symlink(media, track) < 0)
+            {
+                g_printerr("Failed to link %s: %s\n", track, g_strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            g_ptr_array_add(tracks, track);
+        }
+        g_free(album);
+    }
+    return tracks;
+}
+
+static void remove_albums(const char *root)
+{
+    GDir *dir = g_dir_open(root, 0, NULL);
+    const gchar *name;
+
+    while (dir && (name = g_dir_read_name(dir)))
+    {
+        gchar *path = g_build_filename(root, name, NULL);
+
+        if (g_file_test(path, G_FILE_TEST_IS_DIR) &&
+            !g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+        {
+            remove_albums(path);
+        }
+        else
+        {
+            g_remove(path);
+        }
+        g_free(path);
+    }
+    if (dir)
+    {
+        g_dir_close(dir);
+    }
+    g_rmdir(root);
+}
+
+static void track_changes(mpv_handle *mpv, Train *train, GPtrArray *tracks)
+{
+    int count = TRACK_ROUNDS * tracks->len;
+    gint64 *samples = g_new(gint64, count);
+
+    for (guint i = 0; i < tracks->len; i++)
+    {
+        const char *args[] = {"loadfile", g_ptr_array_index(tracks, i), "append", NULL};
+        mpv_command(mpv, args);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        gchar *index = g_strdup_printf("%u", i % tracks->len);
+        gchar *track_id = g_strdup_printf("/%s", index);
+        const char *args[] = {"playlist-play-index", index, NULL};
+        gint64 start = g_get_monotonic_time();
+
+        mpv_command(mpv, args);
+        wait_for(track_id, track_published, train, track_id);
+        samples[i] = g_get_monotonic_time() - start;
+
+        g_free(track_id);
+        g_free(index);
+    }
+    report("track change", samples, count);
+    g_free(samples);
+}
+
+static void issue_get(Train *train);
+
+static void on_get_reply(GObject *source, GAsyncResult *result, gpointer data)
+{
+    Train *train = data;
+    gint64 start = train->samples[train->answered];
+    GError *error = NULL;
+    GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                    result, &error);
+
+    if (!reply)
+    {
+        g_printerr("GetAll storm: %s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+    g_variant_unref(reply);
+    // Replies come in order, so the oldest call in flight is this one
+    train->samples[train->answered++] = g_get_monotonic_time() - start;
+    if (train->issued < GETALL_CALLS)
+    {
+        issue_get(train);
+    }
+}
+
+static void issue_get(Train *train)
+{
+    int i = train->issued++;
+    GVariant *parameters;
+
+    switch (i % 4)
+    {
+    case 0:
+    case 1:
+        parameters = g_variant_new("(s)", "org.mpris.MediaPlayer2.Player");
+        break;
+    case 2:
+        parameters = g_variant_new("(s)", "org.mpris.MediaPlayer2");
+        break;
+    default:
+        parameters = g_variant_new("(ss)", "org.mpris.MediaPlayer2.Player", "Metadata");
+        break;
+    }
+    train->samples[i] = g_get_monotonic_time();
+    g_dbus_connection_call(train->bus, MPRIS_NAME, MPRIS_PATH,
+                           "org.freedesktop.DBus.Properties",
+                           i % 4 == 3 ? "Get" : "GetAll", parameters, NULL,
+                           G_DBUS_CALL_FLAGS_NONE, -1, NULL, on_get_reply, train);
+}
+
+static void getall_storm(Train *train)
+{
+    train->samples = g_new(gint64, GETALL_CALLS);
+    train->issued = train->answered = 0;
+    for (int i = 0; i < GETALL_IN_FLIGHT; i++)
+    {
+        issue_get(train);
+    }
+    wait_for("GetAll replies", storm_answered, train, NULL);
+    report("GetAll storm", train->samples, GETALL_CALLS);
+    g_free(train->samples);
+    train->samples = NULL;
+}
+
+// Volumes stay below 100 during the storm, so 100% is the last one
+static void volume_storm(mpv_handle *mpv, Train *train)
+{
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed;
+    double last = 1.0;
+
+    for (int i = 0; i <= VOLUME_CHANGES; i++)
+    {
+        double volume = i < VOLUME_CHANGES ? i % 100 : 100;
+        mpv_set_property(mpv, "volume", MPV_FORMAT_DOUBLE, &volume);
+    }
+    wait_for("the last Volume", volume_published, train, &last);
+    elapsed = g_get_monotonic_time() - start;
+    printf("%-16s %8" G_GINT64_FORMAT " us for %d changes\n", "volume storm",
+           elapsed, VOLUME_CHANGES);
+}
+
+int main(int argc, char **argv)
+{
+    const char *media = g_getenv("MPV_MPRIS_TEST_PLAY");
+    Train train = {0};
+    GPtrArray *tracks;
+    gchar *plugin, *root;
+    mpv_handle *mpv;
+    guint subscription;
+
+    plugin = g_canonicalize_filename(argc > 1 ? argv[1] : "../mpris.so", NULL);
+    if (argc > 2)
+    {
+        media = argv[2];
+    }
+    if (!media)
+    {
+        media = DEFAULT_MEDIA;
+    }
+    if (!g_file_test(plugin, G_FILE_TEST_EXISTS) || !g_file_test(media, G_FILE_TEST_EXISTS))
+    {
+        g_printerr("Needs %s and %s\n", plugin, media);
+        return EXIT_FAILURE;
+    }
+
+    root = g_dir_make_tmp("mpv-mpris-pgo-XXXXXX", NULL);
+    if (!root)
+    {
+        g_printerr("Failed to create a temporary directory\n");
+        return EXIT_FAILURE;
+    }
+    {
+        gchar *absolute = g_canonicalize_filename(media, NULL);
+        tracks = make_albums(root, absolute);
+        g_free(absolute);
+    }
+
+    train.bus = bench_bus_up();
+    subscription = g_dbus_connection_signal_subscribe(train.bus, NULL,
+                                                      "org.freedesktop.DBus.Properties",
+                                                      "PropertiesChanged", MPRIS_PATH,
+                                                      NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+                                                      on_properties_changed, &train, NULL);
+    g_timeout_add(100, tick, NULL);
+
+    mpv = mpv_create();
+    mpv_set_option_string(mpv, "config", "no");
+    mpv_set_option_string(mpv, "load-scripts", "no");
+    mpv_set_option_string(mpv, "scripts", plugin);
+    mpv_set_option_string(mpv, "idle", "yes");
+    mpv_set_option_string(mpv, "pause", "yes");
+    mpv_set_option_string(mpv, "vo", "null");
+    mpv_set_option_string(mpv, "ao", "null");
+    if (mpv_initialize(mpv) < 0 || !bench_wait_for_name(train.bus, MPRIS_NAME))
+    {
+        g_printerr("mpv or the plugin did not start\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-16s %8s %8s %8s   (us)\n", "", "p50", "p90", "p99");
+    track_changes(mpv, &train, tracks);
+    getall_storm(&train);
+    volume_storm(mpv, &train);
+
+    // The instrumented plugin writes its profile when this process exits
+    mpv_terminate_destroy(mpv);
+
+    g_dbus_connection_signal_unsubscribe(train.bus, subscription);
+    bench_bus_down(train.bus);
+    remove_albums(root);
+    g_ptr_array_unref(tracks);
+    g_free(train.track_id);
+    g_free(root);
+    g_free(plugin);
+    return EXIT_SUCCESS;
+}
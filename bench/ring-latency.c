@@ -0,0 +1,209 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Latency of the rings connecting the mpv and D-Bus threads.
+//
+// Two threads stand in for the mpv thread and the D-Bus thread. Each one
+// pushes timestamped items to the other at a steady rate while its own
+// drain callback is slowed down by synthetic work, as a slow D-Bus client
+// or a slow metadata build would. Reports the delivery latencies, the
+// items dropped on a full ring and the longest single push. Order and
+// completeness are checked by test/unit/ring-threads.
+
+#include <stdio.h>
+
+#include "mpv-mpris-ring.h"
+
+#define ITEMS_PER_SIDE 20000
+#define BURST 16
+#define RING_SIZE 256
+
+typedef struct Item {
+    gint64 sent_at;
+    guint seq;
+} Item;
+
+typedef struct Side {
+    const char *name;
+    GMainContext *context;
+    GMainLoop *loop;
+    GThread *thread;
+    MprisRing *in;  // drained on this side
+    MprisRing *out; // filled on this side
+    gulong work_us; // synthetic load per drain
+    guint attempted;
+    gint sent;
+    gint received;
+    gint dropped;
+    guint next_seq;
+    gint64 max_push_us;
+    GArray *latencies;
+} Side;
+
+static gboolean produce(gpointer data)
+{
+    Side *side = data;
+
+    for (int i = 0; i < BURST && side->attempted < ITEMS_PER_SIDE; i++)
+    {
+        Item item = {g_get_monotonic_time(), side->next_seq};
+        gboolean pushed = ring_push(side->out, &item);
+        gint64 elapsed = g_get_monotonic_time() - item.sent_at;
+
+        side->max_push_us = MAX(side->max_push_us, elapsed);
+        side->attempted++;
+        if (pushed)
+        {
+            side->next_seq++;
+            g_atomic_int_inc(&side->sent);
+        }
+        else
+        {
+            g_atomic_int_inc(&side->dropped);
+        }
+    }
+    ring_notify(side->out);
+
+    return side->attempted < ITEMS_PER_SIDE ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static gboolean consume(gpointer data)
+{
+    Side *side = data;
+    Item item;
+
+    while (ring_pop(side->in, &item))
+    {
+        gint64 latency = g_get_monotonic_time() - item.sent_at;
+
+        g_array_append_val(side->latencies, latency);
+        g_atomic_int_inc(&side->received);
+    }
+
+    g_usleep(side->work_us);
+    return G_SOURCE_CONTINUE;
+}
+
+static gpointer run_side(gpointer data)
+{
+    Side *side = data;
+    GSource *timer = g_timeout_source_new(1);
+
+    g_main_context_push_thread_default(side->context);
+    g_source_set_callback(timer, produce, side, NULL);
+    g_source_attach(timer, side->context);
+    g_source_unref(timer);
+
+    g_main_loop_run(side->loop);
+
+    g_main_context_pop_thread_default(side->context);
+    return NULL;
+}
+
+static int compare_latency(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+static gint64 percentile(GArray *values, double p)
+{
+    if (values->len == 0)
+    {
+        return 0;
+    }
+    return g_array_index(values, gint64, (guint)((values->len - 1) * p));
+}
+
+static void init_side(Side *side, const char *name, gulong work_us,
+                      MprisRing *in, MprisRing *out)
+{
+    GSource *source;
+
+    side->name = name;
+    side->work_us = work_us;
+    side->in = in;
+    side->out = out;
+    side->context = g_main_context_new();
+    side->loop = g_main_loop_new(side->context, FALSE);
+    side->latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+    source = ring_source_new(in, consume, side);
+    g_source_attach(source, side->context);
+    g_source_unref(source);
+}
+
+static void report(Side *receiver, Side *sender)
+{
+    g_array_sort(receiver->latencies, compare_latency);
+    printf("%s -> %s: sent %d dropped %d, latency p50 %" G_GINT64_FORMAT
+           "us p99 %" G_GINT64_FORMAT "us max %" G_GINT64_FORMAT
+           "us, longest push %" G_GINT64_FORMAT "us\n",
+           sender->name, receiver->name, sender->sent, sender->dropped,
+           percentile(receiver->latencies, 0.5),
+           percentile(receiver->latencies, 0.99),
+           percentile(receiver->latencies, 1.0),
+           sender->max_push_us);
+}
+
+int main(void)
+{
+    MprisRing *deltas = ring_new(RING_SIZE, sizeof(Item));
+    MprisRing *commands = ring_new(RING_SIZE, sizeof(Item));
+    Side mpv_side = {0};
+    Side dbus_side = {0};
+    gint64 deadline;
+
+    // The D-Bus side is the slower one, like a client stalling GetAll
+    init_side(&mpv_side, "mpv", 2000, commands, deltas);
+    init_side(&dbus_side, "dbus", 20000, deltas, commands);
+
+    mpv_side.thread = g_thread_new("mpv", run_side, &mpv_side);
+    dbus_side.thread = g_thread_new("dbus", run_side, &dbus_side);
+
+    // Wait until both sides are done and everything pushed was drained
+    deadline = g_get_monotonic_time() + 60 * G_USEC_PER_SEC;
+    while (g_get_monotonic_time() < deadline &&
+           (g_atomic_int_get(&mpv_side.received) +
+                g_atomic_int_get(&dbus_side.dropped) < ITEMS_PER_SIDE ||
+            g_atomic_int_get(&dbus_side.received) +
+                g_atomic_int_get(&mpv_side.dropped) < ITEMS_PER_SIDE))
+    {
+        g_usleep(10000);
+    }
+
+    g_main_loop_quit(mpv_side.loop);
+    g_main_loop_quit(dbus_side.loop);
+    g_thread_join(mpv_side.thread);
+    g_thread_join(dbus_side.thread);
+
+    report(&dbus_side, &mpv_side);
+    report(&mpv_side, &dbus_side);
+
+    ring_free(deltas);
+    ring_free(commands);
+    return 0;
+}
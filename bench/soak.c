@@ -0,0 +1,248 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Long-run memory soak: track changes cycled through the plugin, driven
+// in-process by the fake libmpv (fake-mpv.c) on a private bus, with the
+// plugin built for allocation accounting (mpv-mpris-alloc.h). The run is
+// cut into windows; after each one the plugin is left to settle, then
+// the allocations per track of every scope, the blocks still allocated
+// and the resident set are sampled. The run fails when, against the
+// first window, a later one
+//
+//   - allocates more per track than ALLOC_TOLERANCE allows,
+//   - kept more than LIVE_PER_TRACK blocks per track since, a leak,
+//   - or grew the resident set by more than RSS_SLACK.
+//
+// The first window is not checked, caches and GLib's type system fill
+// during it. dbus-daemon has to be installed.
+//
+// Run with: make -C bench soak
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gio/gio.h>
+
+#include "fake-mpv.h"
+#include "harness.h"
+#include "mpv-mpris-alloc.h"
+
+#define MPRIS_NAME "org.mpris.MediaPlayer2.mpv"
+#define DRAIN_TIMEOUT_US (60 * G_USEC_PER_SEC)
+// Longer than the settle time for metadata and the coalescing of
+// PropertiesChanged, so that a window's work is done when sampled
+#define SETTLE_US (700 * 1000)
+
+#define ALLOC_TOLERANCE 0.05
+#define LIVE_PER_TRACK 0.01
+#define RSS_SLACK (4 * 1024 * 1024)
+
+int mpv_open_cplugin(mpv_handle *mpv);
+
+typedef struct Sample {
+    MprisAllocStats stats;
+    gint64 rss;
+} Sample;
+
+static void drain(mpv_handle *mpv)
+{
+    if (!fake_mpv_wait_drained(mpv, DRAIN_TIMEOUT_US))
+    {
+        g_printerr("The plugin stopped taking events\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Every track has its own path and tags, as an album played through
+static void play_tracks(mpv_handle *mpv, gint64 first, int count)
+{
+    for (gint64 pos = first; pos < first + count; pos++)
+    {
+        gchar *path = g_strdup_printf("/nonexistent/album-%04" G_GINT64_FORMAT
+                                      "/%02" G_GINT64_FORMAT " track.flac",
+                                      pos / 12, pos % 12 + 1);
+        gchar *title = g_strdup_printf("Track %" G_GINT64_FORMAT, pos);
+        gchar *album = g_strdup_printf("Album %" G_GINT64_FORMAT, pos / 12);
+
+        fake_mpv_set(mpv, "metadata/by-key/Title", title);
+        fake_mpv_set(mpv, "metadata/by-key/Album", album);
+        fake_mpv_set(mpv, "metadata/by-key/Artist", "Soak Test");
+        fake_mpv_load(mpv, pos, path);
+        // One track at a time, so that every track is a metadata rebuild
+        drain(mpv);
+
+        g_free(album);
+        g_free(title);
+        g_free(path);
+    }
+}
+
+static void take_sample(Sample *sample)
+{
+    g_usleep(SETTLE_US);
+    alloc_stats_read(&sample->stats);
+    sample->rss = bench_resident_bytes();
+}
+
+static guint64 plugin_allocations(const MprisAllocStats *stats)
+{
+    guint64 total = 0;
+
+    for (int i = ALLOC_SCOPE_OTHER + 1; i < ALLOC_SCOPE_COUNT; i++)
+    {
+        total += stats->allocations[i];
+    }
+    return total;
+}
+
+// Between two readings of the same counter
+static double per_track(guint64 from, guint64 to, int tracks)
+{
+    return (double)(to - from) / tracks;
+}
+
+static void print_header(void)
+{
+    printf("%-7s %9s", "window", "tracks");
+    for (int i = 0; i < ALLOC_SCOPE_COUNT; i++)
+    {
+        printf(" %9s", alloc_scope_names[i]);
+    }
+    printf(" %9s %11s %9s\n", "plugin", "live", "rss KiB");
+}
+
+static void print_window(int window, gint64 tracks, const Sample *from,
+                         const Sample *to, int count)
+{
+    printf("%-7d %9" G_GINT64_FORMAT, window, tracks);
+    for (int i = 0; i < ALLOC_SCOPE_COUNT; i++)
+    {
+        printf(" %9.1f", per_track(from->stats.allocations[i],
+                                   to->stats.allocations[i], count));
+    }
+    printf(" %9.1f %11" G_GUINT64_FORMAT " %9" G_GINT64_FORMAT "\n",
+           per_track(plugin_allocations(&from->stats),
+                     plugin_allocations(&to->stats), count),
+           alloc_stats_live(&to->stats), to->rss / 1024);
+}
+
+int main(int argc, char **argv)
+{
+    GDBusConnection *bus;
+    mpv_handle *mpv;
+    GThread *plugin;
+    GOptionContext *options;
+    GError *error = NULL;
+    Sample *samples;
+    double reference, allowed;
+    gint64 live_growth;
+    int tracks = 100000;
+    int windows = 10;
+    int per_window, ret;
+    gboolean failed = FALSE;
+    GOptionEntry entries[] = {
+        {"tracks", 'n', 0, G_OPTION_ARG_INT, &tracks,
+         "Track changes (100000)", "N"},
+        {"windows", 'w', 0, G_OPTION_ARG_INT, &windows,
+         "Samples taken, at least 2 (10)", "N"},
+        {NULL, 0, 0, 0, NULL, NULL, NULL}};
+
+    options = g_option_context_new("- MPRIS allocation and RSS soak test");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (!g_option_context_parse(options, &argc, &argv, &error))
+    {
+        g_printerr("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(options);
+    if (windows < 2 || tracks < windows)
+    {
+        g_printerr("Needs at least 2 windows and a track per window\n");
+        return EXIT_FAILURE;
+    }
+    per_window = tracks / windows;
+
+    bus = bench_bus_up();
+
+    mpv = fake_mpv_new();
+    fake_mpv_set_int64(mpv, "playlist-count", tracks);
+    plugin = bench_run_plugin(mpv_open_cplugin, mpv);
+    if (!bus || !bench_wait_for_name(bus, MPRIS_NAME))
+    {
+        g_printerr("The plugin did not register on the bus\n");
+        return EXIT_FAILURE;
+    }
+    drain(mpv);
+
+    samples = g_new0(Sample, windows + 1);
+    take_sample(&samples[0]);
+    print_header();
+    for (int w = 0; w < windows; w++)
+    {
+        play_tracks(mpv, (gint64)w * per_window, per_window);
+        take_sample(&samples[w + 1]);
+        print_window(w + 1, (gint64)(w + 1) * per_window, &samples[w],
+                     &samples[w + 1], per_window);
+    }
+
+    // Against the end of the first window
+    reference = per_track(plugin_allocations(&samples[0].stats),
+                          plugin_allocations(&samples[1].stats), per_window);
+    allowed = reference * (1 + ALLOC_TOLERANCE) + 0.5;
+    for (int w = 2; w <= windows; w++)
+    {
+        double allocations = per_track(plugin_allocations(&samples[w - 1].stats),
+                                       plugin_allocations(&samples[w].stats),
+                                       per_window);
+        if (allocations > allowed)
+        {
+            printf("FAIL window %d: %.1f allocations per track, the first "
+                   "window made %.1f\n", w, allocations, reference);
+            failed = TRUE;
+        }
+    }
+
+    live_growth = (gint64)alloc_stats_live(&samples[windows].stats) -
+                  (gint64)alloc_stats_live(&samples[1].stats);
+    if (live_growth > LIVE_PER_TRACK * (windows - 1) * per_window)
+    {
+        printf("FAIL %" G_GINT64_FORMAT " blocks still allocated after %d "
+               "tracks\n", live_growth, (windows - 1) * per_window);
+        failed = TRUE;
+    }
+
+    if (samples[windows].rss - samples[1].rss > RSS_SLACK)
+    {
+        printf("FAIL resident set grew by %" G_GINT64_FORMAT " KiB\n",
+               (samples[windows].rss - samples[1].rss) / 1024);
+        failed = TRUE;
+    }
+
+    fake_mpv_shutdown(mpv);
+    ret = GPOINTER_TO_INT(g_thread_join(plugin));
+    fake_mpv_free(mpv);
+    g_free(samples);
+
+    bench_bus_down(bus);
+    return ret == 0 && !failed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,200 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Plugin startup time: from mpv_create() until org.mpris.MediaPlayer2.mpv
+// is owned on the bus.
+//
+// Each run creates an idle mpv with the built plugin as its only script on
+// a private bus (dbus-daemon has to be installed), waits for the name and
+// tears mpv down again. For reference it also times parsing the interface
+// definition with g_dbus_node_info_new_for_xml(), which the plugin used to
+// do on every start before the introspection data was generated.
+//
+// The resident set is sampled before the first mpv is created and once
+// its plugin is on the bus, for comparing builds: libavformat is only
+// loaded for the first embedded art lookup, and not at all with
+// AVFORMAT=0 (make -C bench startup-avformat runs both).
+//
+// Usage: startup.bench [PLUGIN.so], defaults to ../mpris.so
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gio/gio.h>
+#include <mpv/client.h>
+
+#include "harness.h"
+
+#define RUNS 30
+#define PARSE_RUNS 1000
+#define TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+static const char *bus_name = "org.mpris.MediaPlayer2.mpv";
+
+static void on_name_appeared(G_GNUC_UNUSED GDBusConnection *connection,
+                             G_GNUC_UNUSED const gchar *name,
+                             G_GNUC_UNUSED const gchar *owner,
+                             gpointer data)
+{
+    *(gboolean *)data = TRUE;
+}
+
+static void on_name_vanished(G_GNUC_UNUSED GDBusConnection *connection,
+                             G_GNUC_UNUSED const gchar *name,
+                             gpointer data)
+{
+    *(gboolean *)data = FALSE;
+}
+
+// Runs the default context until the name is (or is not) owned
+static gboolean wait_for_owner(const gboolean *owned, gboolean expected)
+{
+    gint64 deadline = g_get_monotonic_time() + TIMEOUT_US;
+
+    while (*owned != expected)
+    {
+        if (g_get_monotonic_time() > deadline)
+        {
+            return FALSE;
+        }
+        g_main_context_iteration(NULL, TRUE);
+    }
+    return TRUE;
+}
+
+static int compare_gint64(const void *a, const void *b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *name, gint64 *samples, int count)
+{
+    qsort(samples, count, sizeof(gint64), compare_gint64);
+    printf("%-22s %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT "\n",
+           name, samples[0], samples[count / 2], samples[count * 9 / 10]);
+}
+
+// Wakes up the context now and then, so the deadline is checked even when
+// nothing happens on the bus
+static gboolean tick(G_GNUC_UNUSED gpointer data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static void time_xml_parsing(void)
+{
+    gint64 samples[PARSE_RUNS];
+    gchar *xml = NULL;
+
+    if (!g_file_get_contents("../dbus/mpv-mpris.xml", &xml, NULL, NULL))
+    {
+        return;
+    }
+
+    for (int i = 0; i < PARSE_RUNS; i++)
+    {
+        gint64 start = g_get_monotonic_time();
+        GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(xml, NULL);
+        samples[i] = g_get_monotonic_time() - start;
+        g_dbus_node_info_unref(node);
+    }
+    report("introspection XML", samples, PARSE_RUNS);
+    g_free(xml);
+}
+
+int main(int argc, char **argv)
+{
+    gint64 initialized[RUNS], acquired[RUNS];
+    gint64 rss_before, rss_started = 0;
+    GDBusConnection *bus;
+    gboolean owned = FALSE;
+    gchar *plugin;
+    guint watch_id;
+
+    plugin = g_canonicalize_filename(argc > 1 ? argv[1] : "../mpris.so", NULL);
+    if (!g_file_test(plugin, G_FILE_TEST_EXISTS))
+    {
+        g_printerr("%s not found, build the plugin first\n", plugin);
+        return EXIT_FAILURE;
+    }
+
+    bus = bench_bus_up();
+    watch_id = g_bus_watch_name_on_connection(bus, bus_name, G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                              on_name_appeared, on_name_vanished,
+                                              &owned, NULL);
+    g_timeout_add(100, tick, NULL);
+
+    rss_before = bench_resident_bytes();
+    for (int i = 0; i < RUNS; i++)
+    {
+        gint64 start;
+        mpv_handle *mpv;
+
+        start = g_get_monotonic_time();
+        mpv = mpv_create();
+        mpv_set_option_string(mpv, "config", "no");
+        mpv_set_option_string(mpv, "load-scripts", "no");
+        mpv_set_option_string(mpv, "scripts", plugin);
+        mpv_set_option_string(mpv, "idle", "yes");
+        mpv_set_option_string(mpv, "vo", "null");
+        mpv_set_option_string(mpv, "ao", "null");
+        if (mpv_initialize(mpv) < 0)
+        {
+            g_printerr("mpv_initialize() failed\n");
+            return EXIT_FAILURE;
+        }
+        initialized[i] = g_get_monotonic_time() - start;
+
+        if (!wait_for_owner(&owned, TRUE))
+        {
+            g_printerr("%s never showed up\n", bus_name);
+            return EXIT_FAILURE;
+        }
+        acquired[i] = g_get_monotonic_time() - start;
+        if (i == 0)
+        {
+            rss_started = bench_resident_bytes();
+        }
+
+        mpv_terminate_destroy(mpv);
+        if (!wait_for_owner(&owned, FALSE))
+        {
+            g_printerr("%s was not released\n", bus_name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%-22s %8s %8s %8s   (us)\n", "", "min", "p50", "p90");
+    report("mpv_initialize()", initialized, RUNS);
+    report("bus name acquired", acquired, RUNS);
+    printf("%-22s %8" G_GINT64_FORMAT " KiB more after the first start\n", "resident set",
+           (rss_started - rss_before) / 1024);
+    time_xml_parsing();
+
+    g_bus_unwatch_name(watch_id);
+    bench_bus_down(bus);
+    g_free(plugin);
+    return EXIT_SUCCESS;
+}
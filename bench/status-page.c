@@ -0,0 +1,167 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Cost of reading the shared status page compared with nothing else: a
+// reader thread takes snapshots while a writer thread is idle, and then
+// while it rewrites the title and position as fast as it can.
+//
+// Every snapshot is checked for tearing (title_length has to match the
+// title, which changes length as the track number grows). Read and write
+// syscalls of the reader thread come from /proc/thread-self/io and should
+// stay at zero. The D-Bus round trip it replaces is measured by
+// p2p-latency.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-status.h"
+#include "mpv-mpris-status-page.h"
+
+#define READS 5000000
+
+typedef struct Bench {
+    UserData ud;
+    gint stop;
+    guint64 writes;
+} Bench;
+
+static guint64 thread_io_syscalls(void)
+{
+    gchar *contents = NULL;
+    guint64 count = 0;
+
+    if (g_file_get_contents("/proc/thread-self/io", &contents, NULL, NULL))
+    {
+        const char *syscr = strstr(contents, "syscr:");
+        const char *syscw = strstr(contents, "syscw:");
+        if (syscr && syscw)
+        {
+            count = g_ascii_strtoull(syscr + 6, NULL, 10) +
+                    g_ascii_strtoull(syscw + 6, NULL, 10);
+        }
+        g_free(contents);
+    }
+    return count;
+}
+
+static gpointer write_status(gpointer data)
+{
+    Bench *bench = data;
+
+    while (!g_atomic_int_get(&bench->stop))
+    {
+        gchar *title = g_strdup_printf("Track %" G_GUINT64_FORMAT, ++bench->writes);
+        GVariantDict dict;
+        GVariant *metadata;
+
+        g_variant_dict_init(&dict, NULL);
+        g_variant_dict_insert(&dict, "xesam:title", "s", title);
+        metadata = g_variant_ref_sink(g_variant_dict_end(&dict));
+
+        bench->ud.state.position_us = (gint64)bench->writes;
+        bench->ud.state.position_time = g_get_monotonic_time();
+        status_page_update(&bench->ud, "Position", NULL);
+        status_page_update(&bench->ud, "Metadata", metadata);
+
+        g_variant_unref(metadata);
+        g_free(title);
+    }
+    return NULL;
+}
+
+static void run(Bench *bench, const MprisStatusPage *page, gboolean busy)
+{
+    GThread *writer = NULL;
+    MprisStatus status;
+    guint64 torn = 0, failed = 0, syscalls;
+    gint64 start, elapsed;
+    int64_t checksum = 0;
+
+    bench->writes = 0;
+    g_atomic_int_set(&bench->stop, 0);
+    if (busy)
+    {
+        writer = g_thread_new("writer", write_status, bench);
+    }
+
+    syscalls = thread_io_syscalls();
+    start = g_get_monotonic_time();
+    for (int i = 0; i < READS; i++)
+    {
+        if (mpris_status_page_read(page, &status) < 0)
+        {
+            failed++;
+            continue;
+        }
+        if (status.title_length != strlen(status.title))
+        {
+            torn++;
+        }
+        checksum += mpris_status_position(&status);
+    }
+    elapsed = g_get_monotonic_time() - start;
+    syscalls = thread_io_syscalls() - syscalls - 1; // the first /proc read
+
+    g_atomic_int_set(&bench->stop, 1);
+    if (writer)
+    {
+        g_thread_join(writer);
+    }
+
+    printf("%-12s %8.1f ns/read %10" G_GUINT64_FORMAT " writes %4" G_GUINT64_FORMAT
+           " torn %4" G_GUINT64_FORMAT " failed %4" G_GUINT64_FORMAT " syscalls"
+           "   (checksum %" G_GINT64_FORMAT ")\n",
+           busy ? "busy writer" : "idle writer", elapsed * 1000.0 / READS,
+           bench->writes, torn, failed, syscalls, (gint64)checksum);
+}
+
+int main(void)
+{
+    static Bench bench;
+    const MprisStatusPage *page;
+
+    bench.ud.state.status = STATUS_PLAYING;
+    bench.ud.state.rate = 1.0;
+    bench.ud.status_page_path = g_build_filename(g_get_tmp_dir(),
+                                                 "mpv-mpris-status-bench.status", NULL);
+    status_page_open(&bench.ud);
+
+    page = mpris_status_page_open(bench.ud.status_page_path);
+    if (!page)
+    {
+        g_printerr("Failed to map %s\n", bench.ud.status_page_path);
+        return EXIT_FAILURE;
+    }
+
+    run(&bench, page, FALSE);
+    run(&bench, page, TRUE);
+
+    mpris_status_page_close(page);
+    status_page_close(&bench.ud);
+    g_free(bench.ud.status_page_path);
+    return EXIT_SUCCESS;
+}
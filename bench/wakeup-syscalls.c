@@ -0,0 +1,196 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Counts the syscalls the mpv wakeup path costs during event storms.
+//
+// A producer thread plays mpv's part: it queues events in bursts and calls
+// the wakeup callback for each one, as mpv does. A consumer thread plays
+// the event handler: it waits on the fd, drains it and then processes all
+// queued events. The old pipe scheme (one write per event) is compared to
+// MprisWakeup (one write per drain cycle).
+//
+// Write syscalls on the producer thread are read from
+// /proc/thread-self/io, so they include every write the callback made.
+
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mpv-mpris-wakeup.h"
+
+#define BURSTS 200
+#define EVENTS_PER_BURST 500
+#define PROCESS_NS_PER_EVENT 500
+
+typedef struct Bench {
+    const char *name;
+    gboolean use_pipe;
+    int pipe_fds[2];
+    MprisWakeup wakeup;
+    gint queued;
+    gint done;
+    guint64 processed;
+    guint64 wakeups;
+    guint64 producer_writes;
+} Bench;
+
+static guint64 thread_write_syscalls(void)
+{
+    gchar *contents = NULL;
+    guint64 syscw = 0;
+
+    if (g_file_get_contents("/proc/thread-self/io", &contents, NULL, NULL))
+    {
+        const char *line = strstr(contents, "syscw:");
+        if (line)
+        {
+            syscw = g_ascii_strtoull(line + 6, NULL, 10);
+        }
+        g_free(contents);
+    }
+    return syscw;
+}
+
+static void busy_wait_ns(gint64 ns)
+{
+    struct timespec start, now;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000LL +
+                 (now.tv_nsec - start.tv_nsec) < ns);
+}
+
+static gpointer produce(gpointer data)
+{
+    Bench *bench = data;
+    guint64 before = thread_write_syscalls();
+
+    for (int burst = 0; burst < BURSTS; burst++)
+    {
+        for (int i = 0; i < EVENTS_PER_BURST; i++)
+        {
+            g_atomic_int_inc(&bench->queued);
+            if (bench->use_pipe)
+            {
+                (void)!write(bench->pipe_fds[1], "0", 1);
+            }
+            else
+            {
+                wakeup_handler(&bench->wakeup);
+            }
+        }
+        g_usleep(1000);
+    }
+
+    bench->producer_writes = thread_write_syscalls() - before;
+    g_atomic_int_set(&bench->done, 1);
+    return NULL;
+}
+
+static gpointer consume(gpointer data)
+{
+    Bench *bench = data;
+    int fd = bench->use_pipe ? bench->pipe_fds[0] : bench->wakeup.read_fd;
+    struct pollfd pfd = {fd, POLLIN, 0};
+
+    while (!g_atomic_int_get(&bench->done) || g_atomic_int_get(&bench->queued) > 0)
+    {
+        if (poll(&pfd, 1, 10) <= 0)
+        {
+            continue;
+        }
+        bench->wakeups++;
+
+        if (bench->use_pipe)
+        {
+            char unused[16];
+            while (read(fd, unused, sizeof(unused)) > 0)
+                ;
+        }
+        else
+        {
+            wakeup_drain(&bench->wakeup);
+        }
+
+        // Stand-in for mpv_wait_event() returning the queued events
+        gint events;
+        do
+        {
+            events = g_atomic_int_get(&bench->queued);
+        } while (!g_atomic_int_compare_and_exchange(&bench->queued, events, 0));
+        busy_wait_ns((gint64)events * PROCESS_NS_PER_EVENT);
+        bench->processed += events;
+    }
+    return NULL;
+}
+
+static void run(Bench *bench)
+{
+    GThread *consumer = g_thread_new("consumer", consume, bench);
+    GThread *producer = g_thread_new("producer", produce, bench);
+    double per_thousand;
+
+    g_thread_join(producer);
+    g_thread_join(consumer);
+
+    per_thousand = 1000.0 / bench->processed;
+    printf("%-8s %8" G_GUINT64_FORMAT " %14.1f %14.1f\n",
+           bench->name, bench->processed,
+           bench->producer_writes * per_thousand,
+           bench->wakeups * per_thousand);
+}
+
+int main(void)
+{
+    Bench pipe_bench = {"pipe", TRUE, {-1, -1}, {-1, -1, 0}, 0, 0, 0, 0, 0};
+    Bench wakeup_bench = {"wakeup", FALSE, {-1, -1}, {-1, -1, 0}, 0, 0, 0, 0, 0};
+    GError *error = NULL;
+
+    if (!g_unix_open_pipe(pipe_bench.pipe_fds, FD_CLOEXEC, &error) ||
+        !g_unix_set_fd_nonblocking(pipe_bench.pipe_fds[0], TRUE, &error) ||
+        !wakeup_open(&wakeup_bench.wakeup, &error))
+    {
+        fprintf(stderr, "%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-8s %8s %14s %14s\n", "mode", "events", "writes/1000", "wakeups/1000");
+    run(&pipe_bench);
+    run(&wakeup_bench);
+
+    close(pipe_bench.pipe_fds[0]);
+    close(pipe_bench.pipe_fds[1]);
+    wakeup_close(&wakeup_bench.wakeup);
+
+    return EXIT_SUCCESS;
+}
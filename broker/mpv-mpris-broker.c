@@ -0,0 +1,648 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// mpv-mpris-broker: one MPRIS bridge shared by many mpv instances.
+//
+// Plugins started with --script-opts=mpris-broker=yes connect to this
+// daemon over a unix socket and stream their deltas to it instead of
+// talking to the session bus. The broker mirrors each instance's state,
+// answers D-Bus requests for it and sends commands back over the socket.
+//
+// MPRIS puts every player on the same object path under its own bus name,
+// so each instance still gets its own bus connection. What is shared is
+// the process, the main loop, the GDBus worker thread and the art cache:
+// art is resolved once per source for all instances.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-artwork.h"
+#include "mpv-mpris-bridge.h"
+#include "mpv-mpris-dbus.h"
+#include "mpv-mpris-introspection.h"
+#include "mpv-mpris-wire.h"
+
+#define ART_CACHE_MAX 1024
+#define SEND_TIMEOUT_S 1
+
+typedef struct Broker {
+    GMainLoop *loop;
+    gchar *bus_address;
+    GHashTable *art_urls;    // art source -> artUrl, "" when there is none
+    GHashTable *art_pending; // art sources being resolved
+    GList *instances;
+} Broker;
+
+// One connected mpv instance
+typedef struct Instance {
+    Broker *broker;
+    UserData ud; // only the D-Bus side fields are used
+    GSocketConnection *client;
+    GSource *read_source;
+    GByteArray *input;
+    GCancellable *cancellable;
+    GDBusConnection *connection;
+    guint32 pid;
+    guint name_id;
+    gboolean renamed;
+    GVariant *metadata; // last Metadata from the plugin, without art
+    gchar *art_source;
+    GHashTable *requests; // wire request id -> invocation, see WIRE_REPLY
+    guint32 next_request;
+} Instance;
+
+// Deltas accepted from plugins and the type their value must have
+static const struct {
+    const char *name;
+    const char *type;
+} known_deltas[] = {
+    {"PlaybackStatus", "s"},
+    {"LoopStatus", "s"},
+    {"Shuffle", "b"},
+    {"Fullscreen", "b"},
+    {"CanSetFullscreen", "b"},
+    {"Volume", "d"},
+    {"Rate", "d"},
+    {"Metadata", "a{sv}"},
+    {"Position", "(xx)"},
+    {"Seeked", "x"},
+};
+
+static void variant_unref0(gpointer value)
+{
+    if (value)
+    {
+        g_variant_unref(value);
+    }
+}
+
+static void publish_metadata(Instance *inst)
+{
+    const char *art_url = NULL;
+    GVariant *metadata = inst->metadata;
+
+    if (inst->art_source)
+    {
+        art_url = g_hash_table_lookup(inst->broker->art_urls, inst->art_source);
+    }
+
+    if (art_url && *art_url)
+    {
+        GVariantDict dict;
+        g_variant_dict_init(&dict, inst->metadata);
+        g_variant_dict_insert(&dict, "mpris:artUrl", "s", art_url);
+        metadata = g_variant_dict_end(&dict);
+    }
+
+    g_variant_ref_sink(metadata);
+    update_player_state(&inst->ud, "Metadata", metadata);
+    g_variant_unref(metadata);
+}
+
+static void resolve_art_thread(GTask *task, G_GNUC_UNUSED gpointer source_object,
+                               gpointer task_data,
+                               G_GNUC_UNUSED GCancellable *cancellable)
+{
+    g_task_return_pointer(task, find_art_url(task_data, NULL, NULL), g_free);
+}
+
+static void on_art_resolved(G_GNUC_UNUSED GObject *object, GAsyncResult *result,
+                            gpointer data)
+{
+    Broker *broker = data;
+    const char *source = g_task_get_task_data(G_TASK(result));
+    gchar *art_url = g_task_propagate_pointer(G_TASK(result), NULL);
+
+    if (g_hash_table_size(broker->art_urls) >= ART_CACHE_MAX)
+    {
+        g_hash_table_remove_all(broker->art_urls);
+    }
+    g_hash_table_insert(broker->art_urls, g_strdup(source),
+                        art_url ? art_url : g_strdup(""));
+    g_hash_table_remove(broker->art_pending, source);
+
+    for (GList *l = broker->instances; l; l = l->next)
+    {
+        Instance *inst = l->data;
+        if (g_strcmp0(inst->art_source, source) == 0)
+        {
+            publish_metadata(inst);
+        }
+    }
+}
+
+// Embedded art extraction reads the media file, so it runs off the main loop
+static void resolve_art(Broker *broker, const char *source)
+{
+    GTask *task;
+
+    if (g_hash_table_contains(broker->art_pending, source))
+    {
+        return;
+    }
+    g_hash_table_add(broker->art_pending, g_strdup(source));
+
+    task = g_task_new(NULL, NULL, on_art_resolved, broker);
+    g_task_set_task_data(task, g_strdup(source), g_free);
+    g_task_run_in_thread(task, resolve_art_thread);
+    g_object_unref(task);
+}
+
+static void set_metadata(Instance *inst, GVariant *value)
+{
+    GVariantDict dict;
+    gchar *source = NULL;
+
+    g_variant_dict_init(&dict, value);
+    g_variant_dict_lookup(&dict, WIRE_ART_SOURCE_KEY, "s", &source);
+    g_variant_dict_remove(&dict, WIRE_ART_SOURCE_KEY);
+
+    variant_unref0(inst->metadata);
+    inst->metadata = g_variant_ref_sink(g_variant_dict_end(&dict));
+    g_free(inst->art_source);
+    inst->art_source = source;
+
+    if (source && !g_hash_table_contains(inst->broker->art_urls, source))
+    {
+        resolve_art(inst->broker, source);
+    }
+
+    // Art follows in a second update if it still has to be resolved
+    publish_metadata(inst);
+}
+
+static void on_instance_name_lost(GDBusConnection *connection,
+                                  G_GNUC_UNUSED const char *name,
+                                  gpointer data)
+{
+    Instance *inst = data;
+    gchar *instance_name;
+
+    if (!connection || inst->renamed)
+    {
+        return;
+    }
+
+    // Same fallback name the plugin uses on its own
+    inst->renamed = TRUE;
+    instance_name = g_strdup_printf("org.mpris.MediaPlayer2.mpv.instance%u", inst->pid);
+    g_bus_unown_name(inst->name_id);
+    inst->name_id = g_bus_own_name_on_connection(connection, instance_name,
+                                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 NULL, NULL, NULL, NULL);
+    g_free(instance_name);
+}
+
+static void on_connection_ready(G_GNUC_UNUSED GObject *object, GAsyncResult *result,
+                                gpointer data)
+{
+    GError *error = NULL;
+    GDBusConnection *connection = g_dbus_connection_new_for_address_finish(result, &error);
+    Instance *inst = data;
+
+    if (!connection)
+    {
+        // On cancellation the instance is already gone
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_printerr("Failed to connect to the session bus for mpv %u: %s\n",
+                       inst->pid, error->message);
+        }
+        g_error_free(error);
+        return;
+    }
+
+    inst->connection = connection;
+
+    // Registers the objects and emits what the plugin sent so far
+    on_bus_acquired(connection, NULL, &inst->ud);
+
+    inst->name_id = g_bus_own_name_on_connection(connection,
+                                                 "org.mpris.MediaPlayer2.mpv",
+                                                 G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE,
+                                                 NULL, on_instance_name_lost,
+                                                 inst, NULL);
+}
+
+// Sent by the plugin once mpv acknowledged all parts of a request
+static void answer_request(Instance *inst, GVariant *value)
+{
+    GDBusMethodInvocation *invocation;
+    const char *error;
+    guint32 id;
+
+    if (!g_variant_is_of_type(value, WIRE_REPLY_TYPE))
+    {
+        return;
+    }
+
+    g_variant_get(value, "(u&s)", &id, &error);
+    invocation = g_hash_table_lookup(inst->requests, GUINT_TO_POINTER(id));
+    if (!invocation)
+    {
+        return;
+    }
+    g_hash_table_steal(inst->requests, GUINT_TO_POINTER(id));
+
+    if (*error)
+    {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_FAILED,
+                                              "mpv: %s", error);
+    }
+    else
+    {
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+}
+
+static void apply_delta(Instance *inst, const char *name, GVariant *value)
+{
+    if (g_strcmp0(name, WIRE_HELLO) == 0)
+    {
+        if (inst->pid || !g_variant_is_of_type(value, G_VARIANT_TYPE_UINT32))
+        {
+            return;
+        }
+
+        inst->pid = g_variant_get_uint32(value);
+        g_dbus_connection_new_for_address(inst->broker->bus_address,
+                                          G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                              G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                          NULL, inst->cancellable,
+                                          on_connection_ready, inst);
+        return;
+    }
+
+    if (g_strcmp0(name, WIRE_REPLY) == 0)
+    {
+        answer_request(inst, value);
+        return;
+    }
+
+    for (size_t i = 0; i < G_N_ELEMENTS(known_deltas); i++)
+    {
+        if (g_strcmp0(name, known_deltas[i].name) != 0)
+        {
+            continue;
+        }
+
+        if (!g_variant_is_of_type(value, G_VARIANT_TYPE(known_deltas[i].type)))
+        {
+            break;
+        }
+
+        if (g_strcmp0(name, "Metadata") == 0)
+        {
+            set_metadata(inst, value);
+        }
+        else
+        {
+            update_player_state(&inst->ud, known_deltas[i].name, value);
+        }
+        return;
+    }
+
+    g_printerr("Ignoring delta %s from mpv %u\n", name, inst->pid);
+}
+
+static void instance_free(Instance *inst)
+{
+    UserData *ud = &inst->ud;
+    MprisCommand cmd;
+
+    inst->broker->instances = g_list_remove(inst->broker->instances, inst);
+
+    // The last deltas, usually the Stopped status, still have to go out
+    flush_property_changes(ud, TRUE);
+
+    g_cancellable_cancel(inst->cancellable);
+    if (inst->name_id)
+    {
+        g_bus_unown_name(inst->name_id);
+    }
+    if (inst->connection)
+    {
+        if (ud->root_interface_id)
+        {
+            g_dbus_connection_unregister_object(inst->connection, ud->root_interface_id);
+        }
+        if (ud->player_interface_id)
+        {
+            g_dbus_connection_unregister_object(inst->connection, ud->player_interface_id);
+        }
+        if (ud->queue_interface_id)
+        {
+            g_dbus_connection_unregister_object(inst->connection, ud->queue_interface_id);
+        }
+        g_dbus_connection_flush_sync(inst->connection, NULL, NULL);
+        g_dbus_connection_close_sync(inst->connection, NULL, NULL);
+        g_object_unref(inst->connection);
+    }
+
+    g_source_destroy(inst->read_source);
+    g_source_unref(inst->read_source);
+    g_source_destroy(ud->emit_source);
+    g_source_unref(ud->emit_source);
+
+    while (ring_pop(ud->commands, &cmd))
+    {
+        g_strfreev(cmd.args);
+        cancel_request(cmd.invocation);
+    }
+    // Requests the plugin never answered
+    g_hash_table_unref(inst->requests);
+    ring_free(ud->commands);
+
+    g_hash_table_unref(ud->changed_properties);
+    property_cache_clear(&ud->root_properties);
+    property_cache_clear(&ud->player_properties);
+
+    g_io_stream_close(G_IO_STREAM(inst->client), NULL, NULL);
+    g_object_unref(inst->client);
+    g_byte_array_unref(inst->input);
+    g_object_unref(inst->cancellable);
+    variant_unref0(inst->metadata);
+    g_free(inst->art_source);
+    g_free(inst);
+}
+
+static gboolean receive_deltas(GSocket *socket, G_GNUC_UNUSED GIOCondition condition,
+                               gpointer data)
+{
+    Instance *inst = data;
+    GError *error = NULL;
+    GError *frame_error = NULL;
+    GVariant *message;
+    gboolean open = wire_receive(socket, inst->input, &error);
+
+    while ((message = wire_next(inst->input, WIRE_DELTA_TYPE, &frame_error)))
+    {
+        const char *name;
+        GVariant *value;
+
+        g_variant_get(message, "(&sv)", &name, &value);
+        apply_delta(inst, name, value);
+        g_variant_unref(value);
+        g_variant_unref(message);
+    }
+
+    if (open && !frame_error)
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (error || frame_error)
+    {
+        g_printerr("Dropping mpv %u: %s\n", inst->pid,
+                   (frame_error ? frame_error : error)->message);
+    }
+    g_clear_error(&error);
+    g_clear_error(&frame_error);
+
+    instance_free(inst);
+    return G_SOURCE_REMOVE;
+}
+
+// Ring source callback, sends the commands queued by the D-Bus handlers
+static gboolean forward_commands(gpointer data)
+{
+    Instance *inst = data;
+    GSocket *socket = g_socket_connection_get_socket(inst->client);
+    GError *error = NULL;
+    MprisCommand cmd;
+
+    while (ring_pop(inst->ud.commands, &cmd))
+    {
+        // Deferred requests are answered from the WIRE_REPLY the plugin
+        // sends once mpv acknowledged all of their parts
+        if (cmd.invocation)
+        {
+            cmd.request = ++inst->next_request;
+            g_hash_table_insert(inst->requests, GUINT_TO_POINTER(cmd.request),
+                                cmd.invocation);
+        }
+        if (!error && !wire_send(socket, wire_command(&cmd), &error))
+        {
+            g_printerr("Failed to send command to mpv %u: %s\n",
+                       inst->pid, error->message);
+        }
+        g_strfreev(cmd.args);
+    }
+
+    if (error)
+    {
+        // receive_deltas() sees the shutdown and drops the instance, which
+        // cancels the requests still waiting for a reply
+        g_error_free(error);
+        g_socket_shutdown(socket, TRUE, TRUE, NULL);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_incoming(G_GNUC_UNUSED GSocketService *service,
+                            GSocketConnection *client,
+                            G_GNUC_UNUSED GObject *source_object,
+                            gpointer data)
+{
+    Broker *broker = data;
+    Instance *inst = g_new0(Instance, 1);
+    UserData *ud = &inst->ud;
+    GSocket *socket = g_socket_connection_get_socket(client);
+    GSource *source;
+
+    inst->broker = broker;
+    inst->client = g_object_ref(client);
+    inst->input = g_byte_array_new();
+    inst->cancellable = g_cancellable_new();
+    inst->requests = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                           (GDestroyNotify)cancel_request);
+
+    ud->state.status = STATUS_STOPPED;
+    ud->state.rate = 1.0;
+    ud->root_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_interface;
+    ud->player_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_player_interface;
+    ud->queue_interface_info = (GDBusInterfaceInfo *)&org_mpv_mprisqueue_interface;
+    init_property_caches(ud);
+    memcpy(ud->emit_policies, default_emit_policies, sizeof(ud->emit_policies));
+    ud->changed_properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   NULL, variant_unref0);
+    ud->emit_source = emit_source_new(ud);
+    g_source_attach(ud->emit_source, NULL);
+
+    ud->commands = ring_new(COMMAND_RING_SIZE, sizeof(MprisCommand));
+    source = ring_source_new(ud->commands, forward_commands, inst);
+    g_source_attach(source, NULL);
+    g_source_unref(source);
+
+    // A plugin that stops reading must not stall the other instances
+    g_socket_set_timeout(socket, SEND_TIMEOUT_S);
+    inst->read_source = g_socket_create_source(socket, G_IO_IN, NULL);
+    g_source_set_callback(inst->read_source, G_SOURCE_FUNC(receive_deltas), inst, NULL);
+    g_source_attach(inst->read_source, NULL);
+
+    broker->instances = g_list_prepend(broker->instances, inst);
+    return TRUE;
+}
+
+static gboolean quit_broker(gpointer data)
+{
+    Broker *broker = data;
+
+    g_main_loop_quit(broker->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+// Refuse to take over the socket of a broker that is still running
+static gboolean broker_running(const char *socket_path)
+{
+    GSocketClient *client = g_socket_client_new();
+    GSocketAddress *address = g_unix_socket_address_new(socket_path);
+    GSocketConnection *connection;
+
+    connection = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address),
+                                         NULL, NULL);
+    g_object_unref(address);
+    g_object_unref(client);
+
+    if (connection)
+    {
+        g_object_unref(connection);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+int main(int argc, char **argv)
+{
+    Broker broker = {0};
+    GError *error = NULL;
+    gchar *socket_path = NULL;
+    gchar *socket_dir;
+    GOptionContext *options;
+    GSocketService *service = NULL;
+    GSocketAddress *address;
+    int ret = EXIT_FAILURE;
+    GOptionEntry entries[] = {
+        {"socket", 's', 0, G_OPTION_ARG_FILENAME, &socket_path,
+         "Listen on PATH instead of $XDG_RUNTIME_DIR/mpv-mpris/broker.sock", "PATH"},
+        {NULL, 0, 0, 0, NULL, NULL, NULL}};
+
+    options = g_option_context_new("- shared MPRIS bridge for mpv");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (!g_option_context_parse(options, &argc, &argv, &error))
+    {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(options);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(options);
+
+    if (!socket_path)
+    {
+        socket_path = wire_socket_path();
+    }
+
+    if (broker_running(socket_path))
+    {
+        g_printerr("A broker is already listening on %s\n", socket_path);
+        g_free(socket_path);
+        return EXIT_FAILURE;
+    }
+
+    socket_dir = g_path_get_dirname(socket_path);
+    g_mkdir_with_parents(socket_dir, 0700);
+    g_free(socket_dir);
+    g_unlink(socket_path);
+
+    broker.bus_address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if (!broker.bus_address)
+    {
+        g_printerr("No session bus: %s\n", error->message);
+        g_error_free(error);
+        goto cleanup;
+    }
+
+    broker.art_urls = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    broker.art_pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    service = g_socket_service_new();
+    address = g_unix_socket_address_new(socket_path);
+    if (!g_socket_listener_add_address(G_SOCKET_LISTENER(service), address,
+                                       G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT,
+                                       NULL, NULL, &error))
+    {
+        g_printerr("Failed to listen on %s: %s\n", socket_path, error->message);
+        g_error_free(error);
+        g_object_unref(address);
+        goto cleanup;
+    }
+    g_object_unref(address);
+
+    g_signal_connect(service, "incoming", G_CALLBACK(on_incoming), &broker);
+    g_socket_service_start(service);
+
+    broker.loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, quit_broker, &broker);
+    g_unix_signal_add(SIGTERM, quit_broker, &broker);
+
+    ret = EXIT_SUCCESS;
+    g_main_loop_run(broker.loop);
+
+cleanup:
+    while (broker.instances)
+    {
+        instance_free(broker.instances->data);
+    }
+
+    if (service)
+    {
+        g_socket_service_stop(service);
+        g_socket_listener_close(G_SOCKET_LISTENER(service));
+        g_object_unref(service);
+        g_unlink(socket_path);
+    }
+
+    cleanup_old_cache_files();
+
+    if (broker.loop)
+    {
+        g_main_loop_unref(broker.loop);
+    }
+    if (broker.art_urls)
+    {
+        g_hash_table_unref(broker.art_urls);
+        g_hash_table_unref(broker.art_pending);
+    }
+    g_free(broker.bus_address);
+    g_free(socket_path);
+
+    return ret;
+}
@@ -0,0 +1,91 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_ALLOC_H
+#define MPV_MPRIS_ALLOC_H
+
+#include <glib.h>
+
+// Allocation accounting, built in with `make ALLOC_STATS=1`. malloc()
+// and friends are then interposed and every allocation is charged to
+// the scope of the calling thread. The plugin is linked with
+// -Bsymbolic-functions so that its own malloc() calls reach the wrappers
+// even though mpv loads it with dlopen(), after libc. Everything else,
+// g_malloc() and GLib's own allocations included, is only counted when
+// the plugin is preloaded as well as loaded:
+//
+//   LD_PRELOAD=/path/to/mpris.so mpv --script=/path/to/mpris.so ...
+//
+// Without ALLOC_STATS=1 scopes compile to nothing and no counters are
+// kept.
+//
+// Scopes nest, the innermost one is charged: the art lookup done while
+// building metadata counts as art.
+typedef enum MprisAllocScope {
+    ALLOC_SCOPE_OTHER,    // mpv itself, GDBus worker and anything unscoped
+    ALLOC_SCOPE_MPV,      // the plugin's mpv thread: events, commands, deltas
+    ALLOC_SCOPE_METADATA, // create_metadata()
+    ALLOC_SCOPE_ART,      // find_art_url() and writing the art cache
+    ALLOC_SCOPE_DBUS,     // the plugin's D-Bus thread
+    ALLOC_SCOPE_COUNT,
+} MprisAllocScope;
+
+extern const char *const alloc_scope_names[ALLOC_SCOPE_COUNT];
+
+typedef struct MprisAllocStats {
+    guint64 allocations[ALLOC_SCOPE_COUNT];
+    guint64 bytes[ALLOC_SCOPE_COUNT];
+    guint64 frees; // not per scope, memory is often freed elsewhere
+} MprisAllocStats;
+
+#ifdef MPV_MPRIS_ALLOC_STATS
+
+// Returns the scope to hand back to alloc_scope_leave()
+MprisAllocScope alloc_scope_enter(MprisAllocScope scope);
+
+void alloc_scope_leave(MprisAllocScope previous);
+
+#else
+
+#define alloc_scope_enter(scope) ((void)(scope), ALLOC_SCOPE_OTHER)
+#define alloc_scope_leave(previous) ((void)(previous))
+
+#endif
+
+// Counters since the process started. Returns FALSE, with stats zeroed,
+// when built without ALLOC_STATS=1.
+gboolean alloc_stats_read(MprisAllocStats *stats);
+
+// TRUE if the wrappers are the process's malloc(), that is the plugin
+// was preloaded
+gboolean alloc_stats_process_wide(void);
+
+// Blocks allocated and not yet freed, process wide
+guint64 alloc_stats_live(const MprisAllocStats *stats);
+
+// a{s(tt)} of allocations and bytes by scope name
+GVariant *alloc_stats_snapshot(const MprisAllocStats *stats);
+
+#endif // MPV_MPRIS_ALLOC_H
@@ -0,0 +1,71 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_ART_FETCH_H
+#define MPV_MPRIS_ART_FETCH_H
+
+#include <gio/gio.h>
+
+// Local copies of remote art, such as YouTube thumbnails, so that MPRIS
+// clients load a file:// URI instead of each downloading the image again.
+// Images are fetched in the background with plain GIO (https needs
+// glib-networking) into the art cache, next to a .meta key file holding
+// the URL, the ETag and Last-Modified validators and when it was last
+// checked. Copies older than the maximum age are revalidated with a
+// conditional GET, a 304 only updates the check time.
+//
+// Everything but the fetches themselves happens on the thread that
+// created the fetcher, whose thread-default context gets the callbacks.
+
+// Limits of the fetches, exceeding one fails the fetch
+typedef struct ArtFetchBudget {
+    gsize max_bytes;   // of an image, larger ones are not fetched
+    guint timeout_s;   // for a whole fetch, redirects included
+    guint max_running; // fetches at once, more wait in line
+} ArtFetchBudget;
+
+// A fetch stored a new copy of url, art_url is its file:// URI
+typedef void (*ArtFetchFunc)(const char *url, const char *art_url, gpointer data);
+
+typedef struct ArtFetcher ArtFetcher;
+
+ArtFetcher *art_fetcher_new(const char *cache_dir, const ArtFetchBudget *budget,
+                            gint64 max_age_s, ArtFetchFunc func, gpointer data);
+
+// Cancels the fetches running and drops the waiting ones
+void art_fetcher_free(ArtFetcher *fetcher);
+
+// http:// and https:// URLs
+gboolean art_fetcher_is_remote(const char *url);
+
+// The cached copy of url as a file:// URI, NULL until there is one. A
+// missing or stale copy is fetched in the background, once however often
+// it is asked for.
+gchar *art_fetcher_lookup(ArtFetcher *fetcher, const char *url);
+
+// Fetches running or waiting
+guint art_fetcher_pending(ArtFetcher *fetcher);
+
+#endif // MPV_MPRIS_ART_FETCH_H
@@ -26,27 +26,34 @@
 #define MPV_MPRIS_ARTWORK_H
 
 #include "mpv-mpris-types.h"
+#include "mpv-mpris-avformat.h"
+#include "mpv-mpris-cache-writer.h"
 
 // Forward declaration
-gchar *path_to_uri(mpv_handle *mpv, char *path);
+gchar *path_to_uri(const char *working_dir, const char *path);
 
 // Album art file patterns
 extern const char art_files[][32];
+extern const size_t art_files_count;
 
 // Supported image extensions
 extern const char *supported_extensions[];
+extern const size_t supported_extensions_count;
 
 gboolean is_supported_image_file(const char *filename);
 
-gchar *path_to_uri(mpv_handle *mpv, char *path);
+gchar *path_to_uri(const char *working_dir, const char *path);
 
-gchar* extract_embedded_art(AVFormatContext *context, const char *media_path);
+#ifndef MPV_MPRIS_NO_AVFORMAT
+gchar* extract_embedded_art(AVFormatContext *context, const char *media_path,
+                            CacheWriter *writer);
+#endif
 
 gboolean is_art_file(const char *filename);
 
 const char *get_image_extension(const uint8_t *data, size_t size);
 
-gchar *try_get_local_art(mpv_handle *mpv, char *path);
+gchar *try_get_local_art(const char *path);
 
 gchar *get_cache_dir(void);
 
@@ -56,13 +63,14 @@ void cleanup_old_cache_files(void);
 
 gboolean is_art_file(const char *filename);
 
-gchar *try_get_embedded_art(char *path);
+gchar *try_get_embedded_art(char *path, CacheWriter *writer);
 
 void cleanup_old_cache_files(void);
 
 void cleanup_old_cache_files(void);
 
 gchar *try_get_youtube_thumbnail(const char *url);
-gchar *try_get_local_art_enhanced(mpv_handle *mpv, const char *path);
+
+gchar *find_art_url(const char *source, MprisHistogram *histograms, CacheWriter *writer);
 
 #endif // MPV_MPRIS_ARTWORK_H
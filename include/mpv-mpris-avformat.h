@@ -0,0 +1,50 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_AVFORMAT_H
+#define MPV_MPRIS_AVFORMAT_H
+
+// libavformat reads embedded cover art, and is all the plugin uses FFmpeg
+// for. It is not linked: the first lookup of embedded art loads it with
+// dlopen(), so players that never need it do not pay for it. With
+// `make AVFORMAT=0` it is left out altogether, headers included, and
+// MPV_MPRIS_NO_AVFORMAT is defined.
+#ifndef MPV_MPRIS_NO_AVFORMAT
+
+#include <libavformat/avformat.h>
+
+// The functions in use, with the prototypes of the headers built against
+typedef struct AvformatFuncs {
+    __typeof__(&avformat_open_input) open_input;
+    __typeof__(&avformat_close_input) close_input;
+} AvformatFuncs;
+
+// Loads libavformat on the first call, from any thread. NULL when it is
+// not installed, later calls do not try again.
+const AvformatFuncs *avformat_funcs(void);
+
+#endif
+
+#endif // MPV_MPRIS_AVFORMAT_H
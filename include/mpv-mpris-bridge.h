@@ -0,0 +1,69 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_BRIDGE_H
+#define MPV_MPRIS_BRIDGE_H
+
+#include "mpv-mpris-types.h"
+
+#define DELTA_RING_SIZE 256
+#define COMMAND_RING_SIZE 64
+#define REPLY_RING_SIZE 64
+
+// mpv thread
+void publish_delta(UserData *ud, const char *name, GVariant *value);
+
+void publish_position(UserData *ud);
+
+void push_deltas(UserData *ud);
+
+gboolean run_commands(gpointer data);
+
+void complete_request(UserData *ud, guint64 reply_id, int status);
+
+void cancel_pending_replies(UserData *ud);
+
+void bridge_shutdown(UserData *ud);
+
+// D-Bus thread
+gboolean apply_deltas(gpointer data);
+
+gboolean apply_replies(gpointer data);
+
+void cancel_request(GDBusMethodInvocation *invocation);
+
+void command_set_property(MprisCommand *cmd, const char *property,
+                          mpv_format format, const void *value);
+
+void command_run(MprisCommand *cmd, const char *const *args);
+
+void command_set_position(MprisCommand *cmd, gint64 track, gint64 position_us);
+
+void command_enqueue(MprisCommand *cmd, const char *const *uris, MprisEnqueueMode mode);
+
+gboolean submit_request(UserData *ud, MprisCommand *cmds, guint count,
+                        GDBusMethodInvocation *invocation, GError **error);
+
+#endif // MPV_MPRIS_BRIDGE_H
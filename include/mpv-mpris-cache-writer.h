@@ -0,0 +1,69 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef MPV_MPRIS_CACHE_WRITER_H
+#define MPV_MPRIS_CACHE_WRITER_H
+
+#include <glib.h>
+
+// Writes to the art cache. Everything in it can be made again, so files
+// are never fsynced: they are written to an unnamed O_TMPFILE and linked
+// in under their name once complete, so a reader never sees half a file.
+// Without O_TMPFILE support, a temporary name and rename() do the same.
+//
+// The writer thread takes these writes off the mpv thread. It is started
+// by the first queued write, so files without embedded art never pay for
+// it. Its queue is bounded in bytes; when it is full the caller writes
+// inline instead, so a writer that falls behind slows producers down
+// rather than growing.
+
+// Writes the file in place, whatever the writer is doing
+gboolean cache_write_file(const char *path, const void *data, gsize size, GError **error);
+
+// path was linked in, art_url is its file:// URI. key is what it was
+// queued with.
+typedef void (*CacheWriteFunc)(const char *key, const char *art_url, gpointer data);
+
+typedef struct CacheWriter CacheWriter;
+
+// func is called on the thread-default context of the calling thread
+CacheWriter *cache_writer_new(gsize max_queued, CacheWriteFunc func, gpointer data);
+
+// Finishes the queued writes, their callbacks are dropped
+void cache_writer_free(CacheWriter *writer);
+
+// FALSE when the queue is full, nothing is queued then
+gboolean cache_writer_queue(CacheWriter *writer, const char *path, GBytes *contents,
+                            const char *key);
+
+// Names the files of the cache that cache_remove_old_files() ages out
+typedef gboolean (*CacheFileFunc)(const char *name);
+
+// Removes the files of cache_dir that were not written or touched for
+// max_age_s, with the <name>.meta next to them. A .meta as old as that
+// goes on its own, and temporary files left by a crashed write go too.
+void cache_remove_old_files(const char *cache_dir, gint64 max_age_s,
+                            CacheFileFunc is_cache_file);
+
+#endif // MPV_MPRIS_CACHE_WRITER_H
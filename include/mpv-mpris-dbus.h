@@ -30,6 +30,8 @@
 
 extern GDBusInterfaceVTable vtable_root;
 extern GDBusInterfaceVTable vtable_player;
+extern GDBusInterfaceVTable vtable_queue;
+extern GDBusInterfaceVTable vtable_debug;
 
 void method_call_root(GDBusConnection *connection,
                      const char *sender,
@@ -40,23 +42,6 @@ void method_call_root(GDBusConnection *connection,
                      GDBusMethodInvocation *invocation,
                      gpointer user_data);
 
-GVariant *get_property_root(GDBusConnection *connection,
-                           const char *sender,
-                           const char *object_path,
-                           const char *interface_name,
-                           const char *property_name,
-                           GError **error,
-                           gpointer user_data);
-
-gboolean set_property_root(GDBusConnection *connection,
-                          const char *sender,
-                          const char *object_path,
-                          const char *interface_name,
-                          const char *property_name,
-                          GVariant *value,
-                          GError **error,
-                          gpointer user_data);
-
 void method_call_player(GDBusConnection *connection,
                        const char *sender,
                        const char *object_path,
@@ -66,26 +51,41 @@ void method_call_player(GDBusConnection *connection,
                        GDBusMethodInvocation *invocation,
                        gpointer user_data);
 
-GVariant *get_property_player(GDBusConnection *connection,
-                             const char *sender,
-                             const char *object_path,
-                             const char *interface_name,
-                             const char *property_name,
-                             GError **error,
-                             gpointer user_data);
-
-gboolean set_property_player(GDBusConnection *connection,
-                            const char *sender,
-                            const char *object_path,
-                            const char *interface_name,
-                            const char *property_name,
-                            GVariant *value,
-                            GError **error,
-                            gpointer user_data);
+void method_call_queue(GDBusConnection *connection,
+                       const char *sender,
+                       const char *object_path,
+                       const char *interface_name,
+                       const char *method_name,
+                       GVariant *parameters,
+                       GDBusMethodInvocation *invocation,
+                       gpointer user_data);
+
+void method_call_debug(GDBusConnection *connection,
+                       const char *sender,
+                       const char *object_path,
+                       const char *interface_name,
+                       const char *method_name,
+                       GVariant *parameters,
+                       GDBusMethodInvocation *invocation,
+                       gpointer user_data);
+
+void queue_property_change(UserData *ud, const char *prop_name, GVariant *prop_value);
+
+void flush_property_changes(UserData *ud, gboolean force);
 
 gboolean emit_property_changes(gpointer data);
 
-void emit_seeked_signal(UserData *ud);
+GSource *emit_source_new(UserData *ud);
+
+void emit_seeked_signal(UserData *ud, gint64 position_us);
+
+gint64 get_position_us(UserData *ud);
+
+void init_property_caches(UserData *ud);
+
+void update_player_state(UserData *ud, const char *name, GVariant *value);
+
+gpointer run_dbus_thread(gpointer data);
 
 void on_bus_acquired(GDBusConnection *connection,
                     const char *name,
@@ -29,12 +29,19 @@
 
 gboolean event_handler(int fd, GIOCondition condition, gpointer data);
 
-void wakeup_handler(void *fd);
-
 GVariant *set_playback_status(UserData *ud);
 
 void set_stopped_status(UserData *ud);
 
-void handle_property_change(const char *name, void *data, UserData *ud);
+// ArtFetchFunc of ud->art_fetcher
+void art_fetched(const char *url, const char *art_url, gpointer data);
+
+// CacheWriteFunc of ud->cache_writer
+void art_written(const char *key, const char *art_url, gpointer data);
+
+// FrameArtFunc of ud->frame_art
+void frame_art_stored(const char *media, const char *art_url, gpointer data);
+
+int observe_properties(mpv_handle *mpv);
 
 #endif // MPV_MPRIS_EVENTS_H
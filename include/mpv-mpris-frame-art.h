@@ -0,0 +1,79 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef MPV_MPRIS_FRAME_ART_H
+#define MPV_MPRIS_FRAME_ART_H
+
+#include <gio/gio.h>
+#include <mpv/client.h>
+
+// Art for media that has none of its own, taken from the video itself:
+// once playback is past an offset, mpv's screenshot-raw hands over the
+// frame it has already decoded, which is downscaled and stored in the art
+// cache as PNG. No second decoder runs, and a track played again finds
+// its frame in the cache.
+//
+// Grabs are rate-limited and a new track cancels the one in flight. The
+// position is read with mpv_get_property_async(), never waiting on mpv.
+// The frame is encoded in a GTask thread, the rest runs on the mpv thread.
+
+// reply_userdata of the screenshot-raw commands, kept apart from the
+// request ids of mpv-mpris-bridge.c
+#define FRAME_ART_REPLY_BIT (G_GUINT64_CONSTANT(1) << 63)
+
+typedef struct FrameArtOptions {
+    gint64 offset_us;       // media time of the frame, at most a third in
+    guint max_size;         // of the longer side, in pixels
+    gint64 interval_us;     // between two grabs, across tracks
+    guint64 position_reply; // reply_userdata of its time-pos reads
+} FrameArtOptions;
+
+// A frame of media was stored, art_url is its file:// URI
+typedef void (*FrameArtFunc)(const char *media, const char *art_url, gpointer data);
+
+typedef struct FrameArt FrameArt;
+
+FrameArt *frame_art_new(mpv_handle *mpv, const char *cache_dir,
+                        const FrameArtOptions *options, FrameArtFunc func,
+                        gpointer data);
+
+void frame_art_free(FrameArt *frame_art);
+
+// media, the absolute path or URL playing, has no art of its own. Returns
+// its cached frame as a file:// URI, or NULL and grabs one later.
+gchar *frame_art_want(FrameArt *frame_art, const char *media);
+
+// The track changes: the grab in flight or waiting is cancelled
+void frame_art_reset(FrameArt *frame_art);
+
+// MPV_EVENT_GET_PROPERTY_REPLY of a time-pos read, position_us 0 without
+// a value. Grabs now or checks again later. duration_us is -1 if unknown.
+void frame_art_position(FrameArt *frame_art, gint64 position_us, gint64 duration_us);
+
+// MPV_EVENT_COMMAND_REPLY with FRAME_ART_REPLY_BIT set, handled while the
+// event data is still valid
+void frame_art_reply(FrameArt *frame_art, guint64 reply_userdata, int error,
+                     const mpv_event_command *command);
+
+#endif // MPV_MPRIS_FRAME_ART_H
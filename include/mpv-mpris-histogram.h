@@ -0,0 +1,77 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_HISTOGRAM_H
+#define MPV_MPRIS_HISTOGRAM_H
+
+#include <glib.h>
+
+// Log-linear buckets, HDR style: every power of two is split into
+// 2^HISTOGRAM_SUB_BITS buckets, so a bucket is at most 12.5% wide
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+// Durations in nanoseconds. Recording is a single atomic increment, so
+// any thread may record while another one takes a snapshot.
+typedef struct MprisHistogram {
+    gint counts[HISTOGRAM_BUCKETS];
+} MprisHistogram;
+
+// The histograms kept with mpris-debug=yes, besides the per property Get
+// times
+typedef enum MprisHistogramId {
+    HISTOGRAM_EVENT_TO_SIGNAL, // change published by the mpv thread until PropertiesChanged
+    HISTOGRAM_METADATA,        // create_metadata()
+    HISTOGRAM_ART_EMBEDDED,
+    HISTOGRAM_ART_LOCAL,
+    HISTOGRAM_ART_YOUTUBE,
+    HISTOGRAM_LOOP_MPV, // main loop iterations, time between two polls
+    HISTOGRAM_LOOP_DBUS,
+    HISTOGRAM_COUNT,
+} MprisHistogramId;
+
+extern const char *const histogram_names[HISTOGRAM_COUNT];
+
+gint64 histogram_now_ns(void);
+
+void histogram_record(MprisHistogram *histogram, gint64 value_ns);
+
+void histogram_reset(MprisHistogram *histogram);
+
+gint64 histogram_percentile(const MprisHistogram *histogram, double percentile);
+
+GVariant *histogram_snapshot(const MprisHistogram *histogram);
+
+// The helpers below take the whole set, NULL when debugging is off, and
+// then cost nothing but the check
+gint64 histograms_start(MprisHistogram *set);
+
+void histograms_record_since(MprisHistogram *set, MprisHistogramId id, gint64 start);
+
+// Records the iterations of context into histogram, for loops run from
+// the calling thread
+void histogram_time_loop(GMainContext *context, MprisHistogram *histogram);
+
+#endif // MPV_MPRIS_HISTOGRAM_H
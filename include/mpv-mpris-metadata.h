@@ -30,27 +30,27 @@
 GVariant *create_metadata(UserData *ud);
 
 gchar *string_to_utf8(gchar *maybe_utf8);
-gchar *path_to_uri(mpv_handle *mpv, char *path);
+gchar *path_to_uri(const char *working_dir, const char *path);
 
-void add_metadata_item_string(mpv_handle *mpv, GVariantDict *dict,
-                             const char *property, const char *tag);
+// Tags of the metadata property, keys are matched ignoring case. node
+// may be NULL for an empty table.
+GHashTable *metadata_tags_new(const mpv_node *node);
 
-void add_metadata_item_int(mpv_handle *mpv, GVariantDict *dict,
-                          const char *property, const char *tag);
+void add_metadata_item_string(GHashTable *tags, GVariantDict *dict,
+                              const char *key, const char *tag);
 
-void add_metadata_item_string_list(mpv_handle *mpv, GVariantDict *dict,
-                                  const char *property, const char *tag);
+void add_metadata_item_int(GHashTable *tags, GVariantDict *dict,
+                           const char *key, const char *tag);
 
-void add_metadata_uri(mpv_handle *mpv, GVariantDict *dict);
+void add_metadata_item_string_list(GHashTable *tags, GVariantDict *dict,
+                                   const char *key, const char *tag);
 
-void add_metadata_art(mpv_handle *mpv, GVariantDict *dict, UserData *ud);
+void add_metadata_uri(UserData *ud, GVariantDict *dict);
 
-void add_metadata_content_created(mpv_handle *mpv, GVariantDict *dict);
+void add_metadata_art(GVariantDict *dict, UserData *ud);
 
-void wakeup_handler(void *fd);
+void add_metadata_content_created(GHashTable *tags, GVariantDict *dict);
 
 GVariant *create_metadata(UserData *ud);
 
-gchar *extract_embedded_art(AVFormatContext *context, const char *path);
-
 #endif // MPV_MPRIS_METADATA_H
@@ -0,0 +1,42 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_OPTIONS_H
+#define MPV_MPRIS_OPTIONS_H
+
+#include "mpv-mpris-types.h"
+
+// Prefix of the keys this plugin reads from mpv's script-opts
+#define SCRIPT_OPTS_PREFIX "mpris-"
+
+gchar *get_script_opt(mpv_handle *mpv, const char *name);
+
+gint64 get_script_opt_int(mpv_handle *mpv, const char *name, gint64 fallback);
+
+gboolean get_script_opt_flag(mpv_handle *mpv, const char *name, gboolean fallback);
+
+void load_emit_policies(UserData *ud);
+
+#endif // MPV_MPRIS_OPTIONS_H
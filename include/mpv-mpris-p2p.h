@@ -0,0 +1,47 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef MPV_MPRIS_P2P_H
+#define MPV_MPRIS_P2P_H
+
+#include "mpv-mpris-types.h"
+
+// A controller connected directly to the plugin's private socket
+typedef struct MprisPeer {
+    GDBusConnection *connection;
+    guint root_interface_id;
+    guint player_interface_id;
+    guint queue_interface_id;
+} MprisPeer;
+
+gchar *p2p_default_socket_path(void);
+
+void p2p_start(UserData *ud);
+
+void p2p_stop(UserData *ud);
+
+void p2p_emit_signal(UserData *ud, const char *interface_name,
+                     const char *signal_name, GVariant *params);
+
+#endif // MPV_MPRIS_P2P_H
@@ -0,0 +1,54 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef MPV_MPRIS_PROPS_H
+#define MPV_MPRIS_PROPS_H
+
+#include <gio/gio.h>
+
+// Current property values of one D-Bus interface, kept in the form GetAll
+// replies with. Each property is stored as a ready "{sv}" entry and the
+// "(a{sv})" reply is built from them only after a property changed, so
+// serving GetAll usually costs a single reference.
+typedef struct PropertyCache {
+    GDBusInterfaceInfo *info;
+    guint n_entries;
+    GVariant **entries; // "{sv}" in introspection order, NULL when unset
+    GVariant *reply;    // "(a{sv})" GetAll reply, NULL when dirty
+} PropertyCache;
+
+void property_cache_init(PropertyCache *cache, GDBusInterfaceInfo *info);
+
+void property_cache_clear(PropertyCache *cache);
+
+void property_cache_set(PropertyCache *cache, const char *name, GVariant *value);
+
+GVariant *property_cache_get(PropertyCache *cache, const char *name);
+
+GVariant *property_cache_get_all(PropertyCache *cache);
+
+GVariant *property_cache_get_all_with(PropertyCache *cache, const char *name,
+                                      GVariant *value);
+
+#endif // MPV_MPRIS_PROPS_H
@@ -0,0 +1,58 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_RING_H
+#define MPV_MPRIS_RING_H
+
+#include <glib.h>
+
+// Bounded single-producer single-consumer queue of fixed-size elements.
+// Neither side ever blocks: a push into a full ring fails and the
+// producer decides what to do with the element.
+typedef struct MprisRing {
+    guint capacity;       // power of two
+    gsize elem_size;
+    gint head;            // next slot to write, only advanced by the producer
+    gint tail;            // next slot to read, only advanced by the consumer
+    gint wakeup_pending;  // set once the consumer source has been woken up
+    GSource *source;      // consumer side source, see ring_source_new()
+    guint8 *slots;
+} MprisRing;
+
+MprisRing *ring_new(guint capacity, gsize elem_size);
+
+void ring_free(MprisRing *ring);
+
+gboolean ring_push(MprisRing *ring, const void *elem);
+
+gboolean ring_pop(MprisRing *ring, void *elem);
+
+guint ring_length(MprisRing *ring);
+
+void ring_notify(MprisRing *ring);
+
+GSource *ring_source_new(MprisRing *ring, GSourceFunc callback, gpointer user_data);
+
+#endif // MPV_MPRIS_RING_H
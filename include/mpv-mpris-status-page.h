@@ -0,0 +1,168 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef MPV_MPRIS_STATUS_PAGE_H
+#define MPV_MPRIS_STATUS_PAGE_H
+
+// Layout of the shared status page and a reader for it. This header only
+// depends on libc so that status bars and other pollers can copy it.
+//
+// With mpris-status-page=yes the plugin keeps a small file in
+// $XDG_RUNTIME_DIR/mpv-mpris/mpv-<pid>.status mapped in memory and updates
+// it whenever the player state changes. After mpris_status_page_open(), a
+// snapshot is read without any syscall.
+//
+// Updates are published under a seqlock: the writer makes sequence odd,
+// changes the fields and makes it even again. A reader copies the fields
+// between two loads of sequence and retries when they differ.
+//
+// Under a strict -std=c99, define _POSIX_C_SOURCE 200809L before
+// including it.
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MPRIS_STATUS_PAGE_MAGIC 0x5350504du // "MPPS"
+#define MPRIS_STATUS_PAGE_VERSION 1
+#define MPRIS_STATUS_PAGE_TITLE_MAX 256
+
+// Readers give up after this many torn reads, e.g. if mpv died mid-update
+#define MPRIS_STATUS_PAGE_MAX_RETRIES 1000
+
+enum {
+    MPRIS_STATUS_STOPPED = 0,
+    MPRIS_STATUS_PLAYING = 1,
+    MPRIS_STATUS_PAUSED = 2,
+};
+
+// The fields a reader gets a consistent copy of
+typedef struct MprisStatus {
+    uint32_t playback_status; // MPRIS_STATUS_*
+    uint32_t title_length;    // bytes in title, without the terminator
+    int64_t position_us;      // playback position at position_time_us
+    int64_t position_time_us; // CLOCK_MONOTONIC time of the position sample
+    double rate;
+    double volume;
+    char title[MPRIS_STATUS_PAGE_TITLE_MAX]; // UTF-8, NUL-terminated
+} MprisStatus;
+
+typedef struct MprisStatusPage {
+    uint32_t magic;
+    uint32_t version; // bumped on incompatible layout changes
+    uint32_t size;    // sizeof(MprisStatusPage) of the writer
+    uint32_t sequence;
+    int32_t pid;      // the mpv process
+    uint32_t reserved;
+    MprisStatus status;
+} MprisStatusPage;
+
+// Maps a status page read-only. Returns NULL if it cannot be opened or was
+// written by an incompatible version.
+static inline const MprisStatusPage *mpris_status_page_open(const char *path)
+{
+    struct stat st;
+    const MprisStatusPage *page;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(MprisStatusPage))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    page = mmap(NULL, sizeof(MprisStatusPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (page->magic != MPRIS_STATUS_PAGE_MAGIC ||
+        page->version != MPRIS_STATUS_PAGE_VERSION)
+    {
+        munmap((void *)page, sizeof(MprisStatusPage));
+        return NULL;
+    }
+    return page;
+}
+
+static inline void mpris_status_page_close(const MprisStatusPage *page)
+{
+    munmap((void *)page, sizeof(MprisStatusPage));
+}
+
+// Copies a consistent snapshot into out. Returns 0 on success and -1 if
+// the writer never finished its update.
+static inline int mpris_status_page_read(const MprisStatusPage *page, MprisStatus *out)
+{
+    for (int i = 0; i < MPRIS_STATUS_PAGE_MAX_RETRIES; i++)
+    {
+        uint32_t begin = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        uint32_t end;
+
+        if (begin & 1)
+        {
+            continue;
+        }
+
+        memcpy(out, (const void *)&page->status, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+
+        if (begin == end)
+        {
+            out->title[MPRIS_STATUS_PAGE_TITLE_MAX - 1] = '\0';
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Current playback position extrapolated from a snapshot. clock_gettime()
+// with CLOCK_MONOTONIC is served by the vDSO and does not enter the kernel.
+static inline int64_t mpris_status_position(const MprisStatus *status)
+{
+    struct timespec now;
+    int64_t now_us;
+
+    if (status->playback_status != MPRIS_STATUS_PLAYING)
+    {
+        return status->position_us;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_us = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    return status->position_us +
+           (int64_t)((double)(now_us - status->position_time_us) * status->rate);
+}
+
+#endif // MPV_MPRIS_STATUS_PAGE_H
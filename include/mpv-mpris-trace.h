@@ -0,0 +1,69 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_TRACE_H
+#define MPV_MPRIS_TRACE_H
+
+// USDT probes for bpftrace, perf and SystemTap, built in with
+// `make USDT=1` (needs <sys/sdt.h>, from systemtap-sdt-dev or
+// systemtap-sdt-devel). A probe is a single nop until a tracer attaches,
+// arguments are only values already at hand. Without USDT=1 they compile
+// to nothing. Provider mpv_mpris, probes:
+//
+//   event_handler_entry
+//   event_handler_exit         events
+//   property_change            reply_userdata, property name (NULL for reads)
+//   metadata_begin             playlist_pos
+//   metadata_end               playlist_pos
+//   art_begin                  source
+//   art_end                    source, artUrl (NULL if none)
+//   art_cache_write            cache path, bytes, once the file is in place
+//   emit_flush                 interface, properties
+//   dbus_method                interface, method
+//   dbus_get                   interface, property
+//   dbus_get_all               interface
+//
+// For example:
+//   bpftrace -e 'usdt:/path/to/mpris.so:mpv_mpris:dbus_get
+//                { @[str(arg1)] = count(); }' -p $(pidof mpv)
+
+#ifdef MPV_MPRIS_USDT
+
+#include <sys/sdt.h>
+
+#define MPRIS_TRACE(name) DTRACE_PROBE(mpv_mpris, name)
+#define MPRIS_TRACE1(name, a) DTRACE_PROBE1(mpv_mpris, name, a)
+#define MPRIS_TRACE2(name, a, b) DTRACE_PROBE2(mpv_mpris, name, a, b)
+
+#else
+
+// Arguments are still referenced so that values only traced do not warn
+#define MPRIS_TRACE(name) do { } while (0)
+#define MPRIS_TRACE1(name, a) do { (void)(a); } while (0)
+#define MPRIS_TRACE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+
+#endif
+
+#endif // MPV_MPRIS_TRACE_H
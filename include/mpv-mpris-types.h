@@ -28,12 +28,20 @@
 #include <gio/gio.h>
 #include <glib-unix.h>
 #include <mpv/client.h>
-#include <libavformat/avformat.h>
 #include <inttypes.h>
 #include <string.h>
 
+#include "mpv-mpris-art-fetch.h"
+#include "mpv-mpris-histogram.h"
+#include "mpv-mpris-props.h"
+#include "mpv-mpris-ring.h"
+#include "mpv-mpris-wakeup.h"
+
 #define CACHE_MAX_AGE_DAYS 15
 #define SECONDS_PER_DAY 86400
+// Art cache writes waiting for the writer thread, in bytes. Beyond that
+// they are written inline.
+#define CACHE_WRITER_MAX_QUEUED (8 * 1024 * 1024)
 
 extern const char *STATUS_PLAYING;
 extern const char *STATUS_PAUSED;
@@ -47,33 +55,208 @@ extern const char *youtube_url_pattern;
 extern GRegex *youtube_url_regex;
 
 extern const char *supported_extensions[];
+extern const size_t supported_extensions_count;
 
 extern const char art_files[][32];
+extern const size_t art_files_count;
+
+#define EMIT_POLICY_COUNT 8
+
+// How a changed property is turned into PropertiesChanged traffic.
+// A pending change goes out at most latency_budget_us after it was first
+// queued, and never sooner than min_interval_us after the previous
+// emission of the same property. Newer values replace older pending ones.
+typedef struct EmitPolicy {
+    const char *property;
+    const char *interface;
+    gint64 latency_budget_us;
+    gint64 min_interval_us;
+} EmitPolicy;
+
+typedef struct EmitState {
+    gint64 pending_since; // 0 when nothing is pending
+    gint64 last_emit;
+    gint64 changed_at; // MprisDelta.time of the pending change, debug only
+} EmitState;
+
+extern const EmitPolicy default_emit_policies[EMIT_POLICY_COUNT];
+
+// Player state as seen from the D-Bus thread. It is only updated from the
+// deltas sent by the mpv thread, so D-Bus requests never wait on mpv.
+// Property values themselves live in the property caches; this keeps what
+// method calls and the position extrapolation need.
+typedef struct PlayerState {
+    const char *status;
+    gboolean shuffle;
+    double rate;
+    gint64 position_us;   // playback position at position_time
+    gint64 position_time; // monotonic time of the last position update
+} PlayerState;
 
-extern const char *introspection_xml;
+// Property update sent from the mpv thread to the D-Bus thread
+typedef struct MprisDelta {
+    const char *name; // static string
+    GVariant *value;  // owned reference
+    gint64 time;      // histogram_now_ns() of the change, 0 unless debug
+} MprisDelta;
+
+// reply_userdata of the observed mpv properties and of the async property
+// reads. Indexes the dispatch table in mpv-mpris-events.c, 0 is left to
+// events nobody asked for.
+typedef enum MprisPropertyId {
+    PROPERTY_NONE,
+    PROPERTY_PAUSE,
+    PROPERTY_IDLE_ACTIVE,
+    PROPERTY_MEDIA_TITLE,
+    PROPERTY_SPEED,
+    PROPERTY_VOLUME,
+    PROPERTY_LOOP_FILE,
+    PROPERTY_LOOP_PLAYLIST,
+    PROPERTY_DURATION,
+    PROPERTY_SHUFFLE,
+    PROPERTY_FULLSCREEN,
+    PROPERTY_VO_CONFIGURED,
+    PROPERTY_PLAYLIST_POS,
+    PROPERTY_METADATA,
+    PROPERTY_PATH,
+    PROPERTY_WORKING_DIRECTORY,
+    PROPERTY_POSITION,           // publish_position()
+    PROPERTY_SEEK_POSITION,      // after a seek
+    PROPERTY_FRAME_ART_POSITION, // read by ud->frame_art
+    PROPERTY_COUNT,
+} MprisPropertyId;
+
+typedef enum MprisCommandKind {
+    COMMAND_SET_PROPERTY,
+    COMMAND_RUN,
+    COMMAND_SET_POSITION,
+    COMMAND_ENQUEUE,
+} MprisCommandKind;
+
+// Where org.mpv.MprisQueue.Enqueue puts its items
+typedef enum MprisEnqueueMode {
+    ENQUEUE_APPEND,
+    ENQUEUE_REPLACE,
+    ENQUEUE_INSERT_NEXT,
+} MprisEnqueueMode;
+
+// Request sent from the D-Bus thread to the mpv thread
+typedef struct MprisCommand {
+    MprisCommandKind kind;
+    const char *property; // COMMAND_SET_PROPERTY, static string
+    mpv_format format;    // MPV_FORMAT_FLAG or MPV_FORMAT_DOUBLE
+    int flag;
+    double number;
+    gchar **args;         // COMMAND_RUN and COMMAND_ENQUEUE, owned
+    gint64 track;         // COMMAND_SET_POSITION
+    gint64 position_us;
+    // Set on the first command of a D-Bus request only. The request is
+    // answered once mpv acknowledged all of its parts, which follow each
+    // other in the ring. invocation is NULL if it was already answered.
+    GDBusMethodInvocation *invocation; // owned
+    guint parts;
+    // Broker mode: stands in for invocation, the broker waits for the
+    // WIRE_REPLY with this id. 0 when nobody waits.
+    guint32 request;
+} MprisCommand;
+
+// Outcome of a command, sent from the mpv thread to the D-Bus thread
+typedef struct MprisReply {
+    GDBusMethodInvocation *invocation; // owned
+    const char *error;                 // mpv_error_string(), NULL on success
+    guint32 request;                   // broker mode, see MprisCommand
+} MprisReply;
 
 // Main user data structure
 typedef struct UserData {
     mpv_handle *mpv;
+
+    // mpv thread: runs mpv_open_cplugin() and handles mpv events
+    GMainContext *context;
     GMainLoop *loop;
-    gint bus_id;
-    GDBusConnection *connection;
-    GDBusInterfaceInfo *root_interface_info;
-    GDBusInterfaceInfo *player_interface_info;
-    guint root_interface_id;
-    guint player_interface_id;
+    MprisWakeup wakeup;
     const char *status;
     const char *loop_status;
+    gboolean loop_file;
+    gboolean loop_playlist;
     gboolean shuffle;
-    GHashTable *changed_properties;
-    GVariant *metadata;
     gboolean seek_expected;
     gboolean idle;
     gboolean paused;
+    gint64 playlist_pos; // -1 without a current entry
+    // What Metadata is built from, observed so that create_metadata()
+    // never reads from mpv
+    gchar *media_title;
+    gchar *path;
+    gchar *working_dir;
+    double duration;  // seconds, -1 when unknown
+    GHashTable *tags; // the metadata property, see metadata_tags_new()
+    gboolean file_loading;   // from START_FILE or END_FILE until FILE_LOADED
+    gboolean file_loaded;    // the next Metadata rebuild is the one of a load
+    gboolean metadata_dirty; // Metadata has to be rebuilt
+    GSource *metadata_settle; // late tags of the last load are collected
+    guint64 metadata_rebuilds;
+    GHashTable *outgoing; // deltas not yet handed to the D-Bus thread
+    gint64 outgoing_since; // oldest of them, with debug
+    GHashTable *pending_replies; // reply_userdata -> PendingReply
+    GQueue finished_replies;     // PendingReply not yet handed over
+    guint64 next_reply_id;
+    struct PendingReply *current_request; // whose parts run_commands() is running
+    GSource *retry_source;
+    gboolean debug;       // org.mpv.MprisDebug is served
+    gboolean use_broker;  // D-Bus presence is left to the broker daemon
 
     // Cache fields
-    char *cached_path;     // owned by mpv
+    gchar *cached_path;    // owned by glib
     gchar *cached_art_url; // owned by glib
+    gchar *cached_art_source; // what art was looked up for, path or URL
+    gchar *remote_art_url; // what cached_art_url stands in for, NULL if not proxied
+    struct ArtFetcher *art_fetcher; // made on the first remote artUrl
+    gboolean art_proxy;             // mpris-art-proxy, off if there is no cache
+    ArtFetchBudget art_proxy_budget;
+    gint64 art_proxy_max_age_s;
+    struct FrameArt *frame_art;     // NULL unless mpris-frame-art
+    struct CacheWriter *cache_writer; // embedded art is written by it
+
+    // D-Bus thread: owns the bus name and answers D-Bus requests
+    GThread *dbus_thread;
+    GMainContext *dbus_context;
+    GMainLoop *dbus_loop;
+    gint bus_id;
+    GDBusConnection *connection;
+    GDBusInterfaceInfo *root_interface_info;
+    GDBusInterfaceInfo *player_interface_info;
+    GDBusInterfaceInfo *queue_interface_info;
+    GDBusInterfaceInfo *debug_interface_info;
+    guint root_interface_id;
+    guint player_interface_id;
+    guint queue_interface_id;
+    guint debug_interface_id;
+    PlayerState state;
+    PropertyCache root_properties;
+    PropertyCache player_properties;
+    PropertyCache debug_properties; // only with ud->debug
+    GHashTable *get_histograms;     // property name -> MprisHistogram, debug only
+    gint64 delta_time;              // MprisDelta.time of the delta being applied
+    GHashTable *changed_properties;
+    EmitPolicy emit_policies[EMIT_POLICY_COUNT];
+    EmitState emit_state[EMIT_POLICY_COUNT];
+    GSource *emit_source;
+    gchar *p2p_socket; // private socket for direct peers, NULL when disabled
+    GDBusServer *p2p_server;
+    GList *peers; // MprisPeer
+    gchar *status_page_path; // shared status page, NULL when disabled
+    struct MprisStatusPage *status_page;
+    GSocket *broker_socket; // broker mode only, replaces the bus connection
+    GByteArray *broker_input;
+    guint broker_dropping; // parts left of a broker request that did not fit
+
+    // Shared between both threads
+    MprisRing *deltas;   // mpv thread -> D-Bus thread
+    MprisRing *commands; // D-Bus thread -> mpv thread
+    MprisRing *replies;  // mpv thread -> D-Bus thread
+    MprisHistogram *histograms; // HISTOGRAM_COUNT of them, NULL unless debug
+    gint quitting;
 } UserData;
 
 extern const char *STATUS_PLAYING;
@@ -88,10 +271,10 @@ extern const char *youtube_url_pattern;
 extern GRegex *youtube_url_regex;
 
 extern const char *supported_extensions[];
+extern const size_t supported_extensions_count;
 
 extern const char art_files[][32];
-
-extern const char *introspection_xml;
+extern const size_t art_files_count;
 
 extern GMutex metadata_mutex;
 
@@ -0,0 +1,48 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef MPV_MPRIS_WAKEUP_H
+#define MPV_MPRIS_WAKEUP_H
+
+#include <glib.h>
+
+// Wakeup channel from mpv's thread to the mpv event handler. mpv calls the
+// wakeup callback once per queued event; the pending flag makes sure only
+// the first one after a drain costs a write().
+typedef struct MprisWakeup {
+    int read_fd;
+    int write_fd; // same as read_fd when backed by an eventfd
+    gint pending;
+} MprisWakeup;
+
+gboolean wakeup_open(MprisWakeup *wakeup, GError **error);
+
+void wakeup_close(MprisWakeup *wakeup);
+
+void wakeup_handler(void *data);
+
+void wakeup_drain(MprisWakeup *wakeup);
+
+#endif // MPV_MPRIS_WAKEUP_H
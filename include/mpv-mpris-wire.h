@@ -0,0 +1,69 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef MPV_MPRIS_WIRE_H
+#define MPV_MPRIS_WIRE_H
+
+#include <gio/gio.h>
+
+#include "mpv-mpris-types.h"
+
+// Framing between the plugin and the broker daemon on a unix socket.
+// Every frame is a little-endian 32-bit length followed by a serialized
+// GVariant. The plugin sends deltas as "(sv)", the same name and value the
+// D-Bus thread would apply, and the broker sends commands back.
+#define WIRE_DELTA_TYPE G_VARIANT_TYPE("(sv)")
+#define WIRE_COMMAND_TYPE G_VARIANT_TYPE("(usibdasxxuu)")
+#define WIRE_MAX_FRAME (1 << 20)
+
+// First delta on a new connection, carries the pid of the mpv process
+#define WIRE_HELLO "Hello"
+
+// Delta answering a command the broker gave a request id, once mpv
+// acknowledged all of its parts. Carries the id and the mpv error, empty
+// on success.
+#define WIRE_REPLY "Reply"
+#define WIRE_REPLY_TYPE G_VARIANT_TYPE("(us)")
+
+// Metadata key replacing mpris:artUrl in broker mode. The broker resolves
+// and caches the art for this URL or absolute file name.
+#define WIRE_ART_SOURCE_KEY "mpv-mpris:artSource"
+
+gchar *wire_socket_path(void);
+
+GVariant *wire_delta(const char *name, GVariant *value);
+
+GVariant *wire_command(const MprisCommand *cmd);
+
+void wire_parse_command(GVariant *message, MprisCommand *cmd);
+
+GVariant *wire_reply(guint32 request, const char *error);
+
+gboolean wire_send(GSocket *socket, GVariant *message, GError **error);
+
+gboolean wire_receive(GSocket *socket, GByteArray *buffer, GError **error);
+
+GVariant *wire_next(GByteArray *buffer, const GVariantType *type, GError **error);
+
+#endif // MPV_MPRIS_WIRE_H
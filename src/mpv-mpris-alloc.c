@@ -0,0 +1,240 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// RTLD_DEFAULT is a GNU extension
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <string.h>
+
+#include "mpv-mpris-alloc.h"
+
+const char *const alloc_scope_names[ALLOC_SCOPE_COUNT] = {
+    [ALLOC_SCOPE_OTHER] = "other",
+    [ALLOC_SCOPE_MPV] = "mpv",
+    [ALLOC_SCOPE_METADATA] = "metadata",
+    [ALLOC_SCOPE_ART] = "art",
+    [ALLOC_SCOPE_DBUS] = "dbus",
+};
+
+#ifdef MPV_MPRIS_ALLOC_STATS
+
+#include <errno.h>
+
+// glibc's allocator under its internal names, what the wrappers below
+// forward to
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+// initial-exec, the default model for a shared object may allocate on a
+// thread's first access, from inside malloc()
+static __thread MprisAllocScope current_scope
+    __attribute__((tls_model("initial-exec")));
+
+// The plugin hides its symbols, the wrappers have to stay visible to
+// interpose
+#pragma GCC visibility push(default)
+
+static guint64 allocations[ALLOC_SCOPE_COUNT];
+static guint64 bytes[ALLOC_SCOPE_COUNT];
+static guint64 frees;
+
+static void record_allocation(size_t size)
+{
+    MprisAllocScope scope = current_scope;
+
+    __atomic_add_fetch(&allocations[scope], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bytes[scope], size, __ATOMIC_RELAXED);
+}
+
+static void record_free(void)
+{
+    __atomic_add_fetch(&frees, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+
+    if (ptr)
+    {
+        record_allocation(size);
+    }
+    return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *ptr = __libc_calloc(nmemb, size);
+
+    if (ptr)
+    {
+        record_allocation(nmemb * size);
+    }
+    return ptr;
+}
+
+// Growing a block in place is neither an allocation nor a free, but
+// realloc() of NULL and to 0 bytes are
+void *realloc(void *ptr, size_t size)
+{
+    void *new_ptr = __libc_realloc(ptr, size);
+
+    if (!ptr && new_ptr)
+    {
+        record_allocation(size);
+    }
+    else if (ptr && size == 0)
+    {
+        record_free();
+    }
+    else if (new_ptr)
+    {
+        __atomic_add_fetch(&bytes[current_scope], size, __ATOMIC_RELAXED);
+    }
+    return new_ptr;
+}
+
+// Aligned blocks are released with free(), they have to be counted too
+void *memalign(size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+
+    if (ptr)
+    {
+        record_allocation(size);
+    }
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+    ptr = memalign(alignment, size);
+    if (!ptr)
+    {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    if (ptr)
+    {
+        record_free();
+    }
+    __libc_free(ptr);
+}
+
+#pragma GCC visibility pop
+
+MprisAllocScope alloc_scope_enter(MprisAllocScope scope)
+{
+    MprisAllocScope previous = current_scope;
+
+    current_scope = scope;
+    return previous;
+}
+
+void alloc_scope_leave(MprisAllocScope previous)
+{
+    current_scope = previous;
+}
+
+gboolean alloc_stats_read(MprisAllocStats *stats)
+{
+    for (int i = 0; i < ALLOC_SCOPE_COUNT; i++)
+    {
+        stats->allocations[i] = __atomic_load_n(&allocations[i], __ATOMIC_RELAXED);
+        stats->bytes[i] = __atomic_load_n(&bytes[i], __ATOMIC_RELAXED);
+    }
+    stats->frees = __atomic_load_n(&frees, __ATOMIC_RELAXED);
+    return TRUE;
+}
+
+// The first malloc() in lookup order is what GLib and mpv call
+gboolean alloc_stats_process_wide(void)
+{
+    void *symbol = dlsym(RTLD_DEFAULT, "malloc");
+    void *(*first)(size_t);
+
+    // dlsym() returns to a function pointer
+    memcpy(&first, &symbol, sizeof(symbol));
+    return first == malloc;
+}
+
+#else
+
+gboolean alloc_stats_read(MprisAllocStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    return FALSE;
+}
+
+gboolean alloc_stats_process_wide(void)
+{
+    return FALSE;
+}
+
+#endif
+
+guint64 alloc_stats_live(const MprisAllocStats *stats)
+{
+    guint64 total = 0;
+
+    for (int i = 0; i < ALLOC_SCOPE_COUNT; i++)
+    {
+        total += stats->allocations[i];
+    }
+    // Blocks allocated before counting began can be freed later on
+    return total > stats->frees ? total - stats->frees : 0;
+}
+
+GVariant *alloc_stats_snapshot(const MprisAllocStats *stats)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{s(tt)}"));
+    for (int i = 0; i < ALLOC_SCOPE_COUNT; i++)
+    {
+        g_variant_builder_add(&builder, "{s(tt)}", alloc_scope_names[i],
+                              stats->allocations[i], stats->bytes[i]);
+    }
+    return g_variant_builder_end(&builder);
+}
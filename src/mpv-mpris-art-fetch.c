@@ -0,0 +1,799 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-art-fetch.h"
+#include "mpv-mpris-cache-writer.h"
+
+#define META_GROUP "remote"
+#define MAX_REDIRECTS 3
+#define MAX_HEADER_LINES 100
+#define READ_SIZE 16384
+
+struct ArtFetcher {
+    gchar *cache_dir;
+    ArtFetchBudget budget;
+    gint64 max_age_s;
+    ArtFetchFunc func;
+    gpointer data;
+    GCancellable *cancellable;
+    GHashTable *pending; // URL -> FetchJob, running or waiting
+    GQueue waiting;      // FetchJob
+    guint running;
+};
+
+// Everything a fetch needs, the worker thread never touches the fetcher
+typedef struct FetchJob {
+    ArtFetcher *fetcher; // NULL once the fetcher is gone
+    gchar *url;
+    gchar *hash; // names the cached copy and its .meta
+    gchar *cache_dir;
+    ArtFetchBudget budget;
+    // The cached copy and its validators, NULL without one
+    gchar *cached_file;
+    gchar *etag;
+    gchar *last_modified;
+} FetchJob;
+
+typedef struct Response {
+    int status;
+    gchar *content_type;
+    gchar *etag;
+    gchar *last_modified;
+    gchar *location;
+    gint64 content_length; // -1 when not given
+    gboolean chunked;
+    gsize line_bytes; // status, header and chunk-size lines read so far
+    GByteArray *body; // only for 200
+} Response;
+
+static void job_free(gpointer data)
+{
+    FetchJob *job = data;
+
+    g_free(job->url);
+    g_free(job->hash);
+    g_free(job->cache_dir);
+    g_free(job->cached_file);
+    g_free(job->etag);
+    g_free(job->last_modified);
+    g_free(job);
+}
+
+static void response_clear(Response *response)
+{
+    g_free(response->content_type);
+    g_free(response->etag);
+    g_free(response->last_modified);
+    g_free(response->location);
+    if (response->body)
+    {
+        g_byte_array_unref(response->body);
+    }
+    memset(response, 0, sizeof(*response));
+    response->content_length = -1;
+}
+
+static gchar *meta_path(const char *cache_dir, const char *hash)
+{
+    gchar *name = g_strconcat(hash, ".meta", NULL);
+    gchar *path = g_build_filename(cache_dir, name, NULL);
+
+    g_free(name);
+    return path;
+}
+
+// The cache names images by extension, and only images are kept
+static const char *extension_for(const char *content_type)
+{
+    static const char *const types[][2] = {
+        {"image/jpeg", ".jpg"},
+        {"image/png", ".png"},
+        {"image/webp", ".webp"},
+        {"image/gif", ".gif"},
+        {"image/avif", ".avif"},
+        {"image/bmp", ".bmp"},
+    };
+
+    if (!content_type)
+    {
+        return NULL;
+    }
+    for (gsize i = 0; i < G_N_ELEMENTS(types); i++)
+    {
+        gsize length = strlen(types[i][0]);
+
+        if (g_ascii_strncasecmp(content_type, types[i][0], length) == 0 &&
+            (content_type[length] == '\0' || content_type[length] == ';' ||
+             content_type[length] == ' '))
+        {
+            return types[i][1];
+        }
+    }
+    return NULL;
+}
+
+static void write_meta(const FetchJob *job, const char *file, const char *etag,
+                       const char *last_modified)
+{
+    GKeyFile *meta = g_key_file_new();
+    gchar *path = meta_path(job->cache_dir, job->hash);
+    GError *error = NULL;
+
+    g_key_file_set_string(meta, META_GROUP, "url", job->url);
+    g_key_file_set_string(meta, META_GROUP, "file", file);
+    if (etag)
+    {
+        g_key_file_set_string(meta, META_GROUP, "etag", etag);
+    }
+    if (last_modified)
+    {
+        g_key_file_set_string(meta, META_GROUP, "last-modified", last_modified);
+    }
+    g_key_file_set_int64(meta, META_GROUP, "checked", g_get_real_time() / G_USEC_PER_SEC);
+    if (!g_key_file_save_to_file(meta, path, &error))
+    {
+        g_debug("Failed to write %s: %s", path, error->message);
+        g_error_free(error);
+    }
+    g_key_file_free(meta);
+    g_free(path);
+}
+
+static gboolean append_body(const FetchJob *job, Response *response, const guint8 *data,
+                            gsize size, gint64 deadline, GError **error)
+{
+    if (response->body->len + size > job->budget.max_bytes)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE,
+                    "Image larger than %" G_GSIZE_FORMAT " bytes", job->budget.max_bytes);
+        return FALSE;
+    }
+    if (g_get_monotonic_time() > deadline)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                    "Took longer than %u s", job->budget.timeout_s);
+        return FALSE;
+    }
+    g_byte_array_append(response->body, data, size);
+    return TRUE;
+}
+
+// length bytes, or up to the end of the stream when length is negative
+static gboolean read_body(const FetchJob *job, GInputStream *input, gint64 length,
+                          gint64 deadline, Response *response,
+                          GCancellable *cancellable, GError **error)
+{
+    guint8 buffer[READ_SIZE];
+
+    while (length != 0)
+    {
+        gsize wanted = length < 0 || length > READ_SIZE ? READ_SIZE : (gsize)length;
+        gssize got = g_input_stream_read(input, buffer, wanted, cancellable, error);
+
+        if (got < 0)
+        {
+            return FALSE;
+        }
+        if (got == 0)
+        {
+            if (length > 0)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                            "Connection closed before the end of the image");
+                return FALSE;
+            }
+            break;
+        }
+        if (!append_body(job, response, buffer, got, deadline, error))
+        {
+            return FALSE;
+        }
+        if (length > 0)
+        {
+            length -= got;
+        }
+    }
+    return TRUE;
+}
+
+// One line without its line break, or NULL at the end of the stream.
+// Lines count against the same byte budget as the body and the deadline
+// is checked on every byte, so a server can neither send an endless
+// header nor trickle one in forever.
+static gchar *read_line(const FetchJob *job, GInputStream *input, gint64 deadline,
+                        Response *response, GCancellable *cancellable, GError **error)
+{
+    GString *line = g_string_new(NULL);
+    guchar c;
+    gssize got;
+
+    while ((got = g_input_stream_read(input, &c, 1, cancellable, error)) == 1 && c != '\n')
+    {
+        if (++response->line_bytes > job->budget.max_bytes)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE,
+                        "Headers larger than %" G_GSIZE_FORMAT " bytes",
+                        job->budget.max_bytes);
+            got = -1;
+            break;
+        }
+        if (g_get_monotonic_time() > deadline)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                        "Took longer than %u s", job->budget.timeout_s);
+            got = -1;
+            break;
+        }
+        g_string_append_c(line, c);
+    }
+    if (got != 1)
+    {
+        g_string_free(line, TRUE);
+        return NULL;
+    }
+    if (line->len > 0 && line->str[line->len - 1] == '\r')
+    {
+        g_string_truncate(line, line->len - 1);
+    }
+    return g_string_free(line, FALSE);
+}
+
+static gboolean read_chunked_body(const FetchJob *job, GInputStream *input,
+                                  gint64 deadline, Response *response,
+                                  GCancellable *cancellable, GError **error)
+{
+    for (;;)
+    {
+        gchar *line = read_line(job, input, deadline, response, cancellable, error);
+        gchar *end;
+        guint64 size;
+
+        if (!line)
+        {
+            if (error && !*error)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                            "Connection closed inside a chunk");
+            }
+            return FALSE;
+        }
+        size = g_ascii_strtoull(line, &end, 16);
+        if (end == line)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "Bad chunk size \"%s\"", line);
+            g_free(line);
+            return FALSE;
+        }
+        g_free(line);
+        // The trailer after the last chunk is left unread, the
+        // connection is closed anyway
+        if (size == 0)
+        {
+            return TRUE;
+        }
+        if (size > job->budget.max_bytes)
+        {
+            size = job->budget.max_bytes + 1; // fails in append_body()
+        }
+        if (!read_body(job, input, size, deadline, response, cancellable, error))
+        {
+            return FALSE;
+        }
+        // The line break closing the chunk
+        line = read_line(job, input, deadline, response, cancellable, error);
+        if (!line)
+        {
+            if (error && !*error)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                            "Connection closed inside a chunk");
+            }
+            return FALSE;
+        }
+        g_free(line);
+    }
+}
+
+static void parse_header(Response *response, gchar *line)
+{
+    gchar *colon = strchr(line, ':');
+    const gchar *value;
+
+    if (!colon)
+    {
+        return;
+    }
+    *colon = '\0';
+    value = g_strstrip(colon + 1);
+    if (g_ascii_strcasecmp(line, "Content-Type") == 0)
+    {
+        g_free(response->content_type);
+        response->content_type = g_strdup(value);
+    }
+    else if (g_ascii_strcasecmp(line, "ETag") == 0)
+    {
+        g_free(response->etag);
+        response->etag = g_strdup(value);
+    }
+    else if (g_ascii_strcasecmp(line, "Last-Modified") == 0)
+    {
+        g_free(response->last_modified);
+        response->last_modified = g_strdup(value);
+    }
+    else if (g_ascii_strcasecmp(line, "Location") == 0)
+    {
+        g_free(response->location);
+        response->location = g_strdup(value);
+    }
+    else if (g_ascii_strcasecmp(line, "Content-Length") == 0)
+    {
+        response->content_length = g_ascii_strtoll(value, NULL, 10);
+    }
+    else if (g_ascii_strcasecmp(line, "Transfer-Encoding") == 0)
+    {
+        response->chunked = strstr(value, "chunked") != NULL;
+    }
+}
+
+static gboolean read_response(const FetchJob *job, GInputStream *input, gint64 deadline,
+                              Response *response, GCancellable *cancellable,
+                              GError **error)
+{
+    GInputStream *buffered = g_buffered_input_stream_new(input);
+    gboolean ok = FALSE;
+    gchar *line;
+
+    g_filter_input_stream_set_close_base_stream(G_FILTER_INPUT_STREAM(buffered), FALSE);
+
+    line = read_line(job, buffered, deadline, response, cancellable, error);
+    if (!line || sscanf(line, "HTTP/%*u.%*u %d", &response->status) != 1)
+    {
+        if (error && !*error)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "Not an HTTP response");
+        }
+        g_free(line);
+        goto out;
+    }
+    g_free(line);
+
+    for (int i = 0;; i++)
+    {
+        line = read_line(job, buffered, deadline, response, cancellable, error);
+        if (!line || i == MAX_HEADER_LINES)
+        {
+            if (error && !*error)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                            "Bad response headers");
+            }
+            g_free(line);
+            goto out;
+        }
+        if (!*line)
+        {
+            g_free(line);
+            break;
+        }
+        parse_header(response, line);
+        g_free(line);
+    }
+
+    if (response->status != 200)
+    {
+        ok = TRUE;
+        goto out;
+    }
+    if (response->content_length > (gint64)job->budget.max_bytes)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE,
+                    "Image of %" G_GINT64_FORMAT " bytes, more than %" G_GSIZE_FORMAT,
+                    response->content_length, job->budget.max_bytes);
+        goto out;
+    }
+
+    response->body = g_byte_array_new();
+    if (response->chunked)
+    {
+        ok = read_chunked_body(job, buffered, deadline, response, cancellable, error);
+    }
+    else
+    {
+        ok = read_body(job, buffered, response->content_length, deadline, response,
+                       cancellable, error);
+    }
+
+out:
+    g_object_unref(buffered);
+    return ok;
+}
+
+static GString *build_request(GUri *uri, const FetchJob *job, gboolean https)
+{
+    GString *request = g_string_new("GET ");
+    const char *host = g_uri_get_host(uri);
+    const char *path = g_uri_get_path(uri);
+    const char *query = g_uri_get_query(uri);
+    int port = g_uri_get_port(uri);
+
+    g_string_append(request, *path ? path : "/");
+    if (query)
+    {
+        g_string_append_printf(request, "?%s", query);
+    }
+    g_string_append(request, " HTTP/1.1\r\nHost: ");
+    // IPv6 literals keep their brackets
+    g_string_append_printf(request, strchr(host, ':') ? "[%s]" : "%s", host);
+    if (port > 0 && port != (https ? 443 : 80))
+    {
+        g_string_append_printf(request, ":%d", port);
+    }
+    g_string_append(request, "\r\n"
+                             "User-Agent: mpv-mpris\r\n"
+                             "Accept: image/*\r\n"
+                             "Accept-Encoding: identity\r\n"
+                             "Connection: close\r\n");
+    if (job->etag)
+    {
+        g_string_append_printf(request, "If-None-Match: %s\r\n", job->etag);
+    }
+    if (job->last_modified)
+    {
+        g_string_append_printf(request, "If-Modified-Since: %s\r\n", job->last_modified);
+    }
+    g_string_append(request, "\r\n");
+    return request;
+}
+
+// A single GET of url, without following redirects
+static gboolean http_get(const FetchJob *job, const char *url, gint64 deadline,
+                         Response *response, GCancellable *cancellable, GError **error)
+{
+    GUri *uri = g_uri_parse(url, G_URI_FLAGS_ENCODED, error);
+    GSocketClient *client = NULL;
+    GSocketConnectable *address = NULL;
+    GSocketConnection *connection = NULL;
+    GString *request = NULL;
+    gboolean https, ok = FALSE;
+    int port;
+
+    if (!uri)
+    {
+        return FALSE;
+    }
+    https = g_ascii_strcasecmp(g_uri_get_scheme(uri), "https") == 0;
+    if ((!https && g_ascii_strcasecmp(g_uri_get_scheme(uri), "http") != 0) ||
+        !g_uri_get_host(uri))
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                    "Not an http(s) URL: %s", url);
+        goto out;
+    }
+    port = g_uri_get_port(uri);
+
+    client = g_socket_client_new();
+    g_socket_client_set_timeout(client, job->budget.timeout_s);
+    g_socket_client_set_tls(client, https);
+    address = g_network_address_new(g_uri_get_host(uri), port > 0 ? port : (https ? 443 : 80));
+    connection = g_socket_client_connect(client, address, cancellable, error);
+    if (!connection)
+    {
+        goto out;
+    }
+
+    request = build_request(uri, job, https);
+    ok = g_output_stream_write_all(g_io_stream_get_output_stream(G_IO_STREAM(connection)),
+                                   request->str, request->len, NULL, cancellable, error) &&
+         read_response(job, g_io_stream_get_input_stream(G_IO_STREAM(connection)),
+                       deadline, response, cancellable, error);
+
+out:
+    if (request)
+    {
+        g_string_free(request, TRUE);
+    }
+    g_clear_object(&connection);
+    g_clear_object(&address);
+    g_clear_object(&client);
+    g_uri_unref(uri);
+    return ok;
+}
+
+static gchar *store(const FetchJob *job, const Response *response, GError **error)
+{
+    const char *extension = extension_for(response->content_type);
+    gchar *name, *path, *art_url = NULL;
+
+    if (!extension)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Not an image: %s",
+                    response->content_type ? response->content_type : "no Content-Type");
+        return NULL;
+    }
+
+    name = g_strconcat(job->hash, extension, NULL);
+    path = g_build_filename(job->cache_dir, name, NULL);
+    if (cache_write_file(path, response->body->data, response->body->len, error))
+    {
+        // A new type replaces the copy under its old name
+        if (job->cached_file && strcmp(job->cached_file, path) != 0)
+        {
+            g_remove(job->cached_file);
+        }
+        write_meta(job, path, response->etag, response->last_modified);
+        art_url = g_filename_to_uri(path, NULL, error);
+    }
+    g_free(path);
+    g_free(name);
+    return art_url;
+}
+
+static gboolean is_redirect(int status)
+{
+    return status == 301 || status == 302 || status == 303 || status == 307 ||
+           status == 308;
+}
+
+// Returns the artUrl of a new copy, NULL without error when the cached
+// one is still valid
+static void fetch_thread(GTask *task, G_GNUC_UNUSED gpointer source_object,
+                         gpointer task_data, GCancellable *cancellable)
+{
+    FetchJob *job = task_data;
+    gint64 deadline = g_get_monotonic_time() + job->budget.timeout_s * G_USEC_PER_SEC;
+    gchar *url = g_strdup(job->url);
+    Response response = {0};
+    GError *error = NULL;
+    gchar *art_url = NULL;
+
+    response_clear(&response);
+    for (int redirects = 0; http_get(job, url, deadline, &response, cancellable, &error);
+         redirects++)
+    {
+        gchar *next;
+
+        if (!is_redirect(response.status) || !response.location)
+        {
+            break;
+        }
+        if (redirects == MAX_REDIRECTS)
+        {
+            g_set_error(&error, G_IO_ERROR, G_IO_ERROR_FAILED, "Too many redirects");
+            break;
+        }
+        next = g_uri_resolve_relative(url, response.location, G_URI_FLAGS_ENCODED, &error);
+        if (!next)
+        {
+            break;
+        }
+        // Art asked for over TLS is never fetched in the clear
+        if (g_strcmp0(g_uri_peek_scheme(url), "https") == 0 &&
+            g_strcmp0(g_uri_peek_scheme(next), "https") != 0)
+        {
+            g_set_error(&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                        "Refusing redirect from https to %s", next);
+            g_free(next);
+            break;
+        }
+        g_free(url);
+        url = next;
+        response_clear(&response);
+    }
+
+    if (!error)
+    {
+        if (response.status == 304 && job->cached_file)
+        {
+            // Keeps it from the cleanup of old cache files
+            g_utime(job->cached_file, NULL);
+            write_meta(job, job->cached_file,
+                       response.etag ? response.etag : job->etag,
+                       response.last_modified ? response.last_modified : job->last_modified);
+        }
+        else if (response.status == 200)
+        {
+            art_url = store(job, &response, &error);
+        }
+        else
+        {
+            g_set_error(&error, G_IO_ERROR, G_IO_ERROR_FAILED, "HTTP status %d",
+                        response.status);
+        }
+    }
+
+    response_clear(&response);
+    g_free(url);
+    if (error)
+    {
+        g_task_return_error(task, error);
+    }
+    else
+    {
+        g_task_return_pointer(task, art_url, g_free);
+    }
+}
+
+static void start_waiting(ArtFetcher *fetcher);
+
+static void on_fetched(G_GNUC_UNUSED GObject *source_object, GAsyncResult *result,
+                       G_GNUC_UNUSED gpointer data)
+{
+    FetchJob *job = g_task_get_task_data(G_TASK(result));
+    ArtFetcher *fetcher = job->fetcher;
+    GError *error = NULL;
+    gchar *art_url = g_task_propagate_pointer(G_TASK(result), &error);
+
+    if (fetcher)
+    {
+        fetcher->running--;
+        g_hash_table_remove(fetcher->pending, job->url);
+        if (error)
+        {
+            g_debug("Failed to fetch art from %s: %s", job->url, error->message);
+        }
+        else if (art_url)
+        {
+            fetcher->func(job->url, art_url, fetcher->data);
+        }
+        start_waiting(fetcher);
+    }
+    g_clear_error(&error);
+    g_free(art_url);
+}
+
+static void start_job(ArtFetcher *fetcher, FetchJob *job)
+{
+    GTask *task = g_task_new(NULL, fetcher->cancellable, on_fetched, NULL);
+
+    // The task owns the job, so that it outlives the fetcher if need be
+    g_task_set_task_data(task, job, job_free);
+    fetcher->running++;
+    g_task_run_in_thread(task, fetch_thread);
+    g_object_unref(task);
+}
+
+static void start_waiting(ArtFetcher *fetcher)
+{
+    FetchJob *job;
+
+    while (fetcher->running < fetcher->budget.max_running &&
+           (job = g_queue_pop_head(&fetcher->waiting)))
+    {
+        start_job(fetcher, job);
+    }
+}
+
+ArtFetcher *art_fetcher_new(const char *cache_dir, const ArtFetchBudget *budget,
+                            gint64 max_age_s, ArtFetchFunc func, gpointer data)
+{
+    ArtFetcher *fetcher = g_new0(ArtFetcher, 1);
+
+    fetcher->cache_dir = g_strdup(cache_dir);
+    fetcher->budget = *budget;
+    if (fetcher->budget.max_running == 0)
+    {
+        fetcher->budget.max_running = 1;
+    }
+    fetcher->max_age_s = max_age_s;
+    fetcher->func = func;
+    fetcher->data = data;
+    fetcher->cancellable = g_cancellable_new();
+    fetcher->pending = g_hash_table_new(g_str_hash, g_str_equal);
+    g_queue_init(&fetcher->waiting);
+    return fetcher;
+}
+
+void art_fetcher_free(ArtFetcher *fetcher)
+{
+    GHashTableIter iter;
+    gpointer job;
+
+    g_cancellable_cancel(fetcher->cancellable);
+    while ((job = g_queue_pop_head(&fetcher->waiting)))
+    {
+        g_hash_table_remove(fetcher->pending, ((FetchJob *)job)->url);
+        job_free(job);
+    }
+    // Running fetches end on their own, their tasks free the jobs
+    g_hash_table_iter_init(&iter, fetcher->pending);
+    while (g_hash_table_iter_next(&iter, NULL, &job))
+    {
+        ((FetchJob *)job)->fetcher = NULL;
+    }
+    g_hash_table_unref(fetcher->pending);
+    g_object_unref(fetcher->cancellable);
+    g_free(fetcher->cache_dir);
+    g_free(fetcher);
+}
+
+gboolean art_fetcher_is_remote(const char *url)
+{
+    return url && (g_ascii_strncasecmp(url, "http://", 7) == 0 ||
+                   g_ascii_strncasecmp(url, "https://", 8) == 0);
+}
+
+gchar *art_fetcher_lookup(ArtFetcher *fetcher, const char *url)
+{
+    gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256, url, -1);
+    gchar *path = meta_path(fetcher->cache_dir, hash);
+    GKeyFile *meta = g_key_file_new();
+    gchar *file = NULL;
+    gchar *art_url = NULL;
+    gboolean fresh = FALSE;
+
+    if (g_key_file_load_from_file(meta, path, G_KEY_FILE_NONE, NULL))
+    {
+        file = g_key_file_get_string(meta, META_GROUP, "file", NULL);
+        if (file && g_file_test(file, G_FILE_TEST_IS_REGULAR))
+        {
+            gint64 checked = g_key_file_get_int64(meta, META_GROUP, "checked", NULL);
+
+            art_url = g_filename_to_uri(file, NULL, NULL);
+            fresh = g_get_real_time() / G_USEC_PER_SEC - checked < fetcher->max_age_s;
+        }
+        else
+        {
+            g_free(file);
+            file = NULL;
+        }
+    }
+
+    if (!fresh && !g_hash_table_contains(fetcher->pending, url))
+    {
+        FetchJob *job = g_new0(FetchJob, 1);
+
+        job->fetcher = fetcher;
+        job->url = g_strdup(url);
+        job->hash = g_steal_pointer(&hash);
+        job->cache_dir = g_strdup(fetcher->cache_dir);
+        job->budget = fetcher->budget;
+        if (file)
+        {
+            job->cached_file = g_steal_pointer(&file);
+            job->etag = g_key_file_get_string(meta, META_GROUP, "etag", NULL);
+            job->last_modified = g_key_file_get_string(meta, META_GROUP,
+                                                       "last-modified", NULL);
+        }
+        g_hash_table_insert(fetcher->pending, job->url, job);
+        g_queue_push_tail(&fetcher->waiting, job);
+        start_waiting(fetcher);
+    }
+
+    g_key_file_free(meta);
+    g_free(file);
+    g_free(path);
+    g_free(hash);
+    return art_url;
+}
+
+guint art_fetcher_pending(ArtFetcher *fetcher)
+{
+    return g_hash_table_size(fetcher->pending);
+}
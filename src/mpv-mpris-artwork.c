@@ -23,9 +23,16 @@
 */
 
 #include "mpv-mpris-types.h"
+#include "mpv-mpris-alloc.h"
 #include "mpv-mpris-artwork.h"
-
-gchar* extract_embedded_art(AVFormatContext *context, const char *media_path) {
+#include "mpv-mpris-cache-writer.h"
+#include "mpv-mpris-trace.h"
+
+#ifndef MPV_MPRIS_NO_AVFORMAT
+// With a writer the cover is written in the background and NULL returned,
+// the writer reports its URI once it is in the cache
+gchar* extract_embedded_art(AVFormatContext *context, const char *media_path,
+                            CacheWriter *writer) {
     AVPacket *packet = NULL;
     gchar *cache_path = NULL;
     gchar *uri = NULL;
@@ -53,8 +60,21 @@ gchar* extract_embedded_art(AVFormatContext *context, const char *media_path) {
     
     if (!g_file_test(cache_path, G_FILE_TEST_EXISTS)) {
         GError *error = NULL;
-        if (!g_file_set_contents(cache_path, (const gchar*)packet->data, 
-                                packet->size, &error)) {
+        GBytes *contents = writer ? g_bytes_new(packet->data, packet->size) : NULL;
+        gboolean queued = contents && cache_writer_queue(writer, cache_path, contents,
+                                                         media_path);
+
+        if (contents) {
+            g_bytes_unref(contents);
+        }
+        if (queued) {
+            g_free(cache_path);
+            g_free(cache_dir);
+            return NULL;
+        }
+
+        // No writer, or it is behind: written here
+        if (!cache_write_file(cache_path, packet->data, packet->size, &error)) {
             g_warning("Failed to write cover art to cache: %s", error->message);
             g_error_free(error);
             g_free(cache_path);
@@ -69,9 +89,10 @@ gchar* extract_embedded_art(AVFormatContext *context, const char *media_path) {
     g_free(cache_dir);
     return uri;
 }
+#endif
 
 gboolean is_supported_image_file(const char *filename) {
-    for (size_t i = 0; i < sizeof(&supported_extensions) / sizeof(supported_extensions[0]); i++) {
+    for (size_t i = 0; i < supported_extensions_count; i++) {
         if (g_str_has_suffix(filename, supported_extensions[i])) {
             return TRUE;
         }
@@ -80,9 +101,7 @@ gboolean is_supported_image_file(const char *filename) {
 }
 
 gboolean is_art_file(const char *filename) {
-    const int art_files_count = sizeof(&art_files) / sizeof(art_files[0]);
-    
-    for (int i = 0; i < art_files_count; i++) {
+    for (size_t i = 0; i < art_files_count; i++) {
         // Simple string comparison for exact matches
         if (g_strcmp0(filename, art_files[i]) == 0) {
             return TRUE;
@@ -300,16 +319,13 @@ const char* get_image_extension(const uint8_t *data, size_t size) {
     return ".jpg";
 }
 
-gchar *try_get_local_art(mpv_handle *mpv, char *path) {
+gchar *try_get_local_art(const char *path) {
     gchar *dirname = g_path_get_dirname(path);
     gchar *out = NULL;
     gboolean found = FALSE;
     
-    // Calculate art_files_count locally instead of using the global variable
-    const int local_art_files_count = sizeof(&art_files) / sizeof(art_files[0]);
-    
     // First, try the predefined art file names
-    for (int i = 0; i < local_art_files_count && !found; i++) {
+    for (size_t i = 0; i < art_files_count && !found; i++) {
         // Skip wildcard patterns for now
         if (strstr(art_files[i], "{*}") != NULL) {
             continue;
@@ -318,7 +334,7 @@ gchar *try_get_local_art(mpv_handle *mpv, char *path) {
         gchar *filename = g_build_filename(dirname, art_files[i], NULL);
         
         if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
-            out = path_to_uri(mpv, filename);
+            out = g_filename_to_uri(filename, NULL, NULL);
             found = TRUE;
         }
         
@@ -335,7 +351,7 @@ gchar *try_get_local_art(mpv_handle *mpv, char *path) {
                 if (is_art_file(filename)) {
                     gchar *full_path = g_build_filename(dirname, filename, NULL);
                     if (g_file_test(full_path, G_FILE_TEST_IS_REGULAR)) {
-                        out = path_to_uri(mpv, full_path);
+                        out = g_filename_to_uri(full_path, NULL, NULL);
                         found = TRUE;
                     }
                     g_free(full_path);
@@ -349,16 +365,23 @@ gchar *try_get_local_art(mpv_handle *mpv, char *path) {
     return out;
 }
 
-gchar *try_get_youtube_thumbnail(const char *path)
+// Compiled on first use, which may happen on any of the broker's art
+// resolution threads
+static GRegex *get_youtube_url_regex(void)
 {
-    gchar *out = NULL;
-    if (!youtube_url_regex)
+    if (g_once_init_enter(&youtube_url_regex))
     {
-        youtube_url_regex = g_regex_new(youtube_url_pattern, 0, 0, NULL);
+        g_once_init_leave(&youtube_url_regex,
+                          g_regex_new(youtube_url_pattern, 0, 0, NULL));
     }
+    return youtube_url_regex;
+}
 
+gchar *try_get_youtube_thumbnail(const char *path)
+{
+    gchar *out = NULL;
     GMatchInfo *match_info;
-    gboolean matched = g_regex_match(youtube_url_regex, path, 0, &match_info);
+    gboolean matched = g_regex_match(get_youtube_url_regex(), path, 0, &match_info);
 
     if (matched)
     {
@@ -372,23 +395,72 @@ gchar *try_get_youtube_thumbnail(const char *path)
     return out;
 }
 
-gchar *try_get_embedded_art(char *path)
+// libavformat is loaded here, the first time a file is looked at
+gchar *try_get_embedded_art(char *path, CacheWriter *writer)
 {
+#ifdef MPV_MPRIS_NO_AVFORMAT
+    (void)path;
+    (void)writer;
+    return NULL;
+#else
     gchar *uri = NULL;
     AVFormatContext *context = NULL;
+    const AvformatFuncs *avformat = avformat_funcs();
+
+    if (avformat && !avformat->open_input(&context, path, NULL, NULL))
+    {
+        uri = extract_embedded_art(context, path, writer);
+        avformat->close_input(&context);
+    }
+
+    return uri;
+#endif
+}
+
+// Art for a URL or an absolute file name. It does not need mpv, so the
+// broker daemon resolves art with it as well. Each lookup is timed into
+// histograms, which may be NULL. Embedded art going through writer comes
+// later from its callback, without a writer it is written inline.
+gchar *find_art_url(const char *source, MprisHistogram *histograms, CacheWriter *writer)
+{
+    gint64 start = histograms_start(histograms);
+    gchar *uri;
+    MprisAllocScope previous_scope = alloc_scope_enter(ALLOC_SCOPE_ART);
 
-    if (!avformat_open_input(&context, path, NULL, NULL))
+    MPRIS_TRACE1(art_begin, source);
+    if (g_str_has_prefix(source, "http"))
     {
-        uri = extract_embedded_art(context, path);
-        avformat_close_input(&context);
+        uri = try_get_youtube_thumbnail(source);
+        histograms_record_since(histograms, HISTOGRAM_ART_YOUTUBE, start);
+        MPRIS_TRACE2(art_end, source, uri);
+        alloc_scope_leave(previous_scope);
+        return uri;
     }
 
+    uri = try_get_embedded_art((char *)source, writer);
+    histograms_record_since(histograms, HISTOGRAM_ART_EMBEDDED, start);
+    if (!uri && g_path_is_absolute(source))
+    {
+        start = histograms_start(histograms);
+        uri = try_get_local_art(source);
+        histograms_record_since(histograms, HISTOGRAM_ART_LOCAL, start);
+    }
+    MPRIS_TRACE2(art_end, source, uri);
+    alloc_scope_leave(previous_scope);
     return uri;
 }
 
+static gchar *get_cache_dir_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "mpv-mpris", "coverart", NULL);
+}
+
+// Created on first use: when the first embedded cover is written, the
+// art proxy has its first remote artUrl or, with mpris-frame-art, at
+// startup
 gchar *get_cache_dir(void)
 {
-    gchar *cache_dir = g_build_filename(g_get_user_cache_dir(), "mpv-mpris", "coverart", NULL);
+    gchar *cache_dir = get_cache_dir_path();
 
     if (g_mkdir_with_parents(cache_dir, 0755) < 0)
     {
@@ -410,61 +482,11 @@ gchar* generate_cache_filename(const char *path, const uint8_t *image_data, size
 
 void cleanup_old_cache_files(void)
 {
-    gchar *cache_dir = get_cache_dir();
-
-    if (!cache_dir)
-    {
-        return;
-    }
-
-    DIR *dir = opendir(cache_dir);
-
-    if (!dir)
-    {
-        g_free(cache_dir);
-        return;
-    }
-
-    time_t current_time = time(NULL);
-    time_t max_age = CACHE_MAX_AGE_DAYS * SECONDS_PER_DAY; // Convert days to seconds
-
-    struct dirent *entry;
-    struct stat file_stat;
-
-    while ((entry = readdir(dir)) != NULL)
-    {
-        // Skip . and .. directories
-        if (g_strcmp0(entry->d_name, ".") == 0 || g_strcmp0(entry->d_name, "..") == 0)
-        {
-            continue;
-        }
-
-        if (!is_supported_image_file(entry->d_name))
-        {
-            continue;
-        }
-
-        gchar *file_path = g_build_filename(cache_dir, entry->d_name, NULL);
-
-        if (stat(file_path, &file_stat) == 0)
-        {
-            // Check if file is older than max age
-            if (current_time - file_stat.st_mtime > max_age)
-            {
-                if (unlink(file_path) == 0)
-                {
-                    g_debug("Cleaned up old cache file: %s", entry->d_name);
-                }
-                else
-                {
-                    g_warning("Failed to remove old cache file: %s", file_path);
-                }
-            }
-        }
-
-        g_free(file_path);
-    }
+    gchar *cache_dir = get_cache_dir_path();
 
-    closedir(dir);
+    // Covers, proxied art and frame-<sha256>.png frames alike, proxied art
+    // with its .meta
+    cache_remove_old_files(cache_dir, CACHE_MAX_AGE_DAYS * SECONDS_PER_DAY,
+                           is_supported_image_file);
     g_free(cache_dir);
 }
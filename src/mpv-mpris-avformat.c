@@ -0,0 +1,75 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <glib.h>
+
+#include "mpv-mpris-avformat.h"
+
+#ifndef MPV_MPRIS_NO_AVFORMAT
+
+#include <dlfcn.h>
+#include <string.h>
+
+// The major version built against: the plugin reads AVFormatContext and
+// AVStream fields, their layout only holds within it
+#define AVFORMAT_SONAME "libavformat.so." AV_STRINGIFY(LIBAVFORMAT_VERSION_MAJOR)
+
+static AvformatFuncs funcs;
+
+// Assigned through a void pointer, ISO C has no conversion from the one
+// dlsym() returns to a function pointer
+static gboolean resolve(void *handle, const char *name, void *func)
+{
+    void *symbol = dlsym(handle, name);
+
+    memcpy(func, &symbol, sizeof(symbol));
+    return symbol != NULL;
+}
+
+const AvformatFuncs *avformat_funcs(void)
+{
+    static gsize loaded = 0;
+
+    if (g_once_init_enter(&loaded))
+    {
+        void *handle = dlopen(AVFORMAT_SONAME, RTLD_NOW | RTLD_LOCAL);
+
+        if (!handle)
+        {
+            g_debug("No embedded cover art: %s", dlerror());
+        }
+        else if (!resolve(handle, "avformat_open_input", &funcs.open_input) ||
+                 !resolve(handle, "avformat_close_input", &funcs.close_input))
+        {
+            g_warning("No embedded cover art, %s lacks a symbol: %s",
+                      AVFORMAT_SONAME, dlerror());
+            memset(&funcs, 0, sizeof(funcs));
+            dlclose(handle);
+        }
+        g_once_init_leave(&loaded, 1);
+    }
+    return funcs.open_input ? &funcs : NULL;
+}
+
+#endif
@@ -0,0 +1,160 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-bridge.h"
+#include "mpv-mpris-dbus.h"
+
+// D-Bus thread side of the bridge. It only uses glib, so the broker daemon
+// can share it without linking libmpv.
+
+// Ring source callback on the D-Bus thread
+gboolean apply_deltas(gpointer data)
+{
+    UserData *ud = data;
+    MprisDelta delta;
+    gboolean quitting = g_atomic_int_get(&ud->quitting);
+
+    while (ring_pop(ud->deltas, &delta))
+    {
+        ud->delta_time = delta.time;
+        update_player_state(ud, delta.name, delta.value);
+        g_variant_unref(delta.value);
+    }
+
+    if (quitting)
+    {
+        flush_property_changes(ud, TRUE);
+        g_main_loop_quit(ud->dbus_loop);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+// Ring source callback on the D-Bus thread, answers the requests mpv has
+// acknowledged
+gboolean apply_replies(gpointer data)
+{
+    UserData *ud = data;
+    MprisReply reply;
+
+    while (ring_pop(ud->replies, &reply))
+    {
+        if (reply.error)
+        {
+            g_dbus_method_invocation_return_error(reply.invocation, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_FAILED,
+                                                  "mpv: %s", reply.error);
+        }
+        else
+        {
+            g_dbus_method_invocation_return_value(reply.invocation, NULL);
+        }
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+// For requests that will never reach mpv
+void cancel_request(GDBusMethodInvocation *invocation)
+{
+    if (invocation)
+    {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_NO_SERVER,
+                                              "Player is shutting down");
+    }
+}
+
+// Commands are only filled in here, then queued with submit_request()
+void command_set_property(MprisCommand *cmd, const char *property,
+                          mpv_format format, const void *value)
+{
+    *cmd = (MprisCommand){0};
+    cmd->kind = COMMAND_SET_PROPERTY;
+    cmd->property = property;
+    cmd->format = format;
+    if (format == MPV_FORMAT_FLAG)
+    {
+        cmd->flag = *(const int *)value;
+    }
+    else
+    {
+        cmd->number = *(const double *)value;
+    }
+}
+
+void command_run(MprisCommand *cmd, const char *const *args)
+{
+    *cmd = (MprisCommand){0};
+    cmd->kind = COMMAND_RUN;
+    cmd->args = g_strdupv((gchar **)args);
+}
+
+void command_set_position(MprisCommand *cmd, gint64 track, gint64 position_us)
+{
+    *cmd = (MprisCommand){0};
+    cmd->kind = COMMAND_SET_POSITION;
+    cmd->track = track;
+    cmd->position_us = position_us;
+}
+
+void command_enqueue(MprisCommand *cmd, const char *const *uris, MprisEnqueueMode mode)
+{
+    *cmd = (MprisCommand){0};
+    cmd->kind = COMMAND_ENQUEUE;
+    cmd->args = g_strdupv((gchar **)uris);
+    cmd->flag = mode;
+}
+
+// Queue the commands of one D-Bus request, all of them or none. The
+// commands are consumed either way. The invocation is answered later,
+// from apply_replies(), and only taken over when this returns TRUE. It
+// may be NULL for requests that were answered already.
+gboolean submit_request(UserData *ud, MprisCommand *cmds, guint count,
+                        GDBusMethodInvocation *invocation, GError **error)
+{
+    // Only this thread pushes, so the room can only grow meanwhile
+    if (ring_length(ud->commands) + count > ud->commands->capacity)
+    {
+        for (guint i = 0; i < count; i++)
+        {
+            g_strfreev(cmds[i].args);
+        }
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                    "Too many pending requests");
+        return FALSE;
+    }
+
+    cmds[0].invocation = invocation;
+    cmds[0].parts = count;
+    for (guint i = 0; i < count; i++)
+    {
+        ring_push(ud->commands, &cmds[i]);
+    }
+
+    ring_notify(ud->commands);
+    return TRUE;
+}
@@ -0,0 +1,380 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-bridge.h"
+#include "mpv-mpris-dbus.h"
+
+#define SHUTDOWN_WAIT_US (2 * G_USEC_PER_SEC)
+
+// A D-Bus request waiting for mpv to acknowledge its commands
+typedef struct PendingReply {
+    guint64 id; // reply_userdata of the commands
+    GDBusMethodInvocation *invocation;
+    guint32 request;  // broker mode, instead of invocation
+    guint remaining;  // mpv requests not acknowledged yet
+    guint parts_left; // commands of the request not run yet
+    const char *error; // first failure, from mpv_error_string()
+} PendingReply;
+
+// Queue a value for the D-Bus thread. Values are kept per name until the
+// next push_deltas(), so a burst of changes only sends the latest one.
+void publish_delta(UserData *ud, const char *name, GVariant *value)
+{
+    if (ud->histograms && !ud->outgoing_since)
+    {
+        ud->outgoing_since = histogram_now_ns();
+    }
+    g_hash_table_replace(ud->outgoing, (gpointer)name, g_variant_ref_sink(value));
+}
+
+// The Position delta is published when the read completes, timestamped
+// then, see the PROPERTY_POSITION handler
+void publish_position(UserData *ud)
+{
+    mpv_get_property_async(ud->mpv, PROPERTY_POSITION, "time-pos", MPV_FORMAT_DOUBLE);
+}
+
+static gboolean retry_push_deltas(gpointer data)
+{
+    UserData *ud = data;
+
+    ud->retry_source = NULL;
+    push_deltas(ud);
+    return G_SOURCE_REMOVE;
+}
+
+static void push_replies(UserData *ud)
+{
+    gboolean pushed = FALSE;
+
+    while (!g_queue_is_empty(&ud->finished_replies))
+    {
+        PendingReply *pending = g_queue_peek_head(&ud->finished_replies);
+        MprisReply reply = {pending->invocation, pending->error, pending->request};
+
+        if (!ring_push(ud->replies, &reply))
+        {
+            break;
+        }
+        g_free(g_queue_pop_head(&ud->finished_replies));
+        pushed = TRUE;
+    }
+
+    if (pushed)
+    {
+        ring_notify(ud->replies);
+    }
+}
+
+// Hand the queued deltas and finished replies over to the D-Bus thread.
+// Whatever does not fit in the rings stays queued and is retried shortly,
+// without blocking.
+void push_deltas(UserData *ud)
+{
+    gpointer name, value;
+    GHashTableIter iter;
+    gboolean pushed = FALSE;
+
+    push_replies(ud);
+
+    g_hash_table_iter_init(&iter, ud->outgoing);
+    while (g_hash_table_iter_next(&iter, &name, &value))
+    {
+        MprisDelta delta = {name, value, ud->outgoing_since};
+
+        if (!ring_push(ud->deltas, &delta))
+        {
+            break;
+        }
+        // The ring now owns the reference
+        g_hash_table_iter_steal(&iter);
+        pushed = TRUE;
+    }
+
+    if (pushed)
+    {
+        ring_notify(ud->deltas);
+    }
+    if (g_hash_table_size(ud->outgoing) == 0)
+    {
+        ud->outgoing_since = 0;
+    }
+
+    if ((g_hash_table_size(ud->outgoing) > 0 ||
+         !g_queue_is_empty(&ud->finished_replies)) &&
+        !ud->retry_source)
+    {
+        ud->retry_source = g_timeout_source_new(5);
+        g_source_set_callback(ud->retry_source, retry_push_deltas, ud, NULL);
+        g_source_attach(ud->retry_source, ud->context);
+        g_source_unref(ud->retry_source);
+    }
+}
+
+static void finish_request(UserData *ud, PendingReply *pending)
+{
+    g_hash_table_steal(ud->pending_replies, &pending->id);
+    g_queue_push_tail(&ud->finished_replies, pending);
+}
+
+// Starts tracking the request whose first command is cmd
+static void begin_request(UserData *ud, MprisCommand *cmd)
+{
+    PendingReply *pending = g_new0(PendingReply, 1);
+
+    pending->id = ++ud->next_reply_id;
+    pending->invocation = cmd->invocation;
+    pending->request = cmd->request;
+    pending->parts_left = cmd->parts;
+    g_hash_table_insert(ud->pending_replies, &pending->id, pending);
+    ud->current_request = pending;
+}
+
+// Called once a command of the current request has been issued
+static void end_part(UserData *ud)
+{
+    PendingReply *pending = ud->current_request;
+
+    if (!pending || --pending->parts_left > 0)
+    {
+        return;
+    }
+
+    ud->current_request = NULL;
+    if (pending->remaining == 0)
+    {
+        // Nothing went to mpv, or it all failed right away
+        finish_request(ud, pending);
+    }
+}
+
+// The reply_userdata for the next async mpv call of the current command,
+// 0 when there is nobody to answer
+static guint64 expect_reply(UserData *ud)
+{
+    if (!ud->current_request)
+    {
+        return 0;
+    }
+
+    ud->current_request->remaining++;
+    return ud->current_request->id;
+}
+
+// mpv does not send a reply event for calls it rejected
+static void check_async(UserData *ud, guint64 reply_id, int status)
+{
+    if (status < 0)
+    {
+        complete_request(ud, reply_id, status);
+    }
+}
+
+// Called for every MPV_EVENT_COMMAND_REPLY and SET_PROPERTY_REPLY. The
+// request is answered once all of its mpv calls are acknowledged, with
+// the first error if any.
+void complete_request(UserData *ud, guint64 reply_id, int status)
+{
+    PendingReply *pending;
+
+    if (!reply_id || !(pending = g_hash_table_lookup(ud->pending_replies, &reply_id)))
+    {
+        return;
+    }
+
+    if (status < 0 && !pending->error)
+    {
+        pending->error = mpv_error_string(status);
+    }
+    if (--pending->remaining > 0 || pending->parts_left > 0)
+    {
+        return;
+    }
+
+    finish_request(ud, pending);
+}
+
+static void pending_reply_cancel(gpointer data)
+{
+    PendingReply *pending = data;
+
+    cancel_request(pending->invocation);
+    g_free(pending);
+}
+
+static gboolean cancel_pending_reply(G_GNUC_UNUSED gpointer key, gpointer value,
+                                     G_GNUC_UNUSED gpointer data)
+{
+    pending_reply_cancel(value);
+    return TRUE;
+}
+
+// Called once the D-Bus thread is gone. In broker mode there is no
+// invocation here, the broker answers its requests when mpv disconnects.
+void cancel_pending_replies(UserData *ud)
+{
+    MprisReply reply;
+
+    if (ud->pending_replies)
+    {
+        g_hash_table_foreach_steal(ud->pending_replies, cancel_pending_reply, NULL);
+    }
+    g_queue_clear_full(&ud->finished_replies, pending_reply_cancel);
+    ud->current_request = NULL;
+
+    while (ud->replies && ring_pop(ud->replies, &reply))
+    {
+        cancel_request(reply.invocation);
+    }
+}
+
+// One loadfile per URI, all in flight at once. mpv runs async commands in
+// order, and the request is answered when the last one is acknowledged.
+static void run_enqueue(UserData *ud, MprisCommand *cmd)
+{
+    guint count = g_strv_length(cmd->args);
+
+    for (guint i = 0; i < count; i++)
+    {
+        const char *uri, *flags;
+
+        if (cmd->flag == ENQUEUE_INSERT_NEXT)
+        {
+            // Each insert lands right after the current item, so insert
+            // from the last URI to the first to keep their order
+            uri = cmd->args[count - 1 - i];
+            flags = "insert-next";
+        }
+        else
+        {
+            uri = cmd->args[i];
+            flags = cmd->flag == ENQUEUE_REPLACE && i == 0 ? "replace" : "append";
+        }
+
+        const char *args[] = {"loadfile", uri, flags, NULL};
+        guint64 id = expect_reply(ud);
+        check_async(ud, id, mpv_command_async(ud->mpv, id, args));
+    }
+}
+
+// Everything goes through mpv's async API, so neither thread waits for
+// mpv. The replies come back as events, see complete_request().
+static void run_command(UserData *ud, MprisCommand *cmd)
+{
+    guint64 id;
+
+    switch (cmd->kind)
+    {
+    case COMMAND_SET_PROPERTY:
+        id = expect_reply(ud);
+        // mpv copies the value before returning
+        if (cmd->format == MPV_FORMAT_FLAG)
+        {
+            check_async(ud, id, mpv_set_property_async(ud->mpv, id, cmd->property,
+                                                       MPV_FORMAT_FLAG, &cmd->flag));
+        }
+        else
+        {
+            check_async(ud, id, mpv_set_property_async(ud->mpv, id, cmd->property,
+                                                       MPV_FORMAT_DOUBLE, &cmd->number));
+        }
+        break;
+    case COMMAND_RUN:
+        id = expect_reply(ud);
+        check_async(ud, id, mpv_command_async(ud->mpv, id, (const char **)cmd->args));
+        g_strfreev(cmd->args);
+        break;
+    case COMMAND_SET_POSITION:
+    {
+        if (ud->playlist_pos == cmd->track)
+        {
+            // Use MPV's seek command instead of setting time-pos property
+            char *position_str = g_strdup_printf("%.6f", cmd->position_us / 1000000.0);
+            const char *args[] = {"seek", position_str, "absolute", "exact", NULL};
+
+            id = expect_reply(ud);
+            check_async(ud, id, mpv_command_async(ud->mpv, id, args));
+            g_free(position_str);
+        }
+    }
+    break;
+    case COMMAND_ENQUEUE:
+        run_enqueue(ud, cmd);
+        g_strfreev(cmd->args);
+        break;
+    }
+}
+
+// Ring source callback on the mpv thread
+gboolean run_commands(gpointer data)
+{
+    UserData *ud = data;
+    MprisCommand cmd;
+
+    while (ring_pop(ud->commands, &cmd))
+    {
+        // The parts of a request are pushed together, nothing comes between
+        if (cmd.invocation || cmd.request)
+        {
+            begin_request(ud, &cmd);
+        }
+        run_command(ud, &cmd);
+        end_part(ud);
+    }
+
+    // Requests whose commands mpv rejected right away are complete already
+    if (!g_queue_is_empty(&ud->finished_replies))
+    {
+        push_deltas(ud);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+// Called on the mpv thread once its loop has quit. The last deltas (the
+// Stopped status) must reach the D-Bus thread, so this is the only place
+// allowed to wait for room in the ring, for at most SHUTDOWN_WAIT_US in
+// case the D-Bus thread is stuck.
+void bridge_shutdown(UserData *ud)
+{
+    gint64 deadline = g_get_monotonic_time() + SHUTDOWN_WAIT_US;
+
+    while (g_hash_table_size(ud->outgoing) > 0 && ud->dbus_thread &&
+           g_get_monotonic_time() < deadline)
+    {
+        push_deltas(ud);
+        if (g_hash_table_size(ud->outgoing) > 0)
+        {
+            g_usleep(1000);
+        }
+    }
+
+    g_atomic_int_set(&ud->quitting, 1);
+    if (ud->deltas->source)
+    {
+        g_source_set_ready_time(ud->deltas->source, 0);
+    }
+}
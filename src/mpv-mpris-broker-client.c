@@ -0,0 +1,233 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <unistd.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-alloc.h"
+#include "mpv-mpris-broker-client.h"
+#include "mpv-mpris-options.h"
+#include "mpv-mpris-wire.h"
+
+// A broker that stops reading must not block the second thread for long,
+// or the delta ring fills up and shutdown waits on it
+#define SEND_TIMEOUT_S 1
+
+// Broker mode: instead of owning a bus connection, the second thread
+// streams deltas to the broker daemon and feeds the commands it sends back
+// into the command ring. The mpv side works exactly as without a broker.
+
+// Called from mpv_open_cplugin() before the second thread starts. On
+// failure the plugin registers on the bus itself.
+gboolean broker_connect(UserData *ud, GError **error)
+{
+    gchar *path = get_script_opt(ud->mpv, "broker-socket");
+    GSocketAddress *address;
+    GSocket *socket;
+    gboolean ok;
+
+    if (!path || !*path)
+    {
+        g_free(path);
+        path = wire_socket_path();
+    }
+    address = g_unix_socket_address_new(path);
+    g_free(path);
+
+    socket = g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM,
+                          G_SOCKET_PROTOCOL_DEFAULT, error);
+    if (socket)
+    {
+        g_socket_set_timeout(socket, SEND_TIMEOUT_S);
+    }
+    ok = socket && g_socket_connect(socket, address, NULL, error) &&
+         wire_send(socket, wire_delta(WIRE_HELLO, g_variant_new_uint32(getpid())),
+                   error);
+    g_object_unref(address);
+
+    if (!ok)
+    {
+        if (socket)
+        {
+            g_object_unref(socket);
+        }
+        return FALSE;
+    }
+
+    ud->broker_socket = socket;
+    ud->broker_input = g_byte_array_new();
+    return TRUE;
+}
+
+// The broker went away or stopped reading for SEND_TIMEOUT_S. Deltas are
+// dropped from now on, the MPRIS presence comes back once mpv is restarted.
+static void broker_lost(UserData *ud, GError *error)
+{
+    if (g_socket_is_closed(ud->broker_socket))
+    {
+        return;
+    }
+
+    g_printerr("Lost connection to the mpris broker%s%s\n",
+               error ? ": " : "", error ? error->message : "");
+    g_socket_close(ud->broker_socket, NULL);
+}
+
+static void send_frame(UserData *ud, GVariant *message)
+{
+    GError *error = NULL;
+
+    if (g_socket_is_closed(ud->broker_socket))
+    {
+        g_variant_unref(g_variant_ref_sink(message));
+    }
+    else if (!wire_send(ud->broker_socket, message, &error))
+    {
+        broker_lost(ud, error);
+        g_clear_error(&error);
+    }
+}
+
+// Ring source callback on the D-Bus thread in broker mode
+gboolean forward_deltas(gpointer data)
+{
+    UserData *ud = data;
+    MprisDelta delta;
+    gboolean quitting = g_atomic_int_get(&ud->quitting);
+
+    while (ring_pop(ud->deltas, &delta))
+    {
+        send_frame(ud, wire_delta(delta.name, delta.value));
+        g_variant_unref(delta.value);
+    }
+
+    if (quitting)
+    {
+        g_main_loop_quit(ud->dbus_loop);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+// Ring source callback on the D-Bus thread in broker mode, the broker
+// answers its D-Bus requests from these
+gboolean forward_replies(gpointer data)
+{
+    UserData *ud = data;
+    MprisReply reply;
+
+    while (ring_pop(ud->replies, &reply))
+    {
+        send_frame(ud, wire_reply(reply.request, reply.error));
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean receive_commands(GSocket *socket,
+                                 G_GNUC_UNUSED GIOCondition condition,
+                                 gpointer data)
+{
+    UserData *ud = data;
+    GError *error = NULL;
+    GError *frame_error = NULL;
+    GVariant *message;
+    gboolean pushed = FALSE;
+    gboolean open = !g_socket_is_closed(socket) &&
+                    wire_receive(socket, ud->broker_input, &error);
+
+    while ((message = wire_next(ud->broker_input, WIRE_COMMAND_TYPE, &frame_error)))
+    {
+        MprisCommand cmd = {0};
+
+        wire_parse_command(message, &cmd);
+        g_variant_unref(message);
+
+        // Like submit_request(), a request only goes in with all of its
+        // parts, or the broker would wait for its reply forever. Only this
+        // thread pushes, so the room can only grow meanwhile.
+        if (cmd.parts > 0 &&
+            ring_length(ud->commands) + cmd.parts > ud->commands->capacity)
+        {
+            g_printerr("Too many pending requests, dropping broker command\n");
+            ud->broker_dropping = cmd.parts;
+            if (cmd.request)
+            {
+                send_frame(ud, wire_reply(cmd.request, "Too many pending requests"));
+            }
+        }
+
+        if (ud->broker_dropping > 0)
+        {
+            ud->broker_dropping--;
+            g_strfreev(cmd.args);
+            continue;
+        }
+
+        ring_push(ud->commands, &cmd);
+        pushed = TRUE;
+    }
+
+    if (pushed)
+    {
+        ring_notify(ud->commands);
+    }
+
+    if (!open || frame_error)
+    {
+        broker_lost(ud, frame_error ? frame_error : error);
+        g_clear_error(&error);
+        g_clear_error(&frame_error);
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+// Second thread in broker mode, takes the place of run_dbus_thread()
+gpointer run_broker_client(gpointer data)
+{
+    UserData *ud = data;
+    GSource *source;
+    MprisAllocScope previous_scope = alloc_scope_enter(ALLOC_SCOPE_DBUS);
+
+    g_main_context_push_thread_default(ud->dbus_context);
+
+    source = g_socket_create_source(ud->broker_socket, G_IO_IN, NULL);
+    g_source_set_callback(source, G_SOURCE_FUNC(receive_commands), ud, NULL);
+    g_source_attach(source, ud->dbus_context);
+
+    g_main_loop_run(ud->dbus_loop);
+
+    g_source_destroy(source);
+    g_source_unref(source);
+    if (!g_socket_is_closed(ud->broker_socket))
+    {
+        g_socket_close(ud->broker_socket, NULL);
+    }
+
+    g_main_context_pop_thread_default(ud->dbus_context);
+    alloc_scope_leave(previous_scope);
+    return NULL;
+}
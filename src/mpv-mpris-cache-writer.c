@@ -0,0 +1,426 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// O_TMPFILE is Linux, linkat() and mkstemp() POSIX, neither is -std=c99
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-cache-writer.h"
+#include "mpv-mpris-trace.h"
+
+struct CacheWriter {
+    GMutex lock;
+    GCond cond;
+    GQueue jobs; // CacheWriteJob
+    gsize queued;
+    gsize max_queued;
+    gboolean stopping;
+    GThread *thread; // started by the first queued write
+    GMainContext *context;
+    CacheWriteFunc func;
+    gpointer data;
+    gint *alive; // shared with the callbacks in flight, 0 once freed
+};
+
+// Names the tmpfiles linked in to replace a file
+static gint tmp_serial;
+
+// A write keeps its temporary file for moments, older ones were left by
+// a write that never finished
+#define TMP_MAX_AGE_S 3600
+
+typedef struct CacheWriteJob {
+    gchar *path;
+    GBytes *contents;
+    gchar *key;
+} CacheWriteJob;
+
+// A finished write, on its way to the callback
+typedef struct CacheWritten {
+    CacheWriter *writer;
+    gint *alive;
+    gchar *key;
+    gchar *art_url;
+} CacheWritten;
+
+static gboolean write_all(int fd, const guint8 *data, gsize size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return FALSE;
+        }
+        data += written;
+        size -= written;
+    }
+    return TRUE;
+}
+
+// An existing file is replaced: the tmpfile gets a temporary name first,
+// which is renamed over it
+static gboolean link_tmpfile(int fd, const char *dir, const char *path)
+{
+    char proc_path[64];
+    gchar *tmp_path;
+    gboolean ok;
+
+    // Linking an O_TMPFILE by its /proc name needs no privileges, unlike
+    // AT_EMPTY_PATH
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+    if (linkat(AT_FDCWD, proc_path, AT_FDCWD, path, AT_SYMLINK_FOLLOW) == 0)
+    {
+        return TRUE;
+    }
+    if (errno != EEXIST)
+    {
+        return FALSE;
+    }
+
+    tmp_path = g_strdup_printf("%s/.tmp-%d-%d", dir, (int)getpid(),
+                               g_atomic_int_add(&tmp_serial, 1));
+    ok = linkat(AT_FDCWD, proc_path, AT_FDCWD, tmp_path, AT_SYMLINK_FOLLOW) == 0;
+    if (ok && g_rename(tmp_path, path) != 0)
+    {
+        int saved_errno = errno;
+
+        g_unlink(tmp_path);
+        errno = saved_errno;
+        ok = FALSE;
+    }
+    g_free(tmp_path);
+    return ok;
+}
+
+// For file systems without O_TMPFILE
+static gboolean write_renamed(const char *dir, const char *path, const void *data,
+                              gsize size)
+{
+    gchar *tmp_path = g_build_filename(dir, ".tmp-XXXXXX", NULL);
+    int fd = g_mkstemp_full(tmp_path, O_WRONLY | O_CLOEXEC, 0644);
+    gboolean ok = fd >= 0 && write_all(fd, data, size);
+    int saved_errno = errno;
+
+    if (fd >= 0)
+    {
+        close(fd);
+        ok = ok && g_rename(tmp_path, path) == 0;
+        saved_errno = errno;
+        if (!ok)
+        {
+            g_unlink(tmp_path);
+        }
+    }
+    g_free(tmp_path);
+    errno = saved_errno;
+    return ok;
+}
+
+gboolean cache_write_file(const char *path, const void *data, gsize size, GError **error)
+{
+    gchar *dir = g_path_get_dirname(path);
+    gboolean ok = FALSE;
+    int fd = -1;
+    int saved_errno;
+
+#ifdef O_TMPFILE
+    fd = open(dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+#else
+    errno = EOPNOTSUPP;
+#endif
+    if (fd >= 0)
+    {
+        ok = write_all(fd, data, size) && link_tmpfile(fd, dir, path);
+        saved_errno = errno;
+        close(fd);
+    }
+    else if (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)
+    {
+        ok = write_renamed(dir, path, data, size);
+        saved_errno = errno;
+    }
+    else
+    {
+        saved_errno = errno;
+    }
+
+    if (ok)
+    {
+        MPRIS_TRACE2(art_cache_write, path, size);
+    }
+    else
+    {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+                    "Failed to write %s: %s", path, g_strerror(saved_errno));
+    }
+    g_free(dir);
+    return ok;
+}
+
+static void cache_write_job_free(CacheWriteJob *job)
+{
+    g_free(job->path);
+    g_bytes_unref(job->contents);
+    g_free(job->key);
+    g_free(job);
+}
+
+static void cache_written_free(gpointer data)
+{
+    CacheWritten *written = data;
+
+    g_free(written->key);
+    g_free(written->art_url);
+    g_free(written);
+}
+
+static gboolean report_written(gpointer data)
+{
+    CacheWritten *written = data;
+
+    if (g_atomic_int_get(written->alive))
+    {
+        written->writer->func(written->key, written->art_url, written->writer->data);
+    }
+    g_atomic_rc_box_release(written->alive);
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer run_writer(gpointer data)
+{
+    CacheWriter *writer = data;
+
+    g_mutex_lock(&writer->lock);
+    for (;;)
+    {
+        CacheWriteJob *job;
+        GError *error = NULL;
+        gsize size;
+        gconstpointer contents;
+
+        while (g_queue_is_empty(&writer->jobs) && !writer->stopping)
+        {
+            g_cond_wait(&writer->cond, &writer->lock);
+        }
+        job = g_queue_pop_head(&writer->jobs);
+        if (!job)
+        {
+            break;
+        }
+        g_mutex_unlock(&writer->lock);
+
+        contents = g_bytes_get_data(job->contents, &size);
+        if (cache_write_file(job->path, contents, size, &error))
+        {
+            CacheWritten *written = g_new0(CacheWritten, 1);
+
+            written->writer = writer;
+            written->alive = g_atomic_rc_box_acquire(writer->alive);
+            written->key = g_strdup(job->key);
+            written->art_url = g_filename_to_uri(job->path, NULL, NULL);
+            g_main_context_invoke_full(writer->context, G_PRIORITY_DEFAULT,
+                                       report_written, written, cache_written_free);
+        }
+        else
+        {
+            g_warning("Failed to write cover art to cache: %s", error->message);
+            g_error_free(error);
+        }
+
+        g_mutex_lock(&writer->lock);
+        writer->queued -= size;
+        cache_write_job_free(job);
+    }
+    g_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+CacheWriter *cache_writer_new(gsize max_queued, CacheWriteFunc func, gpointer data)
+{
+    CacheWriter *writer = g_new0(CacheWriter, 1);
+
+    g_mutex_init(&writer->lock);
+    g_cond_init(&writer->cond);
+    g_queue_init(&writer->jobs);
+    writer->max_queued = max_queued;
+    writer->context = g_main_context_ref_thread_default();
+    writer->func = func;
+    writer->data = data;
+    writer->alive = g_atomic_rc_box_new(gint);
+    *writer->alive = TRUE;
+    return writer;
+}
+
+void cache_writer_free(CacheWriter *writer)
+{
+    g_mutex_lock(&writer->lock);
+    writer->stopping = TRUE;
+    g_cond_signal(&writer->cond);
+    g_mutex_unlock(&writer->lock);
+    if (writer->thread)
+    {
+        g_thread_join(writer->thread);
+    }
+
+    // Callbacks already invoked but not run yet hold their own reference
+    g_atomic_int_set(writer->alive, FALSE);
+    g_atomic_rc_box_release(writer->alive);
+    g_main_context_unref(writer->context);
+    g_mutex_clear(&writer->lock);
+    g_cond_clear(&writer->cond);
+    g_free(writer);
+}
+
+gboolean cache_writer_queue(CacheWriter *writer, const char *path, GBytes *contents,
+                            const char *key)
+{
+    gsize size = g_bytes_get_size(contents);
+    CacheWriteJob *job;
+
+    g_mutex_lock(&writer->lock);
+    // A single write larger than the bound still goes through an idle queue
+    if (writer->queued > 0 && writer->queued + size > writer->max_queued)
+    {
+        g_mutex_unlock(&writer->lock);
+        return FALSE;
+    }
+
+    job = g_new0(CacheWriteJob, 1);
+    job->path = g_strdup(path);
+    job->contents = g_bytes_ref(contents);
+    job->key = g_strdup(key);
+    g_queue_push_tail(&writer->jobs, job);
+    writer->queued += size;
+    if (!writer->thread)
+    {
+        writer->thread = g_thread_new("mpris-cache", run_writer, writer);
+    }
+    g_cond_signal(&writer->cond);
+    g_mutex_unlock(&writer->lock);
+    return TRUE;
+}
+
+// The name without its extension, a .meta file shares it with its image
+static gchar *file_stem(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+
+    return dot ? g_strndup(name, dot - name) : g_strdup(name);
+}
+
+static gboolean remove_file(const char *cache_dir, const char *name)
+{
+    gchar *path = g_build_filename(cache_dir, name, NULL);
+    gboolean removed = g_unlink(path) == 0;
+
+    if (removed)
+    {
+        g_debug("Cleaned up old cache file: %s", name);
+    }
+    else
+    {
+        g_warning("Failed to remove old cache file: %s", path);
+    }
+    g_free(path);
+    return removed;
+}
+
+static gboolean remove_if_older(const char *cache_dir, const char *name, gint64 max_age_s,
+                                gint64 now)
+{
+    gchar *path = g_build_filename(cache_dir, name, NULL);
+    GStatBuf file_stat;
+    gboolean old = g_stat(path, &file_stat) == 0 && now - file_stat.st_mtime > max_age_s;
+
+    g_free(path);
+    return old && remove_file(cache_dir, name);
+}
+
+void cache_remove_old_files(const char *cache_dir, gint64 max_age_s,
+                            CacheFileFunc is_cache_file)
+{
+    GDir *dir = g_dir_open(cache_dir, 0, NULL);
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    GHashTable *removed; // stems of the files removed
+    GPtrArray *metas;
+    const char *name;
+
+    if (!dir)
+    {
+        return;
+    }
+
+    removed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    metas = g_ptr_array_new_with_free_func(g_free);
+    while ((name = g_dir_read_name(dir)))
+    {
+        if (g_str_has_prefix(name, ".tmp-"))
+        {
+            remove_if_older(cache_dir, name, TMP_MAX_AGE_S, now);
+        }
+        else if (g_str_has_suffix(name, ".meta"))
+        {
+            // Once every file was looked at
+            g_ptr_array_add(metas, g_strdup(name));
+        }
+        else if (is_cache_file(name) && remove_if_older(cache_dir, name, max_age_s, now))
+        {
+            g_hash_table_add(removed, file_stem(name));
+        }
+    }
+    g_dir_close(dir);
+
+    for (guint i = 0; i < metas->len; i++)
+    {
+        const char *meta = g_ptr_array_index(metas, i);
+        gchar *stem = file_stem(meta);
+
+        // Even when it was touched later than its file
+        if (g_hash_table_contains(removed, stem))
+        {
+            remove_file(cache_dir, meta);
+        }
+        else
+        {
+            remove_if_older(cache_dir, meta, max_age_s, now);
+        }
+        g_free(stem);
+    }
+
+    g_ptr_array_unref(metas);
+    g_hash_table_unref(removed);
+}
@@ -23,160 +23,285 @@
 */
 
 #include "mpv-mpris-types.h"
+#include "mpv-mpris-alloc.h"
+#include "mpv-mpris-bridge.h"
 #include "mpv-mpris-dbus.h"
+#include "mpv-mpris-p2p.h"
+#include "mpv-mpris-props.h"
+#include "mpv-mpris-status.h"
+#include "mpv-mpris-trace.h"
 
-void method_call_root(G_GNUC_UNUSED GDBusConnection *connection,
-                             G_GNUC_UNUSED const char *sender,
-                             G_GNUC_UNUSED const char *object_path,
-                             G_GNUC_UNUSED const char *interface_name,
-                             const char *method_name,
-                             G_GNUC_UNUSED GVariant *parameters,
-                             GDBusMethodInvocation *invocation,
-                             gpointer user_data)
+// Service time of Get per property, and of GetAll per interface
+static void record_get_time(UserData *ud, const char *kind, const char *name,
+                            gint64 start)
 {
-    UserData *ud = (UserData *)user_data;
-    if (g_strcmp0(method_name, "Quit") == 0)
+    MprisHistogram *histogram;
+    gchar *key;
+
+    if (!ud->get_histograms || !start)
     {
-        const char *cmd[] = {"quit", NULL};
-        mpv_command_async(ud->mpv, 0, cmd);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        return;
     }
-    else if (g_strcmp0(method_name, "Raise") == 0)
+
+    key = g_strconcat(kind, name, NULL);
+    histogram = g_hash_table_lookup(ud->get_histograms, key);
+    if (histogram)
     {
-        // Can't raise
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        g_free(key);
     }
     else
     {
-        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
-                                              G_DBUS_ERROR_UNKNOWN_METHOD,
-                                              "Unknown method");
+        histogram = g_new0(MprisHistogram, 1);
+        g_hash_table_insert(ud->get_histograms, key, histogram);
     }
+    histogram_record(histogram, histogram_now_ns() - start);
 }
 
-GVariant *get_property_root(G_GNUC_UNUSED GDBusConnection *connection,
-                                   G_GNUC_UNUSED const char *sender,
-                                   G_GNUC_UNUSED const char *object_path,
-                                   G_GNUC_UNUSED const char *interface_name,
-                                   const char *property_name,
-                                   G_GNUC_UNUSED GError **error,
-                                   gpointer user_data)
+// Get and GetAll end up here as the vtables have no get_property. Replies
+// come from the property cache, except for Position during playback.
+static void get_cached_properties(UserData *ud, PropertyCache *cache,
+                                  const char *method_name, GVariant *parameters,
+                                  GDBusMethodInvocation *invocation)
 {
-    UserData *ud = (UserData *)user_data;
-    GVariant *ret;
+    gint64 start = histograms_start(ud->histograms);
+    gboolean live_position = cache == &ud->player_properties &&
+                             ud->state.status == STATUS_PLAYING;
 
-    if (g_strcmp0(property_name, "CanQuit") == 0)
+    if (g_strcmp0(method_name, "GetAll") == 0)
     {
-        ret = g_variant_new_boolean(TRUE);
+        GVariant *reply;
+        if (live_position)
+        {
+            reply = property_cache_get_all_with(cache, "Position",
+                                                g_variant_new_int64(get_position_us(ud)));
+        }
+        else
+        {
+            reply = property_cache_get_all(cache);
+        }
+        g_dbus_method_invocation_return_value(invocation, reply);
+        record_get_time(ud, "get-all:", cache->info->name, start);
+        MPRIS_TRACE1(dbus_get_all, cache->info->name);
     }
-    else if (g_strcmp0(property_name, "Fullscreen") == 0)
+    else if (g_strcmp0(method_name, "Get") == 0)
     {
-        int fullscreen;
-        mpv_get_property(ud->mpv, "fullscreen", MPV_FORMAT_FLAG, &fullscreen);
-        ret = g_variant_new_boolean(fullscreen);
+        const char *property_name;
+        GVariant *value;
+
+        g_variant_get(parameters, "(&s&s)", NULL, &property_name);
+        MPRIS_TRACE2(dbus_get, cache->info->name, property_name);
+        if (live_position && g_strcmp0(property_name, "Position") == 0)
+        {
+            value = g_variant_ref_sink(
+                g_variant_new_variant(g_variant_new_int64(get_position_us(ud))));
+        }
+        else
+        {
+            value = property_cache_get(cache, property_name);
+        }
+
+        if (!value)
+        {
+            g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                                                  "Unknown property %s", property_name);
+            return;
+        }
+        g_dbus_method_invocation_return_value(invocation, g_variant_new_tuple(&value, 1));
+        g_variant_unref(value);
+        record_get_time(ud, "get:", property_name, start);
     }
-    else if (g_strcmp0(property_name, "CanSetFullscreen") == 0)
+    else
     {
-        int can_fullscreen;
-        mpv_get_property(ud->mpv, "vo-configured", MPV_FORMAT_FLAG, &can_fullscreen);
-        ret = g_variant_new_boolean(can_fullscreen);
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method");
     }
-    else if (g_strcmp0(property_name, "CanRaise") == 0)
+}
+
+// Answers invocation from apply_replies() once mpv acknowledged the
+// commands, or right away if they could not be queued
+static void defer_reply(UserData *ud, MprisCommand *cmds, guint count,
+                        GDBusMethodInvocation *invocation)
+{
+    GError *error = NULL;
+
+    if (!submit_request(ud, cmds, count, invocation, &error))
     {
-        ret = g_variant_new_boolean(FALSE);
+        g_dbus_method_invocation_take_error(invocation, error);
     }
-    else if (g_strcmp0(property_name, "HasTrackList") == 0)
+}
+
+// Properties.Set, routed here as the vtables have no set_property either.
+// GDBus has already checked that the property is writable and the type of
+// the value.
+static void set_root_property(UserData *ud, GVariant *parameters,
+                              GDBusMethodInvocation *invocation)
+{
+    const char *property_name;
+    GVariant *value;
+    MprisCommand cmd;
+
+    g_variant_get(parameters, "(&s&sv)", NULL, &property_name, &value);
+    if (g_strcmp0(property_name, "Fullscreen") == 0)
     {
-        ret = g_variant_new_boolean(FALSE);
+        int fullscreen = g_variant_get_boolean(value);
+        command_set_property(&cmd, "fullscreen", MPV_FORMAT_FLAG, &fullscreen);
+        defer_reply(ud, &cmd, 1, invocation);
     }
-    else if (g_strcmp0(property_name, "Identity") == 0)
+    else
     {
-        ret = g_variant_new_string("mpv");
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                                              "Cannot set property %s", property_name);
     }
-    else if (g_strcmp0(property_name, "DesktopEntry") == 0)
+    g_variant_unref(value);
+}
+
+void method_call_root(G_GNUC_UNUSED GDBusConnection *connection,
+                             G_GNUC_UNUSED const char *sender,
+                             G_GNUC_UNUSED const char *object_path,
+                             const char *interface_name,
+                             const char *method_name,
+                             GVariant *parameters,
+                             GDBusMethodInvocation *invocation,
+                             gpointer user_data)
+{
+    UserData *ud = (UserData *)user_data;
+    GError *error = NULL;
+
+    MPRIS_TRACE2(dbus_method, interface_name, method_name);
+    if (g_strcmp0(interface_name, "org.freedesktop.DBus.Properties") == 0)
     {
-        ret = g_variant_new_string("mpv");
+        if (g_strcmp0(method_name, "Set") == 0)
+        {
+            set_root_property(ud, parameters, invocation);
+        }
+        else
+        {
+            get_cached_properties(ud, &ud->root_properties, method_name,
+                                  parameters, invocation);
+        }
     }
-    else if (g_strcmp0(property_name, "SupportedUriSchemes") == 0)
+    else if (g_strcmp0(method_name, "Quit") == 0)
     {
-        GVariantBuilder builder;
-        g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
-        g_variant_builder_add(&builder, "s", "ftp");
-        g_variant_builder_add(&builder, "s", "http");
-        g_variant_builder_add(&builder, "s", "https");
-        g_variant_builder_add(&builder, "s", "mms");
-        g_variant_builder_add(&builder, "s", "rtmp");
-        g_variant_builder_add(&builder, "s", "rtsp");
-        g_variant_builder_add(&builder, "s", "sftp");
-        g_variant_builder_add(&builder, "s", "smb");
-        ret = g_variant_builder_end(&builder);
+        // Answered right away, mpv may well be gone before acknowledging
+        const char *args[] = {"quit", NULL};
+        MprisCommand cmd;
+
+        command_run(&cmd, args);
+        if (submit_request(ud, &cmd, 1, NULL, &error))
+        {
+            g_dbus_method_invocation_return_value(invocation, NULL);
+        }
+        else
+        {
+            g_dbus_method_invocation_take_error(invocation, error);
+        }
     }
-    else if (g_strcmp0(property_name, "SupportedMimeTypes") == 0)
+    else if (g_strcmp0(method_name, "Raise") == 0)
     {
-        GVariantBuilder builder;
-        g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
-        g_variant_builder_add(&builder, "s", "application/ogg");
-        g_variant_builder_add(&builder, "s", "audio/mpeg");
-        // TODO add the rest
-        ret = g_variant_builder_end(&builder);
+        // Can't raise
+        g_dbus_method_invocation_return_value(invocation, NULL);
     }
     else
     {
-        ret = NULL;
-        g_set_error(error, G_DBUS_ERROR,
-                    G_DBUS_ERROR_UNKNOWN_PROPERTY,
-                    "Unknown property %s", property_name);
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method");
     }
-
-    return ret;
 }
 
-gboolean set_property_root(G_GNUC_UNUSED GDBusConnection *connection,
-                                  G_GNUC_UNUSED const char *sender,
-                                  G_GNUC_UNUSED const char *object_path,
-                                  G_GNUC_UNUSED const char *interface_name,
-                                  const char *property_name,
-                                  GVariant *value,
-                                  G_GNUC_UNUSED GError **error,
-                                  gpointer user_data)
+static void set_player_property(UserData *ud, GVariant *parameters,
+                                GDBusMethodInvocation *invocation)
 {
-    UserData *ud = (UserData *)user_data;
-    if (g_strcmp0(property_name, "Fullscreen") == 0)
+    const char *property_name;
+    GVariant *value;
+    MprisCommand cmds[2];
+    guint count = 1;
+
+    g_variant_get(parameters, "(&s&sv)", NULL, &property_name, &value);
+    if (g_strcmp0(property_name, "LoopStatus") == 0)
+    {
+        const char *status = g_variant_get_string(value, NULL);
+        int loop_file = g_strcmp0(status, "Track") == 0;
+        int loop_playlist = g_strcmp0(status, "Playlist") == 0;
+
+        command_set_property(&cmds[0], "loop-file", MPV_FORMAT_FLAG, &loop_file);
+        command_set_property(&cmds[1], "loop-playlist", MPV_FORMAT_FLAG, &loop_playlist);
+        count = 2;
+    }
+    else if (g_strcmp0(property_name, "Rate") == 0)
     {
-        int fullscreen;
-        g_variant_get(value, "b", &fullscreen);
-        mpv_set_property(ud->mpv, "fullscreen", MPV_FORMAT_FLAG, &fullscreen);
+        double rate = g_variant_get_double(value);
+        command_set_property(&cmds[0], "speed", MPV_FORMAT_DOUBLE, &rate);
+    }
+    else if (g_strcmp0(property_name, "Shuffle") == 0)
+    {
+        int shuffle = g_variant_get_boolean(value);
+        if (shuffle != ud->state.shuffle)
+        {
+            const char *args[] = {shuffle ? "playlist-shuffle" : "playlist-unshuffle", NULL};
+            command_run(&cmds[0], args);
+            count = 2;
+        }
+        command_set_property(&cmds[count - 1], "shuffle", MPV_FORMAT_FLAG, &shuffle);
+    }
+    else if (g_strcmp0(property_name, "Volume") == 0)
+    {
+        double volume = g_variant_get_double(value);
+        volume *= 100;
+        command_set_property(&cmds[0], "volume", MPV_FORMAT_DOUBLE, &volume);
     }
     else
     {
-        g_set_error(error, G_DBUS_ERROR,
-                    G_DBUS_ERROR_UNKNOWN_PROPERTY,
-                    "Cannot set property %s", property_name);
-        return FALSE;
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                                              "Cannot set property %s", property_name);
+        g_variant_unref(value);
+        return;
     }
-    return TRUE;
+
+    defer_reply(ud, cmds, count, invocation);
+    g_variant_unref(value);
 }
 
 void method_call_player(G_GNUC_UNUSED GDBusConnection *connection,
                                G_GNUC_UNUSED const char *sender,
                                G_GNUC_UNUSED const char *_object_path,
-                               G_GNUC_UNUSED const char *interface_name,
+                               const char *interface_name,
                                const char *method_name,
-                               G_GNUC_UNUSED GVariant *parameters,
+                               GVariant *parameters,
                                GDBusMethodInvocation *invocation,
                                gpointer user_data)
 {
     UserData *ud = (UserData *)user_data;
+    MprisCommand cmd;
+
+    MPRIS_TRACE2(dbus_method, interface_name, method_name);
+    if (g_strcmp0(interface_name, "org.freedesktop.DBus.Properties") == 0)
+    {
+        if (g_strcmp0(method_name, "Set") == 0)
+        {
+            set_player_property(ud, parameters, invocation);
+        }
+        else
+        {
+            get_cached_properties(ud, &ud->player_properties, method_name,
+                                  parameters, invocation);
+        }
+        return;
+    }
+
     if (g_strcmp0(method_name, "Pause") == 0)
     {
         int paused = TRUE;
-        mpv_set_property(ud->mpv, "pause", MPV_FORMAT_FLAG, &paused);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        command_set_property(&cmd, "pause", MPV_FORMAT_FLAG, &paused);
     }
     else if (g_strcmp0(method_name, "PlayPause") == 0)
     {
         int paused;
-        if (ud->status == STATUS_PAUSED)
+        if (ud->state.status == STATUS_PAUSED)
         {
             paused = FALSE;
         }
@@ -184,32 +309,27 @@ void method_call_player(G_GNUC_UNUSED GDBusConnection *connection,
         {
             paused = TRUE;
         }
-        mpv_set_property(ud->mpv, "pause", MPV_FORMAT_FLAG, &paused);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        command_set_property(&cmd, "pause", MPV_FORMAT_FLAG, &paused);
     }
     else if (g_strcmp0(method_name, "Play") == 0)
     {
         int paused = FALSE;
-        mpv_set_property(ud->mpv, "pause", MPV_FORMAT_FLAG, &paused);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        command_set_property(&cmd, "pause", MPV_FORMAT_FLAG, &paused);
     }
     else if (g_strcmp0(method_name, "Stop") == 0)
     {
-        const char *cmd[] = {"stop", NULL};
-        mpv_command_async(ud->mpv, 0, cmd);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        const char *args[] = {"stop", NULL};
+        command_run(&cmd, args);
     }
     else if (g_strcmp0(method_name, "Next") == 0)
     {
-        const char *cmd[] = {"playlist_next", NULL};
-        mpv_command_async(ud->mpv, 0, cmd);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        const char *args[] = {"playlist_next", NULL};
+        command_run(&cmd, args);
     }
     else if (g_strcmp0(method_name, "Previous") == 0)
     {
-        const char *cmd[] = {"playlist_prev", NULL};
-        mpv_command_async(ud->mpv, 0, cmd);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        const char *args[] = {"playlist_prev", NULL};
+        command_run(&cmd, args);
     }
     else if (g_strcmp0(method_name, "Seek") == 0)
     {
@@ -219,233 +339,340 @@ void method_call_player(G_GNUC_UNUSED GDBusConnection *connection,
         double offset_s = offset_us / 1000000.0;
         offset_str = g_strdup_printf("%f", offset_s);
 
-        const char *cmd[] = {"seek", offset_str, NULL};
-        mpv_command_async(ud->mpv, 0, cmd);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        const char *args[] = {"seek", offset_str, NULL};
+        command_run(&cmd, args);
         g_free(offset_str);
     }
     else if (g_strcmp0(method_name, "SetPosition") == 0)
     {
-        int64_t current_id;
         char *object_path;
-        double new_position_s;
         int64_t new_position_us;
 
-        mpv_get_property(ud->mpv, "playlist-pos", MPV_FORMAT_INT64, &current_id);
         g_variant_get(parameters, "(&ox)", &object_path, &new_position_us);
-        new_position_s = ((float)new_position_us) / 1000000.0; // us -> s
-
-        if (current_id == g_ascii_strtoll(object_path + 1, NULL, 10))
-        {
-            // Use MPV's seek command instead of setting time-pos property
-            char *position_str = g_strdup_printf("%.6f", new_position_s);
-
-            const char *cmd[] = {"seek", position_str, "absolute", "exact", NULL};
-            mpv_command_async(ud->mpv, 0, cmd);
-
-            g_free(position_str);
-        }
 
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        // The track id is checked against playlist-pos on the mpv thread
+        command_set_position(&cmd, g_ascii_strtoll(object_path + 1, NULL, 10),
+                             new_position_us);
     }
     else if (g_strcmp0(method_name, "OpenUri") == 0)
     {
         char *uri;
         g_variant_get(parameters, "(&s)", &uri);
-        const char *cmd[] = {"loadfile", uri, NULL};
-        mpv_command_async(ud->mpv, 0, cmd);
-        g_dbus_method_invocation_return_value(invocation, NULL);
+        const char *args[] = {"loadfile", uri, NULL};
+        command_run(&cmd, args);
     }
     else
     {
         g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
                                               G_DBUS_ERROR_UNKNOWN_METHOD,
                                               "Unknown method");
+        return;
     }
+
+    defer_reply(ud, &cmd, 1, invocation);
 }
 
-GVariant *get_property_player(G_GNUC_UNUSED GDBusConnection *connection,
-                                     G_GNUC_UNUSED const char *sender,
-                                     G_GNUC_UNUSED const char *object_path,
-                                     G_GNUC_UNUSED const char *interface_name,
-                                     const char *property_name,
-                                     GError **error,
-                                     gpointer user_data)
+// Extrapolate from the last position sent by the mpv thread
+gint64 get_position_us(UserData *ud)
 {
-    UserData *ud = (UserData *)user_data;
-    GVariant *ret;
-    if (g_strcmp0(property_name, "PlaybackStatus") == 0)
-    {
-        ret = g_variant_new_string(ud->status);
-    }
-    else if (g_strcmp0(property_name, "LoopStatus") == 0)
-    {
-        ret = g_variant_new_string(ud->loop_status);
-    }
-    else if (g_strcmp0(property_name, "Rate") == 0)
+    gint64 position_us = ud->state.position_us;
+
+    if (ud->state.status == STATUS_PLAYING)
     {
-        double rate;
-        mpv_get_property(ud->mpv, "speed", MPV_FORMAT_DOUBLE, &rate);
-        ret = g_variant_new_double(rate);
+        gint64 elapsed = g_get_monotonic_time() - ud->state.position_time;
+        position_us += (gint64)(elapsed * ud->state.rate);
     }
-    else if (g_strcmp0(property_name, "Shuffle") == 0)
+
+    return MAX(position_us, 0);
+}
+
+static const char *match_status(const char *value, const char *const *statuses,
+                                size_t count)
+{
+    for (size_t i = 0; i < count; i++)
     {
-        int shuffle;
-        mpv_get_property(ud->mpv, "shuffle", MPV_FORMAT_FLAG, &shuffle);
-        ret = g_variant_new_boolean(shuffle);
+        if (g_strcmp0(value, statuses[i]) == 0)
+        {
+            return statuses[i];
+        }
     }
-    else if (g_strcmp0(property_name, "Metadata") == 0)
+    return statuses[0];
+}
+
+static int find_emit_policy(const char *prop_name)
+{
+    for (int i = 0; i < EMIT_POLICY_COUNT; i++)
     {
-        if (!ud->metadata)
+        if (g_strcmp0(prop_name, default_emit_policies[i].property) == 0)
         {
-            ud->metadata = create_metadata(ud);
+            return i;
         }
-        // Increase reference count to prevent it from being freed after returning
-        g_variant_ref(ud->metadata);
-        ret = ud->metadata;
     }
-    else if (g_strcmp0(property_name, "Volume") == 0)
+    return -1;
+}
+
+// Cache that serves Get and GetAll for the property's interface
+static PropertyCache *property_cache_for(UserData *ud, const char *prop_name)
+{
+    int i = find_emit_policy(prop_name);
+
+    if (i >= 0 && g_strcmp0(default_emit_policies[i].interface,
+                            "org.mpris.MediaPlayer2") == 0)
     {
-        double volume;
-        mpv_get_property(ud->mpv, "volume", MPV_FORMAT_DOUBLE, &volume);
-        volume /= 100;
-        ret = g_variant_new_double(volume);
+        return &ud->root_properties;
     }
-    else if (g_strcmp0(property_name, "Position") == 0)
+    return &ud->player_properties;
+}
+
+// Fill the property caches with the initial state. Constant properties
+// are only ever allocated here.
+void init_property_caches(UserData *ud)
+{
+    PropertyCache *root = &ud->root_properties;
+    PropertyCache *player = &ud->player_properties;
+    const char *uri_schemes[] = {"ftp", "http", "https", "mms",
+                                 "rtmp", "rtsp", "sftp", "smb"};
+    // TODO add the rest
+    const char *mime_types[] = {"application/ogg", "audio/mpeg"};
+
+    property_cache_init(root, ud->root_interface_info);
+    property_cache_set(root, "CanQuit", g_variant_new_boolean(TRUE));
+    property_cache_set(root, "Fullscreen", g_variant_new_boolean(FALSE));
+    property_cache_set(root, "CanSetFullscreen", g_variant_new_boolean(FALSE));
+    property_cache_set(root, "CanRaise", g_variant_new_boolean(FALSE));
+    property_cache_set(root, "HasTrackList", g_variant_new_boolean(FALSE));
+    property_cache_set(root, "Identity", g_variant_new_string("mpv"));
+    property_cache_set(root, "DesktopEntry", g_variant_new_string("mpv"));
+    property_cache_set(root, "SupportedUriSchemes",
+                       g_variant_new_strv(uri_schemes, G_N_ELEMENTS(uri_schemes)));
+    property_cache_set(root, "SupportedMimeTypes",
+                       g_variant_new_strv(mime_types, G_N_ELEMENTS(mime_types)));
+
+    property_cache_init(player, ud->player_interface_info);
+    property_cache_set(player, "PlaybackStatus", g_variant_new_string(ud->state.status));
+    property_cache_set(player, "LoopStatus", g_variant_new_string(LOOP_NONE));
+    property_cache_set(player, "Rate", g_variant_new_double(ud->state.rate));
+    property_cache_set(player, "Shuffle", g_variant_new_boolean(ud->state.shuffle));
+    property_cache_set(player, "Metadata", g_variant_new("a{sv}", NULL));
+    property_cache_set(player, "Volume", g_variant_new_double(1.0));
+    property_cache_set(player, "Position", g_variant_new_int64(0));
+    property_cache_set(player, "MinimumRate", g_variant_new_double(0.01));
+    property_cache_set(player, "MaximumRate", g_variant_new_double(100));
+    property_cache_set(player, "CanGoNext", g_variant_new_boolean(TRUE));
+    property_cache_set(player, "CanGoPrevious", g_variant_new_boolean(TRUE));
+    property_cache_set(player, "CanPlay", g_variant_new_boolean(TRUE));
+    property_cache_set(player, "CanPause", g_variant_new_boolean(TRUE));
+    property_cache_set(player, "CanSeek", g_variant_new_boolean(TRUE));
+    property_cache_set(player, "CanControl", g_variant_new_boolean(TRUE));
+
+    if (ud->debug)
     {
-        double position_s;
-        int64_t position_us;
-        mpv_get_property(ud->mpv, "time-pos", MPV_FORMAT_DOUBLE, &position_s);
-        position_us = position_s * 1000000.0; // s -> us
-        ret = g_variant_new_int64(position_us);
+        property_cache_init(&ud->debug_properties, ud->debug_interface_info);
+        property_cache_set(&ud->debug_properties, "MetadataRebuilds",
+                           g_variant_new_uint64(0));
     }
-    else if (g_strcmp0(property_name, "MinimumRate") == 0)
+}
+
+// Apply a delta received from the mpv thread
+void update_player_state(UserData *ud, const char *name, GVariant *value)
+{
+    PlayerState *state = &ud->state;
+
+    if (g_strcmp0(name, "Position") == 0)
     {
-        ret = g_variant_new_double(0.01);
+        g_variant_get(value, "(xx)", &state->position_us, &state->position_time);
+        property_cache_set(&ud->player_properties, "Position",
+                           g_variant_new_int64(MAX(state->position_us, 0)));
+        status_page_update(ud, name, value);
+        return;
     }
-    else if (g_strcmp0(property_name, "MaximumRate") == 0)
+    else if (g_strcmp0(name, "Seeked") == 0)
     {
-        ret = g_variant_new_double(100);
+        state->position_us = g_variant_get_int64(value);
+        state->position_time = g_get_monotonic_time();
+        property_cache_set(&ud->player_properties, "Position",
+                           g_variant_new_int64(MAX(state->position_us, 0)));
+        status_page_update(ud, name, value);
+        emit_seeked_signal(ud, state->position_us);
+        return;
     }
-    else if (g_strcmp0(property_name, "CanGoNext") == 0)
+    else if (g_strcmp0(name, "PlaybackStatus") == 0)
     {
-        ret = g_variant_new_boolean(TRUE);
+        const char *statuses[] = {STATUS_STOPPED, STATUS_PLAYING, STATUS_PAUSED};
+        state->status = match_status(g_variant_get_string(value, NULL),
+                                     statuses, G_N_ELEMENTS(statuses));
     }
-    else if (g_strcmp0(property_name, "CanGoPrevious") == 0)
+    else if (g_strcmp0(name, "Shuffle") == 0)
     {
-        ret = g_variant_new_boolean(TRUE);
+        state->shuffle = g_variant_get_boolean(value);
     }
-    else if (g_strcmp0(property_name, "CanPlay") == 0)
+    else if (g_strcmp0(name, "Rate") == 0)
     {
-        ret = g_variant_new_boolean(TRUE);
+        state->rate = g_variant_get_double(value);
     }
-    else if (g_strcmp0(property_name, "CanPause") == 0)
+    else if (g_strcmp0(name, "MetadataRebuilds") == 0)
     {
-        ret = g_variant_new_boolean(TRUE);
+        // Debug counters are read on demand, never signalled
+        property_cache_set(&ud->debug_properties, name, value);
+        return;
     }
-    else if (g_strcmp0(property_name, "CanSeek") == 0)
+
+    property_cache_set(property_cache_for(ud, name), name, value);
+    status_page_update(ud, name, value);
+    queue_property_change(ud, name, value);
+}
+
+// Earliest time a pending change of the property may be emitted
+static gint64 emit_not_before(const EmitPolicy *policy, const EmitState *state)
+{
+    if (!state->last_emit)
     {
-        ret = g_variant_new_boolean(TRUE);
+        return 0;
     }
-    else if (g_strcmp0(property_name, "CanControl") == 0)
+    return state->last_emit + policy->min_interval_us;
+}
+
+// Time by which a pending change of the property has to be emitted
+static gint64 emit_deadline(const EmitPolicy *policy, const EmitState *state)
+{
+    return MAX(state->pending_since + policy->latency_budget_us,
+               emit_not_before(policy, state));
+}
+
+static void schedule_property_emit(UserData *ud)
+{
+    gint64 next = -1;
+    gpointer prop_name;
+    GHashTableIter iter;
+
+    if (!ud->emit_source)
     {
-        ret = g_variant_new_boolean(TRUE);
+        return;
     }
-    else
+
+    g_hash_table_iter_init(&iter, ud->changed_properties);
+    while (g_hash_table_iter_next(&iter, &prop_name, NULL))
     {
-        ret = NULL;
-        g_set_error(error, G_DBUS_ERROR,
-                    G_DBUS_ERROR_UNKNOWN_PROPERTY,
-                    "Unknown property %s", property_name);
+        int i = find_emit_policy(prop_name);
+        gint64 deadline = emit_deadline(&ud->emit_policies[i], &ud->emit_state[i]);
+        if (next < 0 || deadline < next)
+        {
+            next = deadline;
+        }
     }
 
-    return ret;
+    g_source_set_ready_time(ud->emit_source, next);
 }
 
-gboolean set_property_player(G_GNUC_UNUSED GDBusConnection *connection,
-                                    G_GNUC_UNUSED const char *sender,
-                                    G_GNUC_UNUSED const char *object_path,
-                                    G_GNUC_UNUSED const char *interface_name,
-                                    const char *property_name,
-                                    GVariant *value,
-                                    G_GNUC_UNUSED GError **error,
-                                    gpointer user_data)
+void queue_property_change(UserData *ud, const char *prop_name, GVariant *prop_value)
 {
-    UserData *ud = (UserData *)user_data;
-    if (g_strcmp0(property_name, "LoopStatus") == 0)
+    int i = find_emit_policy(prop_name);
+
+    if (i < 0)
     {
-        const char *status;
-        int t = TRUE;
-        int f = FALSE;
-        status = g_variant_get_string(value, NULL);
-        if (g_strcmp0(status, "Track") == 0)
-        {
-            mpv_set_property(ud->mpv, "loop-file", MPV_FORMAT_FLAG, &t);
-            mpv_set_property(ud->mpv, "loop-playlist", MPV_FORMAT_FLAG, &f);
-        }
-        else if (g_strcmp0(status, "Playlist") == 0)
-        {
-            mpv_set_property(ud->mpv, "loop-file", MPV_FORMAT_FLAG, &f);
-            mpv_set_property(ud->mpv, "loop-playlist", MPV_FORMAT_FLAG, &t);
-        }
-        else
-        {
-            mpv_set_property(ud->mpv, "loop-file", MPV_FORMAT_FLAG, &f);
-            mpv_set_property(ud->mpv, "loop-playlist", MPV_FORMAT_FLAG, &f);
-        }
+        g_printerr("No emission policy for property %s\n", prop_name);
+        return;
     }
-    else if (g_strcmp0(property_name, "Rate") == 0)
+
+    if (!ud->emit_state[i].pending_since)
     {
-        double rate = g_variant_get_double(value);
-        mpv_set_property(ud->mpv, "speed", MPV_FORMAT_DOUBLE, &rate);
+        ud->emit_state[i].pending_since = g_get_monotonic_time();
+        ud->emit_state[i].changed_at = ud->delta_time;
     }
-    else if (g_strcmp0(property_name, "Shuffle") == 0)
+
+    // Last value wins, an older pending value is simply replaced
+    g_hash_table_replace(ud->changed_properties, (gpointer)prop_name,
+                         prop_value ? g_variant_ref_sink(prop_value) : NULL);
+
+    schedule_property_emit(ud);
+}
+
+// Send a signal to the bus and to every directly connected peer
+static void emit_signal(UserData *ud, const char *interface_name,
+                        const char *signal_name, GVariant *params)
+{
+    GError *error = NULL;
+
+    g_variant_ref_sink(params);
+
+    if (ud->connection)
     {
-        int shuffle = g_variant_get_boolean(value);
-        if (shuffle && !ud->shuffle)
-        {
-            const char *cmd[] = {"playlist-shuffle", NULL};
-            mpv_command_async(ud->mpv, 0, cmd);
-        }
-        else if (!shuffle && ud->shuffle)
+        g_dbus_connection_emit_signal(ud->connection, NULL,
+                                      "/org/mpris/MediaPlayer2",
+                                      interface_name, signal_name,
+                                      params, &error);
+        if (error != NULL)
         {
-            const char *cmd[] = {"playlist-unshuffle", NULL};
-            mpv_command_async(ud->mpv, 0, cmd);
+            g_printerr("%s", error->message);
+            g_error_free(error);
         }
-        mpv_set_property(ud->mpv, "shuffle", MPV_FORMAT_FLAG, &shuffle);
-    }
-    else if (g_strcmp0(property_name, "Volume") == 0)
-    {
-        double volume = g_variant_get_double(value);
-        volume *= 100;
-        mpv_set_property(ud->mpv, "volume", MPV_FORMAT_DOUBLE, &volume);
-    }
-    else
-    {
-        g_set_error(error, G_DBUS_ERROR,
-                    G_DBUS_ERROR_UNKNOWN_PROPERTY,
-                    "Cannot set property %s", property_name);
-        return FALSE;
     }
 
-    return TRUE;
+    p2p_emit_signal(ud, interface_name, signal_name, params);
+    g_variant_unref(params);
 }
 
-gboolean emit_property_changes(gpointer data)
+static void emit_properties_changed(UserData *ud, const char *interface_name,
+                                    GVariantBuilder *properties,
+                                    GVariantBuilder *invalidated)
 {
-    UserData *ud = (UserData *)data;
-    GError *error = NULL;
+    emit_signal(ud, "org.freedesktop.DBus.Properties", "PropertiesChanged",
+                g_variant_new("(sa{sv}as)", interface_name, properties, invalidated));
+}
+
+// Emit every pending change whose minimum interval has passed, provided at
+// least one of them reached its deadline. With force, everything goes out.
+void flush_property_changes(UserData *ud, gboolean force)
+{
+    const char *interfaces[] = {"org.mpris.MediaPlayer2.Player",
+                                "org.mpris.MediaPlayer2"};
+    gint64 now = g_get_monotonic_time();
+    gboolean any_due = force;
     gpointer prop_name, prop_value;
     GHashTableIter iter;
 
-    if (g_hash_table_size(ud->changed_properties) > 0)
+    g_hash_table_iter_init(&iter, ud->changed_properties);
+    while (!any_due && g_hash_table_iter_next(&iter, &prop_name, NULL))
+    {
+        int i = find_emit_policy(prop_name);
+        any_due = emit_deadline(&ud->emit_policies[i], &ud->emit_state[i]) <= now;
+    }
+
+    if (!ud->connection && !ud->peers)
+    {
+        // Nothing to emit on yet, on_bus_acquired() flushes once registered
+        if (ud->emit_source)
+        {
+            g_source_set_ready_time(ud->emit_source, -1);
+        }
+        return;
+    }
+
+    if (!any_due)
+    {
+        schedule_property_emit(ud);
+        return;
+    }
+
+    for (size_t n = 0; n < G_N_ELEMENTS(interfaces); n++)
     {
-        GVariant *params;
         GVariantBuilder *properties = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
         GVariantBuilder *invalidated = g_variant_builder_new(G_VARIANT_TYPE("as"));
+        guint count = 0;
+
         g_hash_table_iter_init(&iter, ud->changed_properties);
         while (g_hash_table_iter_next(&iter, &prop_name, &prop_value))
         {
+            int i = find_emit_policy(prop_name);
+            EmitPolicy *policy = &ud->emit_policies[i];
+            EmitState *state = &ud->emit_state[i];
+
+            if (g_strcmp0(policy->interface, interfaces[n]) != 0 ||
+                (!force && emit_not_before(policy, state) > now))
+            {
+                continue;
+            }
+
             if (prop_value)
             {
                 g_variant_builder_add(properties, "{sv}", prop_name, prop_value);
@@ -454,47 +681,222 @@ gboolean emit_property_changes(gpointer data)
             {
                 g_variant_builder_add(invalidated, "s", prop_name);
             }
+
+            histograms_record_since(ud->histograms, HISTOGRAM_EVENT_TO_SIGNAL,
+                                    state->changed_at);
+            state->pending_since = 0;
+            state->changed_at = 0;
+            state->last_emit = now;
+            g_hash_table_iter_remove(&iter);
+            count++;
+        }
+
+        if (count)
+        {
+            MPRIS_TRACE2(emit_flush, interfaces[n], count);
+            emit_properties_changed(ud, interfaces[n], properties, invalidated);
         }
-        params = g_variant_new("(sa{sv}as)",
-                               "org.mpris.MediaPlayer2.Player", properties, invalidated);
         g_variant_builder_unref(properties);
         g_variant_builder_unref(invalidated);
+    }
 
-        g_dbus_connection_emit_signal(ud->connection, NULL,
-                                      "/org/mpris/MediaPlayer2",
-                                      "org.freedesktop.DBus.Properties",
-                                      "PropertiesChanged",
-                                      params, &error);
-        if (error != NULL)
+    schedule_property_emit(ud);
+}
+
+gboolean emit_property_changes(gpointer data)
+{
+    UserData *ud = (UserData *)data;
+
+    flush_property_changes(ud, FALSE);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean emit_source_dispatch(GSource *source, GSourceFunc callback,
+                                     gpointer user_data)
+{
+    g_source_set_ready_time(source, -1);
+    return callback(user_data);
+}
+
+static GSourceFuncs emit_source_funcs = {
+    NULL, NULL, emit_source_dispatch, NULL, NULL, NULL};
+
+// Source driving emit_property_changes(), woken up at the next deadline
+GSource *emit_source_new(UserData *ud)
+{
+    GSource *source = g_source_new(&emit_source_funcs, sizeof(GSource));
+    g_source_set_callback(source, emit_property_changes, ud, NULL);
+    return source;
+}
+
+void emit_seeked_signal(UserData *ud, gint64 position_us)
+{
+    emit_signal(ud, "org.mpris.MediaPlayer2.Player", "Seeked",
+                g_variant_new("(x)", position_us));
+}
+
+static const char *const enqueue_modes[] = {
+    [ENQUEUE_APPEND] = "append",
+    [ENQUEUE_REPLACE] = "replace",
+    [ENQUEUE_INSERT_NEXT] = "insert-next",
+};
+
+// org.mpv.MprisQueue, a vendor extension for controllers that queue many
+// items at once. Enqueue is answered once mpv acknowledged every item.
+void method_call_queue(G_GNUC_UNUSED GDBusConnection *connection,
+                       G_GNUC_UNUSED const char *sender,
+                       G_GNUC_UNUSED const char *object_path,
+                       const char *interface_name,
+                       const char *method_name,
+                       GVariant *parameters,
+                       GDBusMethodInvocation *invocation,
+                       gpointer user_data)
+{
+    UserData *ud = (UserData *)user_data;
+    const char **uris;
+    const char *mode_name;
+    int mode = -1;
+
+    MPRIS_TRACE2(dbus_method, interface_name, method_name);
+    if (g_strcmp0(method_name, "Enqueue") != 0)
+    {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method");
+        return;
+    }
+
+    g_variant_get(parameters, "(^a&s&s)", &uris, &mode_name);
+    for (guint i = 0; i < G_N_ELEMENTS(enqueue_modes); i++)
+    {
+        if (g_strcmp0(mode_name, enqueue_modes[i]) == 0)
         {
-            g_printerr("%s", error->message);
+            mode = i;
         }
+    }
+
+    if (mode < 0)
+    {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_INVALID_ARGS,
+                                              "Unknown mode %s", mode_name);
+    }
+    else if (!uris[0])
+    {
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+    else
+    {
+        MprisCommand cmd;
 
-        g_hash_table_remove_all(ud->changed_properties);
+        command_enqueue(&cmd, uris, mode);
+        defer_reply(ud, &cmd, 1, invocation);
     }
-    return TRUE;
+
+    g_free(uris);
 }
 
+// All histograms by name, see histogram_snapshot() for the values
+static GVariant *snapshot_histograms(UserData *ud)
+{
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer name, histogram;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sa{sv}}"));
+    for (int i = 0; i < HISTOGRAM_COUNT; i++)
+    {
+        g_variant_builder_add(&builder, "{s@a{sv}}", histogram_names[i],
+                              histogram_snapshot(&ud->histograms[i]));
+    }
 
-void emit_seeked_signal(UserData *ud)
+    g_hash_table_iter_init(&iter, ud->get_histograms);
+    while (g_hash_table_iter_next(&iter, &name, &histogram))
+    {
+        g_variant_builder_add(&builder, "{s@a{sv}}", (const char *)name,
+                              histogram_snapshot(histogram));
+    }
+    return g_variant_new("(a{sa{sv}})", &builder);
+}
+
+static void reset_histograms(UserData *ud)
 {
-    GVariant *params;
-    double position_s;
-    int64_t position_us;
-    GError *error = NULL;
-    mpv_get_property(ud->mpv, "time-pos", MPV_FORMAT_DOUBLE, &position_s);
-    position_us = position_s * 1000000.0; // s -> us
-    params = g_variant_new("(x)", position_us);
+    GHashTableIter iter;
+    gpointer histogram;
 
-    g_dbus_connection_emit_signal(ud->connection, NULL,
-                                  "/org/mpris/MediaPlayer2",
-                                  "org.mpris.MediaPlayer2.Player",
-                                  "Seeked",
-                                  params, &error);
+    for (int i = 0; i < HISTOGRAM_COUNT; i++)
+    {
+        histogram_reset(&ud->histograms[i]);
+    }
 
-    if (error != NULL)
+    g_hash_table_iter_init(&iter, ud->get_histograms);
+    while (g_hash_table_iter_next(&iter, NULL, &histogram))
+    {
+        histogram_reset(histogram);
+    }
+}
+
+// org.mpv.MprisDebug, only registered with mpris-debug=yes: counters,
+// latency histograms for comparing builds and, with ALLOC_STATS=1,
+// allocation counts
+void method_call_debug(G_GNUC_UNUSED GDBusConnection *connection,
+                       G_GNUC_UNUSED const char *sender,
+                       G_GNUC_UNUSED const char *object_path,
+                       const char *interface_name,
+                       const char *method_name,
+                       GVariant *parameters,
+                       GDBusMethodInvocation *invocation,
+                       gpointer user_data)
+{
+    UserData *ud = (UserData *)user_data;
+
+    MPRIS_TRACE2(dbus_method, interface_name, method_name);
+    if (g_strcmp0(interface_name, "org.freedesktop.DBus.Properties") == 0)
+    {
+        get_cached_properties(ud, &ud->debug_properties, method_name,
+                              parameters, invocation);
+    }
+    else if (g_strcmp0(method_name, "Snapshot") == 0)
+    {
+        g_dbus_method_invocation_return_value(invocation, snapshot_histograms(ud));
+    }
+    else if (g_strcmp0(method_name, "Reset") == 0)
+    {
+        reset_histograms(ud);
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+    else if (g_strcmp0(method_name, "Allocations") == 0)
+    {
+        MprisAllocStats stats;
+
+        if (!alloc_stats_read(&stats))
+        {
+            g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_NOT_SUPPORTED,
+                                                  "Built without ALLOC_STATS=1");
+            return;
+        }
+        // Only the plugin's direct malloc() calls are seen, there may
+        // have been none
+        if (!alloc_stats_process_wide() && alloc_stats_live(&stats) == 0 &&
+            stats.frees == 0)
+        {
+            g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_NOT_SUPPORTED,
+                                                  "Nothing counted, GLib's allocations "
+                                                  "are only seen with the plugin in "
+                                                  "LD_PRELOAD");
+            return;
+        }
+        g_dbus_method_invocation_return_value(
+            invocation, g_variant_new("(@a{s(tt)}t)", alloc_stats_snapshot(&stats),
+                                      alloc_stats_live(&stats)));
+    }
+    else
     {
-        g_printerr("%s", error->message);
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method");
     }
 }
 
@@ -527,7 +929,36 @@ void on_bus_acquired(GDBusConnection *connection,
     {
         g_printerr("Failed to register player interface: %s\n", error->message);
         g_error_free(error);
+        error = NULL;
+    }
+
+    ud->queue_interface_id =
+        g_dbus_connection_register_object(connection, "/org/mpris/MediaPlayer2",
+                                          ud->queue_interface_info,
+                                          &vtable_queue,
+                                          user_data, NULL, &error);
+    if (error != NULL)
+    {
+        g_printerr("Failed to register queue interface: %s\n", error->message);
+        g_error_free(error);
+        error = NULL;
     }
+
+    if (ud->debug)
+    {
+        ud->debug_interface_id =
+            g_dbus_connection_register_object(connection, "/org/mpris/MediaPlayer2",
+                                              ud->debug_interface_info,
+                                              &vtable_debug,
+                                              user_data, NULL, &error);
+        if (error != NULL)
+        {
+            g_printerr("Failed to register debug interface: %s\n", error->message);
+            g_error_free(error);
+        }
+    }
+
+    flush_property_changes(ud, FALSE);
 }
 
 void on_name_lost(GDBusConnection *connection,
@@ -547,3 +978,62 @@ void on_name_lost(GDBusConnection *connection,
         g_free(name);
     }
 }
+
+// D-Bus thread: owns the bus name and serves requests from mirrored state
+gpointer run_dbus_thread(gpointer data)
+{
+    UserData *ud = data;
+
+    MprisAllocScope previous_scope = alloc_scope_enter(ALLOC_SCOPE_DBUS);
+
+    g_main_context_push_thread_default(ud->dbus_context);
+    if (ud->histograms)
+    {
+        histogram_time_loop(ud->dbus_context, &ud->histograms[HISTOGRAM_LOOP_DBUS]);
+    }
+
+    p2p_start(ud);
+    status_page_open(ud);
+
+    ud->bus_id = g_bus_own_name(G_BUS_TYPE_SESSION,
+                                "org.mpris.MediaPlayer2.mpv",
+                                G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE,
+                                on_bus_acquired,
+                                NULL,
+                                on_name_lost,
+                                ud, NULL);
+
+    g_main_loop_run(ud->dbus_loop);
+
+    if (ud->connection)
+    {
+        if (ud->root_interface_id)
+        {
+            g_dbus_connection_unregister_object(ud->connection, ud->root_interface_id);
+        }
+        if (ud->player_interface_id)
+        {
+            g_dbus_connection_unregister_object(ud->connection, ud->player_interface_id);
+        }
+        if (ud->queue_interface_id)
+        {
+            g_dbus_connection_unregister_object(ud->connection, ud->queue_interface_id);
+        }
+        if (ud->debug_interface_id)
+        {
+            g_dbus_connection_unregister_object(ud->connection, ud->debug_interface_id);
+        }
+    }
+
+    if (ud->bus_id)
+    {
+        g_bus_unown_name(ud->bus_id);
+    }
+
+    p2p_stop(ud);
+    status_page_close(ud);
+
+    g_main_context_pop_thread_default(ud->dbus_context);
+    alloc_scope_leave(previous_scope);
+    return NULL;
+}
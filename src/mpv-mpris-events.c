@@ -22,8 +22,13 @@
     SOFTWARE.
 */
 
+#include <string.h>
+
 #include "mpv-mpris-types.h"
-#include "mpv-mpris-dbus.h"
+#include "mpv-mpris-bridge.h"
+#include "mpv-mpris-frame-art.h"
+#include "mpv-mpris-metadata.h"
+#include "mpv-mpris-trace.h"
 
 GVariant *set_playback_status(UserData *ud)
 {
@@ -44,180 +49,551 @@ GVariant *set_playback_status(UserData *ud)
 
 void set_stopped_status(UserData *ud)
 {
-    const char *prop_name = "PlaybackStatus";
-    GVariant *prop_value = g_variant_new_string(STATUS_STOPPED);
-
     ud->status = STATUS_STOPPED;
 
-    g_hash_table_insert(ud->changed_properties,
-                        (gpointer)prop_name, prop_value);
+    publish_delta(ud, "PlaybackStatus", g_variant_new_string(STATUS_STOPPED));
+}
 
-    emit_property_changes(ud);
+static void on_pause(UserData *ud, void *data)
+{
+    ud->paused = *(int *)data;
+    publish_delta(ud, "PlaybackStatus", set_playback_status(ud));
+    publish_position(ud);
 }
 
-void handle_property_change(const char *name, void *data, UserData *ud)
+static void on_idle_active(UserData *ud, void *data)
 {
-    const char *prop_name = NULL;
-    GVariant *prop_value = NULL;
-    if (g_strcmp0(name, "pause") == 0)
+    ud->idle = *(int *)data;
+    if (ud->idle)
     {
-        ud->paused = *(int *)data;
-        prop_name = "PlaybackStatus";
-        prop_value = set_playback_status(ud);
+        // No file is coming, the emptied Metadata can go out
+        ud->file_loading = FALSE;
     }
-    else if (g_strcmp0(name, "idle-active") == 0)
+    publish_delta(ud, "PlaybackStatus", set_playback_status(ud));
+}
+
+// The inputs of create_metadata() are kept in ud, so that building
+// Metadata never reads from mpv. Strings and tags are taken from the
+// batched event, data is NULL when the property has no value.
+static void take_string(gchar **field, void *data)
+{
+    g_free(*field);
+    *field = data ? g_steal_pointer((char **)data) : NULL;
+}
+
+// Rebuilt from update_metadata(), once per batch of events at most
+static void on_media_title(UserData *ud, void *data)
+{
+    take_string(&ud->media_title, data);
+    ud->metadata_dirty = TRUE;
+}
+
+static void on_path(UserData *ud, void *data)
+{
+    take_string(&ud->path, data);
+    ud->metadata_dirty = TRUE;
+}
+
+// Only used to resolve a relative path, which brings its own update
+static void on_working_directory(UserData *ud, void *data)
+{
+    take_string(&ud->working_dir, data);
+}
+
+static void on_duration(UserData *ud, void *data)
+{
+    ud->duration = data ? *(double *)data : -1;
+    ud->metadata_dirty = TRUE;
+}
+
+static void on_metadata(UserData *ud, void *data)
+{
+    if (ud->tags)
     {
-        ud->idle = *(int *)data;
-        prop_name = "PlaybackStatus";
-        prop_value = set_playback_status(ud);
+        g_hash_table_unref(ud->tags);
     }
-    else if (g_strcmp0(name, "media-title") == 0 ||
-             g_strcmp0(name, "duration") == 0)
+    ud->tags = data ? g_steal_pointer((GHashTable **)data) : NULL;
+    ud->metadata_dirty = TRUE;
+}
+
+static void on_speed(UserData *ud, void *data)
+{
+    publish_delta(ud, "Rate", g_variant_new_double(*(double *)data));
+    publish_position(ud);
+}
+
+static void on_volume(UserData *ud, void *data)
+{
+    publish_delta(ud, "Volume", g_variant_new_double(*(double *)data / 100));
+}
+
+// Both loop properties are kept, so either one changing is enough to
+// work out LoopStatus. loop-file wins as it is what mpv applies first.
+static void publish_loop_status(UserData *ud)
+{
+    if (ud->loop_file)
     {
-        // Free existing metadata object
-        if (ud->metadata)
-        {
-            g_variant_unref(ud->metadata);
-        }
-        ud->metadata = create_metadata(ud);
-        prop_name = "Metadata";
-        prop_value = ud->metadata;
+        ud->loop_status = LOOP_TRACK;
     }
-    else if (g_strcmp0(name, "speed") == 0)
+    else if (ud->loop_playlist)
     {
-        double *rate = data;
-        prop_name = "Rate";
-        prop_value = g_variant_new_double(*rate);
+        ud->loop_status = LOOP_PLAYLIST;
     }
-    else if (g_strcmp0(name, "volume") == 0)
+    else
     {
-        double *volume = data;
-        *volume /= 100;
-        prop_name = "Volume";
-        prop_value = g_variant_new_double(*volume);
+        ud->loop_status = LOOP_NONE;
     }
-    else if (g_strcmp0(name, "loop-file") == 0)
+    publish_delta(ud, "LoopStatus", g_variant_new_string(ud->loop_status));
+}
+
+static void on_loop_file(UserData *ud, void *data)
+{
+    ud->loop_file = g_strcmp0(*(char **)data, "no") != 0;
+    publish_loop_status(ud);
+}
+
+static void on_loop_playlist(UserData *ud, void *data)
+{
+    ud->loop_playlist = g_strcmp0(*(char **)data, "no") != 0;
+    publish_loop_status(ud);
+}
+
+static void on_shuffle(UserData *ud, void *data)
+{
+    ud->shuffle = *(int *)data;
+    publish_delta(ud, "Shuffle", g_variant_new_boolean(ud->shuffle));
+}
+
+static void on_fullscreen(UserData *ud, void *data)
+{
+    publish_delta(ud, "Fullscreen", g_variant_new_boolean(*(int *)data));
+}
+
+static void on_vo_configured(UserData *ud, void *data)
+{
+    publish_delta(ud, "CanSetFullscreen", g_variant_new_boolean(*(int *)data));
+}
+
+static void on_playlist_pos(UserData *ud, void *data)
+{
+    ud->playlist_pos = data ? *(int64_t *)data : -1;
+}
+
+static gint64 position_from(void *data)
+{
+    return data ? (gint64)(*(double *)data * 1000000.0) : 0;
+}
+
+static void on_position(UserData *ud, void *data)
+{
+    publish_delta(ud, "Position",
+                  g_variant_new("(xx)", position_from(data), g_get_monotonic_time()));
+}
+
+static void on_seek_position(UserData *ud, void *data)
+{
+    publish_delta(ud, "Seeked", g_variant_new_int64(position_from(data)));
+    on_position(ud, data);
+}
+
+static void on_frame_art_position(UserData *ud, void *data)
+{
+    if (ud->frame_art)
     {
-        char *status = *(char **)data;
-        if (g_strcmp0(status, "no") != 0)
-        {
-            ud->loop_status = LOOP_TRACK;
-        }
-        else
-        {
-            char *playlist_status;
-            mpv_get_property(ud->mpv, "loop-playlist", MPV_FORMAT_STRING, &playlist_status);
-            if (g_strcmp0(playlist_status, "no") != 0)
-            {
-                ud->loop_status = LOOP_PLAYLIST;
-            }
-            else
-            {
-                ud->loop_status = LOOP_NONE;
-            }
-            mpv_free(playlist_status);
-        }
-        prop_name = "LoopStatus";
-        prop_value = g_variant_new_string(ud->loop_status);
+        frame_art_position(ud->frame_art, position_from(data),
+                           ud->duration > 0 ? (gint64)(ud->duration * 1000000.0) : -1);
     }
-    else if (g_strcmp0(name, "loop-playlist") == 0)
+}
+
+typedef void (*PropertyHandler)(UserData *ud, void *data);
+
+// Indexed by reply_userdata. Properties with a name are observed from
+// observe_properties(), the others come from async reads.
+static const struct {
+    const char *name;
+    mpv_format format;
+    PropertyHandler handler;
+    gboolean when_unavailable; // also called, with NULL, without a value
+} properties[PROPERTY_COUNT] = {
+    [PROPERTY_PAUSE] = {"pause", MPV_FORMAT_FLAG, on_pause, FALSE},
+    [PROPERTY_IDLE_ACTIVE] = {"idle-active", MPV_FORMAT_FLAG, on_idle_active, FALSE},
+    [PROPERTY_MEDIA_TITLE] = {"media-title", MPV_FORMAT_STRING, on_media_title, TRUE},
+    [PROPERTY_SPEED] = {"speed", MPV_FORMAT_DOUBLE, on_speed, FALSE},
+    [PROPERTY_VOLUME] = {"volume", MPV_FORMAT_DOUBLE, on_volume, FALSE},
+    [PROPERTY_LOOP_FILE] = {"loop-file", MPV_FORMAT_STRING, on_loop_file, FALSE},
+    [PROPERTY_LOOP_PLAYLIST] = {"loop-playlist", MPV_FORMAT_STRING, on_loop_playlist, FALSE},
+    [PROPERTY_DURATION] = {"duration", MPV_FORMAT_DOUBLE, on_duration, TRUE},
+    [PROPERTY_SHUFFLE] = {"shuffle", MPV_FORMAT_FLAG, on_shuffle, FALSE},
+    [PROPERTY_FULLSCREEN] = {"fullscreen", MPV_FORMAT_FLAG, on_fullscreen, FALSE},
+    [PROPERTY_VO_CONFIGURED] = {"vo-configured", MPV_FORMAT_FLAG, on_vo_configured, FALSE},
+    [PROPERTY_PLAYLIST_POS] = {"playlist-pos", MPV_FORMAT_INT64, on_playlist_pos, TRUE},
+    [PROPERTY_METADATA] = {"metadata", MPV_FORMAT_NODE, on_metadata, TRUE},
+    [PROPERTY_PATH] = {"path", MPV_FORMAT_STRING, on_path, TRUE},
+    [PROPERTY_WORKING_DIRECTORY] = {"working-directory", MPV_FORMAT_STRING,
+                                    on_working_directory, TRUE},
+    [PROPERTY_POSITION] = {NULL, MPV_FORMAT_DOUBLE, on_position, TRUE},
+    [PROPERTY_SEEK_POSITION] = {NULL, MPV_FORMAT_DOUBLE, on_seek_position, TRUE},
+    [PROPERTY_FRAME_ART_POSITION] = {NULL, MPV_FORMAT_DOUBLE, on_frame_art_position, TRUE},
+};
+
+int observe_properties(mpv_handle *mpv)
+{
+    for (int id = 0; id < PROPERTY_COUNT; id++)
     {
-        char *status = *(char **)data;
-        if (g_strcmp0(status, "no") != 0)
+        int res;
+
+        if (!properties[id].name)
         {
-            ud->loop_status = LOOP_PLAYLIST;
+            continue;
         }
-        else
+        res = mpv_observe_property(mpv, id, properties[id].name, properties[id].format);
+        if (res < 0)
         {
-            char *file_status;
-            mpv_get_property(ud->mpv, "loop-file", MPV_FORMAT_STRING, &file_status);
-            if (g_strcmp0(file_status, "no") != 0)
-            {
-                ud->loop_status = LOOP_TRACK;
-            }
-            else
-            {
-                ud->loop_status = LOOP_NONE;
-            }
-            mpv_free(file_status);
+            return res;
         }
-        prop_name = "LoopStatus";
-        prop_value = g_variant_new_string(ud->loop_status);
     }
-    else if (g_strcmp0(name, "shuffle") == 0)
+    return 0;
+}
+
+// For MPV_EVENT_PROPERTY_CHANGE and GET_PROPERTY_REPLY, data is NULL
+// when the property has no value
+static void handle_property_change(UserData *ud, guint64 id, void *data)
+{
+    if (id >= PROPERTY_COUNT || !properties[id].handler)
     {
-        int shuffle = *(int *)data;
-        ud->shuffle = shuffle;
-        prop_name = "Shuffle";
-        prop_value = g_variant_new_boolean(shuffle);
+        return;
     }
-    else if (g_strcmp0(name, "fullscreen") == 0)
+    MPRIS_TRACE2(property_change, id, properties[id].name);
+    if (data || properties[id].when_unavailable)
     {
-        gboolean *status = data;
-        prop_name = "Fullscreen";
-        prop_value = g_variant_new_boolean(*status);
+        properties[id].handler(ud, data);
     }
+}
 
-    if (prop_name)
+// Changes arriving this long after FILE_LOADED, usually tags parsed late,
+// are folded into a single update
+#define METADATA_SETTLE_MS 500
+
+static void rebuild_metadata(UserData *ud)
+{
+    gint64 start = histograms_start(ud->histograms);
+    GVariant *metadata = create_metadata(ud);
+
+    histograms_record_since(ud->histograms, HISTOGRAM_METADATA, start);
+    ud->metadata_dirty = FALSE;
+    ud->metadata_rebuilds++;
+    publish_delta(ud, "Metadata", metadata);
+    if (ud->debug)
     {
-        if (prop_value)
-        {
-            g_variant_ref(prop_value);
-        }
-        g_hash_table_insert(ud->changed_properties,
-                            (gpointer)prop_name, prop_value);
+        publish_delta(ud, "MetadataRebuilds", g_variant_new_uint64(ud->metadata_rebuilds));
+    }
+}
+
+static gboolean metadata_settled(gpointer data)
+{
+    UserData *ud = data;
+
+    ud->metadata_settle = NULL;
+    if (ud->metadata_dirty)
+    {
+        rebuild_metadata(ud);
+        push_deltas(ud);
     }
+    return G_SOURCE_REMOVE;
 }
 
-gboolean event_handler(int fd, G_GNUC_UNUSED GIOCondition condition, gpointer data)
+static void cancel_metadata_settle(UserData *ud)
+{
+    if (ud->metadata_settle)
+    {
+        g_source_destroy(ud->metadata_settle);
+        ud->metadata_settle = NULL;
+    }
+}
+
+// Called after every batch of events. While a file loads its properties
+// only mark Metadata dirty, FILE_LOADED rebuilds it once and whatever
+// changes during the settle time makes one more update.
+static void update_metadata(UserData *ud)
+{
+    if (!ud->metadata_dirty || ud->file_loading || ud->metadata_settle)
+    {
+        return;
+    }
+
+    rebuild_metadata(ud);
+    if (ud->file_loaded)
+    {
+        ud->file_loaded = FALSE;
+        ud->metadata_settle = g_timeout_source_new(METADATA_SETTLE_MS);
+        g_source_set_callback(ud->metadata_settle, metadata_settled, ud, NULL);
+        g_source_attach(ud->metadata_settle, ud->context);
+        g_source_unref(ud->metadata_settle);
+    }
+}
+
+// Art found after Metadata was built. A load or settle in progress
+// rebuilds Metadata anyway.
+static void replace_art_url(UserData *ud, const char *art_url)
+{
+    g_free(ud->cached_art_url);
+    ud->cached_art_url = g_strdup(art_url);
+    ud->metadata_dirty = TRUE;
+    if (!ud->file_loading && !ud->metadata_settle)
+    {
+        rebuild_metadata(ud);
+        push_deltas(ud);
+    }
+}
+
+// A remote thumbnail was stored in the art cache, the local copy replaces
+// it
+void art_fetched(const char *url, const char *art_url, gpointer data)
 {
     UserData *ud = data;
-    gboolean has_event = TRUE;
 
-    // Discard data in pipe
-    char unused[16];
-    while (read(fd, unused, sizeof(unused)) > 0)
-        ;
+    // The track may have changed while it was fetched
+    if (!ud->remote_art_url || strcmp(url, ud->remote_art_url) != 0 ||
+        g_strcmp0(art_url, ud->cached_art_url) == 0)
+    {
+        return;
+    }
+    replace_art_url(ud, art_url);
+}
+
+// Embedded art of key was written to the cache. It comes before any other
+// art, which is only there because it was not written yet.
+void art_written(const char *key, const char *art_url, gpointer data)
+{
+    UserData *ud = data;
 
-    while (has_event)
+    if (g_strcmp0(key, ud->cached_art_source) != 0 ||
+        g_strcmp0(art_url, ud->cached_art_url) == 0)
+    {
+        return;
+    }
+    if (ud->frame_art)
+    {
+        frame_art_reset(ud->frame_art);
+    }
+    g_free(ud->remote_art_url);
+    ud->remote_art_url = NULL;
+    replace_art_url(ud, art_url);
+}
+
+// A frame of the current track was stored, frame_art only reports the
+// current one
+void frame_art_stored(G_GNUC_UNUSED const char *media, const char *art_url, gpointer data)
+{
+    UserData *ud = data;
+
+    if (!ud->cached_art_url)
+    {
+        replace_art_url(ud, art_url);
+    }
+}
+
+#define EVENT_BATCH_SIZE 64
+
+// An mpv event copied out of mpv_wait_event(), whose data only lives
+// until the next call
+typedef struct BatchedEvent {
+    mpv_event_id event_id; // MPV_EVENT_NONE once a later value replaced it
+    guint64 reply_userdata;
+    int error;
+    mpv_format format; // of the property value, MPV_FORMAT_NONE without one
+    union {
+        int flag;
+        int64_t int64;
+        double number;
+        char *string;
+        GHashTable *tags; // MPV_FORMAT_NODE, only observed for metadata
+    } value;
+} BatchedEvent;
+
+// Events are drained first and applied afterwards. Property values are
+// idempotent, so only the latest one per property id is kept, in the
+// place it arrived. Everything else keeps its order.
+typedef struct EventBatch {
+    BatchedEvent events[EVENT_BATCH_SIZE];
+    guint length;
+    int latest[PROPERTY_COUNT]; // index in events + 1, 0 if none
+} EventBatch;
+
+static void batched_event_clear(BatchedEvent *batched)
+{
+    if (batched->format == MPV_FORMAT_STRING)
+    {
+        g_free(batched->value.string);
+    }
+    else if (batched->format == MPV_FORMAT_NODE && batched->value.tags)
+    {
+        g_hash_table_unref(batched->value.tags);
+    }
+    batched->event_id = MPV_EVENT_NONE;
+    batched->format = MPV_FORMAT_NONE;
+}
+
+static void copy_property_value(BatchedEvent *batched, mpv_event_property *prop)
+{
+    batched->format = prop->format;
+    switch (prop->format)
+    {
+    case MPV_FORMAT_FLAG:
+        batched->value.flag = *(int *)prop->data;
+        break;
+    case MPV_FORMAT_INT64:
+        batched->value.int64 = *(int64_t *)prop->data;
+        break;
+    case MPV_FORMAT_DOUBLE:
+        batched->value.number = *(double *)prop->data;
+        break;
+    case MPV_FORMAT_STRING:
+        batched->value.string = g_strdup(*(char **)prop->data);
+        break;
+    case MPV_FORMAT_NODE:
+        batched->value.tags = metadata_tags_new(prop->data);
+        break;
+    default:
+        batched->format = MPV_FORMAT_NONE;
+        break;
+    }
+}
+
+// Returns FALSE once mpv has no more events, TRUE when the batch is full
+static gboolean drain_events(UserData *ud, EventBatch *batch)
+{
+    while (batch->length < EVENT_BATCH_SIZE)
     {
         mpv_event *event = mpv_wait_event(ud->mpv, 0);
-        switch (event->event_id)
+        BatchedEvent *batched;
+
+        if (event->event_id == MPV_EVENT_NONE)
         {
-        case MPV_EVENT_NONE:
-            has_event = FALSE;
-            break;
-        case MPV_EVENT_SHUTDOWN:
-            set_stopped_status(ud);
-            g_main_loop_quit(ud->loop);
-            break;
-        case MPV_EVENT_PROPERTY_CHANGE:
+            return FALSE;
+        }
+
+        // Its result only lives until the next mpv_wait_event()
+        if (event->event_id == MPV_EVENT_COMMAND_REPLY &&
+            (event->reply_userdata & FRAME_ART_REPLY_BIT))
         {
-            mpv_event_property *prop_event = (mpv_event_property *)event->data;
-            handle_property_change(prop_event->name, prop_event->data, ud);
+            if (ud->frame_art)
+            {
+                frame_art_reply(ud->frame_art, event->reply_userdata, event->error,
+                                event->data);
+            }
+            continue;
         }
-        break;
-        case MPV_EVENT_SEEK:
-            ud->seek_expected = TRUE;
-            break;
-        case MPV_EVENT_PLAYBACK_RESTART:
+
+        batched = &batch->events[batch->length++];
+        batched->event_id = event->event_id;
+        batched->reply_userdata = event->reply_userdata;
+        batched->error = event->error;
+        batched->format = MPV_FORMAT_NONE;
+
+        if ((event->event_id == MPV_EVENT_PROPERTY_CHANGE ||
+             event->event_id == MPV_EVENT_GET_PROPERTY_REPLY) &&
+            event->reply_userdata < PROPERTY_COUNT)
         {
-            if (ud->seek_expected)
+            int *latest = &batch->latest[event->reply_userdata];
+
+            if (*latest)
             {
-                emit_seeked_signal(ud);
-                ud->seek_expected = FALSE;
+                batched_event_clear(&batch->events[*latest - 1]);
             }
+            *latest = batch->length;
+            copy_property_value(batched, event->data);
+        }
+    }
+    return TRUE;
+}
+
+static void apply_event(UserData *ud, BatchedEvent *batched)
+{
+    switch (batched->event_id)
+    {
+    case MPV_EVENT_SHUTDOWN:
+        set_stopped_status(ud);
+        g_main_loop_quit(ud->loop);
+        break;
+    case MPV_EVENT_PROPERTY_CHANGE:
+    case MPV_EVENT_GET_PROPERTY_REPLY:
+        handle_property_change(ud, batched->reply_userdata,
+                               batched->format == MPV_FORMAT_NONE ? NULL : &batched->value);
+        break;
+    case MPV_EVENT_COMMAND_REPLY:
+    case MPV_EVENT_SET_PROPERTY_REPLY:
+        complete_request(ud, batched->reply_userdata, batched->error);
+        break;
+    case MPV_EVENT_START_FILE:
+    case MPV_EVENT_END_FILE:
+        // The next file, if any, brings its own Metadata
+        ud->file_loading = TRUE;
+        ud->file_loaded = FALSE;
+        cancel_metadata_settle(ud);
+        if (ud->frame_art)
+        {
+            frame_art_reset(ud->frame_art);
         }
         break;
-        default:
-            break;
+    case MPV_EVENT_FILE_LOADED:
+        ud->file_loading = FALSE;
+        ud->file_loaded = TRUE;
+        ud->metadata_dirty = TRUE;
+        break;
+    case MPV_EVENT_SEEK:
+        ud->seek_expected = TRUE;
+        break;
+    case MPV_EVENT_PLAYBACK_RESTART:
+        if (ud->seek_expected)
+        {
+            // Publishes Seeked and Position once the read completes
+            mpv_get_property_async(ud->mpv, PROPERTY_SEEK_POSITION, "time-pos",
+                                   MPV_FORMAT_DOUBLE);
+            ud->seek_expected = FALSE;
         }
+        else
+        {
+            publish_position(ud);
+        }
+        break;
+    default:
+        break;
     }
-
-    return TRUE;
 }
 
-void wakeup_handler(void *fd)
+gboolean event_handler(G_GNUC_UNUSED int fd, G_GNUC_UNUSED GIOCondition condition,
+                       gpointer data)
 {
-    (void)!write(*((int *)fd), "0", 1);
+    UserData *ud = data;
+    EventBatch batch;
+    gboolean more = TRUE;
+    guint events = 0;
+
+    MPRIS_TRACE(event_handler_entry);
+
+    // Re-arm the wakeup before draining, so that events queued meanwhile
+    // are either seen by this drain or signal the fd again
+    wakeup_drain(&ud->wakeup);
+
+    while (more)
+    {
+        batch.length = 0;
+        memset(batch.latest, 0, sizeof(batch.latest));
+        more = drain_events(ud, &batch);
+        events += batch.length;
+
+        for (guint i = 0; i < batch.length; i++)
+        {
+            apply_event(ud, &batch.events[i]);
+            batched_event_clear(&batch.events[i]);
+        }
+        update_metadata(ud);
+    }
+
+    // Hand everything collected during this drain to the D-Bus thread
+    push_deltas(ud);
+
+    MPRIS_TRACE1(event_handler_exit, events);
+    return TRUE;
 }
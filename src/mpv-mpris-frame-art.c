@@ -0,0 +1,552 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <string.h>
+
+#include "mpv-mpris-cache-writer.h"
+#include "mpv-mpris-frame-art.h"
+
+// Checks closer to the grab than this just grab
+#define GRAB_SLACK_US 50000
+
+struct FrameArt {
+    mpv_handle *mpv;
+    GMainContext *context;
+    gchar *cache_dir;
+    FrameArtOptions options;
+    FrameArtFunc func;
+    gpointer data;
+    GCancellable *cancellable; // cancelled by frame_art_free()
+    gchar *media;              // wanting a frame, NULL otherwise
+    GSource *timer;            // until the next check of the position
+    guint64 serial;            // of the last grab, in its reply_userdata
+    gboolean in_flight;
+    gboolean reading;          // time-pos, until frame_art_position()
+    guint64 read_serial;       // serial when it was read
+    gint64 last_grab; // monotonic
+};
+
+// A frame downscaled to packed RGB, to be encoded
+typedef struct FrameJob {
+    gchar *media;
+    gchar *file;
+    guint8 *rgb;
+    guint width;
+    guint height;
+} FrameJob;
+
+// The screenshot-raw result, pointing into the event data
+typedef struct RawFrame {
+    gint64 width;
+    gint64 height;
+    gint64 stride;
+    const char *format;
+    const guint8 *pixels;
+    gsize size;
+} RawFrame;
+
+static void frame_job_free(gpointer data)
+{
+    FrameJob *job = data;
+
+    g_free(job->media);
+    g_free(job->file);
+    g_free(job->rgb);
+    g_free(job);
+}
+
+static gchar *frame_file(FrameArt *frame_art, const char *media)
+{
+    gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256, media, -1);
+    gchar *name = g_strconcat("frame-", hash, ".png", NULL);
+    gchar *file = g_build_filename(frame_art->cache_dir, name, NULL);
+
+    g_free(name);
+    g_free(hash);
+    return file;
+}
+
+static guint32 png_crc(const guint8 *data, gsize length)
+{
+    guint32 crc = 0xffffffff;
+
+    for (gsize i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return crc ^ 0xffffffff;
+}
+
+static void put_be32(GByteArray *png, guint32 value)
+{
+    guint8 bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+
+    g_byte_array_append(png, bytes, sizeof(bytes));
+}
+
+static void put_chunk(GByteArray *png, const char *type, const guint8 *data, gsize length)
+{
+    guint start;
+
+    put_be32(png, length);
+    start = png->len;
+    g_byte_array_append(png, (const guint8 *)type, 4);
+    g_byte_array_append(png, data, length);
+    put_be32(png, png_crc(png->data + start, length + 4));
+}
+
+// zlib stream of data, as IDAT wants it
+static GByteArray *compress(const guint8 *data, gsize length, GError **error)
+{
+    GConverter *zlib =
+        G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1));
+    GByteArray *out = g_byte_array_new();
+    guint8 buffer[16384];
+    GConverterResult result;
+
+    do
+    {
+        gsize read = 0, written = 0;
+
+        result = g_converter_convert(zlib, data, length, buffer, sizeof(buffer),
+                                     G_CONVERTER_INPUT_AT_END, &read, &written, error);
+        if (result == G_CONVERTER_ERROR)
+        {
+            g_byte_array_unref(out);
+            out = NULL;
+            break;
+        }
+        g_byte_array_append(out, buffer, written);
+        data += read;
+        length -= read;
+    } while (result != G_CONVERTER_FINISHED);
+
+    g_object_unref(zlib);
+    return out;
+}
+
+// 8-bit RGB PNG, every row unfiltered
+static GByteArray *encode_png(const FrameJob *job, GError **error)
+{
+    static const guint8 signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    gsize row = (gsize)job->width * 3;
+    guint8 *raw = g_malloc((row + 1) * job->height);
+    guint8 header[13] = {0};
+    GByteArray *png, *idat;
+
+    for (guint y = 0; y < job->height; y++)
+    {
+        raw[y * (row + 1)] = 0;
+        memcpy(raw + y * (row + 1) + 1, job->rgb + y * row, row);
+    }
+    idat = compress(raw, (row + 1) * job->height, error);
+    g_free(raw);
+    if (!idat)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        header[i] = job->width >> (24 - 8 * i);
+        header[4 + i] = job->height >> (24 - 8 * i);
+    }
+    header[8] = 8; // bit depth
+    header[9] = 2; // truecolour
+
+    png = g_byte_array_new();
+    g_byte_array_append(png, signature, sizeof(signature));
+    put_chunk(png, "IHDR", header, sizeof(header));
+    put_chunk(png, "IDAT", idat->data, idat->len);
+    put_chunk(png, "IEND", NULL, 0);
+    g_byte_array_unref(idat);
+    return png;
+}
+
+static void encode_thread(GTask *task, G_GNUC_UNUSED gpointer source_object,
+                          gpointer task_data, G_GNUC_UNUSED GCancellable *cancellable)
+{
+    FrameJob *job = task_data;
+    GError *error = NULL;
+    GByteArray *png = encode_png(job, &error);
+    gchar *art_url = NULL;
+
+    if (png && cache_write_file(job->file, png->data, png->len, &error))
+    {
+        art_url = g_filename_to_uri(job->file, NULL, &error);
+    }
+    if (png)
+    {
+        g_byte_array_unref(png);
+    }
+
+    if (art_url)
+    {
+        g_task_return_pointer(task, art_url, g_free);
+    }
+    else
+    {
+        g_task_return_error(task, error);
+    }
+}
+
+static void on_encoded(G_GNUC_UNUSED GObject *source_object, GAsyncResult *result,
+                       gpointer data)
+{
+    FrameJob *job = g_task_get_task_data(G_TASK(result));
+    GError *error = NULL;
+    gchar *art_url = g_task_propagate_pointer(G_TASK(result), &error);
+    FrameArt *frame_art;
+
+    // Cancelled when frame_art is gone, which is then not touched
+    if (!art_url)
+    {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_debug("Failed to store the frame of %s: %s", job->media, error->message);
+        }
+        g_error_free(error);
+        return;
+    }
+
+    frame_art = data;
+    if (g_strcmp0(job->media, frame_art->media) == 0)
+    {
+        frame_art->func(job->media, art_url, frame_art->data);
+    }
+    g_free(art_url);
+}
+
+static gboolean raw_frame_from_node(const mpv_node *node, RawFrame *frame)
+{
+    mpv_node_list *list;
+
+    memset(frame, 0, sizeof(*frame));
+    if (node->format != MPV_FORMAT_NODE_MAP)
+    {
+        return FALSE;
+    }
+
+    list = node->u.list;
+    for (int i = 0; i < list->num; i++)
+    {
+        const char *key = list->keys[i];
+        const mpv_node *value = &list->values[i];
+
+        if (value->format == MPV_FORMAT_INT64)
+        {
+            if (strcmp(key, "w") == 0)
+            {
+                frame->width = value->u.int64;
+            }
+            else if (strcmp(key, "h") == 0)
+            {
+                frame->height = value->u.int64;
+            }
+            else if (strcmp(key, "stride") == 0)
+            {
+                frame->stride = value->u.int64;
+            }
+        }
+        else if (value->format == MPV_FORMAT_STRING && strcmp(key, "format") == 0)
+        {
+            frame->format = value->u.string;
+        }
+        else if (value->format == MPV_FORMAT_BYTE_ARRAY && strcmp(key, "data") == 0)
+        {
+            frame->pixels = value->u.ba->data;
+            frame->size = value->u.ba->size;
+        }
+    }
+
+    return frame->pixels && frame->format && frame->width > 0 && frame->height > 0 &&
+           frame->stride >= frame->width * 4 &&
+           (guint64)frame->stride * frame->height <= frame->size;
+}
+
+// Box filter down to max_size on the longer side, as packed RGB. Only the
+// 8-bit formats with 4 bytes per pixel are taken.
+static gboolean downscale(const RawFrame *frame, guint max_size, FrameJob *job)
+{
+    static const struct {
+        const char *format;
+        int red, green, blue;
+    } layouts[] = {
+        {"bgr0", 2, 1, 0},
+        {"bgra", 2, 1, 0},
+        {"rgb0", 0, 1, 2},
+        {"rgba", 0, 1, 2},
+    };
+    gint64 longer = MAX(frame->width, frame->height);
+    int layout = -1;
+    guint8 *out;
+
+    for (gsize i = 0; i < G_N_ELEMENTS(layouts); i++)
+    {
+        if (strcmp(frame->format, layouts[i].format) == 0)
+        {
+            layout = i;
+        }
+    }
+    if (layout < 0)
+    {
+        return FALSE;
+    }
+
+    job->width = longer > max_size ? MAX(1, frame->width * max_size / longer) : frame->width;
+    job->height = longer > max_size ? MAX(1, frame->height * max_size / longer) : frame->height;
+    job->rgb = out = g_malloc((gsize)job->width * job->height * 3);
+
+    for (guint y = 0; y < job->height; y++)
+    {
+        gint64 y0 = y * frame->height / job->height;
+        gint64 y1 = MAX(y0 + 1, (y + 1) * frame->height / job->height);
+
+        for (guint x = 0; x < job->width; x++)
+        {
+            gint64 x0 = x * frame->width / job->width;
+            gint64 x1 = MAX(x0 + 1, (x + 1) * frame->width / job->width);
+            guint64 red = 0, green = 0, blue = 0;
+            guint64 count = (x1 - x0) * (y1 - y0);
+
+            for (gint64 sy = y0; sy < y1; sy++)
+            {
+                const guint8 *pixel = frame->pixels + sy * frame->stride + x0 * 4;
+
+                for (gint64 sx = x0; sx < x1; sx++, pixel += 4)
+                {
+                    red += pixel[layouts[layout].red];
+                    green += pixel[layouts[layout].green];
+                    blue += pixel[layouts[layout].blue];
+                }
+            }
+            *out++ = red / count;
+            *out++ = green / count;
+            *out++ = blue / count;
+        }
+    }
+    return TRUE;
+}
+
+static void schedule_check(FrameArt *frame_art, gint64 delay_us);
+
+static void grab(FrameArt *frame_art)
+{
+    const char *args[] = {"screenshot-raw", "video", NULL};
+    int res;
+
+    frame_art->serial++;
+    frame_art->last_grab = g_get_monotonic_time();
+    res = mpv_command_async(frame_art->mpv, FRAME_ART_REPLY_BIT | frame_art->serial, args);
+    frame_art->in_flight = res >= 0;
+    if (res < 0)
+    {
+        g_debug("screenshot-raw failed: %s", mpv_error_string(res));
+    }
+}
+
+// time-pos is read async, frame_art_position() goes on with it
+static void read_position(FrameArt *frame_art)
+{
+    int res = mpv_get_property_async(frame_art->mpv, frame_art->options.position_reply,
+                                     "time-pos", MPV_FORMAT_DOUBLE);
+
+    frame_art->reading = res >= 0;
+    frame_art->read_serial = frame_art->serial;
+    if (res < 0)
+    {
+        g_debug("Reading time-pos failed: %s", mpv_error_string(res));
+        schedule_check(frame_art, frame_art->options.interval_us);
+    }
+}
+
+static gboolean check_position(gpointer data)
+{
+    FrameArt *frame_art = data;
+
+    frame_art->timer = NULL;
+    // A read of an earlier track is still out, its reply reads again
+    if (!frame_art->reading)
+    {
+        read_position(frame_art);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_check(FrameArt *frame_art, gint64 delay_us)
+{
+    frame_art->timer = g_timeout_source_new(delay_us / 1000);
+    g_source_set_callback(frame_art->timer, check_position, frame_art, NULL);
+    g_source_attach(frame_art->timer, frame_art->context);
+    g_source_unref(frame_art->timer);
+}
+
+FrameArt *frame_art_new(mpv_handle *mpv, const char *cache_dir,
+                        const FrameArtOptions *options, FrameArtFunc func,
+                        gpointer data)
+{
+    FrameArt *frame_art = g_new0(FrameArt, 1);
+
+    frame_art->mpv = mpv;
+    frame_art->context = g_main_context_ref_thread_default();
+    frame_art->cache_dir = g_strdup(cache_dir);
+    frame_art->options = *options;
+    frame_art->options.max_size = MAX(frame_art->options.max_size, 1);
+    frame_art->func = func;
+    frame_art->data = data;
+    frame_art->cancellable = g_cancellable_new();
+    return frame_art;
+}
+
+void frame_art_free(FrameArt *frame_art)
+{
+    frame_art_reset(frame_art);
+    g_cancellable_cancel(frame_art->cancellable);
+    g_object_unref(frame_art->cancellable);
+    g_main_context_unref(frame_art->context);
+    g_free(frame_art->cache_dir);
+    g_free(frame_art);
+}
+
+gchar *frame_art_want(FrameArt *frame_art, const char *media)
+{
+    gchar *file;
+    gchar *art_url = NULL;
+
+    if (g_strcmp0(media, frame_art->media) == 0)
+    {
+        return NULL;
+    }
+
+    frame_art_reset(frame_art);
+    file = frame_file(frame_art, media);
+    if (g_file_test(file, G_FILE_TEST_IS_REGULAR))
+    {
+        art_url = g_filename_to_uri(file, NULL, NULL);
+    }
+    else
+    {
+        frame_art->media = g_strdup(media);
+        schedule_check(frame_art, 0);
+    }
+    g_free(file);
+    return art_url;
+}
+
+void frame_art_reset(FrameArt *frame_art)
+{
+    if (frame_art->timer)
+    {
+        g_source_destroy(frame_art->timer);
+        frame_art->timer = NULL;
+    }
+    if (frame_art->in_flight)
+    {
+        // Its reply, aborted or not, no longer matches the serial
+        mpv_abort_async_command(frame_art->mpv, FRAME_ART_REPLY_BIT | frame_art->serial);
+        frame_art->in_flight = FALSE;
+    }
+    frame_art->serial++;
+    g_free(frame_art->media);
+    frame_art->media = NULL;
+}
+
+void frame_art_position(FrameArt *frame_art, gint64 position_us, gint64 duration_us)
+{
+    gint64 target = frame_art->options.offset_us;
+    gint64 wait;
+
+    frame_art->reading = FALSE;
+    if (!frame_art->media || frame_art->timer || frame_art->in_flight)
+    {
+        return;
+    }
+    if (frame_art->read_serial != frame_art->serial)
+    {
+        // Read before the track changed
+        read_position(frame_art);
+        return;
+    }
+
+    if (duration_us > 0)
+    {
+        target = MIN(target, duration_us / 3);
+    }
+    wait = target - position_us;
+    if (frame_art->last_grab)
+    {
+        wait = MAX(wait, frame_art->last_grab + frame_art->options.interval_us -
+                             g_get_monotonic_time());
+    }
+
+    if (wait > GRAB_SLACK_US)
+    {
+        schedule_check(frame_art, wait);
+    }
+    else
+    {
+        grab(frame_art);
+    }
+}
+
+void frame_art_reply(FrameArt *frame_art, guint64 reply_userdata, int error,
+                     const mpv_event_command *command)
+{
+    FrameJob *job;
+    RawFrame frame;
+    GTask *task;
+
+    if (!frame_art->in_flight || reply_userdata != (FRAME_ART_REPLY_BIT | frame_art->serial))
+    {
+        return;
+    }
+    frame_art->in_flight = FALSE;
+
+    // Audio without video, or nothing decoded yet: no frame for this track
+    if (error < 0 || !command || !raw_frame_from_node(&command->result, &frame))
+    {
+        g_debug("No frame for %s: %s", frame_art->media,
+                error < 0 ? mpv_error_string(error) : "unexpected screenshot-raw result");
+        return;
+    }
+
+    job = g_new0(FrameJob, 1);
+    if (!downscale(&frame, frame_art->options.max_size, job))
+    {
+        g_debug("No frame for %s: format %s", frame_art->media, frame.format);
+        frame_job_free(job);
+        return;
+    }
+    job->media = g_strdup(frame_art->media);
+    job->file = frame_file(frame_art, frame_art->media);
+
+    task = g_task_new(NULL, frame_art->cancellable, on_encoded, frame_art);
+    g_task_set_task_data(task, job, frame_job_free);
+    g_task_run_in_thread(task, encode_thread);
+    g_object_unref(task);
+}
@@ -74,6 +74,7 @@ const char art_files[][32] = {
     "capa.jpg", "capa.png", // Portuguese
     "pochette.jpg", "pochette.png", // French
 };
+const size_t art_files_count = G_N_ELEMENTS(art_files);
 
 const char *STATUS_PLAYING = "Playing";
 const char *STATUS_PAUSED = "Paused";
@@ -86,73 +87,34 @@ const char *youtube_url_pattern =
 
 GRegex *youtube_url_regex;
 
+// Status changes go out right away, Volume and Rate are throttled since
+// fades and scripted speed changes can produce long bursts of updates.
+const EmitPolicy default_emit_policies[EMIT_POLICY_COUNT] = {
+    {"PlaybackStatus", "org.mpris.MediaPlayer2.Player", 0, 0},
+    {"LoopStatus", "org.mpris.MediaPlayer2.Player", 50000, 0},
+    {"Shuffle", "org.mpris.MediaPlayer2.Player", 50000, 0},
+    {"Metadata", "org.mpris.MediaPlayer2.Player", 100000, 0},
+    {"Volume", "org.mpris.MediaPlayer2.Player", 50000, 200000},
+    {"Rate", "org.mpris.MediaPlayer2.Player", 50000, 200000},
+    {"Fullscreen", "org.mpris.MediaPlayer2", 50000, 0},
+    {"CanSetFullscreen", "org.mpris.MediaPlayer2", 50000, 0},
+};
+
+// No get_property nor set_property: GDBus then routes the Properties
+// calls to method_call. Get and GetAll are answered from the property
+// caches, Set once mpv has acknowledged the change.
 GDBusInterfaceVTable vtable_root = {
-    method_call_root, get_property_root, set_property_root, {0}};
+    method_call_root, NULL, NULL, {0}};
 
 GDBusInterfaceVTable vtable_player = {
-    method_call_player, get_property_player, set_property_player, {0}};
+    method_call_player, NULL, NULL, {0}};
+
+GDBusInterfaceVTable vtable_queue = {
+    method_call_queue, NULL, NULL, {0}};
 
+GDBusInterfaceVTable vtable_debug = {
+    method_call_debug, NULL, NULL, {0}};
 
-const char *introspection_xml =
-    "<node>\n"
-    "  <interface name=\"org.mpris.MediaPlayer2\">\n"
-    "    <method name=\"Raise\">\n"
-    "    </method>\n"
-    "    <method name=\"Quit\">\n"
-    "    </method>\n"
-    "    <property name=\"CanQuit\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"Fullscreen\" type=\"b\" access=\"readwrite\"/>\n"
-    "    <property name=\"CanSetFullscreen\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"CanRaise\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"HasTrackList\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"Identity\" type=\"s\" access=\"read\"/>\n"
-    "    <property name=\"DesktopEntry\" type=\"s\" access=\"read\"/>\n"
-    "    <property name=\"SupportedUriSchemes\" type=\"as\" access=\"read\"/>\n"
-    "    <property name=\"SupportedMimeTypes\" type=\"as\" access=\"read\"/>\n"
-    "  </interface>\n"
-    "  <interface name=\"org.mpris.MediaPlayer2.Player\">\n"
-    "    <method name=\"Next\">\n"
-    "    </method>\n"
-    "    <method name=\"Previous\">\n"
-    "    </method>\n"
-    "    <method name=\"Pause\">\n"
-    "    </method>\n"
-    "    <method name=\"PlayPause\">\n"
-    "    </method>\n"
-    "    <method name=\"Stop\">\n"
-    "    </method>\n"
-    "    <method name=\"Play\">\n"
-    "    </method>\n"
-    "    <method name=\"Seek\">\n"
-    "      <arg type=\"x\" name=\"Offset\" direction=\"in\"/>\n"
-    "    </method>\n"
-    "    <method name=\"SetPosition\">\n"
-    "      <arg type=\"o\" name=\"TrackId\" direction=\"in\"/>\n"
-    "      <arg type=\"x\" name=\"Offset\" direction=\"in\"/>\n"
-    "    </method>\n"
-    "    <method name=\"OpenUri\">\n"
-    "      <arg type=\"s\" name=\"Uri\" direction=\"in\"/>\n"
-    "    </method>\n"
-    "    <signal name=\"Seeked\">\n"
-    "      <arg type=\"x\" name=\"Position\" direction=\"out\"/>\n"
-    "    </signal>\n"
-    "    <property name=\"PlaybackStatus\" type=\"s\" access=\"read\"/>\n"
-    "    <property name=\"LoopStatus\" type=\"s\" access=\"readwrite\"/>\n"
-    "    <property name=\"Rate\" type=\"d\" access=\"readwrite\"/>\n"
-    "    <property name=\"Shuffle\" type=\"b\" access=\"readwrite\"/>\n"
-    "    <property name=\"Metadata\" type=\"a{sv}\" access=\"read\"/>\n"
-    "    <property name=\"Volume\" type=\"d\" access=\"readwrite\"/>\n"
-    "    <property name=\"Position\" type=\"x\" access=\"read\"/>\n"
-    "    <property name=\"MinimumRate\" type=\"d\" access=\"read\"/>\n"
-    "    <property name=\"MaximumRate\" type=\"d\" access=\"read\"/>\n"
-    "    <property name=\"CanGoNext\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"CanGoPrevious\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"CanPlay\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"CanPause\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"CanSeek\" type=\"b\" access=\"read\"/>\n"
-    "    <property name=\"CanControl\" type=\"b\" access=\"read\"/>\n"
-    "  </interface>\n"
-    "</node>\n";
 
 const char* supported_extensions[] = {
     // Common formats
@@ -194,3 +156,4 @@ const char* supported_extensions[] = {
     ".flif",                  // Free Lossless Image Format
     ".qoi",                   // Quite OK Image format
 };
+const size_t supported_extensions_count = G_N_ELEMENTS(supported_extensions);
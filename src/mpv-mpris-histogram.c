@@ -0,0 +1,233 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// clock_gettime() is POSIX, not part of -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+
+#include "mpv-mpris-histogram.h"
+
+const char *const histogram_names[HISTOGRAM_COUNT] = {
+    [HISTOGRAM_EVENT_TO_SIGNAL] = "event-to-signal",
+    [HISTOGRAM_METADATA] = "create-metadata",
+    [HISTOGRAM_ART_EMBEDDED] = "art-embedded",
+    [HISTOGRAM_ART_LOCAL] = "art-local",
+    [HISTOGRAM_ART_YOUTUBE] = "art-youtube",
+    [HISTOGRAM_LOOP_MPV] = "loop-mpv",
+    [HISTOGRAM_LOOP_DBUS] = "loop-dbus",
+};
+
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+gint64 histogram_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static int highest_bit(guint64 value)
+{
+    int bit = 0;
+
+    for (int step = 32; step > 0; step /= 2)
+    {
+        if (value >> step)
+        {
+            value >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+static int bucket_of(gint64 value)
+{
+    int shift;
+
+    if (value < SUB_BUCKETS)
+    {
+        return value < 0 ? 0 : (int)value;
+    }
+
+    shift = highest_bit(value) - HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << HISTOGRAM_SUB_BITS) + (int)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+// Largest value that lands in bucket
+static gint64 bucket_upper(int bucket)
+{
+    int shift;
+
+    if (bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    return ((gint64)(SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << shift) +
+           ((G_GINT64_CONSTANT(1) << shift) - 1);
+}
+
+void histogram_record(MprisHistogram *histogram, gint64 value_ns)
+{
+    g_atomic_int_inc(&histogram->counts[bucket_of(value_ns)]);
+}
+
+void histogram_reset(MprisHistogram *histogram)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        g_atomic_int_set(&histogram->counts[i], 0);
+    }
+}
+
+static guint64 load_counts(const MprisHistogram *histogram, guint counts[HISTOGRAM_BUCKETS])
+{
+    guint64 total = 0;
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        counts[i] = g_atomic_int_get(&histogram->counts[i]);
+        total += counts[i];
+    }
+    return total;
+}
+
+static gint64 percentile_of(const guint counts[HISTOGRAM_BUCKETS], guint64 total,
+                            double percentile)
+{
+    guint64 rank = (guint64)(total * percentile / 100.0 + 0.5);
+    guint64 seen = 0;
+
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return bucket_upper(i);
+        }
+    }
+    return 0;
+}
+
+// Upper bound of the bucket holding the given percentile, 0 when empty
+gint64 histogram_percentile(const MprisHistogram *histogram, double percentile)
+{
+    guint counts[HISTOGRAM_BUCKETS];
+    guint64 total = load_counts(histogram, counts);
+
+    return total ? percentile_of(counts, total, percentile) : 0;
+}
+
+// "a{sv}" with count, p50, p90, p99, p999 and max, plus the non-empty
+// buckets as (upper bound, count) pairs
+GVariant *histogram_snapshot(const MprisHistogram *histogram)
+{
+    guint counts[HISTOGRAM_BUCKETS];
+    guint64 total = load_counts(histogram, counts);
+    GVariantBuilder builder, buckets;
+    gint64 max = 0;
+
+    g_variant_builder_init(&buckets, G_VARIANT_TYPE("a(tt)"));
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        if (counts[i])
+        {
+            max = bucket_upper(i);
+            g_variant_builder_add(&buckets, "(tt)", (guint64)max, (guint64)counts[i]);
+        }
+    }
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&builder, "{sv}", "count", g_variant_new_uint64(total));
+    if (total)
+    {
+        g_variant_builder_add(&builder, "{sv}", "p50",
+                              g_variant_new_uint64(percentile_of(counts, total, 50)));
+        g_variant_builder_add(&builder, "{sv}", "p90",
+                              g_variant_new_uint64(percentile_of(counts, total, 90)));
+        g_variant_builder_add(&builder, "{sv}", "p99",
+                              g_variant_new_uint64(percentile_of(counts, total, 99)));
+        g_variant_builder_add(&builder, "{sv}", "p999",
+                              g_variant_new_uint64(percentile_of(counts, total, 99.9)));
+        g_variant_builder_add(&builder, "{sv}", "max", g_variant_new_uint64(max));
+    }
+    g_variant_builder_add(&builder, "{sv}", "buckets", g_variant_builder_end(&buckets));
+    return g_variant_builder_end(&builder);
+}
+
+gint64 histograms_start(MprisHistogram *set)
+{
+    return set ? histogram_now_ns() : 0;
+}
+
+void histograms_record_since(MprisHistogram *set, MprisHistogramId id, gint64 start)
+{
+    if (set && start)
+    {
+        histogram_record(&set[id], histogram_now_ns() - start);
+    }
+}
+
+// Loop timing is per thread, poll functions get no user data
+typedef struct LoopTiming {
+    MprisHistogram *histogram;
+    gint64 woken; // when the last poll returned
+} LoopTiming;
+
+static GPrivate loop_timing = G_PRIVATE_INIT(g_free);
+
+static gint timed_poll(GPollFD *fds, guint nfds, gint timeout)
+{
+    LoopTiming *timing = g_private_get(&loop_timing);
+    gint ret;
+
+    if (timing && timing->woken)
+    {
+        histogram_record(timing->histogram, histogram_now_ns() - timing->woken);
+    }
+    ret = g_poll(fds, nfds, timeout);
+    if (timing)
+    {
+        timing->woken = histogram_now_ns();
+    }
+    return ret;
+}
+
+void histogram_time_loop(GMainContext *context, MprisHistogram *histogram)
+{
+    LoopTiming *timing = g_new0(LoopTiming, 1);
+
+    timing->histogram = histogram;
+    g_private_replace(&loop_timing, timing);
+    g_main_context_set_poll_func(context, timed_poll);
+}
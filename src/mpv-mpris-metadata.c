@@ -23,8 +23,14 @@
 */
 
 #include "mpv-mpris-types.h"
+#include "mpv-mpris-alloc.h"
+#include "mpv-mpris-art-fetch.h"
 #include "mpv-mpris-metadata.h"
 #include "mpv-mpris-artwork.h"
+#include "mpv-mpris-events.h"
+#include "mpv-mpris-frame-art.h"
+#include "mpv-mpris-trace.h"
+#include "mpv-mpris-wire.h"
 
 gchar *string_to_utf8(gchar *maybe_utf8)
 {
@@ -42,20 +48,17 @@ gchar *string_to_utf8(gchar *maybe_utf8)
     }
 }
 
-gchar *path_to_uri(mpv_handle *mpv, char *path)
+gchar *path_to_uri(const char *working_dir, const char *path)
 {
     #if GLIB_CHECK_VERSION(2, 58, 0)
         // version which uses g_canonicalize_filename which expands .. and .
         // and makes the uris neater
-        char *working_dir;
         gchar *canonical;
         gchar *uri;
 
-        working_dir = mpv_get_property_string(mpv, "working-directory");
         canonical = g_canonicalize_filename(path, working_dir);
         uri = g_filename_to_uri(canonical, NULL, NULL);
 
-        mpv_free(working_dir);
         g_free(canonical);
 
         return uri;
@@ -68,14 +71,11 @@ gchar *path_to_uri(mpv_handle *mpv, char *path)
         }
         else
         {
-            char *working_dir;
             gchar *absolute;
 
-            working_dir = mpv_get_property_string(mpv, "working-directory");
             absolute = g_build_filename(working_dir, path, NULL);
             converted = g_filename_to_uri(absolute, NULL, NULL);
 
-            mpv_free(working_dir);
             g_free(absolute);
         }
 
@@ -83,39 +83,88 @@ gchar *path_to_uri(mpv_handle *mpv, char *path)
     #endif
 }
 
-void add_metadata_item_string(mpv_handle *mpv, GVariantDict *dict,
-                                     const char *property, const char *tag)
+// Tag keys are matched ignoring case, like mpv's metadata/by-key
+static guint tag_hash(gconstpointer key)
 {
-    char *temp = mpv_get_property_string(mpv, property);
-    if (temp)
+    guint hash = 5381;
+
+    for (const char *p = key; *p; p++)
+    {
+        hash = hash * 33 + g_ascii_tolower(*p);
+    }
+    return hash;
+}
+
+static gboolean tag_equal(gconstpointer a, gconstpointer b)
+{
+    return g_ascii_strcasecmp(a, b) == 0;
+}
+
+GHashTable *metadata_tags_new(const mpv_node *node)
+{
+    GHashTable *tags = g_hash_table_new_full(tag_hash, tag_equal, g_free, g_free);
+
+    if (node && node->format == MPV_FORMAT_NODE_MAP)
+    {
+        for (int i = 0; i < node->u.list->num; i++)
+        {
+            const mpv_node *value = &node->u.list->values[i];
+
+            if (value->format == MPV_FORMAT_STRING)
+            {
+                g_hash_table_replace(tags, g_strdup(node->u.list->keys[i]),
+                                     g_strdup(value->u.string));
+            }
+        }
+    }
+    return tags;
+}
+
+static const char *lookup_tag(GHashTable *tags, const char *key)
+{
+    return tags ? g_hash_table_lookup(tags, key) : NULL;
+}
+
+void add_metadata_item_string(GHashTable *tags, GVariantDict *dict,
+                              const char *key, const char *tag)
+{
+    const char *value = lookup_tag(tags, key);
+    if (value)
     {
-        char *utf8 = string_to_utf8(temp);
+        char *utf8 = string_to_utf8((gchar *)value);
         g_variant_dict_insert(dict, tag, "s", utf8);
         g_free(utf8);
-        mpv_free(temp);
     }
 }
 
-void add_metadata_item_int(mpv_handle *mpv, GVariantDict *dict,
-                                  const char *property, const char *tag)
+// Only tags holding nothing but a number, as mpv would convert them
+void add_metadata_item_int(GHashTable *tags, GVariantDict *dict,
+                           const char *key, const char *tag)
 {
-    int64_t value;
-    int res = mpv_get_property(mpv, property, MPV_FORMAT_INT64, &value);
-    if (res >= 0)
+    const char *value = lookup_tag(tags, key);
+    char *end;
+    int64_t number;
+
+    if (!value)
+    {
+        return;
+    }
+    number = g_ascii_strtoll(value, &end, 10);
+    if (end != value && !*end)
     {
-        g_variant_dict_insert(dict, tag, "x", value);
+        g_variant_dict_insert(dict, tag, "x", number);
     }
 }
 
-void add_metadata_item_string_list(mpv_handle *mpv, GVariantDict *dict,
-                                          const char *property, const char *tag)
+void add_metadata_item_string_list(GHashTable *tags, GVariantDict *dict,
+                                   const char *key, const char *tag)
 {
-    char *temp = mpv_get_property_string(mpv, property);
+    const char *value = lookup_tag(tags, key);
 
-    if (temp)
+    if (value)
     {
         GVariantBuilder builder;
-        char **list = g_strsplit(temp, ", ", 0);
+        char **list = g_strsplit(value, ", ", 0);
         char **iter = list;
         g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
 
@@ -130,64 +179,113 @@ void add_metadata_item_string_list(mpv_handle *mpv, GVariantDict *dict,
         g_variant_dict_insert(dict, tag, "as", &builder);
 
         g_strfreev(list);
-        mpv_free(temp);
     }
 }
 
-void add_metadata_uri(mpv_handle *mpv, GVariantDict *dict)
+void add_metadata_uri(UserData *ud, GVariantDict *dict)
 {
-    char *path;
     char *uri;
 
-    path = mpv_get_property_string(mpv, "path");
-    if (!path)
+    if (!ud->path)
     {
         return;
     }
 
-    uri = g_uri_parse_scheme(path);
+    uri = g_uri_parse_scheme(ud->path);
     if (uri)
     {
-        g_variant_dict_insert(dict, "xesam:url", "s", path);
+        g_variant_dict_insert(dict, "xesam:url", "s", ud->path);
         g_free(uri);
     }
     else
     {
-        gchar *converted = path_to_uri(mpv, path);
+        gchar *converted = path_to_uri(ud->working_dir, ud->path);
         g_variant_dict_insert(dict, "xesam:url", "s", converted);
         g_free(converted);
     }
+}
+
+// What art is looked up for: URLs as they are, files as absolute names
+static gchar *art_source(const char *working_dir, const char *path)
+{
+    if (strstr(path, "://") || g_path_is_absolute(path))
+    {
+        return g_strdup(path);
+    }
+
+    #if GLIB_CHECK_VERSION(2, 58, 0)
+        return g_canonicalize_filename(path, working_dir);
+    #else
+        return g_build_filename(working_dir, path, NULL);
+    #endif
+}
+
+// The art proxy is only set up once there is something to fetch
+static ArtFetcher *get_art_fetcher(UserData *ud)
+{
+    gchar *cache_dir;
+
+    if (ud->art_fetcher || !ud->art_proxy) {
+        return ud->art_fetcher;
+    }
 
-    mpv_free(path);
+    cache_dir = get_cache_dir();
+    if (cache_dir) {
+        ud->art_fetcher = art_fetcher_new(cache_dir, &ud->art_proxy_budget,
+                                          ud->art_proxy_max_age_s, art_fetched, ud);
+        g_free(cache_dir);
+    } else {
+        // Not tried again for every track
+        ud->art_proxy = FALSE;
+    }
+    return ud->art_fetcher;
 }
 
-void add_metadata_art(mpv_handle *mpv, GVariantDict *dict, UserData *ud)
+void add_metadata_art(GVariantDict *dict, UserData *ud)
 {
-    char *path = mpv_get_property_string(mpv, "path");
+    const char *path = ud->path;
 
     if (!path) {
         return;
     }
 
+    if (ud->use_broker) {
+        // The broker resolves art once for all instances
+        gchar *source = art_source(ud->working_dir, path);
+        g_variant_dict_insert(dict, WIRE_ART_SOURCE_KEY, "s", source);
+        g_free(source);
+        return;
+    }
+
     // Check cache using UserData instead of globals
     if (!ud->cached_path || strcmp(path, ud->cached_path)) {
+        gchar *source = art_source(ud->working_dir, path);
+
         // Clear old cache
-        mpv_free(ud->cached_path);
+        g_free(ud->cached_path);
         g_free(ud->cached_art_url);
+        g_free(ud->remote_art_url);
+        ud->remote_art_url = NULL;
+        g_free(ud->cached_art_source);
         
-        // Set new cache
-        ud->cached_path = path;
-
-        if (g_str_has_prefix(path, "http")) {
-            ud->cached_art_url = try_get_youtube_thumbnail(path);
-        } else {
-            ud->cached_art_url = try_get_embedded_art(path);
-            if (!ud->cached_art_url) {
-                ud->cached_art_url = try_get_local_art_enhanced(mpv, path);
-            }
+        // Set new cache, embedded art still being written comes from
+        // art_written()
+        ud->cached_path = g_strdup(path);
+        ud->cached_art_source = source;
+        ud->cached_art_url = find_art_url(source, ud->histograms, ud->cache_writer);
+        if (!ud->cached_art_url && ud->frame_art) {
+            // A frame of the video, once it has played far enough
+            ud->cached_art_url = frame_art_want(ud->frame_art, source);
+        }
+
+        // Remote art is served from the local copy once there is one,
+        // art_fetched() swaps it in when a fetch completes
+        if (art_fetcher_is_remote(ud->cached_art_url) && get_art_fetcher(ud)) {
+            gchar *local = art_fetcher_lookup(ud->art_fetcher, ud->cached_art_url);
+
+            ud->remote_art_url = ud->cached_art_url;
+            ud->cached_art_url = local ? local : g_strdup(ud->remote_art_url);
         }
-    } else {
-        mpv_free(path);
     }
 
     if (ud->cached_art_url) {
@@ -195,9 +293,9 @@ void add_metadata_art(mpv_handle *mpv, GVariantDict *dict, UserData *ud)
     }
 }
 
-void add_metadata_content_created(mpv_handle *mpv, GVariantDict *dict)
+void add_metadata_content_created(GHashTable *tags, GVariantDict *dict)
 {
-    char *date_str = mpv_get_property_string(mpv, "metadata/by-key/Date");
+    const char *date_str = lookup_tag(tags, "Date");
 
     if (!date_str)
     {
@@ -226,126 +324,82 @@ void add_metadata_content_created(mpv_handle *mpv, GVariantDict *dict)
     }
 
     g_date_free(date);
-    mpv_free(date_str);
 }
 
 GVariant *create_metadata(UserData *ud)
 {
     GVariantDict dict;
-    int64_t track;
-    double duration;
     char *temp_str;
-    int res;
+    GVariant *metadata;
+    MprisAllocScope previous_scope = alloc_scope_enter(ALLOC_SCOPE_METADATA);
 
+    MPRIS_TRACE1(metadata_begin, ud->playlist_pos);
     g_variant_dict_init(&dict, NULL);
 
     // mpris:trackid
-    mpv_get_property(ud->mpv, "playlist-pos", MPV_FORMAT_INT64, &track);
     // playlist-pos < 0 if there is no playlist or current track
-    if (track < 0)
+    if (ud->playlist_pos < 0)
     {
         temp_str = g_strdup("/noplaylist");
     }
     else
     {
-        temp_str = g_strdup_printf("/%" PRId64, track);
+        temp_str = g_strdup_printf("/%" PRId64, ud->playlist_pos);
     }
     g_variant_dict_insert(&dict, "mpris:trackid", "o", temp_str);
     g_free(temp_str);
 
     // mpris:length
-    res = mpv_get_property(ud->mpv, "duration", MPV_FORMAT_DOUBLE, &duration);
-    if (res == MPV_ERROR_SUCCESS)
+    if (ud->duration >= 0)
     {
-        g_variant_dict_insert(&dict, "mpris:length", "x", (int64_t)(duration * 1000000.0));
+        g_variant_dict_insert(&dict, "mpris:length", "x", (int64_t)(ud->duration * 1000000.0));
     }
 
     // initial value. Replaced with metadata value if available
-    add_metadata_item_string(ud->mpv, &dict, "media-title", "xesam:title");
+    if (ud->media_title)
+    {
+        temp_str = string_to_utf8(ud->media_title);
+        g_variant_dict_insert(&dict, "xesam:title", "s", temp_str);
+        g_free(temp_str);
+    }
 
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/Title", "xesam:title");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/Album", "xesam:album");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/Genre", "xesam:genre");
+    add_metadata_item_string(ud->tags, &dict, "Title", "xesam:title");
+    add_metadata_item_string(ud->tags, &dict, "Album", "xesam:album");
+    add_metadata_item_string(ud->tags, &dict, "Genre", "xesam:genre");
 
     /* Musicbrainz metadata mappings
        (https://picard-docs.musicbrainz.org/en/appendices/tag_mapping.html) */
 
     // IDv3 metadata format
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MusicBrainz Artist Id", "mb:artistId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MusicBrainz Track Id", "mb:trackId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MusicBrainz Album Artist Id", "mb:albumArtistId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MusicBrainz Album Id", "mb:albumId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MusicBrainz Release Track Id", "mb:releaseTrackId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MusicBrainz Work Id", "mb:workId");
+    add_metadata_item_string(ud->tags, &dict, "MusicBrainz Artist Id", "mb:artistId");
+    add_metadata_item_string(ud->tags, &dict, "MusicBrainz Track Id", "mb:trackId");
+    add_metadata_item_string(ud->tags, &dict, "MusicBrainz Album Artist Id", "mb:albumArtistId");
+    add_metadata_item_string(ud->tags, &dict, "MusicBrainz Album Id", "mb:albumId");
+    add_metadata_item_string(ud->tags, &dict, "MusicBrainz Release Track Id", "mb:releaseTrackId");
+    add_metadata_item_string(ud->tags, &dict, "MusicBrainz Work Id", "mb:workId");
 
     // Vorbis & APEv2 metadata format
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MUSICBRAINZ_ARTISTID", "mb:artistId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MUSICBRAINZ_TRACKID", "mb:trackId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MUSICBRAINZ_ALBUMARTISTID", "mb:albumArtistId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MUSICBRAINZ_ALBUMID", "mb:albumId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MUSICBRAINZ_RELEASETRACKID", "mb:releaseTrackId");
-    add_metadata_item_string(ud->mpv, &dict, "metadata/by-key/MUSICBRAINZ_WORKID", "mb:workId");
-
-    add_metadata_item_string_list(ud->mpv, &dict, "metadata/by-key/uploader", "xesam:artist");
-    add_metadata_item_string_list(ud->mpv, &dict, "metadata/by-key/Artist", "xesam:artist");
-    add_metadata_item_string_list(ud->mpv, &dict, "metadata/by-key/Album_Artist", "xesam:albumArtist");
-    add_metadata_item_string_list(ud->mpv, &dict, "metadata/by-key/Composer", "xesam:composer");
-
-    add_metadata_item_int(ud->mpv, &dict, "metadata/by-key/Track", "xesam:trackNumber");
-    add_metadata_item_int(ud->mpv, &dict, "metadata/by-key/Disc", "xesam:discNumber");
-
-    add_metadata_uri(ud->mpv, &dict);
-    add_metadata_art(ud->mpv, &dict, ud); 
-    add_metadata_content_created(ud->mpv, &dict);
-
-    return g_variant_dict_end(&dict);
-}
-
-gchar *try_get_local_art_enhanced(mpv_handle *mpv, const char *path) {
-    gchar *dirname = g_path_get_dirname(path);
-    gchar *out = NULL;
-    gboolean found = FALSE;
-    
-    // Calculate art_files_count locally instead of using the global variable
-    const int local_art_files_count = sizeof(&art_files) / sizeof(art_files[0]);
-    
-    // First, try the predefined art file names
-    for (int i = 0; i < local_art_files_count && !found; i++) {
-        // Skip wildcard patterns for now
-        if (strstr(art_files[i], "{*}") != NULL) {
-            continue;
-        }
-        
-        gchar *filename = g_build_filename(dirname, art_files[i], NULL);
-        
-        if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
-            out = path_to_uri(mpv, filename);
-            found = TRUE;
-        }
-        
-        g_free(filename);
-    }
-    
-    // If no predefined art files found, scan directory for any image files
-    if (!found) {
-        GDir *dir = g_dir_open(dirname, 0, NULL);
-        if (dir) {
-            const gchar *filename;
-            while ((filename = g_dir_read_name(dir)) != NULL && !found) {
-                // Use is_art_file function here to make it used
-                if (is_art_file(filename)) {
-                    gchar *full_path = g_build_filename(dirname, filename, NULL);
-                    if (g_file_test(full_path, G_FILE_TEST_IS_REGULAR)) {
-                        out = path_to_uri(mpv, full_path);
-                        found = TRUE;
-                    }
-                    g_free(full_path);
-                }
-            }
-            g_dir_close(dir);
-        }
-    }
-    
-    g_free(dirname);
-    return out;
+    add_metadata_item_string(ud->tags, &dict, "MUSICBRAINZ_ARTISTID", "mb:artistId");
+    add_metadata_item_string(ud->tags, &dict, "MUSICBRAINZ_TRACKID", "mb:trackId");
+    add_metadata_item_string(ud->tags, &dict, "MUSICBRAINZ_ALBUMARTISTID", "mb:albumArtistId");
+    add_metadata_item_string(ud->tags, &dict, "MUSICBRAINZ_ALBUMID", "mb:albumId");
+    add_metadata_item_string(ud->tags, &dict, "MUSICBRAINZ_RELEASETRACKID", "mb:releaseTrackId");
+    add_metadata_item_string(ud->tags, &dict, "MUSICBRAINZ_WORKID", "mb:workId");
+
+    add_metadata_item_string_list(ud->tags, &dict, "uploader", "xesam:artist");
+    add_metadata_item_string_list(ud->tags, &dict, "Artist", "xesam:artist");
+    add_metadata_item_string_list(ud->tags, &dict, "Album_Artist", "xesam:albumArtist");
+    add_metadata_item_string_list(ud->tags, &dict, "Composer", "xesam:composer");
+
+    add_metadata_item_int(ud->tags, &dict, "Track", "xesam:trackNumber");
+    add_metadata_item_int(ud->tags, &dict, "Disc", "xesam:discNumber");
+
+    add_metadata_uri(ud, &dict);
+    add_metadata_art(&dict, ud);
+    add_metadata_content_created(ud->tags, &dict);
+
+    MPRIS_TRACE1(metadata_end, ud->playlist_pos);
+    metadata = g_variant_dict_end(&dict);
+    alloc_scope_leave(previous_scope);
+    return metadata;
 }
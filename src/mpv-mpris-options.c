@@ -0,0 +1,142 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-options.h"
+
+// Look up mpris-<name> in mpv's script-opts (--script-opts=mpris-foo=bar).
+// Returns a newly allocated copy of the value, or NULL if unset.
+gchar *get_script_opt(mpv_handle *mpv, const char *name)
+{
+    mpv_node opts;
+    gchar *key;
+    gchar *value = NULL;
+
+    if (mpv_get_property(mpv, "options/script-opts", MPV_FORMAT_NODE, &opts) < 0)
+    {
+        return NULL;
+    }
+
+    if (opts.format == MPV_FORMAT_NODE_MAP)
+    {
+        key = g_strconcat(SCRIPT_OPTS_PREFIX, name, NULL);
+        for (int i = 0; i < opts.u.list->num; i++)
+        {
+            mpv_node *node = &opts.u.list->values[i];
+            if (g_strcmp0(opts.u.list->keys[i], key) == 0 &&
+                node->format == MPV_FORMAT_STRING)
+            {
+                value = g_strdup(node->u.string);
+                break;
+            }
+        }
+        g_free(key);
+    }
+
+    mpv_free_node_contents(&opts);
+    return value;
+}
+
+gint64 get_script_opt_int(mpv_handle *mpv, const char *name, gint64 fallback)
+{
+    gchar *str = get_script_opt(mpv, name);
+    gint64 value = fallback;
+
+    if (str)
+    {
+        gchar *end;
+        gint64 parsed = g_ascii_strtoll(str, &end, 10);
+        if (end != str && *end == '\0')
+        {
+            value = parsed;
+        }
+        else
+        {
+            g_printerr("Ignoring invalid value for %s%s: %s\n",
+                       SCRIPT_OPTS_PREFIX, name, str);
+        }
+        g_free(str);
+    }
+
+    return value;
+}
+
+gboolean get_script_opt_flag(mpv_handle *mpv, const char *name, gboolean fallback)
+{
+    gchar *str = get_script_opt(mpv, name);
+    gboolean value = fallback;
+
+    if (str)
+    {
+        if (g_strcmp0(str, "yes") == 0 || g_strcmp0(str, "1") == 0)
+        {
+            value = TRUE;
+        }
+        else if (g_strcmp0(str, "no") == 0 || g_strcmp0(str, "0") == 0)
+        {
+            value = FALSE;
+        }
+        else
+        {
+            g_printerr("Ignoring invalid value for %s%s: %s\n",
+                       SCRIPT_OPTS_PREFIX, name, str);
+        }
+        g_free(str);
+    }
+
+    return value;
+}
+
+// Copy the default emission policies into ud and apply the
+// mpris-emit-<property>-latency / mpris-emit-<property>-interval overrides,
+// both given in milliseconds.
+void load_emit_policies(UserData *ud)
+{
+    for (int i = 0; i < EMIT_POLICY_COUNT; i++)
+    {
+        EmitPolicy *policy = &ud->emit_policies[i];
+        gchar *lower;
+        gchar *name;
+
+        *policy = default_emit_policies[i];
+
+        lower = g_ascii_strdown(policy->property, -1);
+
+        name = g_strdup_printf("emit-%s-latency", lower);
+        policy->latency_budget_us = get_script_opt_int(ud->mpv, name,
+                policy->latency_budget_us / 1000) * 1000;
+        g_free(name);
+
+        name = g_strdup_printf("emit-%s-interval", lower);
+        policy->min_interval_us = get_script_opt_int(ud->mpv, name,
+                policy->min_interval_us / 1000) * 1000;
+        g_free(name);
+
+        g_free(lower);
+
+        policy->latency_budget_us = MAX(policy->latency_budget_us, 0);
+        policy->min_interval_us = MAX(policy->min_interval_us, 0);
+    }
+}
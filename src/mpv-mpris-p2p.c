@@ -0,0 +1,227 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-dbus.h"
+#include "mpv-mpris-p2p.h"
+
+// Optional peer-to-peer endpoint. Controllers that connect to the private
+// socket talk to the D-Bus thread directly, without the hop through the
+// bus daemon. They see the same objects as bus clients and receive the
+// same signals. The session bus registration is not affected.
+
+gchar *p2p_default_socket_path(void)
+{
+    gchar *name = g_strdup_printf("mpv-%d.sock", (int)getpid());
+    gchar *path = g_build_filename(g_get_user_runtime_dir(), "mpv-mpris", name, NULL);
+
+    g_free(name);
+    return path;
+}
+
+// Only processes of the same user may control the player
+static gboolean authorize_peer(G_GNUC_UNUSED GDBusAuthObserver *observer,
+                               G_GNUC_UNUSED GIOStream *stream,
+                               GCredentials *credentials,
+                               G_GNUC_UNUSED gpointer data)
+{
+    return credentials &&
+           g_credentials_get_unix_user(credentials, NULL) == getuid();
+}
+
+static void peer_free(MprisPeer *peer)
+{
+    if (peer->root_interface_id)
+    {
+        g_dbus_connection_unregister_object(peer->connection, peer->root_interface_id);
+    }
+    if (peer->player_interface_id)
+    {
+        g_dbus_connection_unregister_object(peer->connection, peer->player_interface_id);
+    }
+    if (peer->queue_interface_id)
+    {
+        g_dbus_connection_unregister_object(peer->connection, peer->queue_interface_id);
+    }
+    g_object_unref(peer->connection);
+    g_free(peer);
+}
+
+static void on_peer_closed(GDBusConnection *connection,
+                           G_GNUC_UNUSED gboolean remote_peer_vanished,
+                           G_GNUC_UNUSED GError *error,
+                           gpointer data)
+{
+    UserData *ud = data;
+
+    for (GList *l = ud->peers; l; l = l->next)
+    {
+        MprisPeer *peer = l->data;
+        if (peer->connection == connection)
+        {
+            ud->peers = g_list_delete_link(ud->peers, l);
+            g_signal_handlers_disconnect_by_func(connection, on_peer_closed, ud);
+            peer_free(peer);
+            break;
+        }
+    }
+}
+
+static gboolean on_new_connection(G_GNUC_UNUSED GDBusServer *server,
+                                  GDBusConnection *connection,
+                                  gpointer data)
+{
+    UserData *ud = data;
+    MprisPeer *peer = g_new0(MprisPeer, 1);
+    GError *error = NULL;
+
+    peer->connection = g_object_ref(connection);
+
+    peer->root_interface_id =
+        g_dbus_connection_register_object(connection, "/org/mpris/MediaPlayer2",
+                                          ud->root_interface_info,
+                                          &vtable_root, ud, NULL, &error);
+    if (error != NULL)
+    {
+        g_printerr("Failed to register root interface for peer: %s\n", error->message);
+        g_clear_error(&error);
+    }
+
+    peer->player_interface_id =
+        g_dbus_connection_register_object(connection, "/org/mpris/MediaPlayer2",
+                                          ud->player_interface_info,
+                                          &vtable_player, ud, NULL, &error);
+    if (error != NULL)
+    {
+        g_printerr("Failed to register player interface for peer: %s\n", error->message);
+        g_clear_error(&error);
+    }
+
+    peer->queue_interface_id =
+        g_dbus_connection_register_object(connection, "/org/mpris/MediaPlayer2",
+                                          ud->queue_interface_info,
+                                          &vtable_queue, ud, NULL, &error);
+    if (error != NULL)
+    {
+        g_printerr("Failed to register queue interface for peer: %s\n", error->message);
+        g_clear_error(&error);
+    }
+
+    g_signal_connect(connection, "closed", G_CALLBACK(on_peer_closed), ud);
+    ud->peers = g_list_prepend(ud->peers, peer);
+
+    // Changes held back while nobody was connected can go out now
+    flush_property_changes(ud, FALSE);
+    return TRUE;
+}
+
+// Called on the D-Bus thread, so peers are served from its context
+void p2p_start(UserData *ud)
+{
+    GDBusAuthObserver *observer;
+    GError *error = NULL;
+    gchar *dir, *escaped, *address, *guid;
+
+    if (!ud->p2p_socket)
+    {
+        return;
+    }
+
+    dir = g_path_get_dirname(ud->p2p_socket);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+    g_unlink(ud->p2p_socket);
+
+    escaped = g_dbus_address_escape_value(ud->p2p_socket);
+    address = g_strconcat("unix:path=", escaped, NULL);
+    guid = g_dbus_generate_guid();
+
+    observer = g_dbus_auth_observer_new();
+    g_signal_connect(observer, "authorize-authenticated-peer",
+                     G_CALLBACK(authorize_peer), NULL);
+
+    ud->p2p_server = g_dbus_server_new_sync(address, G_DBUS_SERVER_FLAGS_NONE,
+                                            guid, observer, NULL, &error);
+    if (ud->p2p_server)
+    {
+        g_signal_connect(ud->p2p_server, "new-connection",
+                         G_CALLBACK(on_new_connection), ud);
+        g_dbus_server_start(ud->p2p_server);
+    }
+    else
+    {
+        g_printerr("Failed to listen on %s: %s\n", ud->p2p_socket, error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(observer);
+    g_free(guid);
+    g_free(address);
+    g_free(escaped);
+}
+
+void p2p_stop(UserData *ud)
+{
+    if (ud->p2p_server)
+    {
+        g_dbus_server_stop(ud->p2p_server);
+        g_object_unref(ud->p2p_server);
+        ud->p2p_server = NULL;
+        g_unlink(ud->p2p_socket);
+    }
+
+    while (ud->peers)
+    {
+        MprisPeer *peer = ud->peers->data;
+
+        ud->peers = g_list_delete_link(ud->peers, ud->peers);
+        g_signal_handlers_disconnect_by_func(peer->connection, on_peer_closed, ud);
+        g_dbus_connection_close(peer->connection, NULL, NULL, NULL);
+        peer_free(peer);
+    }
+}
+
+// params must not be floating, it is sent to every peer
+void p2p_emit_signal(UserData *ud, const char *interface_name,
+                     const char *signal_name, GVariant *params)
+{
+    for (GList *l = ud->peers; l; l = l->next)
+    {
+        MprisPeer *peer = l->data;
+        GError *error = NULL;
+
+        g_dbus_connection_emit_signal(peer->connection, NULL,
+                                      "/org/mpris/MediaPlayer2",
+                                      interface_name, signal_name,
+                                      params, &error);
+        if (error != NULL)
+        {
+            g_printerr("%s", error->message);
+            g_error_free(error);
+        }
+    }
+}
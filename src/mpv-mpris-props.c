@@ -0,0 +1,162 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "mpv-mpris-props.h"
+
+static int find_entry(PropertyCache *cache, const char *name)
+{
+    for (guint i = 0; i < cache->n_entries; i++)
+    {
+        if (g_strcmp0(cache->info->properties[i]->name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static GVariant *new_entry(const char *name, GVariant *value)
+{
+    return g_variant_ref_sink(g_variant_new_dict_entry(g_variant_new_string(name),
+                                                       g_variant_new_variant(value)));
+}
+
+void property_cache_init(PropertyCache *cache, GDBusInterfaceInfo *info)
+{
+    cache->info = g_dbus_interface_info_ref(info);
+    cache->n_entries = 0;
+    while (info->properties && info->properties[cache->n_entries])
+    {
+        cache->n_entries++;
+    }
+    cache->entries = g_new0(GVariant *, cache->n_entries);
+    cache->reply = NULL;
+}
+
+void property_cache_clear(PropertyCache *cache)
+{
+    if (!cache->info)
+    {
+        return;
+    }
+
+    for (guint i = 0; i < cache->n_entries; i++)
+    {
+        if (cache->entries[i])
+        {
+            g_variant_unref(cache->entries[i]);
+        }
+    }
+    g_free(cache->entries);
+
+    if (cache->reply)
+    {
+        g_variant_unref(cache->reply);
+    }
+
+    g_dbus_interface_info_unref(cache->info);
+    cache->info = NULL;
+    cache->entries = NULL;
+    cache->reply = NULL;
+    cache->n_entries = 0;
+}
+
+// Store a new value, the GetAll reply is rebuilt on the next request
+void property_cache_set(PropertyCache *cache, const char *name, GVariant *value)
+{
+    int i = find_entry(cache, name);
+
+    if (i < 0)
+    {
+        g_printerr("No cached property %s\n", name);
+        g_variant_unref(g_variant_ref_sink(value));
+        return;
+    }
+
+    if (cache->entries[i])
+    {
+        g_variant_unref(cache->entries[i]);
+    }
+    cache->entries[i] = new_entry(name, value);
+
+    if (cache->reply)
+    {
+        g_variant_unref(cache->reply);
+        cache->reply = NULL;
+    }
+}
+
+// Boxed "v" value of the property, or NULL. Free with g_variant_unref().
+GVariant *property_cache_get(PropertyCache *cache, const char *name)
+{
+    int i = find_entry(cache, name);
+
+    if (i < 0 || !cache->entries[i])
+    {
+        return NULL;
+    }
+    return g_variant_get_child_value(cache->entries[i], 1);
+}
+
+static GVariant *build_reply(PropertyCache *cache, int replace, GVariant *replacement)
+{
+    GVariant **children = g_newa(GVariant *, cache->n_entries);
+    GVariant *properties;
+    guint n = 0;
+
+    for (guint i = 0; i < cache->n_entries; i++)
+    {
+        GVariant *entry = (int)i == replace ? replacement : cache->entries[i];
+        if (entry)
+        {
+            children[n++] = entry;
+        }
+    }
+
+    properties = g_variant_new_array(G_VARIANT_TYPE("{sv}"), children, n);
+    return g_variant_new_tuple(&properties, 1);
+}
+
+// "(a{sv})" GetAll reply, owned by the cache
+GVariant *property_cache_get_all(PropertyCache *cache)
+{
+    if (!cache->reply)
+    {
+        cache->reply = g_variant_ref_sink(build_reply(cache, -1, NULL));
+    }
+    return cache->reply;
+}
+
+// Floating "(a{sv})" GetAll reply with one property replaced by a value
+// that changes too often to be cached, such as Position during playback
+GVariant *property_cache_get_all_with(PropertyCache *cache, const char *name,
+                                      GVariant *value)
+{
+    int i = find_entry(cache, name);
+    GVariant *entry = new_entry(name, value);
+    GVariant *reply = build_reply(cache, i, entry);
+
+    g_variant_unref(entry);
+    return reply;
+}
@@ -0,0 +1,146 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <string.h>
+
+#include "mpv-mpris-ring.h"
+
+typedef struct RingSource {
+    GSource source;
+    MprisRing *ring;
+} RingSource;
+
+MprisRing *ring_new(guint capacity, gsize elem_size)
+{
+    MprisRing *ring = g_new0(MprisRing, 1);
+    guint size = 1;
+
+    // Round up so that slot indices can be masked instead of divided
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    ring->capacity = size;
+    ring->elem_size = elem_size;
+    ring->slots = g_malloc0(size * elem_size);
+    return ring;
+}
+
+void ring_free(MprisRing *ring)
+{
+    if (!ring)
+    {
+        return;
+    }
+
+    if (ring->source)
+    {
+        g_source_destroy(ring->source);
+        g_source_unref(ring->source);
+    }
+    g_free(ring->slots);
+    g_free(ring);
+}
+
+// Producer side. Returns FALSE without blocking when the ring is full.
+gboolean ring_push(MprisRing *ring, const void *elem)
+{
+    guint head = (guint)g_atomic_int_get(&ring->head);
+    guint tail = (guint)g_atomic_int_get(&ring->tail);
+
+    if (head - tail >= ring->capacity)
+    {
+        return FALSE;
+    }
+
+    memcpy(ring->slots + (head & (ring->capacity - 1)) * ring->elem_size,
+           elem, ring->elem_size);
+
+    // Publish the slot, the atomic store orders it after the copy
+    g_atomic_int_set(&ring->head, (gint)(head + 1));
+    return TRUE;
+}
+
+// Consumer side. Returns FALSE when the ring is empty.
+gboolean ring_pop(MprisRing *ring, void *elem)
+{
+    guint tail = (guint)g_atomic_int_get(&ring->tail);
+    guint head = (guint)g_atomic_int_get(&ring->head);
+
+    if (head == tail)
+    {
+        return FALSE;
+    }
+
+    memcpy(elem, ring->slots + (tail & (ring->capacity - 1)) * ring->elem_size,
+           ring->elem_size);
+
+    // Hand the slot back to the producer
+    g_atomic_int_set(&ring->tail, (gint)(tail + 1));
+    return TRUE;
+}
+
+guint ring_length(MprisRing *ring)
+{
+    return (guint)g_atomic_int_get(&ring->head) - (guint)g_atomic_int_get(&ring->tail);
+}
+
+// Producer side. Wakes the consumer source up, at most once until it runs.
+void ring_notify(MprisRing *ring)
+{
+    if (ring->source && g_atomic_int_compare_and_exchange(&ring->wakeup_pending, 0, 1))
+    {
+        g_source_set_ready_time(ring->source, 0);
+    }
+}
+
+static gboolean ring_source_dispatch(GSource *source, GSourceFunc callback,
+                                     gpointer user_data)
+{
+    MprisRing *ring = ((RingSource *)source)->ring;
+
+    // Disarm before clearing the flag so that a concurrent ring_notify()
+    // cannot have its wakeup overwritten
+    g_source_set_ready_time(source, -1);
+    g_atomic_int_set(&ring->wakeup_pending, 0);
+
+    return callback ? callback(user_data) : G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs ring_source_funcs = {
+    NULL, NULL, ring_source_dispatch, NULL, NULL, NULL};
+
+// Source dispatched in the consumer's main context after ring_notify().
+// The callback is expected to drain the ring with ring_pop().
+GSource *ring_source_new(MprisRing *ring, GSourceFunc callback, gpointer user_data)
+{
+    GSource *source = g_source_new(&ring_source_funcs, sizeof(RingSource));
+    ((RingSource *)source)->ring = ring;
+    g_source_set_callback(source, callback, user_data, NULL);
+
+    ring->source = g_source_ref(source);
+    return source;
+}
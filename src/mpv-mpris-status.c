@@ -0,0 +1,217 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// ftruncate() and mmap() are POSIX, not part of -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-types.h"
+#include "mpv-mpris-status.h"
+#include "mpv-mpris-status-page.h"
+
+// Writer side of the shared status page. It is only touched from the
+// D-Bus thread, fed by the same deltas as the property caches, so there is
+// a single writer and no lock beyond the seqlock readers rely on.
+
+gchar *status_page_default_path(void)
+{
+    gchar *name = g_strdup_printf("mpv-%d.status", (int)getpid());
+    gchar *path = g_build_filename(g_get_user_runtime_dir(), "mpv-mpris", name, NULL);
+
+    g_free(name);
+    return path;
+}
+
+static void begin_update(MprisStatusPage *page)
+{
+    __atomic_store_n(&page->sequence, page->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void end_update(MprisStatusPage *page)
+{
+    __atomic_store_n(&page->sequence, page->sequence + 1, __ATOMIC_RELEASE);
+}
+
+static uint32_t status_code(const char *status)
+{
+    if (status == STATUS_PLAYING)
+    {
+        return MPRIS_STATUS_PLAYING;
+    }
+    if (status == STATUS_PAUSED)
+    {
+        return MPRIS_STATUS_PAUSED;
+    }
+    return MPRIS_STATUS_STOPPED;
+}
+
+// Truncates on a character boundary so readers always get valid UTF-8
+static void set_title(MprisStatus *status, const char *title)
+{
+    gsize length = strlen(title);
+
+    if (length >= MPRIS_STATUS_PAGE_TITLE_MAX)
+    {
+        const char *end = g_utf8_find_prev_char(title, title + MPRIS_STATUS_PAGE_TITLE_MAX);
+        length = end ? (gsize)(end - title) : 0;
+    }
+
+    memcpy(status->title, title, length);
+    memset(status->title + length, 0, MPRIS_STATUS_PAGE_TITLE_MAX - length);
+    status->title_length = (uint32_t)length;
+}
+
+static void write_field(MprisStatus *status, UserData *ud, const char *name,
+                        GVariant *value)
+{
+    if (g_strcmp0(name, "Position") == 0 || g_strcmp0(name, "Seeked") == 0)
+    {
+        status->position_us = ud->state.position_us;
+        status->position_time_us = ud->state.position_time;
+    }
+    else if (g_strcmp0(name, "PlaybackStatus") == 0)
+    {
+        status->playback_status = status_code(ud->state.status);
+    }
+    else if (g_strcmp0(name, "Rate") == 0)
+    {
+        status->rate = ud->state.rate;
+    }
+    else if (g_strcmp0(name, "Volume") == 0)
+    {
+        status->volume = g_variant_get_double(value);
+    }
+    else if (g_strcmp0(name, "Metadata") == 0)
+    {
+        const char *title = NULL;
+
+        g_variant_lookup(value, "xesam:title", "&s", &title);
+        set_title(status, title ? title : "");
+    }
+}
+
+// Called whenever the D-Bus thread applied a delta, after ud->state
+void status_page_update(UserData *ud, const char *name, GVariant *value)
+{
+    MprisStatusPage *page = ud->status_page;
+
+    if (!page)
+    {
+        return;
+    }
+
+    begin_update(page);
+    write_field(&page->status, ud, name, value);
+    end_update(page);
+}
+
+// Seeds a field from the property caches when the page is created
+static void seed_field(UserData *ud, MprisStatus *status, const char *name)
+{
+    GVariant *boxed = property_cache_get(&ud->player_properties, name);
+    GVariant *value;
+
+    if (!boxed)
+    {
+        return;
+    }
+    value = g_variant_get_variant(boxed);
+    write_field(status, ud, name, value);
+    g_variant_unref(value);
+    g_variant_unref(boxed);
+}
+
+void status_page_open(UserData *ud)
+{
+    MprisStatusPage *page;
+    gchar *dir;
+    int fd;
+
+    if (!ud->status_page_path)
+    {
+        return;
+    }
+
+    dir = g_path_get_dirname(ud->status_page_path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    // Replace rather than reuse a file, readers may still map the old one
+    g_unlink(ud->status_page_path);
+    fd = open(ud->status_page_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        g_printerr("Failed to create %s: %s\n", ud->status_page_path, g_strerror(errno));
+        return;
+    }
+    if (ftruncate(fd, sizeof(MprisStatusPage)) < 0)
+    {
+        g_printerr("Failed to size %s: %s\n", ud->status_page_path, g_strerror(errno));
+        close(fd);
+        g_unlink(ud->status_page_path);
+        return;
+    }
+
+    page = mmap(NULL, sizeof(MprisStatusPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        g_printerr("Failed to map %s: %s\n", ud->status_page_path, g_strerror(errno));
+        g_unlink(ud->status_page_path);
+        return;
+    }
+
+    page->version = MPRIS_STATUS_PAGE_VERSION;
+    page->size = sizeof(MprisStatusPage);
+    page->pid = (int32_t)getpid();
+    page->status.rate = ud->state.rate;
+    page->status.playback_status = status_code(ud->state.status);
+    seed_field(ud, &page->status, "Volume");
+    seed_field(ud, &page->status, "Metadata");
+    __atomic_store_n(&page->magic, MPRIS_STATUS_PAGE_MAGIC, __ATOMIC_RELEASE);
+
+    ud->status_page = page;
+}
+
+void status_page_close(UserData *ud)
+{
+    if (!ud->status_page)
+    {
+        return;
+    }
+
+    // Readers that keep the mapping see a stopped player
+    begin_update(ud->status_page);
+    ud->status_page->status.playback_status = MPRIS_STATUS_STOPPED;
+    end_update(ud->status_page);
+    munmap(ud->status_page, sizeof(MprisStatusPage));
+    ud->status_page = NULL;
+    g_unlink(ud->status_page_path);
+}
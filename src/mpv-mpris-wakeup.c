@@ -0,0 +1,126 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "mpv-mpris-wakeup.h"
+
+gboolean wakeup_open(MprisWakeup *wakeup, GError **error)
+{
+    wakeup->pending = 0;
+
+#ifdef __linux__
+    wakeup->read_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeup->read_fd != -1)
+    {
+        wakeup->write_fd = wakeup->read_fd;
+        return TRUE;
+    }
+#endif
+
+    // Fall back to a pipe where eventfd is not available
+    int fds[2];
+    if (!g_unix_open_pipe(fds, FD_CLOEXEC, error))
+    {
+        wakeup->read_fd = wakeup->write_fd = -1;
+        return FALSE;
+    }
+
+    if (!g_unix_set_fd_nonblocking(fds[0], TRUE, error) ||
+        !g_unix_set_fd_nonblocking(fds[1], TRUE, error))
+    {
+        close(fds[0]);
+        close(fds[1]);
+        wakeup->read_fd = wakeup->write_fd = -1;
+        return FALSE;
+    }
+
+    wakeup->read_fd = fds[0];
+    wakeup->write_fd = fds[1];
+    return TRUE;
+}
+
+void wakeup_close(MprisWakeup *wakeup)
+{
+    if (wakeup->write_fd != -1 && wakeup->write_fd != wakeup->read_fd)
+    {
+        close(wakeup->write_fd);
+    }
+    if (wakeup->read_fd != -1)
+    {
+        close(wakeup->read_fd);
+    }
+    wakeup->read_fd = wakeup->write_fd = -1;
+}
+
+// Called by mpv from its own thread, must not block
+void wakeup_handler(void *data)
+{
+    MprisWakeup *wakeup = data;
+
+    // Only the first wakeup since the last drain has to signal the fd
+    if (!g_atomic_int_compare_and_exchange(&wakeup->pending, 0, 1))
+    {
+        return;
+    }
+
+#ifdef __linux__
+    if (wakeup->write_fd == wakeup->read_fd)
+    {
+        (void)!eventfd_write(wakeup->write_fd, 1);
+        return;
+    }
+#endif
+    (void)!write(wakeup->write_fd, "0", 1);
+}
+
+// Called by the event handler before it drains mpv's event queue. Events
+// queued after this point signal the fd again.
+void wakeup_drain(MprisWakeup *wakeup)
+{
+#ifdef __linux__
+    if (wakeup->write_fd == wakeup->read_fd)
+    {
+        // A single read resets the eventfd counter
+        eventfd_t count;
+        (void)!eventfd_read(wakeup->read_fd, &count);
+        g_atomic_int_set(&wakeup->pending, 0);
+        return;
+    }
+#endif
+
+    char unused[16];
+    while (read(wakeup->read_fd, unused, sizeof(unused)) > 0)
+        ;
+
+    g_atomic_int_set(&wakeup->pending, 0);
+}
@@ -0,0 +1,188 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "mpv-mpris-wire.h"
+
+// Default broker socket, shared by the daemon and the plugin
+gchar *wire_socket_path(void)
+{
+    return g_build_filename(g_get_user_runtime_dir(), "mpv-mpris", "broker.sock", NULL);
+}
+
+GVariant *wire_delta(const char *name, GVariant *value)
+{
+    return g_variant_new("(sv)", name, value);
+}
+
+GVariant *wire_command(const MprisCommand *cmd)
+{
+    const char *const no_args[] = {NULL};
+
+    return g_variant_new("(usibd^asxxuu)",
+                         (guint32)cmd->kind,
+                         cmd->property ? cmd->property : "",
+                         (gint32)cmd->format,
+                         cmd->flag,
+                         cmd->number,
+                         cmd->args ? (const char *const *)cmd->args : no_args,
+                         cmd->track,
+                         cmd->position_us,
+                         cmd->request,
+                         cmd->parts);
+}
+
+// Fill cmd from a frame sent by the broker. The property name is interned
+// since MprisCommand only carries static strings.
+void wire_parse_command(GVariant *message, MprisCommand *cmd)
+{
+    guint32 kind;
+    gint32 format;
+    const char *property;
+    gboolean flag;
+
+    g_variant_get(message, "(u&sibd^asxxuu)", &kind, &property, &format, &flag,
+                  &cmd->number, &cmd->args, &cmd->track, &cmd->position_us,
+                  &cmd->request, &cmd->parts);
+
+    cmd->kind = kind;
+    cmd->format = format;
+    cmd->flag = flag;
+    cmd->property = *property ? g_intern_string(property) : NULL;
+}
+
+GVariant *wire_reply(guint32 request, const char *error)
+{
+    return wire_delta(WIRE_REPLY, g_variant_new("(us)", request, error ? error : ""));
+}
+
+// Write one frame, blocking until it is out or the socket times out
+gboolean wire_send(GSocket *socket, GVariant *message, GError **error)
+{
+    gsize size;
+    guint32 header;
+    guint8 *frame;
+    gsize sent = 0;
+    gboolean ok = TRUE;
+
+    g_variant_ref_sink(message);
+    size = g_variant_get_size(message);
+    header = GUINT32_TO_LE((guint32)size);
+
+    frame = g_malloc(sizeof(header) + size);
+    memcpy(frame, &header, sizeof(header));
+    g_variant_store(message, frame + sizeof(header));
+    g_variant_unref(message);
+
+    while (sent < sizeof(header) + size)
+    {
+        gssize n = g_socket_send_with_blocking(socket, (const gchar *)frame + sent,
+                                               sizeof(header) + size - sent,
+                                               TRUE, NULL, error);
+        if (n < 0)
+        {
+            ok = FALSE;
+            break;
+        }
+        sent += n;
+    }
+
+    g_free(frame);
+    return ok;
+}
+
+// Append whatever is readable without blocking. Returns FALSE once the
+// peer has closed the connection or on errors.
+gboolean wire_receive(GSocket *socket, GByteArray *buffer, GError **error)
+{
+    guint8 chunk[4096];
+    GError *local_error = NULL;
+
+    for (;;)
+    {
+        gssize n = g_socket_receive_with_blocking(socket, (gchar *)chunk,
+                                                  sizeof(chunk), FALSE,
+                                                  NULL, &local_error);
+        if (n > 0)
+        {
+            g_byte_array_append(buffer, chunk, n);
+            continue;
+        }
+        if (n == 0)
+        {
+            return FALSE;
+        }
+        // A socket with a send timeout also wakes its read source when
+        // that much time passed without input, which is not an error
+        if (g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK) ||
+            g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+        {
+            g_error_free(local_error);
+            return TRUE;
+        }
+        g_propagate_error(error, local_error);
+        return FALSE;
+    }
+}
+
+// Pop the next complete frame off the buffer. Returns NULL when more data
+// is needed, or with error set when the peer sent garbage.
+GVariant *wire_next(GByteArray *buffer, const GVariantType *type, GError **error)
+{
+    guint32 header;
+    GBytes *bytes;
+    GVariant *message;
+
+    if (buffer->len < sizeof(header))
+    {
+        return NULL;
+    }
+
+    memcpy(&header, buffer->data, sizeof(header));
+    header = GUINT32_FROM_LE(header);
+    if (header > WIRE_MAX_FRAME)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "Frame of %u bytes is too large", header);
+        return NULL;
+    }
+    if (buffer->len < sizeof(header) + header)
+    {
+        return NULL;
+    }
+
+    bytes = g_bytes_new(buffer->data + sizeof(header), header);
+    g_byte_array_remove_range(buffer, 0, sizeof(header) + header);
+
+    message = g_variant_ref_sink(g_variant_new_from_bytes(type, bytes, FALSE));
+    g_bytes_unref(bytes);
+
+    if (!g_variant_is_normal_form(message))
+    {
+        g_variant_unref(message);
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "Malformed frame");
+        return NULL;
+    }
+    return message;
+}
@@ -22,24 +22,50 @@
     SOFTWARE.
 */
 
+#include "mpv-mpris-alloc.h"
+#include "mpv-mpris-art-fetch.h"
 #include "mpv-mpris-artwork.h"
+#include "mpv-mpris-bridge.h"
+#include "mpv-mpris-broker-client.h"
+#include "mpv-mpris-cache-writer.h"
 #include "mpv-mpris-dbus.h"
 #include "mpv-mpris-events.h"
+#include "mpv-mpris-frame-art.h"
+#include "mpv-mpris-introspection.h"
 #include "mpv-mpris-metadata.h"
+#include "mpv-mpris-options.h"
+#include "mpv-mpris-p2p.h"
+#include "mpv-mpris-status.h"
 #include "mpv-mpris-types.h"
 
+static void variant_unref0(gpointer value)
+{
+    if (value)
+    {
+        g_variant_unref(value);
+    }
+}
+
 // Plugin entry point
+//
+// This thread becomes the mpv thread: it drains mpv events and runs the
+// commands queued by the D-Bus thread. The D-Bus thread owns the bus name
+// and answers requests. The two only talk through the delta and command
+// rings, so a slow D-Bus client never delays mpv events and vice versa.
+//
+// The plugin is built with -fvisibility=hidden, this is the only symbol
+// mpv looks up.
+__attribute__((visibility("default")))
 int mpv_open_cplugin(mpv_handle *mpv) 
 {
     GMainContext *ctx = NULL;
     GMainLoop *loop = NULL;
     UserData ud = {0};
     GError *error = NULL;
-    GDBusNodeInfo *introspection_data = NULL;
-    int pipe[2] = {-1, -1};
-    GSource *mpv_pipe_source = NULL;
-    GSource *timeout_source = NULL;
+    GSource *mpv_wakeup_source = NULL;
+    GSource *source = NULL;
     int ret = -1; // Default to error
+    MprisAllocScope previous_scope;
 
     // Validate input
     if (!mpv) {
@@ -47,51 +73,47 @@ int mpv_open_cplugin(mpv_handle *mpv)
         return ret;
     }
 
-    // Initialize context and loop
+    // This thread belongs to the plugin until it returns
+    previous_scope = alloc_scope_enter(ALLOC_SCOPE_MPV);
+
+    ud.wakeup.read_fd = ud.wakeup.write_fd = -1;
+
+    // Initialize contexts and loops
     ctx = g_main_context_new();
-    if (!ctx) {
+    ud.dbus_context = g_main_context_new();
+    if (!ctx || !ud.dbus_context) {
         g_printerr("Failed to create main context\n");
         goto cleanup;
     }
+    // GTask callbacks, such as finished art fetches, run on this thread
+    g_main_context_push_thread_default(ctx);
 
     loop = g_main_loop_new(ctx, FALSE);
-    if (!loop) {
+    ud.dbus_loop = g_main_loop_new(ud.dbus_context, FALSE);
+    if (!loop || !ud.dbus_loop) {
         g_printerr("Failed to create main loop\n");
         goto cleanup;
     }
 
-    // Load D-Bus introspection data
-    introspection_data = g_dbus_node_info_new_for_xml(introspection_xml, &error);
-    if (error != NULL) {
-        g_printerr("Failed to parse introspection XML: %s\n", error->message);
-        g_error_free(error);
-        error = NULL;
-        goto cleanup;
-    }
-
-    if (!introspection_data) {
-        g_printerr("Failed to create D-Bus introspection data\n");
-        goto cleanup;
-    }
-
-    // Setup interface info
-    ud.root_interface_info = g_dbus_node_info_lookup_interface(introspection_data, 
-                                "org.mpris.MediaPlayer2");
-    ud.player_interface_info = g_dbus_node_info_lookup_interface(introspection_data, 
-                                "org.mpris.MediaPlayer2.Player");
-    
-    if (!ud.root_interface_info || !ud.player_interface_info) {
-        g_printerr("Failed to lookup D-Bus interfaces\n");
-        goto cleanup;
-    }
+    // Interface info is generated from dbus/mpv-mpris.xml at build time
+    ud.root_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_interface;
+    ud.player_interface_info = (GDBusInterfaceInfo *)&org_mpris_mediaplayer2_player_interface;
+    ud.queue_interface_info = (GDBusInterfaceInfo *)&org_mpv_mprisqueue_interface;
+    ud.debug_interface_info = (GDBusInterfaceInfo *)&org_mpv_mprisdebug_interface;
 
     // Initialize UserData
     ud.mpv = mpv;
+    ud.context = ctx;
     ud.loop = loop;
     ud.status = STATUS_STOPPED;
     ud.loop_status = LOOP_NONE;
-    ud.changed_properties = g_hash_table_new(g_str_hash, g_str_equal);
-    if (!ud.changed_properties) {
+    ud.playlist_pos = -1;
+    ud.duration = -1;
+    ud.outgoing = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        NULL, variant_unref0);
+    ud.changed_properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  NULL, variant_unref0);
+    if (!ud.outgoing || !ud.changed_properties) {
         g_printerr("Failed to create properties hash table\n");
         goto cleanup;
     }
@@ -101,71 +123,148 @@ int mpv_open_cplugin(mpv_handle *mpv)
     ud.paused = FALSE;
     ud.shuffle = FALSE;
 
-    // Register on D-Bus
-    g_main_context_push_thread_default(ctx);
-    ud.bus_id = g_bus_own_name(G_BUS_TYPE_SESSION,
-                               "org.mpris.MediaPlayer2.mpv",
-                               G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE,
-                               on_bus_acquired,
-                               NULL,
-                               on_name_lost,
-                               &ud, NULL);
-    g_main_context_pop_thread_default(ctx);
-
-    if (!ud.bus_id) {
-        g_printerr("Failed to own D-Bus name\n");
-        goto cleanup;
+    // With mpris-broker=yes the broker daemon owns the D-Bus presence and
+    // this instance only streams deltas to it
+    if (get_script_opt_flag(mpv, "broker", FALSE)) {
+        ud.use_broker = broker_connect(&ud, &error);
+        if (!ud.use_broker) {
+            g_printerr("mpris broker unavailable, registering on the bus: %s\n",
+                       error->message);
+            g_error_free(error);
+            error = NULL;
+        }
+    }
+
+    ud.state.status = STATUS_STOPPED;
+    ud.state.rate = 1.0;
+    // Counters for tests and profiling, on org.mpv.MprisDebug
+    ud.debug = !ud.use_broker && get_script_opt_flag(mpv, "debug", FALSE);
+    if (ud.debug) {
+        ud.histograms = g_new0(MprisHistogram, HISTOGRAM_COUNT);
+        ud.get_histograms = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, g_free);
+    }
+    if (!ud.use_broker) {
+        init_property_caches(&ud);
+        load_emit_policies(&ud);
+    }
+
+    // Private socket for controllers that skip the bus daemon
+    if (!ud.use_broker && get_script_opt_flag(mpv, "p2p", FALSE)) {
+        ud.p2p_socket = get_script_opt(mpv, "p2p-socket");
+        if (!ud.p2p_socket || !*ud.p2p_socket) {
+            g_free(ud.p2p_socket);
+            ud.p2p_socket = p2p_default_socket_path();
+        }
+    }
+
+    // Status page for pollers that should not pay a D-Bus round trip
+    if (!ud.use_broker && get_script_opt_flag(mpv, "status-page", FALSE)) {
+        ud.status_page_path = get_script_opt(mpv, "status-page-path");
+        if (!ud.status_page_path || !*ud.status_page_path) {
+            g_free(ud.status_page_path);
+            ud.status_page_path = status_page_default_path();
+        }
+    }
+
+    // Embedded covers are written to the art cache off this thread, by
+    // a writer thread started with the first one
+    if (!ud.use_broker) {
+        ud.cache_writer = cache_writer_new(CACHE_WRITER_MAX_QUEUED, art_written, &ud);
+    }
+
+    // Remote thumbnails are fetched once into the art cache and served
+    // from there, controllers do not each download them. The fetcher and
+    // the cache directory wait for the first remote artUrl.
+    if (!ud.use_broker && get_script_opt_flag(mpv, "art-proxy", TRUE)) {
+        ud.art_proxy = TRUE;
+        ud.art_proxy_budget.max_bytes = get_script_opt_int(mpv, "art-proxy-max-kb", 1024) * 1024;
+        ud.art_proxy_budget.timeout_s = get_script_opt_int(mpv, "art-proxy-timeout", 10);
+        ud.art_proxy_budget.max_running = 2;
+        ud.art_proxy_max_age_s = get_script_opt_int(mpv, "art-proxy-max-age", 86400);
+    }
+
+    // Media without art of its own gets a frame of its video
+    if (!ud.use_broker && get_script_opt_flag(mpv, "frame-art", FALSE)) {
+        gchar *cache_dir = get_cache_dir();
+        FrameArtOptions options = {
+            .offset_us = get_script_opt_int(mpv, "frame-art-offset", 10) * G_USEC_PER_SEC,
+            .max_size = get_script_opt_int(mpv, "frame-art-size", 320),
+            .interval_us = get_script_opt_int(mpv, "frame-art-interval", 5) * G_USEC_PER_SEC,
+            .position_reply = PROPERTY_FRAME_ART_POSITION,
+        };
+
+        if (cache_dir) {
+            ud.frame_art = frame_art_new(mpv, cache_dir, &options, frame_art_stored, &ud);
+            g_free(cache_dir);
+        }
+    }
+
+    // Rings between the two threads and the sources draining them
+    ud.deltas = ring_new(DELTA_RING_SIZE, sizeof(MprisDelta));
+    ud.commands = ring_new(COMMAND_RING_SIZE, sizeof(MprisCommand));
+    ud.replies = ring_new(REPLY_RING_SIZE, sizeof(MprisReply));
+    ud.pending_replies = g_hash_table_new(g_int64_hash, g_int64_equal);
+
+    source = ring_source_new(ud.deltas, ud.use_broker ? forward_deltas : apply_deltas, &ud);
+    g_source_attach(source, ud.dbus_context);
+    g_source_unref(source);
+
+    source = ring_source_new(ud.commands, run_commands, &ud);
+    g_source_attach(source, ctx);
+    g_source_unref(source);
+
+    source = ring_source_new(ud.replies, ud.use_broker ? forward_replies : apply_replies, &ud);
+    g_source_attach(source, ud.dbus_context);
+    g_source_unref(source);
+
+    // Emission source, woken up whenever a queued property change is due
+    if (!ud.use_broker) {
+        ud.emit_source = emit_source_new(&ud);
+        g_source_attach(ud.emit_source, ud.dbus_context);
     }
 
     // Setup property observers
-    if (mpv_observe_property(mpv, 0, "pause", MPV_FORMAT_FLAG) < 0 ||
-        mpv_observe_property(mpv, 0, "idle-active", MPV_FORMAT_FLAG) < 0 ||
-        mpv_observe_property(mpv, 0, "media-title", MPV_FORMAT_STRING) < 0 ||
-        mpv_observe_property(mpv, 0, "speed", MPV_FORMAT_DOUBLE) < 0 ||
-        mpv_observe_property(mpv, 0, "volume", MPV_FORMAT_DOUBLE) < 0 ||
-        mpv_observe_property(mpv, 0, "loop-file", MPV_FORMAT_STRING) < 0 ||
-        mpv_observe_property(mpv, 0, "loop-playlist", MPV_FORMAT_STRING) < 0 ||
-        mpv_observe_property(mpv, 0, "duration", MPV_FORMAT_INT64) < 0 ||
-        mpv_observe_property(mpv, 0, "shuffle", MPV_FORMAT_FLAG) < 0 ||
-        mpv_observe_property(mpv, 0, "fullscreen", MPV_FORMAT_FLAG) < 0) {
+    if (observe_properties(mpv) < 0) {
         g_printerr("Failed to observe MPV properties\n");
         goto cleanup;
     }
 
-    // Setup event pipe
-    if (!g_unix_open_pipe(pipe, FD_CLOEXEC, &error)) {
-        g_printerr("Failed to create pipe: %s\n", error->message);
+    // Setup event wakeup
+    if (!wakeup_open(&ud.wakeup, &error)) {
+        g_printerr("Failed to create wakeup fd: %s\n", error->message);
         g_error_free(error);
         error = NULL;
         goto cleanup;
     }
 
-    if (fcntl(pipe[0], F_SETFL, O_NONBLOCK) == -1) {
-        g_printerr("Failed to set pipe non-blocking: %s\n", g_strerror(errno));
-        goto cleanup;
-    }
-
-    mpv_set_wakeup_callback(mpv, wakeup_handler, &pipe[1]);
+    mpv_set_wakeup_callback(mpv, wakeup_handler, &ud.wakeup);
 
-    // Create and attach pipe source
-    mpv_pipe_source = g_unix_fd_source_new(pipe[0], G_IO_IN);
-    if (!mpv_pipe_source) {
-        g_printerr("Failed to create pipe source\n");
+    // Create and attach wakeup source
+    mpv_wakeup_source = g_unix_fd_source_new(ud.wakeup.read_fd, G_IO_IN);
+    if (!mpv_wakeup_source) {
+        g_printerr("Failed to create wakeup source\n");
         goto cleanup;
     }
 
-    g_source_set_callback(mpv_pipe_source, G_SOURCE_FUNC(event_handler), &ud, NULL);
-    g_source_attach(mpv_pipe_source, ctx);
+    g_source_set_callback(mpv_wakeup_source, G_SOURCE_FUNC(event_handler), &ud, NULL);
+    g_source_attach(mpv_wakeup_source, ctx);
 
-    // Create and attach timeout source
-    timeout_source = g_timeout_source_new(100);
-    if (!timeout_source) {
-        g_printerr("Failed to create timeout source\n");
+    // Start the D-Bus thread, it registers on the bus from its own context
+    // or talks to the broker
+    ud.dbus_thread = g_thread_try_new("mpris-dbus",
+                                      ud.use_broker ? run_broker_client : run_dbus_thread,
+                                      &ud, &error);
+    if (!ud.dbus_thread) {
+        g_printerr("Failed to start D-Bus thread: %s\n", error->message);
+        g_error_free(error);
+        error = NULL;
         goto cleanup;
     }
 
-    g_source_set_callback(timeout_source, G_SOURCE_FUNC(emit_property_changes), &ud, NULL);
-    g_source_attach(timeout_source, ctx);
+    if (ud.histograms) {
+        histogram_time_loop(ctx, &ud.histograms[HISTOGRAM_LOOP_MPV]);
+    }
 
     // Main loop - only reach here if everything succeeded
     ret = 0;
@@ -173,58 +272,125 @@ int mpv_open_cplugin(mpv_handle *mpv)
 
 cleanup:
     // Cleanup in reverse order of initialization
-    if (timeout_source) {
-        g_source_unref(timeout_source);
+    if (ud.dbus_thread) {
+        bridge_shutdown(&ud);
+        g_thread_join(ud.dbus_thread);
     }
 
-    if (mpv_pipe_source) {
-        g_source_unref(mpv_pipe_source);
+    mpv_set_wakeup_callback(mpv, NULL, NULL);
+
+    if (ud.emit_source) {
+        g_source_destroy(ud.emit_source);
+        g_source_unref(ud.emit_source);
     }
 
-    if (pipe[0] != -1) {
-        close(pipe[0]);
+    if (ud.retry_source) {
+        g_source_destroy(ud.retry_source);
     }
-    if (pipe[1] != -1) {
-        close(pipe[1]);
+
+    if (ud.metadata_settle) {
+        g_source_destroy(ud.metadata_settle);
     }
 
-    mpv_free(ud.cached_path);
-    g_free(ud.cached_art_url);
+    if (mpv_wakeup_source) {
+        g_source_destroy(mpv_wakeup_source);
+        g_source_unref(mpv_wakeup_source);
+    }
 
-    cleanup_old_cache_files();
+    wakeup_close(&ud.wakeup);
 
-    if (ud.connection) {
-        if (ud.root_interface_id) {
-            g_dbus_connection_unregister_object(ud.connection, ud.root_interface_id);
+    // Drop whatever is still in flight between the threads
+    if (ud.deltas) {
+        MprisDelta delta;
+        while (ring_pop(ud.deltas, &delta)) {
+            g_variant_unref(delta.value);
         }
-        if (ud.player_interface_id) {
-            g_dbus_connection_unregister_object(ud.connection, ud.player_interface_id);
+        ring_free(ud.deltas);
+    }
+
+    if (ud.commands) {
+        MprisCommand cmd;
+        while (ring_pop(ud.commands, &cmd)) {
+            g_strfreev(cmd.args);
+            cancel_request(cmd.invocation);
         }
+        ring_free(ud.commands);
+    }
+
+    // Requests mpv never acknowledged
+    cancel_pending_replies(&ud);
+    if (ud.replies) {
+        ring_free(ud.replies);
+    }
+    if (ud.pending_replies) {
+        g_hash_table_unref(ud.pending_replies);
+    }
+
+    if (ud.broker_socket) {
+        g_object_unref(ud.broker_socket);
+        g_byte_array_unref(ud.broker_input);
+    }
+
+    g_free(ud.p2p_socket);
+    g_free(ud.status_page_path);
+    if (ud.cache_writer) {
+        cache_writer_free(ud.cache_writer);
+    }
+    if (ud.art_fetcher) {
+        art_fetcher_free(ud.art_fetcher);
     }
+    if (ud.frame_art) {
+        frame_art_free(ud.frame_art);
+    }
+    g_free(ud.media_title);
+    g_free(ud.path);
+    g_free(ud.working_dir);
+    if (ud.tags) {
+        g_hash_table_unref(ud.tags);
+    }
+    g_free(ud.cached_path);
+    g_free(ud.cached_art_url);
+    g_free(ud.remote_art_url);
+    g_free(ud.cached_art_source);
+
+    cleanup_old_cache_files();
 
-    if (ud.bus_id) {
-        g_bus_unown_name(ud.bus_id);
+    if (ud.outgoing) {
+        g_hash_table_unref(ud.outgoing);
     }
 
     if (ud.changed_properties) {
         g_hash_table_unref(ud.changed_properties);
     }
 
-    if (ud.metadata) {
-        g_variant_unref(ud.metadata);
+    property_cache_clear(&ud.root_properties);
+    property_cache_clear(&ud.player_properties);
+    property_cache_clear(&ud.debug_properties);
+    if (ud.get_histograms) {
+        g_hash_table_unref(ud.get_histograms);
     }
+    g_free(ud.histograms);
 
     if (loop) {
         g_main_loop_unref(loop);
     }
 
+    if (ud.dbus_loop) {
+        g_main_loop_unref(ud.dbus_loop);
+    }
+
+    if (ctx && ud.dbus_context) {
+        g_main_context_pop_thread_default(ctx);
+    }
+
     if (ctx) {
         g_main_context_unref(ctx);
     }
 
-    if (introspection_data) {
-        g_dbus_node_info_unref(introspection_data);
+    if (ud.dbus_context) {
+        g_main_context_unref(ud.dbus_context);
     }
 
+    alloc_scope_leave(previous_scope);
     return ret;
 }
@@ -0,0 +1,313 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Test for the art proxy, against a small HTTP server on the loopback.
+//
+// A fetched thumbnail must be stored in the cache and reported once, a
+// fresh copy must be served without a request, a stale one revalidated
+// with If-None-Match. Redirects and chunked bodies must be followed,
+// bodies or headers over the budget and non-images must be dropped.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mpv-mpris-art-fetch.h"
+#include "test-util.h"
+
+#define ETAG "\"v1\""
+
+static const char png[] = "\x89PNG\r\n\x1a\n thumbnail";
+static const char chunks[][8] = {"\x89PNG\r\n", "\x1a\n tail"};
+
+static gint requests = 0;
+static gint not_modified = 0;
+static int fetched = 0;
+static gchar *fetched_art_url = NULL;
+
+static void respond(GString *response, const char *path, gboolean revalidated)
+{
+    if (strcmp(path, "/thumb.png") == 0 && revalidated)
+    {
+        g_atomic_int_inc(&not_modified);
+        g_string_append(response, "HTTP/1.1 304 Not Modified\r\nETag: " ETAG "\r\n\r\n");
+    }
+    else if (strcmp(path, "/thumb.png") == 0)
+    {
+        g_string_append_printf(response,
+                               "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\n"
+                               "ETag: " ETAG "\r\nContent-Length: %zu\r\n\r\n",
+                               sizeof(png) - 1);
+        g_string_append_len(response, png, sizeof(png) - 1);
+    }
+    else if (strcmp(path, "/big.png") == 0)
+    {
+        g_string_append(response, "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\n"
+                                  "Content-Length: 4096\r\n\r\n");
+        for (int i = 0; i < 4096; i++)
+        {
+            g_string_append_c(response, 'x');
+        }
+    }
+    else if (strcmp(path, "/long-header.png") == 0)
+    {
+        g_string_append(response, "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nX-Padding: ");
+        for (int i = 0; i < 4096; i++)
+        {
+            g_string_append_c(response, 'x');
+        }
+        g_string_append_printf(response, "\r\nContent-Length: %zu\r\n\r\n", sizeof(png) - 1);
+        g_string_append_len(response, png, sizeof(png) - 1);
+    }
+    else if (strcmp(path, "/redirect") == 0)
+    {
+        g_string_append(response, "HTTP/1.1 302 Found\r\nLocation: /thumb.png\r\n"
+                                  "Content-Length: 0\r\n\r\n");
+    }
+    else if (strcmp(path, "/chunked.png") == 0)
+    {
+        g_string_append(response, "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\n"
+                                  "Transfer-Encoding: chunked\r\n\r\n");
+        for (gsize i = 0; i < G_N_ELEMENTS(chunks); i++)
+        {
+            g_string_append_printf(response, "%zx\r\n%s\r\n", strlen(chunks[i]), chunks[i]);
+        }
+        g_string_append(response, "0\r\n\r\n");
+    }
+    else if (strcmp(path, "/page.html") == 0)
+    {
+        g_string_append(response, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
+                                  "Content-Length: 6\r\n\r\n<html>");
+    }
+    else
+    {
+        g_string_append(response, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    }
+}
+
+// One request per connection, the fetcher always asks to close it
+static gboolean serve(G_GNUC_UNUSED GThreadedSocketService *service,
+                      GSocketConnection *connection, G_GNUC_UNUSED GObject *source_object,
+                      G_GNUC_UNUSED gpointer data)
+{
+    GDataInputStream *input =
+        g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+    GString *response = g_string_new(NULL);
+    gboolean revalidated = FALSE;
+    char path[64] = "";
+    gchar *line;
+
+    g_data_input_stream_set_newline_type(input, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+    line = g_data_input_stream_read_line(input, NULL, NULL, NULL);
+    if (line && sscanf(line, "GET %63s", path) == 1)
+    {
+        g_free(line);
+        while ((line = g_data_input_stream_read_line(input, NULL, NULL, NULL)) && *line)
+        {
+            revalidated = revalidated || strcmp(line, "If-None-Match: " ETAG) == 0;
+            g_free(line);
+        }
+        g_atomic_int_inc(&requests);
+        respond(response, path, revalidated);
+        g_output_stream_write_all(g_io_stream_get_output_stream(G_IO_STREAM(connection)),
+                                  response->str, response->len, NULL, NULL, NULL);
+    }
+    g_free(line);
+    g_string_free(response, TRUE);
+    g_object_unref(input);
+    return TRUE;
+}
+
+static void on_fetched(G_GNUC_UNUSED const char *url, const char *art_url,
+                       G_GNUC_UNUSED gpointer data)
+{
+    fetched++;
+    g_free(fetched_art_url);
+    fetched_art_url = g_strdup(art_url);
+}
+
+static void wait_for(ArtFetcher *fetcher)
+{
+    while (art_fetcher_pending(fetcher))
+    {
+        g_main_context_iteration(NULL, TRUE);
+    }
+}
+
+static gchar *base = NULL;
+
+static gchar *url_for(const char *path)
+{
+    return g_strconcat(base, path, NULL);
+}
+
+// Fetches a single URL into a fresh cache, returns how many were reported
+static int fetch_one(const char *path)
+{
+    ArtFetchBudget budget = {.max_bytes = 1024, .timeout_s = 5, .max_running = 2};
+    gchar *cache_dir = g_dir_make_tmp("mpv-mpris-art-XXXXXX", NULL);
+    gchar *url = url_for(path);
+    ArtFetcher *fetcher;
+    int before = fetched;
+
+    g_assert_nonnull(cache_dir);
+    fetcher = art_fetcher_new(cache_dir, &budget, 3600, on_fetched, NULL);
+    g_free(art_fetcher_lookup(fetcher, url));
+    wait_for(fetcher);
+    art_fetcher_free(fetcher);
+
+    test_remove_dir(cache_dir);
+    g_free(cache_dir);
+    g_free(url);
+    return fetched - before;
+}
+
+static void test_is_remote(void)
+{
+    g_assert_true(art_fetcher_is_remote("https://i1.ytimg.com/vi/x/hqdefault.jpg"));
+    g_assert_true(art_fetcher_is_remote("HTTP://example.com/a.png"));
+    g_assert_false(art_fetcher_is_remote("file:///tmp/a.png"));
+    g_assert_false(art_fetcher_is_remote(NULL));
+}
+
+static void test_cache(void)
+{
+    ArtFetchBudget budget = {.max_bytes = 1024, .timeout_s = 5, .max_running = 2};
+    gchar *cache_dir = g_dir_make_tmp("mpv-mpris-art-XXXXXX", NULL);
+    gchar *url = url_for("/thumb.png");
+    ArtFetcher *fetcher;
+    gchar *art_url, *thumb_art_url;
+    int before = fetched;
+
+    g_assert_nonnull(cache_dir);
+    g_atomic_int_set(&requests, 0);
+    g_atomic_int_set(&not_modified, 0);
+
+    // First lookup: nothing local yet, a second lookup joins the fetch
+    fetcher = art_fetcher_new(cache_dir, &budget, 3600, on_fetched, NULL);
+    g_assert_null(art_fetcher_lookup(fetcher, url));
+    g_assert_cmpuint(art_fetcher_pending(fetcher), ==, 1);
+    g_free(art_fetcher_lookup(fetcher, url));
+    g_assert_cmpuint(art_fetcher_pending(fetcher), ==, 1);
+    wait_for(fetcher);
+    g_assert_cmpint(fetched - before, ==, 1);
+    g_assert_cmpint(g_atomic_int_get(&requests), ==, 1);
+    g_assert_true(g_str_has_prefix(fetched_art_url, "file://"));
+    g_assert_true(test_uri_equals(fetched_art_url, png));
+    thumb_art_url = g_strdup(fetched_art_url);
+
+    // Fresh: served from the cache without a request
+    art_url = art_fetcher_lookup(fetcher, url);
+    g_assert_cmpstr(art_url, ==, thumb_art_url);
+    g_assert_cmpuint(art_fetcher_pending(fetcher), ==, 0);
+    g_free(art_url);
+    art_fetcher_free(fetcher);
+
+    // Stale: still served, revalidated with its ETag, a 304 is not reported
+    fetcher = art_fetcher_new(cache_dir, &budget, 0, on_fetched, NULL);
+    art_url = art_fetcher_lookup(fetcher, url);
+    g_assert_cmpstr(art_url, ==, thumb_art_url);
+    g_free(art_url);
+    wait_for(fetcher);
+    g_assert_cmpint(g_atomic_int_get(&not_modified), ==, 1);
+    g_assert_cmpint(fetched - before, ==, 1);
+    art_fetcher_free(fetcher);
+
+    test_remove_dir(cache_dir);
+    g_free(cache_dir);
+    g_free(thumb_art_url);
+    g_free(url);
+}
+
+static void test_dropped(void)
+{
+    // Over the budget, headers over the budget, and not an image
+    g_assert_cmpint(fetch_one("/big.png"), ==, 0);
+    g_assert_cmpint(fetch_one("/long-header.png"), ==, 0);
+    g_assert_cmpint(fetch_one("/page.html"), ==, 0);
+}
+
+static void test_redirect(void)
+{
+    ArtFetchBudget budget = {.max_bytes = 1024, .timeout_s = 5, .max_running = 2};
+    gchar *cache_dir = g_dir_make_tmp("mpv-mpris-art-XXXXXX", NULL);
+    gchar *url = url_for("/redirect");
+    gchar *target = url_for("/thumb.png");
+    ArtFetcher *fetcher;
+    gchar *art_url;
+    int before = fetched;
+
+    g_assert_nonnull(cache_dir);
+    fetcher = art_fetcher_new(cache_dir, &budget, 3600, on_fetched, NULL);
+    g_free(art_fetcher_lookup(fetcher, url));
+    wait_for(fetcher);
+    g_assert_cmpint(fetched - before, ==, 1);
+    g_assert_true(test_uri_equals(fetched_art_url, png));
+
+    // Cached under the URL that was asked for, not the one redirected to
+    art_url = art_fetcher_lookup(fetcher, url);
+    g_assert_cmpstr(art_url, ==, fetched_art_url);
+    g_free(art_url);
+    g_assert_null(art_fetcher_lookup(fetcher, target));
+    wait_for(fetcher);
+
+    art_fetcher_free(fetcher);
+    test_remove_dir(cache_dir);
+    g_free(cache_dir);
+    g_free(target);
+    g_free(url);
+}
+
+static void test_chunked(void)
+{
+    g_assert_cmpint(fetch_one("/chunked.png"), ==, 1);
+    g_assert_true(test_uri_equals(fetched_art_url, "\x89PNG\r\n\x1a\n tail"));
+}
+
+int main(int argc, char *argv[])
+{
+    GSocketService *service = g_threaded_socket_service_new(4);
+    guint16 port;
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    port = g_socket_listener_add_any_inet_port(G_SOCKET_LISTENER(service), NULL, NULL);
+    g_assert_cmpuint(port, !=, 0);
+    g_signal_connect(service, "run", G_CALLBACK(serve), NULL);
+    g_socket_service_start(service);
+    base = g_strdup_printf("http://127.0.0.1:%u", port);
+
+    g_test_add_func("/art-fetch/is-remote", test_is_remote);
+    g_test_add_func("/art-fetch/cache", test_cache);
+    g_test_add_func("/art-fetch/dropped", test_dropped);
+    g_test_add_func("/art-fetch/redirect", test_redirect);
+    g_test_add_func("/art-fetch/chunked", test_chunked);
+    result = g_test_run();
+
+    g_socket_service_stop(service);
+    g_object_unref(service);
+    g_free(base);
+    g_free(fetched_art_url);
+    return result;
+}
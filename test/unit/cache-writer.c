@@ -0,0 +1,194 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Test for the art cache writes.
+//
+// A write must leave the complete file under its name and nothing else in
+// the directory, and replace a file already there. A queued write must
+// only be reported once its file is in place. The cleanup must take a
+// .meta along with its file and leave fresh files alone.
+
+#include <string.h>
+#include <utime.h>
+#include <glib/gstdio.h>
+
+#include "mpv-mpris-cache-writer.h"
+#include "test-util.h"
+
+#define WRITES 16
+
+static int reported = 0;
+static gboolean linked_when_reported = TRUE;
+
+static guint count_entries(const char *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    guint count = 0;
+
+    while (dir && g_dir_read_name(dir))
+    {
+        count++;
+    }
+    if (dir)
+    {
+        g_dir_close(dir);
+    }
+    return count;
+}
+
+static void on_written(const char *key, const char *art_url, G_GNUC_UNUSED gpointer data)
+{
+    reported++;
+    linked_when_reported = linked_when_reported && test_uri_equals(art_url, key);
+}
+
+static void test_write_file(void)
+{
+    gchar *cache_dir = g_dir_make_tmp("mpv-mpris-cache-XXXXXX", NULL);
+    gchar *path;
+
+    g_assert_nonnull(cache_dir);
+    path = g_build_filename(cache_dir, "cover.jpg", NULL);
+
+    g_assert_true(cache_write_file(path, "first", 5, NULL));
+    g_assert_true(test_file_equals(path, "first"));
+    g_assert_true(cache_write_file(path, "second", 6, NULL));
+    g_assert_true(test_file_equals(path, "second"));
+    // No temporary file is left
+    g_assert_cmpuint(count_entries(cache_dir), ==, 1);
+
+    g_free(path);
+    test_remove_dir(cache_dir);
+    g_free(cache_dir);
+}
+
+static void test_queue(void)
+{
+    gchar *cache_dir = g_dir_make_tmp("mpv-mpris-cache-XXXXXX", NULL);
+    CacheWriter *writer;
+    gint64 deadline;
+    int queued = 0;
+
+    g_assert_nonnull(cache_dir);
+
+    // Each file holds its key, which on_written() checks
+    writer = cache_writer_new(1024 * 1024, on_written, NULL);
+    for (int i = 0; i < WRITES; i++)
+    {
+        gchar *name = g_strdup_printf("queued-%d.png", i);
+        gchar *key = g_strdup_printf("/media/%d.flac", i);
+        GBytes *contents = g_bytes_new(key, strlen(key));
+        gchar *path = g_build_filename(cache_dir, name, NULL);
+
+        queued += cache_writer_queue(writer, path, contents, key);
+        g_bytes_unref(contents);
+        g_free(path);
+        g_free(key);
+        g_free(name);
+    }
+    g_assert_cmpint(queued, ==, WRITES);
+
+    deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+    while (reported < WRITES && g_get_monotonic_time() < deadline)
+    {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    g_assert_cmpint(reported, ==, WRITES);
+    g_assert_true(linked_when_reported);
+    g_assert_cmpuint(count_entries(cache_dir), ==, WRITES);
+    cache_writer_free(writer);
+
+    test_remove_dir(cache_dir);
+    g_free(cache_dir);
+}
+
+static gboolean is_png(const char *name)
+{
+    return g_str_has_suffix(name, ".png");
+}
+
+// age_s seconds since it was last written
+static void make_file(const char *cache_dir, const char *name, gint64 age_s)
+{
+    gchar *path = g_build_filename(cache_dir, name, NULL);
+    struct utimbuf times;
+
+    g_assert_true(g_file_set_contents(path, name, -1, NULL));
+    times.actime = times.modtime = g_get_real_time() / G_USEC_PER_SEC - age_s;
+    g_assert_cmpint(g_utime(path, &times), ==, 0);
+    g_free(path);
+}
+
+static gboolean exists(const char *cache_dir, const char *name)
+{
+    gchar *path = g_build_filename(cache_dir, name, NULL);
+    gboolean found = g_file_test(path, G_FILE_TEST_EXISTS);
+
+    g_free(path);
+    return found;
+}
+
+static void test_remove_old(void)
+{
+    gchar *cache_dir = g_dir_make_tmp("mpv-mpris-cache-XXXXXX", NULL);
+    const gint64 day = 24 * 60 * 60;
+
+    g_assert_nonnull(cache_dir);
+
+    // Its .meta was rewritten since, it still goes with it
+    make_file(cache_dir, "old.png", 20 * day);
+    make_file(cache_dir, "old.meta", 0);
+    make_file(cache_dir, "fresh.png", day);
+    make_file(cache_dir, "fresh.meta", day);
+    make_file(cache_dir, "orphan.meta", 20 * day);
+    make_file(cache_dir, ".tmp-1-0", day);
+    make_file(cache_dir, ".tmp-AbC123", 0);
+    make_file(cache_dir, "notes.txt", 20 * day);
+
+    cache_remove_old_files(cache_dir, 15 * day, is_png);
+
+    g_assert_false(exists(cache_dir, "old.png"));
+    g_assert_false(exists(cache_dir, "old.meta"));
+    g_assert_false(exists(cache_dir, "orphan.meta"));
+    g_assert_false(exists(cache_dir, ".tmp-1-0"));
+    g_assert_true(exists(cache_dir, "fresh.png"));
+    g_assert_true(exists(cache_dir, "fresh.meta"));
+    // A write in progress
+    g_assert_true(exists(cache_dir, ".tmp-AbC123"));
+    // Not a file of the cache
+    g_assert_true(exists(cache_dir, "notes.txt"));
+    g_assert_cmpuint(count_entries(cache_dir), ==, 4);
+
+    test_remove_dir(cache_dir);
+    g_free(cache_dir);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/cache-writer/write-file", test_write_file);
+    g_test_add_func("/cache-writer/queue", test_queue);
+    g_test_add_func("/cache-writer/remove-old", test_remove_old);
+    return g_test_run();
+}
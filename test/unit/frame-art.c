@@ -0,0 +1,229 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Test for video-frame art, with mpv replaced by the functions below.
+//
+// A grab past the offset must be stored as a downscaled PNG and reported,
+// the stored frame must be served without a grab afterwards, and a reply
+// or a position arriving after the track changed must be dropped.
+
+#include <string.h>
+
+#include "mpv-mpris-frame-art.h"
+#include "test-util.h"
+
+#define FRAME_WIDTH 640
+#define FRAME_HEIGHT 360
+#define POSITION_REPLY 17
+
+static int reads = 0;
+static int grabs = 0;
+static int aborts = 0;
+static guint64 grab_id = 0;
+static int stored = 0;
+static gchar *stored_art_url = NULL;
+
+int mpv_get_property_async(G_GNUC_UNUSED mpv_handle *ctx, uint64_t reply_userdata,
+                           const char *name, mpv_format format)
+{
+    g_assert_cmpuint(reply_userdata, ==, POSITION_REPLY);
+    g_assert_cmpstr(name, ==, "time-pos");
+    g_assert_cmpint(format, ==, MPV_FORMAT_DOUBLE);
+    reads++;
+    return MPV_ERROR_SUCCESS;
+}
+
+int mpv_command_async(G_GNUC_UNUSED mpv_handle *ctx, uint64_t reply_userdata,
+                      G_GNUC_UNUSED const char **args)
+{
+    grabs++;
+    grab_id = reply_userdata;
+    return MPV_ERROR_SUCCESS;
+}
+
+void mpv_abort_async_command(G_GNUC_UNUSED mpv_handle *ctx,
+                             G_GNUC_UNUSED uint64_t reply_userdata)
+{
+    aborts++;
+}
+
+const char *mpv_error_string(G_GNUC_UNUSED int error)
+{
+    return "error";
+}
+
+static void on_stored(G_GNUC_UNUSED const char *media, const char *art_url,
+                      G_GNUC_UNUSED gpointer data)
+{
+    stored++;
+    g_free(stored_art_url);
+    stored_art_url = g_strdup(art_url);
+}
+
+// A grey bgr0 frame with a red left half
+static void reply(FrameArt *frame_art, guint64 id)
+{
+    static guint8 pixels[FRAME_WIDTH * FRAME_HEIGHT * 4];
+    mpv_byte_array data = {pixels, sizeof(pixels)};
+    char *keys[] = {"w", "h", "stride", "format", "data"};
+    mpv_node values[G_N_ELEMENTS(keys)];
+    mpv_node_list list = {G_N_ELEMENTS(keys), values, keys};
+    mpv_event_command command = {{.u.list = &list, .format = MPV_FORMAT_NODE_MAP}};
+
+    for (int i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++)
+    {
+        gboolean red = i % FRAME_WIDTH < FRAME_WIDTH / 2;
+
+        pixels[i * 4] = red ? 0 : 128;
+        pixels[i * 4 + 1] = red ? 0 : 128;
+        pixels[i * 4 + 2] = red ? 255 : 128;
+    }
+    values[0] = (mpv_node){.u.int64 = FRAME_WIDTH, .format = MPV_FORMAT_INT64};
+    values[1] = (mpv_node){.u.int64 = FRAME_HEIGHT, .format = MPV_FORMAT_INT64};
+    values[2] = (mpv_node){.u.int64 = FRAME_WIDTH * 4, .format = MPV_FORMAT_INT64};
+    values[3] = (mpv_node){.u.string = "bgr0", .format = MPV_FORMAT_STRING};
+    values[4] = (mpv_node){.u.ba = &data, .format = MPV_FORMAT_BYTE_ARRAY};
+    frame_art_reply(frame_art, id, MPV_ERROR_SUCCESS, &command);
+}
+
+// Well past the offset of 10 s, of 100 s
+static void answer_position(FrameArt *frame_art)
+{
+    frame_art_position(frame_art, 30 * G_USEC_PER_SEC, 100 * G_USEC_PER_SEC);
+}
+
+static void iterate(int times)
+{
+    for (int i = 0; i < times; i++)
+    {
+        g_main_context_iteration(NULL, FALSE);
+    }
+}
+
+static void wait_stored(int count)
+{
+    gint64 deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+
+    while (stored < count && g_get_monotonic_time() < deadline)
+    {
+        g_main_context_iteration(NULL, TRUE);
+    }
+}
+
+static guint32 read_be32(const guint8 *data)
+{
+    return (guint32)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+static gboolean is_png_of_size(const char *art_url, guint32 width, guint32 height)
+{
+    gchar *path = art_url ? g_filename_from_uri(art_url, NULL, NULL) : NULL;
+    gchar *contents = NULL;
+    gsize length = 0;
+    gboolean ok = path && g_file_get_contents(path, &contents, &length, NULL) &&
+                  length > 24 && memcmp(contents, "\x89PNG\r\n\x1a\n", 8) == 0 &&
+                  memcmp(contents + 12, "IHDR", 4) == 0 &&
+                  read_be32((guint8 *)contents + 16) == width &&
+                  read_be32((guint8 *)contents + 20) == height;
+
+    g_free(contents);
+    g_free(path);
+    return ok;
+}
+
+static void test_grab(void)
+{
+    FrameArtOptions options = {
+        .offset_us = 10 * G_USEC_PER_SEC,
+        .max_size = 320,
+        .position_reply = POSITION_REPLY,
+    };
+    gchar *cache_dir = g_dir_make_tmp("mpv-mpris-frame-XXXXXX", NULL);
+    FrameArt *frame_art;
+    gchar *art_url;
+    guint64 stale_id;
+
+    g_assert_nonnull(cache_dir);
+    frame_art = frame_art_new(NULL, cache_dir, &options, on_stored, NULL);
+
+    // Nothing cached: a grab past the offset, its frame stored and reported
+    g_assert_null(frame_art_want(frame_art, "/media/a.mkv"));
+    iterate(3);
+    g_assert_cmpint(reads, ==, 1);
+    g_assert_cmpint(grabs, ==, 0);
+    answer_position(frame_art);
+    g_assert_cmpint(grabs, ==, 1);
+    // Grabs are told apart from requests
+    g_assert_true(grab_id & FRAME_ART_REPLY_BIT);
+    reply(frame_art, grab_id);
+    wait_stored(1);
+    g_assert_cmpint(stored, ==, 1);
+    g_assert_true(is_png_of_size(stored_art_url, 320, 180));
+
+    // Played again: served from the cache, not grabbed again
+    frame_art_reset(frame_art);
+    art_url = frame_art_want(frame_art, "/media/a.mkv");
+    g_assert_cmpstr(art_url, ==, stored_art_url);
+    iterate(3);
+    g_assert_cmpint(reads, ==, 1);
+    g_assert_cmpint(grabs, ==, 1);
+    g_free(art_url);
+
+    // Track change while grabbing: aborted, the late reply dropped
+    g_free(frame_art_want(frame_art, "/media/b.mkv"));
+    iterate(3);
+    answer_position(frame_art);
+    g_assert_cmpint(grabs, ==, 2);
+    stale_id = grab_id;
+    frame_art_reset(frame_art);
+    g_assert_cmpint(aborts, ==, 1);
+    g_free(frame_art_want(frame_art, "/media/c.mkv"));
+    reply(frame_art, stale_id);
+    iterate(10);
+    g_assert_cmpint(stored, ==, 1);
+
+    // Track change while reading the position: read again, then grab
+    g_assert_cmpint(reads, ==, 3);
+    frame_art_reset(frame_art);
+    g_free(frame_art_want(frame_art, "/media/d.mkv"));
+    iterate(3);
+    g_assert_cmpint(reads, ==, 3);
+    answer_position(frame_art);
+    g_assert_cmpint(reads, ==, 4);
+    g_assert_cmpint(grabs, ==, 2);
+    answer_position(frame_art);
+    g_assert_cmpint(grabs, ==, 3);
+
+    frame_art_free(frame_art);
+    test_remove_dir(cache_dir);
+    g_free(cache_dir);
+    g_free(stored_art_url);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/frame-art/grab", test_grab);
+    return g_test_run();
+}
@@ -0,0 +1,107 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Test for the latency histograms behind org.mpv.MprisDebug.
+//
+// Every value must land in a bucket whose upper bound is at most 12.5%
+// above it, percentiles must follow the recorded distribution and Reset
+// must empty the histogram.
+
+#include "mpv-mpris-histogram.h"
+
+static gboolean within(gint64 bound, gint64 value)
+{
+    return bound >= value && bound <= value + value / 8;
+}
+
+static void test_bucket_bounds(void)
+{
+    MprisHistogram *histogram = g_new0(MprisHistogram, 1);
+
+    for (gint64 value = 1; value < G_GINT64_CONSTANT(1) << 60; value = value * 3 + 1)
+    {
+        histogram_reset(histogram);
+        histogram_record(histogram, value);
+        g_assert_true(within(histogram_percentile(histogram, 100), value));
+    }
+    g_free(histogram);
+}
+
+static void test_percentiles(void)
+{
+    MprisHistogram *histogram = g_new0(MprisHistogram, 1);
+    GVariant *snapshot;
+    guint64 count = 0, p99 = 0;
+
+    g_assert_cmpint(histogram_percentile(histogram, 50), ==, 0);
+
+    // 990 fast samples around 1 us, 10 slow ones around 1 ms
+    for (int i = 0; i < 990; i++)
+    {
+        histogram_record(histogram, 1000);
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        histogram_record(histogram, 1000000);
+    }
+    g_assert_true(within(histogram_percentile(histogram, 50), 1000));
+    g_assert_true(within(histogram_percentile(histogram, 99), 1000));
+    g_assert_true(within(histogram_percentile(histogram, 99.9), 1000000));
+
+    snapshot = g_variant_ref_sink(histogram_snapshot(histogram));
+    g_variant_lookup(snapshot, "count", "t", &count);
+    g_variant_lookup(snapshot, "p99", "t", &p99);
+    g_assert_cmpuint(count, ==, 1000);
+    g_assert_true(within(p99, 1000));
+    g_variant_unref(snapshot);
+
+    g_free(histogram);
+}
+
+static void test_reset(void)
+{
+    MprisHistogram *histogram = g_new0(MprisHistogram, 1);
+    GVariant *snapshot;
+    guint64 count = 1, p50 = 0;
+
+    histogram_record(histogram, 1000);
+    histogram_reset(histogram);
+    snapshot = g_variant_ref_sink(histogram_snapshot(histogram));
+    g_variant_lookup(snapshot, "count", "t", &count);
+    g_assert_cmpuint(count, ==, 0);
+    g_assert_false(g_variant_lookup(snapshot, "p50", "t", &p50));
+    g_variant_unref(snapshot);
+
+    g_free(histogram);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/histogram/bucket-bounds", test_bucket_bounds);
+    g_test_add_func("/histogram/percentiles", test_percentiles);
+    g_test_add_func("/histogram/reset", test_reset);
+    return g_test_run();
+}
@@ -0,0 +1,123 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Test for the property cache answering Get and GetAll.
+//
+// The GetAll reply must be the same object until a property changes, hold
+// every property in introspection order, and replacing a live value such
+// as Position must not touch the cached reply.
+
+#include "mpv-mpris-props.h"
+
+static const char *xml =
+    "<node>\n"
+    "  <interface name=\"org.example.Test\">\n"
+    "    <property name=\"Status\" type=\"s\" access=\"read\"/>\n"
+    "    <property name=\"Position\" type=\"x\" access=\"read\"/>\n"
+    "    <property name=\"CanPlay\" type=\"b\" access=\"read\"/>\n"
+    "  </interface>\n"
+    "</node>\n";
+
+static gboolean reply_equals(GVariant *reply, const char *text)
+{
+    GVariant *expected = g_variant_parse(G_VARIANT_TYPE("(a{sv})"), text,
+                                         NULL, NULL, NULL);
+    gboolean equal = expected && g_variant_equal(reply, expected);
+
+    if (!equal)
+    {
+        gchar *printed = g_variant_print(reply, TRUE);
+        g_test_message("got %s, expected %s", printed, text);
+        g_free(printed);
+    }
+    if (expected)
+    {
+        g_variant_unref(expected);
+    }
+    return equal;
+}
+
+static void test_get_all(void)
+{
+    GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(xml, NULL);
+    PropertyCache cache = {0};
+    GVariant *first, *second, *live;
+
+    property_cache_init(&cache, node->interfaces[0]);
+    property_cache_set(&cache, "CanPlay", g_variant_new_boolean(TRUE));
+    property_cache_set(&cache, "Status", g_variant_new_string("Stopped"));
+
+    // Unset properties are left out, the order follows introspection
+    first = property_cache_get_all(&cache);
+    g_assert_true(reply_equals(first, "({'Status': <'Stopped'>, 'CanPlay': <true>},)"));
+    g_assert_true(property_cache_get_all(&cache) == first);
+
+    property_cache_set(&cache, "Position", g_variant_new_int64(42));
+    second = property_cache_get_all(&cache);
+    g_assert_true(reply_equals(second, "({'Status': <'Stopped'>, 'Position': <int64 42>, "
+                                       "'CanPlay': <true>},)"));
+
+    // A live value replaces the cached one and leaves the cache clean
+    g_variant_ref(second);
+    live = g_variant_ref_sink(property_cache_get_all_with(&cache, "Position",
+                                                          g_variant_new_int64(99)));
+    g_assert_true(reply_equals(live, "({'Status': <'Stopped'>, 'Position': <int64 99>, "
+                                     "'CanPlay': <true>},)"));
+    g_assert_true(property_cache_get_all(&cache) == second);
+
+    g_variant_unref(live);
+    g_variant_unref(second);
+    property_cache_clear(&cache);
+    g_dbus_node_info_unref(node);
+}
+
+static void test_get(void)
+{
+    GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(xml, NULL);
+    PropertyCache cache = {0};
+    GVariant *value, *inner;
+
+    property_cache_init(&cache, node->interfaces[0]);
+    property_cache_set(&cache, "Position", g_variant_new_int64(42));
+
+    value = property_cache_get(&cache, "Position");
+    g_assert_nonnull(value);
+    inner = g_variant_get_variant(value);
+    g_assert_cmpint(g_variant_get_int64(inner), ==, 42);
+    g_assert_null(property_cache_get(&cache, "Missing"));
+
+    g_variant_unref(inner);
+    g_variant_unref(value);
+    property_cache_clear(&cache);
+    g_dbus_node_info_unref(node);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/property-cache/get-all", test_get_all);
+    g_test_add_func("/property-cache/get", test_get);
+    return g_test_run();
+}
@@ -0,0 +1,230 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Test for the rings connecting the mpv and D-Bus threads.
+//
+// A push into a full ring must fail instead of waiting for the consumer.
+// Two threads then stand in for the mpv thread and the D-Bus thread, each
+// one pushing numbered items to the other at a steady rate while its own
+// drain callback is slowed down by synthetic work, as a slow D-Bus client
+// or a slow metadata build would. Every pushed item must arrive once and
+// in order. bench/ring-latency reports the latencies of the same setup.
+
+#include <stdio.h>
+
+#include "mpv-mpris-ring.h"
+
+#define ITEMS_PER_SIDE 20000
+#define BURST 16
+#define RING_SIZE 256
+
+typedef struct Side {
+    const char *name;
+    GMainContext *context;
+    GMainLoop *loop;
+    GThread *thread;
+    MprisRing *in;  // drained on this side
+    MprisRing *out; // filled on this side
+    gulong work_us; // synthetic load per drain
+    guint attempted;
+    gint sent;
+    gint received;
+    gint dropped;
+    guint next_seq;
+    guint expected_seq;
+    gboolean out_of_order;
+} Side;
+
+static void test_full(void)
+{
+    MprisRing *ring = ring_new(RING_SIZE, sizeof(guint));
+    guint value;
+
+    for (guint i = 0; i < RING_SIZE; i++)
+    {
+        g_assert_true(ring_push(ring, &i));
+    }
+    g_assert_cmpuint(ring_length(ring), ==, RING_SIZE);
+
+    // Nobody drains the ring, so a waiting push would never return
+    value = RING_SIZE;
+    g_assert_false(ring_push(ring, &value));
+    g_assert_cmpuint(ring_length(ring), ==, RING_SIZE);
+
+    g_assert_true(ring_pop(ring, &value));
+    g_assert_cmpuint(value, ==, 0);
+    value = RING_SIZE;
+    g_assert_true(ring_push(ring, &value));
+
+    for (guint i = 1; i <= RING_SIZE; i++)
+    {
+        g_assert_true(ring_pop(ring, &value));
+        g_assert_cmpuint(value, ==, i);
+    }
+    g_assert_false(ring_pop(ring, &value));
+
+    ring_free(ring);
+}
+
+static gboolean produce(gpointer data)
+{
+    Side *side = data;
+
+    for (int i = 0; i < BURST && side->attempted < ITEMS_PER_SIDE; i++)
+    {
+        side->attempted++;
+        if (ring_push(side->out, &side->next_seq))
+        {
+            side->next_seq++;
+            g_atomic_int_inc(&side->sent);
+        }
+        else
+        {
+            g_atomic_int_inc(&side->dropped);
+        }
+    }
+    ring_notify(side->out);
+
+    return side->attempted < ITEMS_PER_SIDE ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static gboolean consume(gpointer data)
+{
+    Side *side = data;
+    guint seq;
+
+    while (ring_pop(side->in, &seq))
+    {
+        if (seq != side->expected_seq)
+        {
+            side->out_of_order = TRUE;
+        }
+        side->expected_seq = seq + 1;
+        g_atomic_int_inc(&side->received);
+    }
+
+    g_usleep(side->work_us);
+    return G_SOURCE_CONTINUE;
+}
+
+static gpointer run_side(gpointer data)
+{
+    Side *side = data;
+    GSource *timer = g_timeout_source_new(1);
+
+    g_main_context_push_thread_default(side->context);
+    g_source_set_callback(timer, produce, side, NULL);
+    g_source_attach(timer, side->context);
+    g_source_unref(timer);
+
+    g_main_loop_run(side->loop);
+
+    g_main_context_pop_thread_default(side->context);
+    return NULL;
+}
+
+static void init_side(Side *side, const char *name, gulong work_us,
+                      MprisRing *in, MprisRing *out)
+{
+    GSource *source;
+
+    side->name = name;
+    side->work_us = work_us;
+    side->in = in;
+    side->out = out;
+    side->context = g_main_context_new();
+    side->loop = g_main_loop_new(side->context, FALSE);
+
+    source = ring_source_new(in, consume, side);
+    g_source_attach(source, side->context);
+    g_source_unref(source);
+}
+
+static gboolean check(Side *receiver, Side *sender)
+{
+    gboolean ok = TRUE;
+
+    if (receiver->out_of_order)
+    {
+        fprintf(stderr, "%s received items out of order\n", receiver->name);
+        ok = FALSE;
+    }
+    if (receiver->received != sender->sent)
+    {
+        fprintf(stderr, "%s received %d of %d items\n", receiver->name,
+                receiver->received, sender->sent);
+        ok = FALSE;
+    }
+    return ok;
+}
+
+static void test_threads(void)
+{
+    MprisRing *deltas = ring_new(RING_SIZE, sizeof(guint));
+    MprisRing *commands = ring_new(RING_SIZE, sizeof(guint));
+    Side mpv_side = {0};
+    Side dbus_side = {0};
+    gint64 deadline;
+    gboolean ok;
+
+    // The D-Bus side is the slower one, like a client stalling GetAll
+    init_side(&mpv_side, "mpv", 2000, commands, deltas);
+    init_side(&dbus_side, "dbus", 20000, deltas, commands);
+
+    mpv_side.thread = g_thread_new("mpv", run_side, &mpv_side);
+    dbus_side.thread = g_thread_new("dbus", run_side, &dbus_side);
+
+    // Wait until both sides are done and everything pushed was drained
+    deadline = g_get_monotonic_time() + 60 * G_USEC_PER_SEC;
+    while (g_get_monotonic_time() < deadline &&
+           (g_atomic_int_get(&mpv_side.received) +
+                g_atomic_int_get(&dbus_side.dropped) < ITEMS_PER_SIDE ||
+            g_atomic_int_get(&dbus_side.received) +
+                g_atomic_int_get(&mpv_side.dropped) < ITEMS_PER_SIDE))
+    {
+        g_usleep(10000);
+    }
+
+    g_main_loop_quit(mpv_side.loop);
+    g_main_loop_quit(dbus_side.loop);
+    g_thread_join(mpv_side.thread);
+    g_thread_join(dbus_side.thread);
+
+    ok = check(&dbus_side, &mpv_side);
+    ok = check(&mpv_side, &dbus_side) && ok;
+
+    ring_free(deltas);
+    ring_free(commands);
+
+    g_assert_true(ok);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/ring/full", test_full);
+    g_test_add_func("/ring/threads", test_threads);
+    return g_test_run();
+}
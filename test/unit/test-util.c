@@ -0,0 +1,66 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "test-util.h"
+
+void test_remove_dir(const char *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    const char *name;
+
+    while (dir && (name = g_dir_read_name(dir)))
+    {
+        gchar *file = g_build_filename(path, name, NULL);
+        g_remove(file);
+        g_free(file);
+    }
+    if (dir)
+    {
+        g_dir_close(dir);
+    }
+    g_rmdir(path);
+}
+
+gboolean test_file_equals(const char *path, const char *expected)
+{
+    gchar *contents = NULL;
+    gsize length = 0;
+    gboolean same = path && g_file_get_contents(path, &contents, &length, NULL) &&
+                    length == strlen(expected) && memcmp(contents, expected, length) == 0;
+
+    g_free(contents);
+    return same;
+}
+
+gboolean test_uri_equals(const char *art_url, const char *expected)
+{
+    gchar *path = art_url ? g_filename_from_uri(art_url, NULL, NULL) : NULL;
+    gboolean same = test_file_equals(path, expected);
+
+    g_free(path);
+    return same;
+}
@@ -0,0 +1,207 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Test for the framing between the plugin and the broker daemon.
+//
+// Frames sent over a socket pair must come out unchanged, also when they
+// arrive in pieces, and oversized or malformed frames must be rejected.
+
+#include <sys/socket.h>
+
+#include "mpv-mpris-wire.h"
+
+static void socket_pair(GSocket **plugin, GSocket **broker)
+{
+    int fds[2];
+
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+    *plugin = g_socket_new_from_fd(fds[0], NULL);
+    *broker = g_socket_new_from_fd(fds[1], NULL);
+}
+
+static GVariant *receive_one(GSocket *socket, GByteArray *buffer,
+                             const GVariantType *type)
+{
+    GVariant *message = NULL;
+
+    for (int i = 0; i < 100 && !message; i++)
+    {
+        wire_receive(socket, buffer, NULL);
+        message = wire_next(buffer, type, NULL);
+        if (!message)
+        {
+            g_usleep(1000);
+        }
+    }
+    return message;
+}
+
+static void test_delta(void)
+{
+    GSocket *plugin, *broker;
+    GByteArray *buffer = g_byte_array_new();
+    GVariant *value = g_variant_ref_sink(g_variant_new("(xx)", (gint64)42, (gint64)7));
+    GVariant *message;
+    const char *name;
+    GVariant *received;
+
+    socket_pair(&plugin, &broker);
+    g_assert_true(wire_send(plugin, wire_delta("Position", value), NULL));
+    message = receive_one(broker, buffer, WIRE_DELTA_TYPE);
+    g_assert_nonnull(message);
+
+    g_variant_get(message, "(&sv)", &name, &received);
+    g_assert_cmpstr(name, ==, "Position");
+    g_assert_true(g_variant_equal(received, value));
+    g_assert_cmpuint(buffer->len, ==, 0);
+
+    g_variant_unref(received);
+    g_variant_unref(message);
+
+    g_variant_unref(value);
+    g_byte_array_unref(buffer);
+    g_object_unref(plugin);
+    g_object_unref(broker);
+}
+
+static void test_command(void)
+{
+    GSocket *plugin, *broker;
+    GByteArray *buffer = g_byte_array_new();
+    const char *args[] = {"seek", "1.5", NULL};
+    MprisCommand sent = {0};
+    MprisCommand received = {0};
+    GVariant *message;
+
+    socket_pair(&plugin, &broker);
+    sent.kind = COMMAND_RUN;
+    sent.args = (gchar **)args;
+    sent.request = 3;
+    sent.parts = 2;
+    g_assert_true(wire_send(broker, wire_command(&sent), NULL));
+
+    message = receive_one(plugin, buffer, WIRE_COMMAND_TYPE);
+    g_assert_nonnull(message);
+    wire_parse_command(message, &received);
+    g_assert_cmpint(received.kind, ==, COMMAND_RUN);
+    g_assert_null(received.property);
+    g_assert_nonnull(received.args);
+    g_assert_cmpuint(g_strv_length(received.args), ==, 2);
+    g_assert_cmpstr(received.args[1], ==, "1.5");
+    g_assert_cmpuint(received.request, ==, 3);
+    g_assert_cmpuint(received.parts, ==, 2);
+
+    g_strfreev(received.args);
+    g_variant_unref(message);
+
+    g_byte_array_unref(buffer);
+    g_object_unref(plugin);
+    g_object_unref(broker);
+}
+
+static void test_reply(void)
+{
+    GSocket *plugin, *broker;
+    GByteArray *buffer = g_byte_array_new();
+    GVariant *message;
+    const char *name, *error;
+    GVariant *value;
+    guint32 request;
+
+    socket_pair(&plugin, &broker);
+    g_assert_true(wire_send(plugin, wire_reply(5, NULL), NULL));
+    g_assert_true(wire_send(plugin, wire_reply(6, "property unavailable"), NULL));
+
+    message = receive_one(broker, buffer, WIRE_DELTA_TYPE);
+    g_assert_nonnull(message);
+    g_variant_get(message, "(&sv)", &name, &value);
+    g_assert_cmpstr(name, ==, WIRE_REPLY);
+    g_assert_true(g_variant_is_of_type(value, WIRE_REPLY_TYPE));
+    g_variant_get(value, "(u&s)", &request, &error);
+    g_assert_cmpuint(request, ==, 5);
+    g_assert_cmpstr(error, ==, "");
+    g_variant_unref(value);
+    g_variant_unref(message);
+
+    message = receive_one(broker, buffer, WIRE_DELTA_TYPE);
+    g_assert_nonnull(message);
+    g_variant_get(message, "(&sv)", &name, &value);
+    g_variant_get(value, "(u&s)", &request, &error);
+    g_assert_cmpuint(request, ==, 6);
+    g_assert_cmpstr(error, ==, "property unavailable");
+    g_variant_unref(value);
+    g_variant_unref(message);
+
+    g_byte_array_unref(buffer);
+    g_object_unref(plugin);
+    g_object_unref(broker);
+}
+
+static void test_partial_frames(void)
+{
+    GVariant *message = g_variant_ref_sink(wire_delta("Volume", g_variant_new_double(0.5)));
+    gsize size = g_variant_get_size(message);
+    guint32 header = GUINT32_TO_LE((guint32)size);
+    guint8 *data = g_malloc(size);
+    GByteArray *buffer = g_byte_array_new();
+    GVariant *received;
+    GError *error = NULL;
+
+    g_variant_store(message, data);
+    g_byte_array_append(buffer, (guint8 *)&header, 2);
+    // Half a header, then an incomplete body
+    g_assert_null(wire_next(buffer, WIRE_DELTA_TYPE, &error));
+    g_assert_no_error(error);
+    g_byte_array_append(buffer, (guint8 *)&header + 2, 2);
+    g_byte_array_append(buffer, data, size - 1);
+    g_assert_null(wire_next(buffer, WIRE_DELTA_TYPE, &error));
+    g_assert_no_error(error);
+    g_byte_array_append(buffer, data + size - 1, 1);
+
+    received = wire_next(buffer, WIRE_DELTA_TYPE, &error);
+    g_assert_nonnull(received);
+    g_assert_true(g_variant_equal(received, message));
+    g_variant_unref(received);
+
+    header = GUINT32_TO_LE((guint32)WIRE_MAX_FRAME + 1);
+    g_byte_array_append(buffer, (guint8 *)&header, sizeof(header));
+    g_assert_null(wire_next(buffer, WIRE_DELTA_TYPE, &error));
+    g_assert_nonnull(error);
+    g_clear_error(&error);
+
+    g_free(data);
+    g_variant_unref(message);
+    g_byte_array_unref(buffer);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/wire/delta", test_delta);
+    g_test_add_func("/wire/command", test_command);
+    g_test_add_func("/wire/reply", test_reply);
+    g_test_add_func("/wire/partial-frames", test_partial_frames);
+    return g_test_run();
+}
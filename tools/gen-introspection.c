@@ -0,0 +1,292 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Build-time generator for the D-Bus introspection data.
+//
+// Reads the interface definition and writes a C file with every interface
+// as static const GDBusInterfaceInfo, plus the header declaring them, so
+// the plugin does not parse XML at startup. All structures use a reference
+// count of -1, which GDBus treats as static and never frees.
+//
+// Usage: gen-introspection DEFINITION.xml OUTPUT.c OUTPUT.h
+//
+// An interface org.example.Foo becomes org_example_foo_interface.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gio/gio.h>
+
+static gchar *symbol_for(const char *interface_name)
+{
+    gchar *symbol = g_ascii_strdown(interface_name, -1);
+
+    g_strdelimit(symbol, ".", '_');
+    return symbol;
+}
+
+// Writes a NULL-terminated array named prefix and returns whether there
+// was anything to write
+static gboolean write_args(GString *out, const char *prefix, GDBusArgInfo **args)
+{
+    guint n = 0;
+
+    if (!args || !args[0])
+    {
+        return FALSE;
+    }
+
+    for (; args[n]; n++)
+    {
+        g_string_append_printf(out,
+                               "static const GDBusArgInfo %s_%u = {\n"
+                               "    -1, (gchar *)\"%s\", (gchar *)\"%s\", NULL};\n",
+                               prefix, n, args[n]->name, args[n]->signature);
+    }
+
+    g_string_append_printf(out, "static const GDBusArgInfo *const %s[] = {\n", prefix);
+    for (guint i = 0; i < n; i++)
+    {
+        g_string_append_printf(out, "    &%s_%u,\n", prefix, i);
+    }
+    g_string_append(out, "    NULL};\n\n");
+    return TRUE;
+}
+
+static void append_ref(GString *out, const char *type, const char *name, gboolean present)
+{
+    if (present)
+    {
+        g_string_append_printf(out, "(%s **)%s", type, name);
+    }
+    else
+    {
+        g_string_append(out, "NULL");
+    }
+}
+
+static void write_methods(GString *out, const char *symbol, GDBusMethodInfo **methods)
+{
+    guint n = 0;
+
+    for (; methods && methods[n]; n++)
+    {
+        gchar *in = g_strdup_printf("%s_method_%u_in", symbol, n);
+        gchar *out_args = g_strdup_printf("%s_method_%u_out", symbol, n);
+        gboolean has_in = write_args(out, in, methods[n]->in_args);
+        gboolean has_out = write_args(out, out_args, methods[n]->out_args);
+
+        g_string_append_printf(out,
+                               "static const GDBusMethodInfo %s_method_%u = {\n"
+                               "    -1, (gchar *)\"%s\", ",
+                               symbol, n, methods[n]->name);
+        append_ref(out, "GDBusArgInfo", in, has_in);
+        g_string_append(out, ", ");
+        append_ref(out, "GDBusArgInfo", out_args, has_out);
+        g_string_append(out, ", NULL};\n\n");
+
+        g_free(in);
+        g_free(out_args);
+    }
+
+    if (n)
+    {
+        g_string_append_printf(out, "static const GDBusMethodInfo *const %s_methods[] = {\n", symbol);
+        for (guint i = 0; i < n; i++)
+        {
+            g_string_append_printf(out, "    &%s_method_%u,\n", symbol, i);
+        }
+        g_string_append(out, "    NULL};\n\n");
+    }
+}
+
+static void write_signals(GString *out, const char *symbol, GDBusSignalInfo **signals)
+{
+    guint n = 0;
+
+    for (; signals && signals[n]; n++)
+    {
+        gchar *args = g_strdup_printf("%s_signal_%u_args", symbol, n);
+        gboolean has_args = write_args(out, args, signals[n]->args);
+
+        g_string_append_printf(out,
+                               "static const GDBusSignalInfo %s_signal_%u = {\n"
+                               "    -1, (gchar *)\"%s\", ",
+                               symbol, n, signals[n]->name);
+        append_ref(out, "GDBusArgInfo", args, has_args);
+        g_string_append(out, ", NULL};\n\n");
+        g_free(args);
+    }
+
+    if (n)
+    {
+        g_string_append_printf(out, "static const GDBusSignalInfo *const %s_signals[] = {\n", symbol);
+        for (guint i = 0; i < n; i++)
+        {
+            g_string_append_printf(out, "    &%s_signal_%u,\n", symbol, i);
+        }
+        g_string_append(out, "    NULL};\n\n");
+    }
+}
+
+static const char *property_flags(GDBusPropertyInfoFlags flags)
+{
+    gboolean readable = flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE;
+    gboolean writable = flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE;
+
+    if (readable && writable)
+    {
+        return "(GDBusPropertyInfoFlags)(G_DBUS_PROPERTY_INFO_FLAGS_READABLE | "
+               "G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE)";
+    }
+    if (readable)
+    {
+        return "G_DBUS_PROPERTY_INFO_FLAGS_READABLE";
+    }
+    if (writable)
+    {
+        return "G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE";
+    }
+    return "G_DBUS_PROPERTY_INFO_FLAGS_NONE";
+}
+
+static void write_properties(GString *out, const char *symbol, GDBusPropertyInfo **properties)
+{
+    guint n = 0;
+
+    for (; properties && properties[n]; n++)
+    {
+        g_string_append_printf(out,
+                               "static const GDBusPropertyInfo %s_property_%u = {\n"
+                               "    -1, (gchar *)\"%s\", (gchar *)\"%s\",\n"
+                               "    %s, NULL};\n\n",
+                               symbol, n, properties[n]->name, properties[n]->signature,
+                               property_flags(properties[n]->flags));
+    }
+
+    if (n)
+    {
+        g_string_append_printf(out, "static const GDBusPropertyInfo *const %s_properties[] = {\n", symbol);
+        for (guint i = 0; i < n; i++)
+        {
+            g_string_append_printf(out, "    &%s_property_%u,\n", symbol, i);
+        }
+        g_string_append(out, "    NULL};\n\n");
+    }
+}
+
+static void write_interface(GString *source, GString *header, GDBusInterfaceInfo *info)
+{
+    gchar *symbol = symbol_for(info->name);
+    gchar *methods = g_strconcat(symbol, "_methods", NULL);
+    gchar *signals = g_strconcat(symbol, "_signals", NULL);
+    gchar *properties = g_strconcat(symbol, "_properties", NULL);
+
+    g_string_append_printf(source, "// %s\n\n", info->name);
+    write_methods(source, symbol, info->methods);
+    write_signals(source, symbol, info->signals);
+    write_properties(source, symbol, info->properties);
+
+    g_string_append_printf(source,
+                           "const GDBusInterfaceInfo %s_interface = {\n"
+                           "    -1, (gchar *)\"%s\",\n    ",
+                           symbol, info->name);
+    append_ref(source, "GDBusMethodInfo", methods, info->methods && info->methods[0]);
+    g_string_append(source, ",\n    ");
+    append_ref(source, "GDBusSignalInfo", signals, info->signals && info->signals[0]);
+    g_string_append(source, ",\n    ");
+    append_ref(source, "GDBusPropertyInfo", properties,
+               info->properties && info->properties[0]);
+    g_string_append(source, ",\n    NULL};\n\n");
+
+    g_string_append_printf(header, "extern const GDBusInterfaceInfo %s_interface;\n", symbol);
+
+    g_free(properties);
+    g_free(signals);
+    g_free(methods);
+    g_free(symbol);
+}
+
+int main(int argc, char **argv)
+{
+    GDBusNodeInfo *node;
+    GString *source, *header;
+    GError *error = NULL;
+    gchar *xml = NULL, *guard, *header_name;
+    int ret = EXIT_FAILURE;
+
+    if (argc != 4)
+    {
+        g_printerr("Usage: %s DEFINITION.xml OUTPUT.c OUTPUT.h\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!g_file_get_contents(argv[1], &xml, NULL, &error) ||
+        !(node = g_dbus_node_info_new_for_xml(xml, &error)))
+    {
+        g_printerr("%s: %s\n", argv[1], error->message);
+        g_error_free(error);
+        g_free(xml);
+        return EXIT_FAILURE;
+    }
+
+    header_name = g_path_get_basename(argv[3]);
+    guard = g_ascii_strup(header_name, -1);
+    g_strcanon(guard, "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789", '_');
+
+    source = g_string_new(NULL);
+    header = g_string_new(NULL);
+    g_string_append_printf(source,
+                           "// Generated by gen-introspection from %s, do not edit.\n\n"
+                           "#include \"%s\"\n\n",
+                           argv[1], header_name);
+    g_string_append_printf(header,
+                           "// Generated by gen-introspection from %s, do not edit.\n\n"
+                           "#ifndef %s\n#define %s\n\n#include <gio/gio.h>\n\n",
+                           argv[1], guard, guard);
+
+    for (guint i = 0; node->interfaces && node->interfaces[i]; i++)
+    {
+        write_interface(source, header, node->interfaces[i]);
+    }
+    g_string_append_printf(header, "\n#endif // %s\n", guard);
+
+    if (!g_file_set_contents(argv[2], source->str, source->len, &error) ||
+        !g_file_set_contents(argv[3], header->str, header->len, &error))
+    {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+    }
+    else
+    {
+        ret = EXIT_SUCCESS;
+    }
+
+    g_string_free(source, TRUE);
+    g_string_free(header, TRUE);
+    g_free(guard);
+    g_free(header_name);
+    g_free(xml);
+    g_dbus_node_info_unref(node);
+    return ret;
+}
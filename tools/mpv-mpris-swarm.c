@@ -0,0 +1,645 @@
+/*
+    MIT License
+
+    Copyright (c) 2025 Mattia Tognela
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// MPRIS client swarm: load generator for a running mpv with the plugin.
+//
+// Starts N clients, each with its own bus connection and thread, which
+// subscribe to PropertiesChanged and Seeked like a desktop shell would and
+// call Get, GetAll, PlayPause, Seek and SetPosition in a configurable mix
+// at a fixed rate (open loop: calls do not wait for earlier replies).
+// Reports the completed calls per second, latency percentiles per call
+// and the CPU time mpv and the plugin's D-Bus thread used meanwhile.
+//
+// With --ramp the run is repeated with 1, 2, 4, ... up to N clients,
+// which shows from how many clients on the controls start to lag.
+//
+// PlayPause, Seek and SetPosition do change playback, so point it at an
+// mpv instance started for the purpose.
+
+// sysconf() is POSIX, not part of -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "mpv-mpris-histogram.h"
+
+#define MPRIS_PATH "/org/mpris/MediaPlayer2"
+#define PLAYER_INTERFACE "org.mpris.MediaPlayer2.Player"
+#define DRAIN_TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+typedef enum CallId {
+    CALL_GET,
+    CALL_GET_ALL,
+    CALL_PLAY_PAUSE,
+    CALL_SEEK,
+    CALL_SET_POSITION,
+    CALL_COUNT,
+} CallId;
+
+static const char *const call_names[CALL_COUNT] = {
+    [CALL_GET] = "get",
+    [CALL_GET_ALL] = "getall",
+    [CALL_PLAY_PAUSE] = "playpause",
+    [CALL_SEEK] = "seek",
+    [CALL_SET_POSITION] = "setposition",
+};
+
+// What Get asks for, in turn
+static const char *const get_properties[] = {
+    "PlaybackStatus", "Position", "Metadata", "Volume", "CanGoNext",
+};
+
+typedef struct Swarm {
+    const char *destination;
+    gchar *address;
+    double rate; // calls per second and client
+    guint weights[CALL_COUNT];
+    guint weight_total;
+    gint64 end_time;
+
+    MprisHistogram latency[CALL_COUNT];
+    gint calls[CALL_COUNT];
+    gint errors[CALL_COUNT];
+    gint signals;
+} Swarm;
+
+typedef struct Client {
+    Swarm *swarm;
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+    GDBusConnection *connection;
+    GRand *rand;
+    gchar *track_id;
+    gint64 start;
+    guint64 issued;
+    guint in_flight;
+    guint next_get;
+    gboolean failed;
+} Client;
+
+typedef struct Call {
+    Client *client;
+    CallId id;
+    gint64 start;
+} Call;
+
+typedef struct CpuTimes {
+    guint64 process; // clock ticks
+    guint64 dbus_thread;
+} CpuTimes;
+
+static gboolean parse_mix(const char *mix, Swarm *swarm, GError **error)
+{
+    gchar **items = g_strsplit(mix, ",", -1);
+    gboolean ok = TRUE;
+
+    memset(swarm->weights, 0, sizeof(swarm->weights));
+    for (gchar **item = items; ok && *item; item++)
+    {
+        gchar **pair = g_strsplit(*item, "=", 2);
+        int id = -1;
+
+        for (int i = 0; pair[0] && i < CALL_COUNT; i++)
+        {
+            if (g_strcmp0(g_strstrip(pair[0]), call_names[i]) == 0)
+            {
+                id = i;
+            }
+        }
+
+        if (id < 0 || !pair[1])
+        {
+            g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                        "Bad mix entry \"%s\", expected NAME=WEIGHT with NAME one of "
+                        "get, getall, playpause, seek, setposition", *item);
+            ok = FALSE;
+        }
+        else
+        {
+            swarm->weights[id] = (guint)g_ascii_strtoull(pair[1], NULL, 10);
+        }
+        g_strfreev(pair);
+    }
+    g_strfreev(items);
+
+    swarm->weight_total = 0;
+    for (int i = 0; i < CALL_COUNT; i++)
+    {
+        swarm->weight_total += swarm->weights[i];
+    }
+    if (ok && !swarm->weight_total)
+    {
+        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                    "The mix has no calls");
+        ok = FALSE;
+    }
+    return ok;
+}
+
+static void update_track_id(Client *client, GVariant *metadata)
+{
+    const char *track_id;
+
+    if (g_variant_lookup(metadata, "mpris:trackid", "&o", &track_id))
+    {
+        g_free(client->track_id);
+        client->track_id = g_strdup(track_id);
+    }
+}
+
+static void on_signal(G_GNUC_UNUSED GDBusConnection *connection,
+                      G_GNUC_UNUSED const char *sender,
+                      G_GNUC_UNUSED const char *path,
+                      G_GNUC_UNUSED const char *interface,
+                      const char *signal, GVariant *parameters, gpointer data)
+{
+    Client *client = data;
+
+    g_atomic_int_inc(&client->swarm->signals);
+    if (g_strcmp0(signal, "PropertiesChanged") == 0)
+    {
+        GVariant *changed, *metadata;
+        g_variant_get(parameters, "(s@a{sv}as)", NULL, &changed, NULL);
+        metadata = g_variant_lookup_value(changed, "Metadata", G_VARIANT_TYPE_VARDICT);
+        if (metadata)
+        {
+            update_track_id(client, metadata);
+            g_variant_unref(metadata);
+        }
+        g_variant_unref(changed);
+    }
+}
+
+static void on_reply(GObject *source, GAsyncResult *result, gpointer data)
+{
+    Call *call = data;
+    Client *client = call->client;
+    GError *error = NULL;
+    GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                    result, &error);
+
+    if (reply)
+    {
+        histogram_record(&client->swarm->latency[call->id],
+                         histogram_now_ns() - call->start);
+        g_variant_unref(reply);
+    }
+    else
+    {
+        g_atomic_int_inc(&client->swarm->errors[call->id]);
+        g_error_free(error);
+    }
+
+    client->in_flight--;
+    g_free(call);
+}
+
+static CallId pick_call(Client *client)
+{
+    Swarm *swarm = client->swarm;
+    guint pick = (guint)g_rand_int_range(client->rand, 0, (gint32)swarm->weight_total);
+
+    for (int i = 0; i < CALL_COUNT; i++)
+    {
+        if (pick < swarm->weights[i])
+        {
+            return i;
+        }
+        pick -= swarm->weights[i];
+    }
+    return CALL_GET;
+}
+
+static void issue_call(Client *client)
+{
+    Call *call = g_new0(Call, 1);
+    const char *interface = PLAYER_INTERFACE;
+    const char *method = NULL;
+    GVariant *parameters = NULL;
+
+    call->client = client;
+    call->id = pick_call(client);
+
+    switch (call->id)
+    {
+    case CALL_GET:
+        interface = "org.freedesktop.DBus.Properties";
+        method = "Get";
+        parameters = g_variant_new("(ss)", PLAYER_INTERFACE,
+                                   get_properties[client->next_get++ % G_N_ELEMENTS(get_properties)]);
+        break;
+    case CALL_GET_ALL:
+        interface = "org.freedesktop.DBus.Properties";
+        method = "GetAll";
+        parameters = g_variant_new("(s)", PLAYER_INTERFACE);
+        break;
+    case CALL_PLAY_PAUSE:
+        method = "PlayPause";
+        break;
+    case CALL_SEEK:
+        method = "Seek";
+        parameters = g_variant_new("(x)", g_rand_boolean(client->rand) ? G_USEC_PER_SEC
+                                                                         : -G_USEC_PER_SEC);
+        break;
+    case CALL_SET_POSITION:
+    default:
+        method = "SetPosition";
+        parameters = g_variant_new("(ox)",
+                                   client->track_id ? client->track_id : "/noplaylist",
+                                   (gint64)g_rand_int_range(client->rand, 0, 10) * G_USEC_PER_SEC);
+        break;
+    }
+
+    g_atomic_int_inc(&client->swarm->calls[call->id]);
+    client->in_flight++;
+    call->start = histogram_now_ns();
+    g_dbus_connection_call(client->connection, client->swarm->destination, MPRIS_PATH,
+                           interface, method, parameters, NULL,
+                           G_DBUS_CALL_FLAGS_NONE, -1, NULL, on_reply, call);
+}
+
+// Issues the calls that became due since the last tick, then stops once
+// the run is over and every reply came back
+static gboolean on_tick(gpointer data)
+{
+    Client *client = data;
+    gint64 now = g_get_monotonic_time();
+    guint64 due = (guint64)((now - client->start) * client->swarm->rate / G_USEC_PER_SEC);
+
+    if (now >= client->swarm->end_time)
+    {
+        if (!client->in_flight || now >= client->swarm->end_time + DRAIN_TIMEOUT_US)
+        {
+            g_main_loop_quit(client->loop);
+            return G_SOURCE_REMOVE;
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    while (client->issued < due)
+    {
+        issue_call(client);
+        client->issued++;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gpointer run_client(gpointer data)
+{
+    Client *client = data;
+    Swarm *swarm = client->swarm;
+    GError *error = NULL;
+    GVariant *reply;
+    GSource *tick;
+    guint subscriptions[2];
+    guint interval_ms = MAX(1, (guint)(1000 / swarm->rate / 2));
+
+    g_main_context_push_thread_default(client->context);
+
+    client->connection = g_dbus_connection_new_for_address_sync(
+        swarm->address,
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+            G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+    if (!client->connection)
+    {
+        g_printerr("Could not connect: %s\n", error->message);
+        g_error_free(error);
+        client->failed = TRUE;
+        g_main_context_pop_thread_default(client->context);
+        return NULL;
+    }
+
+    subscriptions[0] = g_dbus_connection_signal_subscribe(
+        client->connection, swarm->destination, "org.freedesktop.DBus.Properties",
+        "PropertiesChanged", MPRIS_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+        on_signal, client, NULL);
+    subscriptions[1] = g_dbus_connection_signal_subscribe(
+        client->connection, swarm->destination, PLAYER_INTERFACE, "Seeked",
+        MPRIS_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE, on_signal, client, NULL);
+
+    // Clients read the current track first, as they would on startup
+    reply = g_dbus_connection_call_sync(client->connection, swarm->destination, MPRIS_PATH,
+                                        "org.freedesktop.DBus.Properties", "Get",
+                                        g_variant_new("(ss)", PLAYER_INTERFACE, "Metadata"),
+                                        G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE,
+                                        -1, NULL, NULL);
+    if (reply)
+    {
+        GVariant *metadata;
+        g_variant_get(reply, "(v)", &metadata);
+        update_track_id(client, metadata);
+        g_variant_unref(metadata);
+        g_variant_unref(reply);
+    }
+
+    client->start = g_get_monotonic_time();
+    tick = g_timeout_source_new(interval_ms);
+    g_source_set_callback(tick, on_tick, client, NULL);
+    g_source_attach(tick, client->context);
+    g_main_loop_run(client->loop);
+    g_source_destroy(tick);
+    g_source_unref(tick);
+
+    g_dbus_connection_signal_unsubscribe(client->connection, subscriptions[0]);
+    g_dbus_connection_signal_unsubscribe(client->connection, subscriptions[1]);
+    g_dbus_connection_close_sync(client->connection, NULL, NULL);
+    g_clear_object(&client->connection);
+
+    // Let the pending callbacks run before the context goes away
+    while (g_main_context_iteration(client->context, FALSE))
+    {
+    }
+    g_main_context_pop_thread_default(client->context);
+    return NULL;
+}
+
+static guint64 parse_stat_ticks(const char *path)
+{
+    gchar *contents = NULL;
+    guint64 ticks = 0;
+
+    if (g_file_get_contents(path, &contents, NULL, NULL))
+    {
+        // utime and stime are fields 14 and 15, counted after the
+        // parenthesised command name, which may contain spaces
+        const char *fields = strrchr(contents, ')');
+        gchar **parts = fields ? g_strsplit(fields + 2, " ", 0) : NULL;
+        if (parts && g_strv_length(parts) > 12)
+        {
+            ticks = g_ascii_strtoull(parts[11], NULL, 10) +
+                    g_ascii_strtoull(parts[12], NULL, 10);
+        }
+        g_strfreev(parts);
+        g_free(contents);
+    }
+    return ticks;
+}
+
+static gboolean read_cpu(guint32 pid, CpuTimes *times)
+{
+    gchar *path = g_strdup_printf("/proc/%u/stat", pid);
+    gchar *task_dir = g_strdup_printf("/proc/%u/task", pid);
+    GDir *dir;
+    gboolean ok;
+
+    times->process = parse_stat_ticks(path);
+    times->dbus_thread = 0;
+    ok = times->process > 0 || g_file_test(path, G_FILE_TEST_EXISTS);
+
+    dir = ok ? g_dir_open(task_dir, 0, NULL) : NULL;
+    if (dir)
+    {
+        const char *tid;
+        while ((tid = g_dir_read_name(dir)))
+        {
+            gchar *comm_path = g_build_filename(task_dir, tid, "comm", NULL);
+            gchar *comm = NULL;
+            if (g_file_get_contents(comm_path, &comm, NULL, NULL) &&
+                g_str_has_prefix(comm, "mpris-dbus"))
+            {
+                gchar *stat_path = g_build_filename(task_dir, tid, "stat", NULL);
+                times->dbus_thread += parse_stat_ticks(stat_path);
+                g_free(stat_path);
+            }
+            g_free(comm);
+            g_free(comm_path);
+        }
+        g_dir_close(dir);
+    }
+
+    g_free(task_dir);
+    g_free(path);
+    return ok;
+}
+
+static guint32 destination_pid(GDBusConnection *bus, const char *destination)
+{
+    guint32 pid = 0;
+    GVariant *reply = g_dbus_connection_call_sync(bus, "org.freedesktop.DBus",
+                                                  "/org/freedesktop/DBus",
+                                                  "org.freedesktop.DBus",
+                                                  "GetConnectionUnixProcessID",
+                                                  g_variant_new("(s)", destination),
+                                                  G_VARIANT_TYPE("(u)"),
+                                                  G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+    if (reply)
+    {
+        g_variant_get(reply, "(u)", &pid);
+        g_variant_unref(reply);
+    }
+    return pid;
+}
+
+static guint64 lookup_u64(GVariant *snapshot, const char *key)
+{
+    guint64 value = 0;
+
+    g_variant_lookup(snapshot, key, "t", &value);
+    return value;
+}
+
+static void print_round(Swarm *swarm, guint clients, double seconds,
+                        gboolean have_cpu, const CpuTimes *before, const CpuTimes *after)
+{
+    guint64 completed = 0;
+    double ticks = sysconf(_SC_CLK_TCK);
+
+    printf("\n%u clients, %.0f calls/s each, %.1f s\n", clients, swarm->rate, seconds);
+    printf("%-12s %9s %7s %9s %9s %9s %9s %9s\n", "", "calls", "errors",
+           "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+    for (int i = 0; i < CALL_COUNT; i++)
+    {
+        GVariant *snapshot;
+        guint64 count;
+
+        if (!swarm->weights[i])
+        {
+            continue;
+        }
+        snapshot = g_variant_ref_sink(histogram_snapshot(&swarm->latency[i]));
+        count = lookup_u64(snapshot, "count");
+        completed += count;
+        printf("%-12s %9d %7d %9.0f %9.0f %9.0f %9.0f %9.0f\n", call_names[i],
+               g_atomic_int_get(&swarm->calls[i]), g_atomic_int_get(&swarm->errors[i]),
+               lookup_u64(snapshot, "p50") / 1000.0, lookup_u64(snapshot, "p90") / 1000.0,
+               lookup_u64(snapshot, "p99") / 1000.0, lookup_u64(snapshot, "p999") / 1000.0,
+               lookup_u64(snapshot, "max") / 1000.0);
+        g_variant_unref(snapshot);
+    }
+
+    printf("throughput %.0f calls/s, %d signals received\n",
+           completed / seconds, g_atomic_int_get(&swarm->signals));
+    if (have_cpu)
+    {
+        printf("mpv cpu %.1f%%, mpris-dbus thread %.1f%% (of one core)\n",
+               100.0 * (after->process - before->process) / ticks / seconds,
+               100.0 * (after->dbus_thread - before->dbus_thread) / ticks / seconds);
+    }
+    else
+    {
+        printf("mpv cpu unavailable (not a local process)\n");
+    }
+}
+
+static gboolean run_round(Swarm *swarm, guint clients, guint seconds, guint32 pid)
+{
+    Client *swarm_clients = g_new0(Client, clients);
+    CpuTimes before, after;
+    gboolean have_cpu, ok = TRUE;
+    gint64 start;
+
+    for (int i = 0; i < CALL_COUNT; i++)
+    {
+        histogram_reset(&swarm->latency[i]);
+        g_atomic_int_set(&swarm->calls[i], 0);
+        g_atomic_int_set(&swarm->errors[i], 0);
+    }
+    g_atomic_int_set(&swarm->signals, 0);
+
+    have_cpu = pid && read_cpu(pid, &before);
+    start = g_get_monotonic_time();
+    swarm->end_time = start + seconds * G_USEC_PER_SEC;
+
+    for (guint i = 0; i < clients; i++)
+    {
+        Client *client = &swarm_clients[i];
+        gchar *name = g_strdup_printf("client-%u", i);
+        client->swarm = swarm;
+        client->context = g_main_context_new();
+        client->loop = g_main_loop_new(client->context, FALSE);
+        client->rand = g_rand_new_with_seed(i);
+        client->thread = g_thread_new(name, run_client, client);
+        g_free(name);
+    }
+
+    for (guint i = 0; i < clients; i++)
+    {
+        Client *client = &swarm_clients[i];
+        g_thread_join(client->thread);
+        ok = ok && !client->failed;
+        g_main_loop_unref(client->loop);
+        g_main_context_unref(client->context);
+        g_rand_free(client->rand);
+        g_free(client->track_id);
+    }
+
+    have_cpu = have_cpu && read_cpu(pid, &after);
+    if (ok)
+    {
+        print_round(swarm, clients, (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC,
+                    have_cpu, &before, &after);
+    }
+    g_free(swarm_clients);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    Swarm swarm = {0};
+    GError *error = NULL;
+    GOptionContext *options;
+    GDBusConnection *bus;
+    gchar *destination = NULL;
+    gchar *mix = NULL;
+    gint clients = 10;
+    gint seconds = 10;
+    gboolean ramp = FALSE;
+    guint32 pid;
+    int ret = EXIT_SUCCESS;
+    GOptionEntry entries[] = {
+        {"clients", 'n', 0, G_OPTION_ARG_INT, &clients,
+         "Number of clients (10)", "N"},
+        {"rate", 'r', 0, G_OPTION_ARG_DOUBLE, &swarm.rate,
+         "Calls per second of each client (20)", "RATE"},
+        {"mix", 'm', 0, G_OPTION_ARG_STRING, &mix,
+         "Weights of the calls (get=60,getall=20,playpause=5,seek=10,setposition=5)", "MIX"},
+        {"duration", 'd', 0, G_OPTION_ARG_INT, &seconds,
+         "Seconds per run (10)", "SECONDS"},
+        {"ramp", 0, 0, G_OPTION_ARG_NONE, &ramp,
+         "Run with 1, 2, 4, ... up to N clients", NULL},
+        {"dest", 0, 0, G_OPTION_ARG_STRING, &destination,
+         "Bus name of the player (org.mpris.MediaPlayer2.mpv)", "NAME"},
+        {NULL, 0, 0, 0, NULL, NULL, NULL}};
+
+    swarm.rate = 20;
+    options = g_option_context_new("- MPRIS client swarm");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (!g_option_context_parse(options, &argc, &argv, &error) ||
+        !parse_mix(mix ? mix : "get=60,getall=20,playpause=5,seek=10,setposition=5",
+                   &swarm, &error))
+    {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(options);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(options);
+
+    if (clients <= 0 || seconds <= 0 || swarm.rate <= 0)
+    {
+        g_printerr("--clients, --duration and --rate have to be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    swarm.destination = destination ? destination : "org.mpris.MediaPlayer2.mpv";
+    swarm.address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    bus = swarm.address ? g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error) : NULL;
+    if (!bus)
+    {
+        g_printerr("No session bus: %s\n", error->message);
+        g_error_free(error);
+        return EXIT_FAILURE;
+    }
+
+    pid = destination_pid(bus, swarm.destination);
+    if (!pid)
+    {
+        g_printerr("%s is not on the bus\n", swarm.destination);
+        ret = EXIT_FAILURE;
+    }
+
+    for (gint n = ramp ? 1 : clients; ret == EXIT_SUCCESS; n = MIN(n * 2, clients))
+    {
+        if (!run_round(&swarm, n, seconds, pid))
+        {
+            ret = EXIT_FAILURE;
+        }
+        if (n == clients)
+        {
+            break;
+        }
+    }
+
+    g_object_unref(bus);
+    g_free(swarm.address);
+    g_free(destination);
+    g_free(mix);
+    return ret;
+}